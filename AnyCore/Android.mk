@@ -16,6 +16,36 @@
 # Ucc Jni
 LOCAL_PATH := $(call my-dir)
 ANYCORE := ./
+LIVE555 := lib_rtsp
+LIVE555_INCLUDES := $(LOCAL_PATH)/$(LIVE555)/UsageEnvironment/include \
+		$(LOCAL_PATH)/$(LIVE555)/BasicUsageEnvironment/include \
+		$(LOCAL_PATH)/$(LIVE555)/groupsock/include \
+		$(LOCAL_PATH)/$(LIVE555)/liveMedia/include
+LIVE555_CFLAGS := -DSOCKLEN_T=socklen_t -DNO_SSTREAM=1 -DBSD=1 -D_LARGEFILE_SOURCE=1 -D_FILE_OFFSET_BITS=64 -DXLOCALE_NOT_USED
+
+################################################################
+# live555
+include $(CLEAR_VARS)
+
+LOCAL_MODULE    := rtsp
+
+LOCAL_SRC_FILES := $(patsubst $(LOCAL_PATH)/%,%,$(wildcard \
+		$(LOCAL_PATH)/$(LIVE555)/UsageEnvironment/*.cpp \
+		$(LOCAL_PATH)/$(LIVE555)/BasicUsageEnvironment/*.cpp \
+		$(LOCAL_PATH)/$(LIVE555)/groupsock/*.cpp \
+		$(LOCAL_PATH)/$(LIVE555)/groupsock/*.c \
+		$(LOCAL_PATH)/$(LIVE555)/liveMedia/*.cpp \
+		$(LOCAL_PATH)/$(LIVE555)/liveMedia/*.c))
+
+LOCAL_CFLAGS := $(LIVE555_CFLAGS)
+LOCAL_CPPFLAGS := -fexceptions
+
+LOCAL_C_INCLUDES += $(LIVE555_INCLUDES)
+
+include $(BUILD_STATIC_LIBRARY)
+
+################################################################
+# AnyCore
 include $(CLEAR_VARS)
 
 LOCAL_MODULE    := anycore
@@ -23,29 +53,38 @@ LOCAL_MODULE    := anycore
 LOCAL_SRC_FILES := $(ANYCORE)/srs_librtmp/srs_librtmp.cpp \
 		$(ANYCORE)/aacencode.cc \
 		$(ANYCORE)/aacdecode.cc \
+		$(ANYCORE)/anyhlswriter.cc \
 		$(ANYCORE)/anyrtmpcore.cc \
 		$(ANYCORE)/anyrtmplayer.cc \
+		$(ANYCORE)/anyrtmprelay.cc \
 		$(ANYCORE)/anyrtmpstreamer.cc \
 		$(ANYCORE)/anyrtmpull.cc \
 		$(ANYCORE)/anyrtmpush.cc \
+		$(ANYCORE)/anyrtspgateway.cc \
+		$(ANYCORE)/anyrtspserver.cc \
 		$(ANYCORE)/avcodec.cc \
+		$(ANYCORE)/demuxframe.cc \
+		$(ANYCORE)/encbuffer.cc \
 		$(ANYCORE)/plybuffer.cc \
 		$(ANYCORE)/plydecoder.cc \
 		$(ANYCORE)/RtmpGuesterImpl.cc \
 		$(ANYCORE)/RtmpHosterImpl.cc \
+		$(ANYCORE)/rtmpreactor.cc \
+		$(ANYCORE)/rtspreactor.cc \
 		$(ANYCORE)/videofilter.cc
 	
 ## 
 ## Widows (call host-path,/cygdrive/path/to/your/file/libstlport_shared.so) 	
 #		   
 #LOCAL_LDLIBS := -llog
-LOCAL_CFLAGS := -std=gnu++11 -frtti -Wno-literal-suffix -DWEBRTC_POSIX -DWEBRTC_ANDROID -DWEBRTC_INCLUDE_INTERNAL_AUDIO_DEVICE -D__STDC_CONSTANT_MACROS 
+LOCAL_CFLAGS := -std=gnu++11 -frtti -Wno-literal-suffix -DWEBRTC_POSIX -DWEBRTC_ANDROID -DWEBRTC_INCLUDE_INTERNAL_AUDIO_DEVICE -D__STDC_CONSTANT_MACROS $(LIVE555_CFLAGS)
 #
 
 LOCAL_C_INCLUDES += $(NDK_STL_INC) \
 		$(LOCAL_PATH)/srs_librtmp \
 		$(LOCAL_PATH)/../ \
 		$(LOCAL_PATH)/../third_party/faac-1.28/include \
-		$(LOCAL_PATH)/../third_party/faad2-2.7/include
+		$(LOCAL_PATH)/../third_party/faad2-2.7/include \
+		$(LIVE555_INCLUDES)
 					
 include $(BUILD_STATIC_LIBRARY)
\ No newline at end of file
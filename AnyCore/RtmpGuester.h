@@ -33,7 +33,9 @@ public:
 	virtual ~RTMPGuesterEvent(void) {};
 
 	virtual void OnRtmplayerOK() = 0;
-	virtual void OnRtmplayerStatus(int cacheTime, int curBitrate) = 0;
+	//* cacheTime: current buffered delay, targetDelay: delay the jitter buffer aims at,
+	//* minDelay: minimum buffered delay in the last second, all in ms.
+	virtual void OnRtmplayerStatus(int cacheTime, int curBitrate, int targetDelay, int minDelay) = 0;
 	virtual void OnRtmplayerCache(int time) = 0;
 	virtual void OnRtmplayerClosed(int errcode/*0:OK */) = 0;
 };
@@ -49,6 +51,8 @@ public:
 	virtual void StopRtmpPlay() = 0;
 
 	virtual void SetAudioEnable(bool enabled) = 0;
+	//* volume: 0.0 ~ 1.0 (or more to amplify), the audio of all guesters is mixed for playout.
+	virtual void SetAudioVolume(float volume) = 0;
 
 protected:
 	virtual void* GotSelfPtr() = 0;
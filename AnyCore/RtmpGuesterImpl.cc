@@ -36,6 +36,7 @@ RtmpGuesterImpl::RtmpGuesterImpl(RTMPGuesterEvent&callback)
 	, av_rtmp_player_(NULL)
 	, video_render_(NULL)
 	, audio_enabled_(true)
+	, audio_volume_(1.0f)
 {
 	av_rtmp_player_ = AnyRtmplayer::Create(*this);
 }
@@ -66,6 +67,7 @@ void RtmpGuesterImpl::StartRtmpPlay(const char* url, void* render)
 		av_rtmp_player_->SetVideoRender(video_render_);
 		av_rtmp_player_->StartPlay(url);
 		webrtc::AnyRtmpCore::Inst().StartAudioTrack(this);
+		webrtc::AnyRtmpCore::Inst().SetAudioTrackGain(this, audio_volume_);
 	}
 }
 
@@ -74,7 +76,7 @@ void RtmpGuesterImpl::StopRtmpPlay()
 	if (av_rtmp_started_) {
 		av_rtmp_started_ = false;
 		rtmp_url_ = "";
-		webrtc::AnyRtmpCore::Inst().StopAudioTrack();
+		webrtc::AnyRtmpCore::Inst().StopAudioTrack(this);
 		av_rtmp_player_->StopPlay();
 		if (video_render_ != NULL) {
 			delete video_render_;
@@ -88,21 +90,28 @@ void RtmpGuesterImpl::SetAudioEnable(bool enabled)
 	if (enabled) {
 		audio_enabled_ = true;
 		webrtc::AnyRtmpCore::Inst().StartAudioTrack(this);		
+		webrtc::AnyRtmpCore::Inst().SetAudioTrackGain(this, audio_volume_);
 	}
 	else {
 		audio_enabled_ = false;
-		webrtc::AnyRtmpCore::Inst().StopAudioTrack();		
+		webrtc::AnyRtmpCore::Inst().StopAudioTrack(this);		
 	}
 }
 
+void RtmpGuesterImpl::SetAudioVolume(float volume)
+{
+	audio_volume_ = volume;
+	webrtc::AnyRtmpCore::Inst().SetAudioTrackGain(this, volume);
+}
+
 //* For AnyRtmplayerEvent
 void RtmpGuesterImpl::OnRtmplayerOK()
 {
 	callback_.OnRtmplayerOK();
 }
-void RtmpGuesterImpl::OnRtmplayerStatus(int cacheTime, int curBitrate)
+void RtmpGuesterImpl::OnRtmplayerStatus(int cacheTime, int curBitrate, int targetDelay, int minDelay)
 {
-	callback_.OnRtmplayerStatus(cacheTime, curBitrate);
+	callback_.OnRtmplayerStatus(cacheTime, curBitrate, targetDelay, minDelay);
 }
 void RtmpGuesterImpl::OnRtmplayerCache(int time)
 {
@@ -35,13 +35,14 @@ public:
 	virtual void StopRtmpPlay();
 
 	virtual void SetAudioEnable(bool enabled);
+	virtual void SetAudioVolume(float volume);
 
 	virtual void* GotSelfPtr() { return this; };
 
 protected:
 	//* For AnyRtmplayerEvent
 	virtual void OnRtmplayerOK();
-	virtual void OnRtmplayerStatus(int cacheTime, int curBitrate);
+	virtual void OnRtmplayerStatus(int cacheTime, int curBitrate, int targetDelay, int minDelay);
 	virtual void OnRtmplayerCache(int time);
 	virtual void OnRtmplayerClose(int errcode);
 
@@ -59,6 +60,7 @@ private:
 	rtc::VideoSinkInterface < cricket::VideoFrame >	*video_render_;
 
 	bool audio_enabled_;
+	float audio_volume_;
 };
 
 #endif	// __RTMP_GUSTER_IMPL_H__
\ No newline at end of file
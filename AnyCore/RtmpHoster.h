@@ -32,7 +32,8 @@ public:
 public:
 	virtual void OnRtmpStreamOK() = 0;
 	virtual void OnRtmpStreamReconnecting(int times) = 0;
-	virtual void OnRtmpStreamStatus(int delayMs, int netBand) = 0;
+	//* dropFrames and dropBytes: media dropped from the send queue since the last status.
+	virtual void OnRtmpStreamStatus(int delayMs, int netBand, int dropFrames, int dropBytes) = 0;
 	virtual void OnRtmpStreamFailed(int code) = 0;
 	virtual void OnRtmpStreamClosed() = 0;
 };
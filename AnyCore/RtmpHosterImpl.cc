@@ -289,9 +289,9 @@ void RtmpHosterImpl::OnStreamClosed()
 {
 	callback_.OnRtmpStreamClosed();
 }
-void RtmpHosterImpl::OnStreamStatus(int delayMs, int netBand)
+void RtmpHosterImpl::OnStreamStatus(int delayMs, int netBand, int dropFrames, int dropBytes)
 {
-	callback_.OnRtmpStreamStatus(delayMs, netBand);
+	callback_.OnRtmpStreamStatus(delayMs, netBand, dropFrames, dropBytes);
 }
 
 
@@ -313,7 +313,9 @@ void RtmpHosterImpl::OnMessage(rtc::Message* msg)
 void RtmpHosterImpl::OnRecordAudio(const void* audioSamples, const size_t nSamples,
 	const size_t nBytesPerSample, const size_t nChannels, const uint32_t samplesPerSec, const uint32_t totalDelayMS)
 {
-	webrtc::AudioSinkInterface::Data audio((int16_t*)audioSamples, nSamples, samplesPerSec, nChannels, totalDelayMS);
+	//* Stamp with the capture time of the first sample, the chunk is delivered when recorded.
+	uint32_t captureMs = rtc::Time() - (uint32_t)(nSamples * 1000 / samplesPerSec);
+	webrtc::AudioSinkInterface::Data audio((int16_t*)audioSamples, nSamples, samplesPerSec, nChannels, captureMs);
 	((webrtc::AnyRtmpStreamerImpl*)av_rtmp_streamer_)->GetAudioSink()->OnData(audio);
 }
 
@@ -62,7 +62,7 @@ public:
 	virtual void OnStreamReconnecting(int times);
 	virtual void OnStreamFailed(int code);
 	virtual void OnStreamClosed();
-	virtual void OnStreamStatus(int delayMs, int netBand);
+	virtual void OnStreamStatus(int delayMs, int netBand, int dropFrames, int dropBytes);
 
 public:
 	//* For rtc::MessageHandler
@@ -24,6 +24,16 @@ extern "C"
 #include <faac.h>
 }
 #define DEFAULT_TNS     0
+#define PCM_GAIN_UNITY	4096	// Q12
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define AAC_PCM_SSE2
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define AAC_PCM_NEON
+	#include <arm_neon.h>
+#endif
+
 typedef struct tagAacENC
 {
 	tagAacENC(void)
@@ -34,6 +44,8 @@ typedef struct tagAacENC
 		, nMaxOutputBytes(0)
 		, nPcmSize(0)
 		, nPcmALen(0)
+		, nChannels(1)
+		, nFramesOut(0)
 	{
 	}
 
@@ -45,6 +57,8 @@ typedef struct tagAacENC
 	unsigned char*	pPCM;
 	int				nPcmSize;
 	int				nPcmALen;
+	int				nChannels;
+	long long		nFramesOut;
 
 }AacENC, *PAacENC;
 
@@ -59,6 +73,7 @@ void*aac_encoder_open(unsigned char ucAudioChannel, unsigned int u32AudioSampler
 	pEnc->hEncoder = faacEncOpen(u32AudioSamplerate, ucAudioChannel, &nInputSamples, &nMaxOutputBytes);
 
 	pEnc->nInputSamples = nInputSamples;
+	pEnc->nChannels = ucAudioChannel > 0 ? ucAudioChannel : 1;
 	pEnc->nPcmSize = nInputSamples * u32PCMBitSize / 8;
 	if (pEnc->nPcmSize > 0) {
 		pEnc->pPCM = new unsigned char[pEnc->nPcmSize];
@@ -102,27 +117,134 @@ void aac_encoder_close(void*pHandle)
 	}
 }
 
+int aac_encoder_get_info(void*pHandle, unsigned int* frameSamples, unsigned int* maxFrameBytes)
+{
+	if (pHandle == NULL)
+		return -1;
+	AacENC* pEnc = (AacENC*)pHandle;
+	if (frameSamples)
+		*frameSamples = pEnc->nInputSamples / pEnc->nChannels;
+	if (maxFrameBytes)
+		*maxFrameBytes = pEnc->nMaxOutputBytes;
+	return 0;
+}
+
 int aac_encoder_encode_frame(void*pHandle, unsigned char* inbuf, unsigned int inlen, unsigned char* outbuf, unsigned int* outlen)
 {
-	int ret = 0;
-	if (pHandle != NULL) {
-		AacENC* pEnc = (AacENC*)pHandle;
-		if (pEnc->nPcmALen + inlen < pEnc->nPcmSize){
-			memcpy(pEnc->pPCM + pEnc->nPcmALen, inbuf, inlen);
-			pEnc->nPcmALen += inlen;
-			return 0;
+	if (pHandle == NULL)
+		return 0;
+	AacENC* pEnc = (AacENC*)pHandle;
+	aac_enc_frame_t frame;
+	unsigned int inused = 0;
+	//* The pcm short of a frame is kept by the encoder, only what would be a
+	//* second frame is left unused and dropped.
+	int ret = aac_encoder_encode_frames(pHandle, inbuf, inlen, &inused, pEnc->pOutput, pEnc->nMaxOutputBytes, &frame, 1);
+	if (ret > 0) {
+		memcpy(outbuf, pEnc->pOutput + frame.offset, frame.size);
+		*outlen = frame.size;
+	}
+	return ret;
+}
+
+int aac_encoder_encode_frames(void*pHandle, const unsigned char* inbuf, unsigned int inlen, unsigned int* inused,
+	unsigned char* outbuf, unsigned int outsize, aac_enc_frame_t* frames, int maxFrames)
+{
+	if (pHandle == NULL)
+		return -1;
+	AacENC* pEnc = (AacENC*)pHandle;
+	unsigned int used = 0;
+	unsigned int outpos = 0;
+	int count = 0;
+	while (used < inlen) {
+		unsigned int room = pEnc->nPcmSize - pEnc->nPcmALen;
+		if (inlen - used >= room) {
+			//* A frame will be encoded, make sure it fits.
+			if (count >= maxFrames || outsize - outpos < (unsigned int)pEnc->nMaxOutputBytes)
+				break;
+		}
+		unsigned int n = inlen - used < room ? inlen - used : room;
+		memcpy(pEnc->pPCM + pEnc->nPcmALen, inbuf + used, n);
+		pEnc->nPcmALen += n;
+		used += n;
+		if (pEnc->nPcmALen < pEnc->nPcmSize)
+			break;
+
+		pEnc->nPcmALen = 0;
+		int nRet = faacEncEncode(pEnc->hEncoder, (int*)pEnc->pPCM, pEnc->nInputSamples, outbuf + outpos, outsize - outpos);
+		if (nRet < 0) {
+			count = -1;
+			break;
 		}
-		else{
-			ret = pEnc->nPcmALen;
-			memcpy(pEnc->pPCM + pEnc->nPcmALen, inbuf, pEnc->nPcmSize - pEnc->nPcmALen);
-			int nRet = faacEncEncode(pEnc->hEncoder, (int*)pEnc->pPCM, pEnc->nInputSamples, pEnc->pOutput, pEnc->nMaxOutputBytes);
-			if (nRet > 0) {
-				memcpy(outbuf , pEnc->pOutput, nRet);
-				*outlen = (unsigned int)nRet;
-			}
-			memcpy(pEnc->pPCM, inbuf + (pEnc->nPcmSize - pEnc->nPcmALen), inlen - (pEnc->nPcmSize - pEnc->nPcmALen));
-			pEnc->nPcmALen = inlen - (pEnc->nPcmSize - pEnc->nPcmALen);
+		if (nRet > 0) {
+			//* The first frames are taken by the encoder delay, the output is counted from then.
+			frames[count].offset = outpos;
+			frames[count].size = nRet;
+			frames[count].pts = pEnc->nFramesOut * (pEnc->nInputSamples / pEnc->nChannels);
+			pEnc->nFramesOut++;
+			outpos += nRet;
+			count++;
 		}
 	}
-	return ret;
-}
\ No newline at end of file
+	if (inused)
+		*inused = used;
+	return count;
+}
+
+void aac_pcm_process(short* pcm, unsigned int samples, int gainQ12, short gate, bool mute)
+{
+	if (mute) {
+		memset(pcm, 0, samples * sizeof(short));
+		return;
+	}
+	if (gate < 0)
+		gate = 0;
+	if (gainQ12 < 0)
+		gainQ12 = 0;
+	if (gainQ12 > 32767)
+		gainQ12 = 32767;
+	//* Soft gate: x - clamp(x, -gate, gate), zero inside the gate and moved toward zero by it outside.
+	unsigned int i = 0;
+#if defined(AAC_PCM_SSE2)
+	const __m128i hi = _mm_set1_epi16(gate);
+	const __m128i lo = _mm_set1_epi16(-gate);
+	const __m128i gain = _mm_set1_epi16((short)gainQ12);
+	const __m128i round = _mm_set1_epi32(PCM_GAIN_UNITY / 2);
+	for (; i + 8 <= samples; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(pcm + i));
+		x = _mm_sub_epi16(x, _mm_min_epi16(_mm_max_epi16(x, lo), hi));
+		if (gainQ12 != PCM_GAIN_UNITY) {
+			__m128i l = _mm_mullo_epi16(x, gain);
+			__m128i h = _mm_mulhi_epi16(x, gain);
+			__m128i p0 = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(l, h), round), 12);
+			__m128i p1 = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(l, h), round), 12);
+			x = _mm_packs_epi32(p0, p1);
+		}
+		_mm_storeu_si128((__m128i*)(pcm + i), x);
+	}
+#elif defined(AAC_PCM_NEON)
+	const int16x8_t hi = vdupq_n_s16(gate);
+	const int16x8_t lo = vdupq_n_s16(-gate);
+	for (; i + 8 <= samples; i += 8) {
+		int16x8_t x = vld1q_s16(pcm + i);
+		x = vsubq_s16(x, vminq_s16(vmaxq_s16(x, lo), hi));
+		if (gainQ12 != PCM_GAIN_UNITY) {
+			int32x4_t p0 = vmull_n_s16(vget_low_s16(x), (short)gainQ12);
+			int32x4_t p1 = vmull_n_s16(vget_high_s16(x), (short)gainQ12);
+			x = vcombine_s16(vqrshrn_n_s32(p0, 12), vqrshrn_n_s32(p1, 12));
+		}
+		vst1q_s16(pcm + i, x);
+	}
+#endif
+	for (; i < samples; i++) {
+		int x = pcm[i];
+		x -= x < -gate ? -gate : (x > gate ? gate : x);
+		if (gainQ12 != PCM_GAIN_UNITY) {
+			x = (x * gainQ12 + PCM_GAIN_UNITY / 2) >> 12;
+			if (x > 32767)
+				x = 32767;
+			else if (x < -32768)
+				x = -32768;
+		}
+		pcm[i] = (short)x;
+	}
+}
@@ -0,0 +1,231 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "anyhlswriter.h"
+#include <string.h>
+#include "srs_librtmp.h"
+#include "webrtc/base/atomicops.h"
+#include "webrtc/base/bind.h"
+#include "webrtc/base/logging.h"
+
+#define HLS_MAX_NALUS		64			// Max NALUs of one frame, the left data is in the last one
+#define HLS_VIDEO_QUEUE		1024		// Max NALUs waiting for the writer
+#define HLS_AUDIO_QUEUE		512			// Max audio frames waiting for the writer
+#define HLS_MAX_WRITES		256			// Max frames written per loop, keep the thread responsive
+
+enum {
+	MSG_WRITE		// New data in the queues
+};
+
+//* The flv flags of aac, the ts muxer takes the audio config from the adts header,
+//* the rate is not one of 11/22/44 kHz, which overrides the sample rate of adts.
+#define HLS_SOUND_FORMAT	10			// 10 = AAC
+#define HLS_SOUND_RATE		0
+#define HLS_SOUND_SIZE		1			// 1 = 16-bit samples
+#define HLS_SOUND_TYPE		1			// 1 = Stereo sound
+
+AnyHlsWriter::AnyHlsWriter(const std::string&m3u8, int segmentMs, int window)
+: writer_(NULL)
+, hls_(NULL)
+, muxer_(NULL)
+, need_keyframe_(true)
+, only_audio_mode_(false)
+, que_video_enc_(HLS_VIDEO_QUEUE)
+, que_audio_enc_(HLS_AUDIO_QUEUE)
+, write_posted_(0)
+, drop_frames_(0)
+{
+	hls_ = srs_hls_open(m3u8.c_str(), segmentMs, window);
+	if (hls_ == NULL) {
+		LOG(LS_ERROR) << "AnyHlsWriter invalid playlist " << m3u8;
+		return;
+	}
+	muxer_ = srs_rtmp_create("");
+	if (muxer_ == NULL) {
+		srs_hls_close(hls_);
+		hls_ = NULL;
+		return;
+	}
+	srs_rtmp_set_hls(muxer_, hls_);
+
+	writer_ = new rtc::Thread();
+	writer_->SetName("AnyHlsWriter", this);
+	writer_->Start();
+}
+
+AnyHlsWriter::~AnyHlsWriter(void)
+{
+	//* No producer is left, the streamer takes us out under the lock the encoders push with.
+	if (writer_) {
+		writer_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&AnyHlsWriter::DoClose, this));
+		writer_->Clear(this);
+		writer_->Stop();
+		delete writer_;
+		writer_ = NULL;
+	}
+	ClearEncData();
+}
+
+void AnyHlsWriter::EnableOnlyAudioMode()
+{
+	only_audio_mode_ = true;
+}
+
+void AnyHlsWriter::SetH264Data(uint8_t* pData, int len, uint32_t dts, uint32_t pts)
+{
+	if (hls_ == NULL)
+		return;
+	int nalus[HLS_MAX_NALUS];
+	int nb_nalus[HLS_MAX_NALUS];
+	int count = srs_h264_scan_nalus((char*)pData, len, nalus, nb_nalus, HLS_MAX_NALUS);
+	if (count == 0)
+		return;
+	//* The segments start at the keyframe, which comes after the sps.
+	if ((pData[nalus[0]] & 0x1f) == 7)
+		need_keyframe_ = false;
+	if (need_keyframe_)
+		return;
+	//* Each NALU without start code in a pooled buffer, srs_librtmp muxes the flv header in the headroom.
+	for (int i = 0; i < count; i++) {
+		EncBuffer* buf = EncBuffer::Create(nb_nalus[i]);
+		memcpy(buf->Data(), pData + nalus[i], nb_nalus[i]);
+		buf->SetSize(nb_nalus[i]);
+		PushEncData(VIDEO_DATA, buf, dts, pts);
+	}
+}
+
+void AnyHlsWriter::SetAacData(uint8_t* pData, int len, uint32_t ts)
+{
+	if (hls_ == NULL)
+		return;
+	if (need_keyframe_ && !only_audio_mode_)
+		return;
+	//* Always a copy, the buffer shared with AnyRtmpPush is muxed in place by it.
+	EncBuffer* buf = EncBuffer::Create(len);
+	memcpy(buf->Data(), pData, len);
+	buf->SetSize(len);
+	PushEncData(AUDIO_DATA, buf, ts, ts);
+}
+
+void AnyHlsWriter::OnMessage(rtc::Message* msg)
+{
+	switch (msg->message_id) {
+	case MSG_WRITE:
+		rtc::AtomicOps::ReleaseStore(&write_posted_, 0);
+		DoWrite();
+		break;
+	}
+}
+
+void AnyHlsWriter::PushEncData(ENC_DATA_TYPE type, EncBuffer* buf, uint32_t dts, uint32_t pts)
+{
+	EncData* pdata = new EncData();
+	pdata->_buf = buf;
+	pdata->_dataLen = buf->Size();
+	pdata->_bVideo = (type == VIDEO_DATA);
+	pdata->_type = type;
+	pdata->_dts = dts;
+	pdata->_pts = pts;
+	rtc::SpscQueue<EncData*>& que = (type == AUDIO_DATA) ? que_audio_enc_ : que_video_enc_;
+	if (!que.Push(&pdata)) {
+		//* The disk is stuck, restart the video at the next keyframe.
+		if (type == VIDEO_DATA)
+			need_keyframe_ = true;
+		rtc::AtomicOps::Increment(&drop_frames_);
+		delete pdata;
+		return;
+	}
+	if (rtc::AtomicOps::CompareAndSwap(&write_posted_, 0, 1) == 0) {
+		writer_->Post(RTC_FROM_HERE, this, MSG_WRITE);
+	}
+}
+
+void AnyHlsWriter::DoWrite()
+{
+	//* Merge the two queues by dts, each of them is in dts order.
+	EncData** video = que_video_enc_.Front();
+	EncData** audio = que_audio_enc_.Front();
+	int writes = 0;
+	while ((video != NULL || audio != NULL) && writes < HLS_MAX_WRITES) {
+		EncData* pdata = NULL;
+		if (audio == NULL || (video != NULL && (int)((*video)->_dts - (*audio)->_dts) <= 0)) {
+			que_video_enc_.Pop(&pdata);
+			video = que_video_enc_.Front();
+		}
+		else {
+			que_audio_enc_.Pop(&pdata);
+			audio = que_audio_enc_.Front();
+		}
+		writes++;
+
+		//* The buffer is released by srs_librtmp when written, even if error.
+		EncBuffer* buf = pdata->_buf;
+		pdata->_buf = NULL;
+		int ret = 0;
+		if (pdata->_type == VIDEO_DATA) {
+			ret = srs_h264_write_raw_frame_nocopy(muxer_, (char*)buf->Data(), buf->Size(),
+				pdata->_dts, pdata->_pts, EncBuffer::FreeData, buf);
+			if (srs_h264_is_dvbsp_error(ret) || srs_h264_is_duplicated_sps_error(ret) || srs_h264_is_duplicated_pps_error(ret))
+				ret = 0;
+		}
+		else {
+			ret = srs_audio_write_raw_frame_nocopy(muxer_,
+				HLS_SOUND_FORMAT, HLS_SOUND_RATE, HLS_SOUND_SIZE, HLS_SOUND_TYPE,
+				(char*)buf->Data(), buf->Size(), pdata->_dts, EncBuffer::FreeData, buf);
+		}
+		if (ret != 0) {
+			srs_human_trace("write hls failed. ret=%d", ret);
+		}
+		delete pdata;
+	}
+
+	if (video != NULL || audio != NULL) {
+		//* Go on after the other messages of the thread.
+		if (rtc::AtomicOps::CompareAndSwap(&write_posted_, 0, 1) == 0) {
+			writer_->Post(RTC_FROM_HERE, this, MSG_WRITE);
+		}
+	}
+}
+
+void AnyHlsWriter::DoClose()
+{
+	//* Write all queued, then reap the last segment and end the playlist.
+	while (que_video_enc_.Front() != NULL || que_audio_enc_.Front() != NULL) {
+		DoWrite();
+	}
+	if (muxer_) {
+		srs_rtmp_destroy(muxer_);
+		muxer_ = NULL;
+	}
+	if (hls_) {
+		srs_hls_close(hls_);
+		hls_ = NULL;
+	}
+	if (drop_frames_ > 0) {
+		LOG(LS_WARNING) << "AnyHlsWriter dropped " << drop_frames_ << " frames for the slow disk";
+	}
+}
+
+void AnyHlsWriter::ClearEncData()
+{
+	EncData* pdata = NULL;
+	while (que_video_enc_.Pop(&pdata))
+		delete pdata;
+	while (que_audio_enc_.Pop(&pdata))
+		delete pdata;
+}
@@ -0,0 +1,67 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __ANY_HLS_WRITER_H__
+#define __ANY_HLS_WRITER_H__
+#include <string>
+#include "anyrtmpush.h"
+#include "webrtc/base/thread.h"
+
+//* Writes the encoded media to rolling mpegts segments and a m3u8 playlist,
+//* by the ts muxer of srs_librtmp, without the rtmp server or a second process.
+//* The segments are cut at the first keyframe after segmentMs, the playlist
+//* keeps the last window of them, 0 to keep all for recording. The files are
+//* written on a thread of the writer, in whole pages by a buffer, and the
+//* playlist only lists the completed segments, so it's valid even if crash.
+class AnyHlsWriter : public rtc::MessageHandler
+{
+public:
+	AnyHlsWriter(const std::string&m3u8, int segmentMs, int window);
+	virtual ~AnyHlsWriter(void);
+
+	bool IsOpen() const { return hls_ != NULL; };
+	void EnableOnlyAudioMode();
+
+	//* Timestamps are the capture time in ms, the data is copied.
+	void SetH264Data(uint8_t* pdata, int len, uint32_t dts, uint32_t pts);
+	void SetAacData(uint8_t* pdata, int len, uint32_t ts);
+
+protected:
+	//* For rtc::MessageHandler
+	virtual void OnMessage(rtc::Message* msg);
+
+	void PushEncData(ENC_DATA_TYPE type, EncBuffer* buf, uint32_t dts, uint32_t pts);
+	//* On the writer thread only
+	void DoWrite();
+	void DoClose();
+	void ClearEncData();
+
+private:
+	rtc::Thread*		writer_;
+	void*				hls_;
+	void*				muxer_;		// Rtmp never connected, muxes the raw frames to hls_
+	bool				need_keyframe_;
+	bool				only_audio_mode_;
+
+	rtc::SpscQueue<EncData*>	que_video_enc_;	// Video from the video encoder thread
+	rtc::SpscQueue<EncData*>	que_audio_enc_;	// Audio from the audio encoder thread
+	volatile int			write_posted_;	// 1 when MSG_WRITE is posted for the new data
+	volatile int			drop_frames_;	// Dropped for the writer is slower than the encoders
+};
+
+#endif	// __ANY_HLS_WRITER_H__
@@ -19,6 +19,7 @@
 #include <iostream>
 #include "anyrtmpcore.h"
 #include "webrtc/modules/audio_device/audio_device_impl.h"
+#include "webrtc/modules/utility/include/audio_frame_operations.h"
 #include "webrtc/base/logging.h"
 #ifdef WIN32
 #include "webrtc/base/win32socketserver.h"
@@ -31,9 +32,67 @@
 #include "AudioCaptureModule.h"
 
 static const size_t kMaxDataSizeSamples = 3840;
-static const uint32_t kMaxAacSizeSamples = 1920;
+static const int32_t kAudioRecordMixerId = 0;
+static const int32_t kAudioTrackMixerId = 1;
+static const int32_t kAudioTrackMixHz = 48000;	// AudioConferenceMixer only mixes at 8/16/32/48k
 
 namespace webrtc {
+AVAudioTrackSource::AVAudioTrackSource(AVAudioTrackCallback* callback)
+	: callback_(callback)
+	, gain_(1.0f)
+{
+}
+
+AVAudioTrackSource::~AVAudioTrackSource()
+{
+}
+
+void AVAudioTrackSource::SetGain(float gain)
+{
+	rtc::CritScope cs(&cs_gain_);
+	gain_ = gain < 0.0f ? 0.0f : gain;
+}
+
+MixerParticipant::AudioFrameInfo AVAudioTrackSource::GetAudioFrameWithMuted(int32_t id, AudioFrame* audio_frame)
+{
+	uint32_t sampleHz = 0;
+	size_t channel = 0;
+	//* Always pull, even when muted, so the player keeps draining its buffer.
+	int readed = callback_->OnNeedPlayAudio(pcm_data_, sampleHz, channel);
+	if (readed <= 0 || sampleHz == 0 || channel == 0 || channel > 2) {
+		return AudioFrameInfo::kMuted;
+	}
+
+	int samples_per_channel = resampler_.Resample10Msec(pcm_data_, sampleHz, kAudioTrackMixHz, channel,
+		AudioFrame::kMaxDataSizeSamples, audio_frame->data_);
+	if (samples_per_channel <= 0) {
+		return AudioFrameInfo::kError;
+	}
+	audio_frame->samples_per_channel_ = samples_per_channel;
+	audio_frame->sample_rate_hz_ = kAudioTrackMixHz;
+	audio_frame->num_channels_ = channel;
+	audio_frame->speech_type_ = AudioFrame::kNormalSpeech;
+	audio_frame->vad_activity_ = AudioFrame::kVadActive;
+
+	float gain;
+	{
+		rtc::CritScope cs(&cs_gain_);
+		gain = gain_;
+	}
+	if (gain == 0.0f) {
+		return AudioFrameInfo::kMuted;
+	}
+	if (gain != 1.0f) {
+		AudioFrameOperations::ScaleWithSat(gain, *audio_frame);
+	}
+	return AudioFrameInfo::kNormal;
+}
+
+int32_t AVAudioTrackSource::NeededFrequency(int32_t id) const
+{
+	return kAudioTrackMixHz;
+}
+
 AnyRtmpCore::AnyRtmpCore()
 	: running_(false)
 	, audio_device_ptr_(NULL)
@@ -41,9 +100,6 @@ AnyRtmpCore::AnyRtmpCore()
 	, audio_record_callback_(NULL)
 	, audio_record_sample_hz_(48000)
 	, audio_record_channels_(2)
-	, audio_track_callback_(NULL)
-	, audio_track_sample_hz_(48000)
-	, audio_track_channels_(2)
 {
 	running_ = true;
 	rtc::Thread::SetName("AnyRTC-RTMP-Core", this);
@@ -65,12 +121,17 @@ AnyRtmpCore::AnyRtmpCore()
 	audio_capture_mixer_ptr_.reset(new webrtc::AVAudioMixerParticipant());
 	audio_capture_ptr_->RegisterAudioCallback(audio_capture_mixer_ptr_.get());
 
-	audio_mixer_ = webrtc::AudioConferenceMixer::Create(0);
+	audio_mixer_ = webrtc::AudioConferenceMixer::Create(kAudioRecordMixerId);
 	audio_mixer_->SetMinimumMixingFrequency(AudioConferenceMixer::Frequency::kFbInHz);
 	audio_mixer_->RegisterMixedStreamCallback(this);
 	audio_mixer_->SetMixabilityStatus(audio_device_mixer_ptr_.get(), true);
 	audio_mixer_->SetMixabilityStatus(audio_capture_mixer_ptr_.get(), true);
 
+	//Players
+	audio_track_mixer_ = webrtc::AudioConferenceMixer::Create(kAudioTrackMixerId);
+	audio_track_mixer_->SetMinimumMixingFrequency(AudioConferenceMixer::Frequency::kFbInHz);
+	audio_track_mixer_->RegisterMixedStreamCallback(this);
+
 	// Initialize the default microphone
 #ifdef WIN32
 	if (audio_device_ptr_ && audio_device_ptr_->SetRecordingDevice(AudioDeviceModule::kDefaultCommunicationDevice) != 0) {
@@ -114,6 +175,19 @@ AnyRtmpCore::~AnyRtmpCore()
 		audio_capture_ptr_ = NULL;
 	}
 
+	{
+		rtc::CritScope cs(&cs_audio_track_);
+		std::map<AVAudioTrackCallback*, AVAudioTrackSource*>::iterator iter = audio_track_sources_.begin();
+		while (iter != audio_track_sources_.end()) {
+			audio_track_mixer_->SetMixabilityStatus(iter->second, false);
+			delete iter->second;
+			iter = audio_track_sources_.erase(iter);
+		}
+		audio_track_mixer_->UnRegisterMixedStreamCallback();
+		delete audio_track_mixer_;
+		audio_track_mixer_ = nullptr;
+	}
+
 	if (running_) {
 		running_ = false;
 		rtc::Thread::Stop();
@@ -289,9 +363,23 @@ void AnyRtmpCore::StopAudioRecord()
 
 void AnyRtmpCore::StartAudioTrack(AVAudioTrackCallback* callback)
 {
+	if (callback == NULL)
+		return;
+
 	{
 		rtc::CritScope cs(&cs_audio_track_);
-		audio_track_callback_ = callback;
+		if (audio_track_sources_.find(callback) == audio_track_sources_.end()) {
+			AVAudioTrackSource* source = new AVAudioTrackSource(callback);
+			//* Anonymous participants are all mixed, named ones only the 3 loudest,
+			//* only a registered participant can be made anonymous
+			if (audio_track_mixer_->SetMixabilityStatus(source, true) != 0
+				|| audio_track_mixer_->SetAnonymousMixabilityStatus(source, true) != 0) {
+				audio_track_mixer_->SetMixabilityStatus(source, false);
+				delete source;
+				return;
+			}
+			audio_track_sources_[callback] = source;
+		}
 	}
 	
 	if (audio_device_ptr_ && !audio_device_ptr_->Playing()) {
@@ -305,11 +393,18 @@ void AnyRtmpCore::StartAudioTrack(AVAudioTrackCallback* callback)
 	}
 }
 
-void AnyRtmpCore::StopAudioTrack()
+void AnyRtmpCore::StopAudioTrack(AVAudioTrackCallback* callback)
 {
 	{
 		rtc::CritScope cs(&cs_audio_track_);
-		audio_track_callback_ = NULL;
+		std::map<AVAudioTrackCallback*, AVAudioTrackSource*>::iterator iter = audio_track_sources_.find(callback);
+		if (iter != audio_track_sources_.end()) {
+			audio_track_mixer_->SetMixabilityStatus(iter->second, false);
+			delete iter->second;
+			audio_track_sources_.erase(iter);
+		}
+		if (!audio_track_sources_.empty())
+			return;	// Other players still use the playout device
 	}
 
     if (audio_device_ptr_ && audio_device_ptr_->Playing()) {
@@ -321,6 +416,15 @@ void AnyRtmpCore::StopAudioTrack()
 	}
 }
 
+void AnyRtmpCore::SetAudioTrackGain(AVAudioTrackCallback* callback, float gain)
+{
+	rtc::CritScope cs(&cs_audio_track_);
+	std::map<AVAudioTrackCallback*, AVAudioTrackSource*>::iterator iter = audio_track_sources_.find(callback);
+	if (iter != audio_track_sources_.end()) {
+		iter->second->SetGain(gain);
+	}
+}
+
 int32_t AnyRtmpCore::RecordedDataIsAvailable(const void* audioSamples, const size_t nSamples,
 	const size_t nBytesPerSample, const size_t nChannels, const uint32_t samplesPerSec, const uint32_t totalDelayMS,
 	const int32_t clockDrift, const uint32_t currentMicLevel, const bool keyPressed, uint32_t& newMicLevel)
@@ -387,34 +491,38 @@ int32_t AnyRtmpCore::NeedMorePlayData(const size_t nSamples, const size_t nBytes
 	const uint32_t samplesPerSec, void* audioSamples, size_t& nSamplesOut, int64_t* elapsed_time_ms, int64_t* ntp_time_ms)
 {
 	rtc::CritScope cs(&cs_audio_track_);
-	if (audio_track_callback_ != NULL) {
-		char aac_buf[kMaxAacSizeSamples];
-		uint32_t sampleHz = 0;
-		size_t channel = 0;
-		int readed = audio_track_callback_->OnNeedPlayAudio(aac_buf, sampleHz, channel);
-		audio_track_sample_hz_ = sampleHz;
-		audio_track_channels_ = channel;
-		*elapsed_time_ms = 0;
-		*ntp_time_ms = 0;
-
-		if (readed > 0) {
-			int16_t temp_output[kMaxDataSizeSamples];
-			int samples_per_channel_int = resampler_track_.Resample10Msec((int16_t*)aac_buf, audio_track_sample_hz_ * audio_track_channels_,
-				samplesPerSec * nChannels, 1, kMaxDataSizeSamples, temp_output);
-			
-			if (samples_per_channel_int > 0) {
-				memcpy(audioSamples, (char*)temp_output, samples_per_channel_int * sizeof(int16_t));
-				nSamplesOut = samples_per_channel_int / nChannels;
-			}
-		}
-		else {
-			int samples_per_channel_int = samplesPerSec / 100;
-			if (samples_per_channel_int > 0) {
-				memset(audioSamples, 0, samples_per_channel_int * sizeof(int16_t) * nChannels);
-				nSamplesOut = samples_per_channel_int;
-			}
+	*elapsed_time_ms = 0;
+	*ntp_time_ms = 0;
+
+	//* Pull 10ms from every source, the mix arrives in NewMixedAudio before Process returns
+	audio_track_mixed_ = false;
+	if (!audio_track_sources_.empty()) {
+		audio_track_mixer_->Process();
+	}
+
+	AudioFrame* frame = &audio_track_frame_;
+	if (audio_track_mixed_) {
+		if (frame->num_channels_ == 1 && nChannels == 2)
+			AudioFrameOperations::MonoToStereo(frame);
+		else if (frame->num_channels_ == 2 && nChannels == 1)
+			AudioFrameOperations::StereoToMono(frame);
+	}
+
+	int samples_per_channel_int = -1;
+	if (audio_track_mixed_ && frame->num_channels_ == nChannels) {
+		//* Mixed at kAudioTrackMixHz, resample straight into the device buffer
+		samples_per_channel_int = resampler_track_.Resample10Msec(frame->data_, frame->sample_rate_hz_,
+			samplesPerSec, nChannels, nSamples * nChannels, (int16_t*)audioSamples);
+	}
+	if (samples_per_channel_int > 0) {
+		nSamplesOut = samples_per_channel_int;
+	}
+	else {
+		samples_per_channel_int = samplesPerSec / 100;
+		if (samples_per_channel_int > 0) {
+			memset(audioSamples, 0, samples_per_channel_int * sizeof(int16_t) * nChannels);
+			nSamplesOut = samples_per_channel_int;
 		}
-		
 	}
 
 	return 0;
@@ -422,6 +530,13 @@ int32_t AnyRtmpCore::NeedMorePlayData(const size_t nSamples, const size_t nBytes
 
 void AnyRtmpCore::NewMixedAudio(const int32_t id, const AudioFrame& generalAudioFrame, const AudioFrame** uniqueAudioFrames,
 	const uint32_t size) {
+	if (id == kAudioTrackMixerId) {
+		//* Playout mix, called from audio_track_mixer_->Process() in NeedMorePlayData
+		audio_track_frame_.CopyFrom(generalAudioFrame);
+		audio_track_mixed_ = true;
+		return;
+	}
+
 	//从audioframe中读取数据进行编码上传，是混合之后的声音
 	if (audio_record_callback_) {
 		audio_record_callback_->OnRecordAudio(generalAudioFrame.data_, generalAudioFrame.samples_per_channel_, 0, generalAudioFrame.num_channels_, generalAudioFrame.sample_rate_hz_, 0);
@@ -54,6 +54,28 @@ public:
 	virtual int OnNeedPlayAudio(void* audioSamples, uint32_t& samplesPerSec, size_t& nChannels) = 0;
 };
 
+//* One playout source of AnyRtmpCore: pulls 10ms of pcm from its callback, resamples it
+//* to the mixing rate and applies its gain before the track mixer sums all sources.
+class AVAudioTrackSource : public webrtc::MixerParticipant
+{
+public:
+	AVAudioTrackSource(AVAudioTrackCallback* callback);
+	virtual ~AVAudioTrackSource();
+
+	void SetGain(float gain);
+
+	//* For webrtc::MixerParticipant
+	virtual AudioFrameInfo GetAudioFrameWithMuted(int32_t id, AudioFrame* audio_frame);
+	virtual int32_t NeededFrequency(int32_t id) const;
+
+private:
+	AVAudioTrackCallback	*callback_;
+	rtc::CriticalSection	cs_gain_;
+	float					gain_;
+	webrtc::acm2::ACMResampler resampler_;
+	int16_t					pcm_data_[AudioFrame::kMaxDataSizeSamples];
+};
+
 class AVAudioMixerParticipant : public webrtc::AudioTransport, public webrtc::MixerParticipant
 {
 	//ͨAudioTransport¼ݣл棬ȻͨMixerParticipantл
@@ -159,8 +181,11 @@ public:
 
 	rtc::scoped_refptr<webrtc::AudioDeviceModule> getAudioDeviceManager();
 
+	//* Any number of callbacks can play at once, they are mixed into the playout device.
 	void StartAudioTrack(AVAudioTrackCallback* callback);
-	void StopAudioTrack();
+	void StopAudioTrack(AVAudioTrackCallback* callback);
+	//* gain: 0.0 mutes the source, 1.0 plays it unchanged.
+	void SetAudioTrackGain(AVAudioTrackCallback* callback, float gain);
 
 	bool CheckAudioRecordStatus(); //¼Ƶ״̬ҪǶԱ¼ʱ
 
@@ -204,9 +229,10 @@ protected:
 	//* For audio player
 	rtc::CriticalSection	cs_audio_track_;
 	webrtc::acm2::ACMResampler resampler_track_;
-	AVAudioTrackCallback	*audio_track_callback_;
-	int						audio_track_sample_hz_;
-	int						audio_track_channels_;
+	std::map<AVAudioTrackCallback*, AVAudioTrackSource*> audio_track_sources_;
+	webrtc::AudioConferenceMixer *audio_track_mixer_ = nullptr;
+	AudioFrame				audio_track_frame_;	// the last mix of audio_track_mixer_
+	bool					audio_track_mixed_ = false;
 
 	int						audio_capture_dis = 0; //ʱ䣬3s,ûݣ򲻽л
 
@@ -110,7 +110,8 @@ void AnyRtmplayerImpl::OnMessage(rtc::Message* msg)
     case PLY_TICK: {
         if (ply_decoder_) {
             if (ply_decoder_->IsPlaying()) {
-                callback_.OnRtmplayerStatus(ply_decoder_->CacheTime(), cur_bitrate_);
+                callback_.OnRtmplayerStatus(ply_decoder_->CacheTime(), cur_bitrate_,
+                    ply_decoder_->TargetDelay(), ply_decoder_->MinDelay());
                 cur_bitrate_ = 0;
             } else {
                 callback_.OnRtmplayerCache(ply_decoder_->CacheTime());
@@ -139,20 +140,23 @@ void AnyRtmplayerImpl::OnRtmpullDisconnect()
 	callback_.OnRtmplayerClose(-2);
 }
 
-void AnyRtmplayerImpl::OnRtmpullH264Data(const uint8_t*pdata, int len, uint32_t ts)
+void AnyRtmplayerImpl::OnRtmpullH264Data(DemuxFrame* frame, uint32_t ts)
 {
+    cur_bitrate_ += frame->Size();
 	if (ply_decoder_) {
-		ply_decoder_->AddH264Data(pdata, len, ts);
+		ply_decoder_->AddH264Data(frame, ts);
+	}
+	else {
+		delete frame;
 	}
-    cur_bitrate_ += len;
 }
 
-void AnyRtmplayerImpl::OnRtmpullAACData(const uint8_t*pdata, int len, uint32_t ts)
+void AnyRtmplayerImpl::OnRtmpullAACData(const DemuxFrame& frame, uint32_t ts)
 {
 	if (ply_decoder_) {
-		ply_decoder_->AddAACData(pdata, len, ts);
+		ply_decoder_->AddAACData(frame, ts);
 	}
-    cur_bitrate_ += len;
+    cur_bitrate_ += frame.Size();
 }
 
 int AnyRtmplayerImpl::GetNeedPlayAudio(void* audioSamples, uint32_t& samplesPerSec, size_t& nChannels)
@@ -46,8 +46,8 @@ protected:
 	virtual void OnRtmpullConnected();
 	virtual void OnRtmpullFailed();
 	virtual void OnRtmpullDisconnect();
-	virtual void OnRtmpullH264Data(const uint8_t*pdata, int len, uint32_t ts);
-	virtual void OnRtmpullAACData(const uint8_t*pdata, int len, uint32_t ts);
+	virtual void OnRtmpullH264Data(DemuxFrame* frame, uint32_t ts);
+	virtual void OnRtmpullAACData(const DemuxFrame& frame, uint32_t ts);
 
 private:
 	AnyRtmpPull			*rtmp_pull_;
@@ -46,7 +46,9 @@ public:
 	virtual ~AnyRtmplayerEvent(void){};
 
 	virtual void OnRtmplayerOK() = 0;
-	virtual void OnRtmplayerStatus(int cacheTime, int curBitrate) = 0;
+	//* cacheTime: current buffered delay, targetDelay: delay the jitter buffer aims at,
+	//* minDelay: minimum buffered delay in the last second, all in ms.
+	virtual void OnRtmplayerStatus(int cacheTime, int curBitrate, int targetDelay, int minDelay) = 0;
 	virtual void OnRtmplayerCache(int time) = 0;
 	virtual void OnRtmplayerClose(int errcode) = 0;
 };
@@ -0,0 +1,467 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "anyrtmprelay.h"
+#include <string.h>
+#if defined(WEBRTC_WIN)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#define RELAY_SHUT_BOTH	SD_BOTH
+#define RELAY_CLOSE(fd)	closesocket(fd)
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define RELAY_SHUT_BOTH	SHUT_RDWR
+#define RELAY_CLOSE(fd)	::close(fd)
+#endif
+#include "srs_librtmp.h"
+#include "webrtc/base/bind.h"
+#include "webrtc/base/logging.h"
+
+#define RELAY_BACKLOG		128			// Backlog of the listen socket
+#define RELAY_ACCEPT_THREADS	2		// Threads of the blocking handshake
+#define RELAY_MAX_ACCEPTS	64			// Max accepts per readable event
+#define RELAY_QUEUE_MS		10000		// Max ms queued for a player, the slower one drops to the next keyframe
+
+enum {
+	MSG_ACCEPT,		// Blocking handshake, on the acceptor
+	MSG_ACCEPTED,
+	MSG_PACKETS,	// Ingest from the other threads
+	MSG_SEND		// Send the queued of all players
+};
+
+static bool SetNonblock(int fd, bool enable)
+{
+#if defined(WEBRTC_WIN)
+	u_long v = enable ? 1 : 0;
+	return ioctlsocket(fd, FIONBIO, &v) == 0;
+#else
+	int flags = fcntl(fd, F_GETFL, 0);
+	if (flags == -1)
+		return false;
+	flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+	return fcntl(fd, F_SETFL, flags) != -1;
+#endif
+}
+
+//* Client on the way to the acceptor and back, destroyed with the message
+//* if it is cleared.
+class RelayAccept : public rtc::MessageData
+{
+public:
+	RelayAccept(void* server) : server_(server), publish_(false), ret_(0) {};
+	virtual ~RelayAccept(void) {
+		if (server_)
+			srs_rtmp_server_destroy(server_);
+	};
+
+	void* Take() {
+		void* server = server_;
+		server_ = NULL;
+		return server;
+	}
+
+	void*	server_;
+	bool	publish_;
+	int		ret_;
+};
+
+//===================================================
+//* RelayClient, a player or the publisher, on the reactor of relay.
+class RelayClient : public RtmpReactorHandler
+{
+public:
+	RelayClient(AnyRtmpRelay& relay, void* server, bool publish)
+		: relay_(relay), server_(server), publish_(publish), blocked_(false) {};
+	virtual ~RelayClient(void) {
+		//* Removed from the source also.
+		srs_rtmp_server_destroy(server_);
+	};
+
+	void* Server() const { return server_; };
+	bool Publish() const { return publish_; };
+	bool Blocked() const { return blocked_; };
+	void SetBlocked(bool blocked) { blocked_ = blocked; };
+
+	//* For rtc::MessageHandler, nothing is posted to the clients.
+	virtual void OnMessage(rtc::Message* msg) {};
+	//* For RtmpReactorHandler
+	virtual void OnRtmpReadable() {
+		//* Read until no entire packet left, the buffered raise no socket event.
+		for (;;) {
+			char type;
+			u_int32_t ts;
+			char* data;
+			int size;
+			int ret = srs_rtmp_server_read_packet(server_, &type, &ts, &data, &size);
+			if (srs_rtmp_is_would_block(ret))
+				break;
+			if (ret != 0) {
+				relay_.CloseClient(this);
+				return;
+			}
+			if (publish_)
+				relay_.GotPacket(type, ts, data, size);
+			else
+				delete[] data;
+		}
+		//* The acks of the protocol.
+		relay_.SendTo(this);
+	}
+	virtual void OnRtmpWritable() {
+		if (srs_rtmp_server_flush(server_) != 0) {
+			relay_.CloseClient(this);
+			return;
+		}
+		if (srs_rtmp_server_get_send_pending(server_) == 0)
+			relay_.SendTo(this);
+	}
+
+private:
+	AnyRtmpRelay&	relay_;
+	void*			server_;
+	bool			publish_;
+	bool			blocked_;	// Waiting for writable
+};
+
+//===================================================
+//* AnyRtmpRelay
+AnyRtmpRelay::AnyRtmpRelay(void)
+	: reactor_(NULL)
+	, next_acceptor_(0)
+	, pull_(NULL)
+	, listen_fd_(-1)
+	, port_(0)
+	, source_(NULL)
+	, publisher_(NULL)
+	, send_posted_(false)
+	, closing_(false)
+	, num_players_(0)
+	, has_ingest_(false)
+	, packets_posted_(false)
+{
+	reactor_ = RtmpReactor::Get();
+	for (int i = 0; i < RELAY_ACCEPT_THREADS; i++) {
+		rtc::Thread* acceptor = new rtc::Thread();
+		acceptor->SetName("RtmpRelayAccept", this);
+		acceptor->Start();
+		acceptors_.push_back(acceptor);
+	}
+}
+
+AnyRtmpRelay::~AnyRtmpRelay(void)
+{
+	//* No more ingest when the pull is deleted.
+	if (pull_) {
+		delete pull_;
+		pull_ = NULL;
+	}
+	reactor_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&AnyRtmpRelay::DoClose, this));
+	{
+		//* Break the blocking handshakes, or wait them for RTMP_CONNECT_TIMEOUT.
+		rtc::CritScope l(&cs_accept_);
+		std::set<void*>::iterator iter = accepting_.begin();
+		for (; iter != accepting_.end(); iter++) {
+			::shutdown(srs_rtmp_server_get_fd(*iter), RELAY_SHUT_BOTH);
+		}
+	}
+	for (size_t i = 0; i < acceptors_.size(); i++) {
+		reactor_->Detach(this, acceptors_[i]);
+		delete acceptors_[i];
+	}
+	acceptors_.clear();
+
+	for (size_t i = 0; i < packets_.size(); i++) {
+		delete[] packets_[i].data;
+	}
+	packets_.clear();
+	if (source_) {
+		srs_rtmp_source_destroy(source_);
+		source_ = NULL;
+	}
+}
+
+bool AnyRtmpRelay::Open(int port, bool gop_cache)
+{
+	if (listen_fd_ >= 0)
+		return false;
+	int fd = (int)::socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0)
+		return false;
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	socklen_t len = sizeof(addr);
+	if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, RELAY_BACKLOG) != 0
+		|| ::getsockname(fd, (sockaddr*)&addr, &len) != 0 || !SetNonblock(fd, true)) {
+		LOG(LS_ERROR) << "Relay listen on port " << port << " failed";
+		RELAY_CLOSE(fd);
+		return false;
+	}
+	listen_fd_ = fd;
+	port_ = ntohs(addr.sin_port);
+
+	source_ = srs_rtmp_source_create(gop_cache, RELAY_QUEUE_MS);
+	reactor_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&AnyRtmpRelay::DoListen, this));
+	return true;
+}
+
+void AnyRtmpRelay::Pull(const std::string& url)
+{
+	if (pull_)
+		return;
+	has_ingest_ = true;
+	pull_ = new AnyRtmpPull(*this, url);
+}
+
+void AnyRtmpRelay::OnRtmpPacket(char type, uint32_t ts, const char* data, int size)
+{
+	if (size <= 0)
+		return;
+	//* One copy for all players.
+	char* copy = new char[size];
+	memcpy(copy, data, size);
+	if (reactor_->IsCurrent()) {
+		GotPacket(type, ts, copy, size);
+		return;
+	}
+
+	rtc::CritScope l(&cs_packets_);
+	RelayPacket packet = { type, ts, copy, size };
+	packets_.push_back(packet);
+	if (!packets_posted_) {
+		packets_posted_ = true;
+		reactor_->Post(RTC_FROM_HERE, this, MSG_PACKETS);
+	}
+}
+
+//* For rtc::MessageHandler
+void AnyRtmpRelay::OnMessage(rtc::Message* msg)
+{
+	switch (msg->message_id) {
+	case MSG_ACCEPT:
+		DoAccept(msg->pdata);
+		break;
+	case MSG_ACCEPTED:
+		DoAccepted(msg->pdata);
+		break;
+	case MSG_PACKETS:
+		DoPackets();
+		break;
+	case MSG_SEND:
+		DoSend();
+		break;
+	}
+	delete msg->pdata;
+}
+
+//* For RtmpReactorHandler
+void AnyRtmpRelay::OnRtmpReadable()
+{
+	for (int i = 0; i < RELAY_MAX_ACCEPTS; i++) {
+		int fd = (int)::accept(listen_fd_, NULL, NULL);
+		if (fd < 0)
+			break;
+		//* The handshake is blocking, and the small messages go at once.
+		int nodelay = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, (const char*)&nodelay, sizeof(nodelay));
+		void* server = NULL;
+		if (!SetNonblock(fd, false) || (server = srs_rtmp_server_create(fd)) == NULL) {
+			RELAY_CLOSE(fd);
+			continue;
+		}
+		srs_rtmp_server_set_timeout(server, RTMP_CONNECT_TIMEOUT, RTMP_CONNECT_TIMEOUT);
+		{
+			rtc::CritScope l(&cs_accept_);
+			accepting_.insert(server);
+		}
+		acceptors_[next_acceptor_]->Post(RTC_FROM_HERE, this, MSG_ACCEPT, new RelayAccept(server));
+		next_acceptor_ = (next_acceptor_ + 1) % acceptors_.size();
+	}
+}
+
+void AnyRtmpRelay::OnRtmpWritable()
+{
+}
+
+//* For AnyRtmpPullCallback
+void AnyRtmpRelay::OnRtmpullConnected()
+{
+	LOG(LS_INFO) << "Relay ingest connected";
+}
+
+void AnyRtmpRelay::OnRtmpullDisconnect()
+{
+	LOG(LS_WARNING) << "Relay ingest disconnected";
+}
+
+void AnyRtmpRelay::OnRtmpullPacket(char type, uint32_t ts, const char* data, int size)
+{
+	OnRtmpPacket(type, ts, data, size);
+}
+
+void AnyRtmpRelay::DoListen()
+{
+	reactor_->Add(this, listen_fd_);
+}
+
+void AnyRtmpRelay::DoAccept(rtc::MessageData* data)
+{
+	//* On the acceptor, blocks until done or RTMP_CONNECT_TIMEOUT.
+	RelayAccept* accept = (RelayAccept*)data;
+	srs_bool publish = false;
+	accept->ret_ = srs_rtmp_server_accept(accept->server_, &publish);
+	if (accept->ret_ == 0) {
+		accept->ret_ = srs_rtmp_server_set_nonblock(accept->server_);
+	}
+	{
+		rtc::CritScope l(&cs_accept_);
+		accepting_.erase(accept->server_);
+	}
+	RelayAccept* accepted = new RelayAccept(accept->Take());
+	accepted->publish_ = publish ? true : false;
+	accepted->ret_ = accept->ret_;
+	reactor_->Post(RTC_FROM_HERE, this, MSG_ACCEPTED, accepted);
+}
+
+void AnyRtmpRelay::DoAccepted(rtc::MessageData* data)
+{
+	RelayAccept* accept = (RelayAccept*)data;
+	if (closing_ || accept->ret_ != 0)
+		return;
+	//* One ingest only.
+	if (accept->publish_ && has_ingest_) {
+		LOG(LS_WARNING) << "Relay has ingest, reject the publisher of " << srs_rtmp_server_get_stream(accept->server_);
+		return;
+	}
+
+	RelayClient* client = new RelayClient(*this, accept->Take(), accept->publish_);
+	clients_.push_back(client);
+	reactor_->Add(client, srs_rtmp_server_get_fd(client->Server()));
+	if (client->Publish()) {
+		publisher_ = client;
+		has_ingest_ = true;
+	}
+	else {
+		//* The metadata, sequence headers and gop cache are queued at once.
+		srs_rtmp_source_add_player(source_, client->Server());
+		num_players_++;
+	}
+	//* The packets after the publish response may be read to the buffer already.
+	client->OnRtmpReadable();
+}
+
+void AnyRtmpRelay::DoPackets()
+{
+	std::vector<RelayPacket> packets;
+	{
+		rtc::CritScope l(&cs_packets_);
+		packets.swap(packets_);
+		packets_posted_ = false;
+	}
+	for (size_t i = 0; i < packets.size(); i++) {
+		GotPacket(packets[i].type, packets[i].ts, packets[i].data, packets[i].size);
+	}
+}
+
+void AnyRtmpRelay::DoSend()
+{
+	send_posted_ = false;
+	//* The client closed in SendTo is erased from the list.
+	std::list<RelayClient*>::iterator iter = clients_.begin();
+	while (iter != clients_.end()) {
+		RelayClient* client = *iter++;
+		if (!client->Publish() && !client->Blocked())
+			SendTo(client);
+	}
+}
+
+void AnyRtmpRelay::DoClose()
+{
+	closing_ = true;
+	if (listen_fd_ >= 0) {
+		reactor_->Remove(this);
+		RELAY_CLOSE(listen_fd_);
+		listen_fd_ = -1;
+	}
+	std::list<RelayClient*>::iterator iter = clients_.begin();
+	for (; iter != clients_.end(); iter++) {
+		reactor_->Remove(*iter);
+		delete *iter;
+	}
+	clients_.clear();
+	publisher_ = NULL;
+	num_players_ = 0;
+}
+
+void AnyRtmpRelay::GotPacket(char type, uint32_t ts, char* data, int size)
+{
+	if (closing_) {
+		delete[] data;
+		return;
+	}
+	//* Queued to all players, the send is posted once for the packets of
+	//* the same wakeup, so they are merged to less writev.
+	srs_rtmp_source_on_packet(source_, type, ts, data, size);
+	if (!send_posted_ && num_players_ > 0) {
+		send_posted_ = true;
+		reactor_->Post(RTC_FROM_HERE, this, MSG_SEND);
+	}
+}
+
+void AnyRtmpRelay::SendTo(RelayClient* client)
+{
+	void* server = client->Server();
+	if (!client->Publish()) {
+		int dropped = 0;
+		if (srs_rtmp_source_send(source_, server, &dropped) != 0) {
+			CloseClient(client);
+			return;
+		}
+		if (dropped > 0) {
+			LOG(LS_WARNING) << "Relay player is slow, dropped " << dropped << " packets";
+		}
+	}
+	bool blocked = srs_rtmp_server_get_send_pending(server) > 0;
+	if (blocked != client->Blocked()) {
+		client->SetBlocked(blocked);
+		reactor_->SetWritable(client, blocked);
+	}
+}
+
+void AnyRtmpRelay::CloseClient(RelayClient* client)
+{
+	reactor_->Remove(client);
+	clients_.remove(client);
+	if (client == publisher_) {
+		publisher_ = NULL;
+		has_ingest_ = pull_ != NULL;
+	}
+	else {
+		num_players_--;
+	}
+	delete client;
+}
@@ -0,0 +1,116 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __ANY_RTMP_RELAY_H__
+#define __ANY_RTMP_RELAY_H__
+#include <list>
+#include <set>
+#include <string>
+#include <vector>
+#include "anyrtmpull.h"
+#include "rtmpreactor.h"
+#include "webrtc/base/criticalsection.h"
+
+class RelayClient;
+
+//* Embedded rtmp server of one live stream, fans out one ingest to many local
+//* players, an edge box serves the viewers by one upstream pull.
+//* The ingest is pulled by Pull, fed by OnRtmpPacket, or a publisher of the relay
+//* when there is no other. The players play any app/stream of it.
+//* The packets are shared by all players, each player queues the references and
+//* sends them by merged writev, the last gop is cached for the new players to
+//* start at the keyframe. The relay and its clients run on one reactor, the
+//* blocking handshakes run on the threads of the relay, not the reactor the
+//* clients in the same process connect on.
+class AnyRtmpRelay : public RtmpReactorHandler, public AnyRtmpPullCallback
+{
+public:
+	AnyRtmpRelay(void);
+	virtual ~AnyRtmpRelay(void);
+
+	//* Listen on all interfaces, 0 for a random port.
+	bool Open(int port, bool gop_cache);
+	int Port() const { return port_; };
+	//* Pull the ingest from the url.
+	void Pull(const std::string& url);
+	//* Ingest of the packets of a pull owned by the user, call it from
+	//* AnyRtmpPullCallback::OnRtmpullPacket, the data is copied.
+	void OnRtmpPacket(char type, uint32_t ts, const char* data, int size);
+
+	int Players() const { return num_players_; };
+	bool HasIngest() const { return has_ingest_; };
+
+protected:
+	//* For rtc::MessageHandler, MSG_ACCEPT on the acceptor, the others on the reactor.
+	virtual void OnMessage(rtc::Message* msg);
+	//* For RtmpReactorHandler, the listen socket.
+	virtual void OnRtmpReadable();
+	virtual void OnRtmpWritable();
+
+	//* For AnyRtmpPullCallback
+	virtual void OnRtmpullConnected();
+	virtual void OnRtmpullFailed() {};
+	virtual void OnRtmpullDisconnect();
+	virtual void OnRtmpullH264Data(DemuxFrame* frame, uint32_t ts) { delete frame; };
+	virtual void OnRtmpullAACData(const DemuxFrame& frame, uint32_t ts) {};
+	virtual void OnRtmpullPacket(char type, uint32_t ts, const char* data, int size);
+
+	void DoListen();
+	void DoAccept(rtc::MessageData* data);
+	void DoAccepted(rtc::MessageData* data);
+	void DoPackets();
+	void DoSend();
+	void DoClose();
+
+	friend class RelayClient;
+	//* On the reactor thread, by the clients.
+	void GotPacket(char type, uint32_t ts, char* data, int size);
+	void SendTo(RelayClient* client);
+	void CloseClient(RelayClient* client);
+
+private:
+	struct RelayPacket {
+		char type;
+		uint32_t ts;
+		char* data;
+		int size;
+	};
+
+	RtmpReactor*		reactor_;
+	std::vector<rtc::Thread*>	acceptors_;
+	size_t				next_acceptor_;
+	AnyRtmpPull*		pull_;
+	int					listen_fd_;
+	int					port_;
+	void*				source_;	// srs_rtmp_source_t, on the reactor only
+	RelayClient*		publisher_;	// The ingest when no pull
+	std::list<RelayClient*>	clients_;
+	bool				send_posted_;
+	bool				closing_;
+	volatile int		num_players_;
+	volatile bool		has_ingest_;
+
+	rtc::CriticalSection	cs_packets_;
+	std::vector<RelayPacket>	packets_;	// From the other threads
+	bool				packets_posted_;
+
+	rtc::CriticalSection	cs_accept_;
+	std::set<void*>		accepting_;	// Blocked in the handshake, shut down when closing
+};
+
+#endif	// __ANY_RTMP_RELAY_H__
@@ -16,9 +16,24 @@ public:
     virtual void SetAutoAdjustBit(bool enabled) = 0;
 	virtual void SetVideoParameter(int w, int h, int bitrate) = 0;
 	virtual void SetBitrate(int bitrate) = 0;
+	//* Encode video as soon as captured, for interactive streams.
+	virtual void SetLowLatency(bool enabled) = 0;
+	//* Drop policy of the rtmp send queue when the uplink is slower than the encoders,
+	//* policy is the SEND_DROP_POLICY bits of anyrtmpush.h, the thresholds are in ms of
+	//* queued media, 0 to disable. Kept for the next StartStream too.
+	virtual void SetSendQueuePolicy(int policy, int nonrefMs, int gopMs, int maxMs) = 0;
 
 	virtual void StartStream(const std::string&url) = 0;
 	virtual void StopStream() = 0;
+	//* Write rolling MPEG-TS segments and a m3u8 playlist, with or without the rtmp stream.
+	//* The segments are cut at the first keyframe after segmentMs, the playlist keeps the
+	//* last window of them, 0 to keep all for recording.
+	virtual void StartHls(const std::string&m3u8, int segmentMs, int window) = 0;
+	virtual void StopHls() = 0;
+	//* Serve the stream live at rtsp://<ip>:port/stream, with or without the rtmp stream.
+	//* multicast is the group address to send once for all the viewers, empty for unicast.
+	virtual void StartRtsp(int port, const std::string&stream, const std::string&multicast) = 0;
+	virtual void StopRtsp() = 0;
 
 protected:
 	AnyRtmpstreamer(void){};
@@ -36,7 +51,8 @@ public:
 	virtual void OnStreamReconnecting(int times) = 0;
 	virtual void OnStreamFailed(int code) = 0;
 	virtual void OnStreamClosed() = 0;
-	virtual void OnStreamStatus(int delayMs, int netBand) = 0;
+	//* dropFrames and dropBytes: media dropped from the send queue since the last status.
+	virtual void OnStreamStatus(int delayMs, int netBand, int dropFrames, int dropBytes) = 0;
 };
 
 #endif	// __ANY_RTMP_STREAM_INTERFACE_H__
\ No newline at end of file
@@ -42,6 +42,14 @@ AnyRtmpStreamerImpl::AnyRtmpStreamerImpl(AnyRtmpstreamerEvent&callback)
 , v_framerate_(20)
 , v_bitrate_(768)
 , av_rtmp_(NULL)
+, sq_policy_set_(false)
+, sq_policy_(0)
+, sq_nonref_ms_(0)
+, sq_gop_ms_(0)
+, sq_max_ms_(0)
+, av_hls_(NULL)
+, av_rtsp_(NULL)
+, only_audio_mode_(false)
 {
 	AnyRtmpCore::Inst();
 
@@ -74,6 +82,16 @@ AnyRtmpStreamerImpl::~AnyRtmpStreamerImpl(void)
 		delete av_rtmp_;
 		av_rtmp_ = NULL;
 	}
+	if(av_hls_)
+	{
+		delete av_hls_;
+		av_hls_ = NULL;
+	}
+	if(av_rtsp_)
+	{
+		delete av_rtsp_;
+		av_rtsp_ = NULL;
+	}
 }
 
 void AnyRtmpStreamerImpl::SetAudioEnable(bool enabled)
@@ -86,9 +104,22 @@ void AnyRtmpStreamerImpl::SetAudioEnable(bool enabled)
 
 void AnyRtmpStreamerImpl::SetVideoEnable(bool enabled)
 {
-	if (!enabled && av_rtmp_) {
+	if (enabled)
+		return;
+	only_audio_mode_ = true;
+	if (av_rtmp_) {
 		av_rtmp_->EnableOnlyAudioMode();
 	}
+	{
+		rtc::CritScope l(&cs_av_hls_);
+		if (av_hls_) {
+			av_hls_->EnableOnlyAudioMode();
+		}
+	}
+	rtc::CritScope l(&cs_av_rtsp_);
+	if (av_rtsp_) {
+		av_rtsp_->EnableOnlyAudioMode();
+	}
 }
 
 void AnyRtmpStreamerImpl::SetAutoAdjustBit(bool enabled)
@@ -118,14 +149,38 @@ void AnyRtmpStreamerImpl::SetBitrate(int bitrate)
 	v_bitrate_ = bitrate;
 }
 
+void AnyRtmpStreamerImpl::SetLowLatency(bool enabled)
+{
+	if (v_h264_encoder_) {
+		v_h264_encoder_->SetLowLatency(enabled);
+	}
+}
+
+void AnyRtmpStreamerImpl::SetSendQueuePolicy(int policy, int nonrefMs, int gopMs, int maxMs)
+{
+	rtc::CritScope l(&cs_av_rtmp_);
+	sq_policy_set_ = true;
+	sq_policy_ = policy;
+	sq_nonref_ms_ = nonrefMs;
+	sq_gop_ms_ = gopMs;
+	sq_max_ms_ = maxMs;
+	if (av_rtmp_)
+		av_rtmp_->SetSendQueuePolicy(policy, nonrefMs, gopMs, maxMs);
+}
+
 void AnyRtmpStreamerImpl::StartStream(const std::string&url)
 {
    	int bitpersample = 16;
     rtc::CritScope l(&cs_av_rtmp_);
-	if(av_rtmp_ == NULL)
+	if (av_rtmp_ == NULL) {
 		av_rtmp_ = new AnyRtmpPush(*this, url);
+		if (sq_policy_set_)
+			av_rtmp_->SetSendQueuePolicy(sq_policy_, sq_nonref_ms_, sq_gop_ms_, sq_max_ms_);
+	}
 	av_rtmp_->SetAudioParameter(a_sample_hz_, bitpersample, a_channels_);
 	av_rtmp_->SetVideoParameter(v_width, v_height, v_bitrate_, v_framerate_);
+	if (only_audio_mode_)
+		av_rtmp_->EnableOnlyAudioMode();
 }
 
 void AnyRtmpStreamerImpl::StopStream()
@@ -139,7 +194,97 @@ void AnyRtmpStreamerImpl::StopStream()
         }
     }
 
-	StopEncoder();
+	if (!HasLocalOutput())
+		StopEncoder();
+}
+
+void AnyRtmpStreamerImpl::StartHls(const std::string&m3u8, int segmentMs, int window)
+{
+	{
+		rtc::CritScope l(&cs_av_hls_);
+		if (av_hls_ != NULL)
+			return;
+		av_hls_ = new AnyHlsWriter(m3u8, segmentMs, window);
+		if (!av_hls_->IsOpen()) {
+			delete av_hls_;
+			av_hls_ = NULL;
+			return;
+		}
+		if (only_audio_mode_)
+			av_hls_->EnableOnlyAudioMode();
+	}
+	//* The rtmp starts the encoders when connected, the hls at once.
+	StartEncoder();
+}
+
+void AnyRtmpStreamerImpl::StopHls()
+{
+	AnyHlsWriter* hls = NULL;
+	{
+		rtc::CritScope l(&cs_av_hls_);
+		hls = av_hls_;
+		av_hls_ = NULL;
+	}
+	if (hls == NULL)
+		return;
+	//* Out of the lock, it writes the queued and the playlist.
+	delete hls;
+
+	if (!HasRtmp() && !HasLocalOutput())
+		StopEncoder();
+}
+
+void AnyRtmpStreamerImpl::StartRtsp(int port, const std::string&stream, const std::string&multicast)
+{
+	{
+		rtc::CritScope l(&cs_av_rtsp_);
+		if (av_rtsp_ != NULL)
+			return;
+		av_rtsp_ = new AnyRtspServer(*this, port, stream, multicast, a_sample_hz_, a_channels_, v_bitrate_);
+		if (!av_rtsp_->IsOpen()) {
+			delete av_rtsp_;
+			av_rtsp_ = NULL;
+			return;
+		}
+		if (only_audio_mode_)
+			av_rtsp_->EnableOnlyAudioMode();
+	}
+	//* Served at once, as the hls.
+	StartEncoder();
+}
+
+void AnyRtmpStreamerImpl::StopRtsp()
+{
+	AnyRtspServer* rtsp = NULL;
+	{
+		rtc::CritScope l(&cs_av_rtsp_);
+		rtsp = av_rtsp_;
+		av_rtsp_ = NULL;
+	}
+	if (rtsp == NULL)
+		return;
+	//* Out of the lock, it waits for the reactor to close the viewers.
+	delete rtsp;
+
+	if (!HasRtmp() && !HasLocalOutput())
+		StopEncoder();
+}
+
+bool AnyRtmpStreamerImpl::HasRtmp()
+{
+	rtc::CritScope l(&cs_av_rtmp_);
+	return av_rtmp_ != NULL;
+}
+
+bool AnyRtmpStreamerImpl::HasLocalOutput()
+{
+	{
+		rtc::CritScope l(&cs_av_hls_);
+		if (av_hls_ != NULL)
+			return true;
+	}
+	rtc::CritScope l(&cs_av_rtsp_);
+	return av_rtsp_ != NULL;
 }
 
 void AnyRtmpStreamerImpl::OnEncodeDataCallback(bool audio, uint8_t *p, uint32_t length, uint32_t ts)
@@ -151,7 +296,43 @@ void AnyRtmpStreamerImpl::OnEncodeDataCallback(bool audio, uint8_t *p, uint32_t
 	}
 	else
 	{
-		OnH264Data(p, length, ts);
+		OnH264Data(p, length, ts, ts);
+	}
+}
+
+void AnyRtmpStreamerImpl::OnEncodeVideoCallback(uint8_t *p, uint32_t length, uint32_t dts, uint32_t pts)
+{
+	OnH264Data(p, length, dts, pts);
+}
+
+void AnyRtmpStreamerImpl::OnEncodeBufferCallback(bool audio, EncBuffer* buf, uint32_t ts)
+{
+	if(audio)
+	{
+		{
+			//* Copied before the push muxes the buffer in place.
+			rtc::CritScope l(&cs_av_hls_);
+			if(av_hls_)
+			{
+				av_hls_->SetAacData(buf->Data(), buf->Size(), ts);
+			}
+		}
+		{
+			rtc::CritScope l(&cs_av_rtsp_);
+			if(av_rtsp_)
+			{
+				av_rtsp_->SetAacData(buf->Data(), buf->Size(), ts);
+			}
+		}
+		rtc::CritScope l(&cs_av_rtmp_);
+		if(av_rtmp_)
+		{
+			av_rtmp_->SetAacData(buf, ts);
+		}
+	}
+	else
+	{
+		OnH264Data(buf->Data(), buf->Size(), ts, ts);
 	}
 }
 
@@ -163,13 +344,15 @@ void AnyRtmpStreamerImpl::OnRtmpConnected()
 
 void AnyRtmpStreamerImpl::OnRtmpReconnecting(int times)
 {
-	StopEncoder();
+	if (!HasLocalOutput())
+		StopEncoder();
 	callback_.OnStreamReconnecting(times);
 }
 
 void AnyRtmpStreamerImpl::OnRtmpDisconnect()
 {
-	StopEncoder();
+	if (!HasLocalOutput())
+		StopEncoder();
 	if(rtmp_connected_)
 	{
 		callback_.OnStreamClosed();
@@ -181,12 +364,19 @@ void AnyRtmpStreamerImpl::OnRtmpDisconnect()
 	rtmp_connected_ = false;
 }
 
-void AnyRtmpStreamerImpl::OnRtmpStatusEvent(int delayMs, int netBand)
+void AnyRtmpStreamerImpl::OnRtmpStatusEvent(int delayMs, int netBand, int dropFrames, int dropBytes)
 {
     if (auto_adjust_bit_ && v_h264_encoder_) {
         v_h264_encoder_->SetNetDelay(delayMs);
     }
-	callback_.OnStreamStatus(delayMs, netBand);
+	callback_.OnStreamStatus(delayMs, netBand, dropFrames, dropBytes);
+}
+
+void AnyRtmpStreamerImpl::OnRtspKeyFrameRequest()
+{
+	if (v_h264_encoder_) {
+		v_h264_encoder_->RequestKeyFrame();
+	}
 }
 
 void AnyRtmpStreamerImpl::StartEncoder()
@@ -211,6 +401,20 @@ void AnyRtmpStreamerImpl::StopEncoder()
 
 void AnyRtmpStreamerImpl::OnAACData(uint8_t* pData, int len, uint32_t ts)
 {
+	{
+		rtc::CritScope l(&cs_av_hls_);
+		if(av_hls_)
+		{
+			av_hls_->SetAacData(pData, len, ts);
+		}
+	}
+	{
+		rtc::CritScope l(&cs_av_rtsp_);
+		if(av_rtsp_)
+		{
+			av_rtsp_->SetAacData(pData, len, ts);
+		}
+	}
     rtc::CritScope l(&cs_av_rtmp_);
 	if(av_rtmp_)
 	{
@@ -218,12 +422,26 @@ void AnyRtmpStreamerImpl::OnAACData(uint8_t* pData, int len, uint32_t ts)
 	}
 }
 
-void AnyRtmpStreamerImpl::OnH264Data(uint8_t* pData, int len, uint32_t ts)
+void AnyRtmpStreamerImpl::OnH264Data(uint8_t* pData, int len, uint32_t dts, uint32_t pts)
 {
+	{
+		rtc::CritScope l(&cs_av_hls_);
+		if(av_hls_)
+		{
+			av_hls_->SetH264Data(pData, len, dts, pts);
+		}
+	}
+	{
+		rtc::CritScope l(&cs_av_rtsp_);
+		if(av_rtsp_)
+		{
+			av_rtsp_->SetH264Data(pData, len, dts, pts);
+		}
+	}
     rtc::CritScope l(&cs_av_rtmp_);
 	if(av_rtmp_)
 	{
-		av_rtmp_->SetH264Data(pData, len, ts);
+		av_rtmp_->SetH264Data(pData, len, dts, pts);
 	}
 }
 
@@ -19,9 +19,11 @@
 #ifndef __ANY_RTMP_STREAMER_H__
 #define __ANY_RTMP_STREAMER_H__
 #include "avcodec.h"
+#include "anyhlswriter.h"
 #include "anyrtmpcore.h"
 #include "anyrtmpush.h"
 #include "anyrtmpstream_interface.h"
+#include "anyrtspserver.h"
 #include "webrtc/audio_sink.h"
 #include "webrtc/api/mediastreaminterface.h"
 #include "webrtc/base/thread.h"
@@ -31,7 +33,8 @@
 
 namespace webrtc {
 
-class AnyRtmpStreamerImpl : public AnyRtmpstreamer, public AVCodecCallback, public AnyRtmpushCallback
+class AnyRtmpStreamerImpl : public AnyRtmpstreamer, public AVCodecCallback, public AnyRtmpushCallback,
+	public AnyRtspServerCallback
 {
 public:
 	AnyRtmpStreamerImpl(AnyRtmpstreamerEvent&callback);
@@ -46,25 +49,39 @@ public:
     virtual void SetAutoAdjustBit(bool enabled);
 	virtual void SetVideoParameter(int w, int h, int bitrate);
 	virtual void SetBitrate(int bitrate);
+	virtual void SetLowLatency(bool enabled);
+	virtual void SetSendQueuePolicy(int policy, int nonrefMs, int gopMs, int maxMs);
 
 	void StartStream(const std::string&url);
 	void StopStream();
+	void StartHls(const std::string&m3u8, int segmentMs, int window);
+	void StopHls();
+	void StartRtsp(int port, const std::string&stream, const std::string&multicast);
+	void StopRtsp();
 
 public:
 	//* For AVCodecCallback
 	virtual void OnEncodeDataCallback(bool audio, uint8_t *p, uint32_t length, uint32_t ts);
+	virtual void OnEncodeBufferCallback(bool audio, EncBuffer* buf, uint32_t ts);
+	virtual void OnEncodeVideoCallback(uint8_t *p, uint32_t length, uint32_t dts, uint32_t pts);
 
 	//* For AnyRtmpushCallback
 	virtual void OnRtmpConnected();
 	virtual void OnRtmpReconnecting(int times);
 	virtual void OnRtmpDisconnect();
-	virtual void OnRtmpStatusEvent(int delayMs, int netBand);
+	virtual void OnRtmpStatusEvent(int delayMs, int netBand, int dropFrames, int dropBytes);
+
+	//* For AnyRtspServerCallback
+	virtual void OnRtspKeyFrameRequest();
 
 protected:
 	virtual void StartEncoder();
 	virtual void StopEncoder();
 	void OnAACData(uint8_t* pdata, int len, uint32_t ts);
-	void OnH264Data(uint8_t* pdata, int len, uint32_t ts);
+	void OnH264Data(uint8_t* pdata, int len, uint32_t dts, uint32_t pts);
+	//* The encoders run while any output is on.
+	bool HasRtmp();
+	bool HasLocalOutput();
 
 private:
 	bool					rtmp_connected_;
@@ -86,6 +103,16 @@ private:
 
     rtc::CriticalSection	cs_av_rtmp_;
 	AnyRtmpPush*				av_rtmp_;
+	bool					sq_policy_set_;		// SetSendQueuePolicy called, otherwise the AnyRtmpPush defaults
+	int						sq_policy_;
+	int						sq_nonref_ms_;
+	int						sq_gop_ms_;
+	int						sq_max_ms_;
+	rtc::CriticalSection	cs_av_hls_;
+	AnyHlsWriter*			av_hls_;
+	rtc::CriticalSection	cs_av_rtsp_;
+	AnyRtspServer*			av_rtsp_;
+	bool					only_audio_mode_;
 };
 
 }	// namespace webrtc
@@ -24,43 +24,51 @@
 #define ERROR_SUCCESS   0
 #endif
 #define MAX_RETRY_TIME  3
+#define PULL_MAX_NALUS  64      // Max NALUs of one frame, the left data is in the last one
+#define PULL_MAX_PACKETS	256		// Max packets to demux per loop, keep the message queue responsive
+#define PULL_RECV_BUFFER	(256 * 1024)	// Recv buffer of merged read
+
+enum {
+	MSG_CONNECT,
+	MSG_READ		// Go on with the buffered packets
+};
 static u_int8_t fresh_nalu_header[] = { 0x00, 0x00, 0x00, 0x01 };
 static u_int8_t cont_nalu_header[] = { 0x00, 0x00, 0x01 };
 
 AnyRtmpPull::AnyRtmpPull(AnyRtmpPullCallback&callback, const std::string&url)
 	: callback_(callback)
+	, reactor_(NULL)
 	, srs_codec_(NULL)
 	, running_(false)
     , connected_(false)
 	, retry_ct_(0)
 	, rtmp_status_(RS_PLY_Init)
 	, rtmp_(NULL)
-	, audio_payload_(NULL)
-	, video_payload_(NULL)
 {
 	str_url_ = url;
 	rtmp_ = srs_rtmp_create(url.c_str());
+	if (rtmp_) {
+		srs_rtmp_set_merged_read(rtmp_, PULL_RECV_BUFFER);
+	}
 	srs_codec_ = new SrsAvcAacCodec();
-
-	audio_payload_ = new DemuxData(1024);
-	video_payload_ = new DemuxData(384 * 1024);
+	reactor_ = RtmpReactor::Get();
 
 	running_ = true;
-	rtc::Thread::Start();
+	if (rtmp_) {
+		reactor_->Post(RTC_FROM_HERE, this, MSG_CONNECT);
+	}
 }
 
 AnyRtmpPull::~AnyRtmpPull(void)
 {
 	running_ = false;
-	rtmp_status_ = RS_PLY_Closed;
-	rtc::Thread::SleepMs(100);
 	{
 		rtc::CritScope l(&cs_rtmp_);
-		if (rtmp_) {
-			srs_rtmp_disconnect_server(rtmp_);
-		}
+		rtmp_status_ = RS_PLY_Closed;
 	}
-	rtc::Thread::Stop();
+	//* Also cancels the setup, the socket is closed after removed from the
+	//* reactor, or its fd may be reused by another session.
+	reactor_->Detach(this);
 	if (rtmp_) {
 		srs_rtmp_destroy(rtmp_);
 		rtmp_ = NULL;
@@ -70,115 +78,140 @@ AnyRtmpPull::~AnyRtmpPull(void)
 		delete srs_codec_;
 		srs_codec_ = NULL;
 	}
-	if (audio_payload_) {
-		delete audio_payload_;
-		audio_payload_ = NULL;
+}
+
+//* For rtc::MessageHandler
+void AnyRtmpPull::OnMessage(rtc::Message* msg)
+{
+	switch (msg->message_id) {
+	case MSG_CONNECT:
+		reactor_->Connect(this, rtmp_, false);
+		break;
+	case MSG_READ:
+		if (rtmp_status_ == RS_PLY_Played)
+			DoReadData();
+		break;
 	}
-	if (video_payload_) {
-		delete video_payload_;
-		video_payload_ = NULL;
+}
+
+//* For RtmpReactorHandler
+void AnyRtmpPull::OnRtmpReadable()
+{
+	DoReadData();
+}
+
+void AnyRtmpPull::OnRtmpWritable()
+{
+	//* Only the acks are sent by the player.
+	if (srs_rtmp_flush(rtmp_) != 0) {
+		CallDisconnect();
+		return;
+	}
+	if (srs_rtmp_get_send_pending(rtmp_) == 0) {
+		reactor_->SetWritable(this, false);
+	}
+}
+
+void AnyRtmpPull::OnRtmpConnect(int ret)
+{
+	if (ret != 0) {
+		srs_human_trace("SRS: play stream failed. ret=%d", ret);
+		CallDisconnect();
+		return;
 	}
+	srs_human_trace("SRS: play stream ok.");
+	DoConnected();
 }
 
-//* For Thread
-void AnyRtmpPull::Run()
+void AnyRtmpPull::DoConnected()
 {
-	while (running_)
 	{
-		{// ProcessMessages
-			this->ProcessMessages(10);
-		}
+		rtc::CritScope l(&cs_rtmp_);
+		if (rtmp_status_ == RS_PLY_Closed)
+			return;
+		rtmp_status_ = RS_PLY_Played;
+		reactor_->Add(this, srs_rtmp_get_fd(rtmp_));
+	}
+	CallConnect();
+	//* The packets after the play response may be read to the buffer already.
+	DoReadData();
+}
 
-		if (rtmp_ != NULL)
-		{
-			switch (rtmp_status_) {
-			case RS_PLY_Init:
-			{
-				if (srs_rtmp_handshake(rtmp_) == 0) {
-					srs_human_trace("SRS: simple handshake ok.");
-					rtmp_status_ = RS_PLY_Handshaked;
-				}
-                else {
-                    CallDisconnect();
-                }
-			}
-				break;
-			case RS_PLY_Handshaked:
-			{
-				if (srs_rtmp_connect_app(rtmp_) == 0) {
-					srs_human_trace("SRS: connect vhost/app ok.");
-					rtmp_status_ = RS_PLY_Connected;
-				}
-                else {
-                    CallDisconnect();
-                }
-			}
-				break;
-			case RS_PLY_Connected:
-			{
-				if (srs_rtmp_play_stream(rtmp_) == 0) {
-					srs_human_trace("SRS: play stream ok.");
-					rtmp_status_ = RS_PLY_Played;
-					CallConnect();
-				}
-                else {
-                    CallDisconnect();
-                }
-			}
-				break;
-			case RS_PLY_Played:
-			{
-				DoReadData();
-			}
-				break;
+void AnyRtmpPull::DoReadData()
+{
+	//* Demux until no entire packet left, but give the other sessions of
+	//* the reactor a chance after PULL_MAX_PACKETS.
+	int count = 0;
+	do {
+		int ret = DoReadPacket();
+		if (srs_rtmp_is_would_block(ret)) {
+			if (srs_rtmp_get_send_pending(rtmp_) > 0) {
+				reactor_->SetWritable(this, true);
 			}
+			return;
 		}
+		if (ret != 0) {
+			srs_human_trace("read packet failed. ret=%d", ret);
+			CallDisconnect();
+			return;
+		}
+	} while (running_ && ++count < PULL_MAX_PACKETS);
+
+	//* The buffered packets raise no socket event.
+	if (running_ && srs_rtmp_has_buffered(rtmp_)) {
+		reactor_->Post(RTC_FROM_HERE, this, MSG_READ);
 	}
 }
 
-void AnyRtmpPull::DoReadData()
+int AnyRtmpPull::DoReadPacket()
 {
 	int size;
 	char type;
 	char* data;
 	u_int32_t timestamp;
 
-	if (srs_rtmp_read_packet(rtmp_, &type, &timestamp, &data, &size) != 0) {
-
+	int ret = srs_rtmp_read_packet(rtmp_, &type, &timestamp, &data, &size);
+	if (ret != 0) {
+		return ret;
 	}
+	callback_.OnRtmpullPacket(type, timestamp, data, size);
 	if (type == SRS_RTMP_TYPE_VIDEO) {
+		//* The frames reference the payload, it's freed after the last of them is decoded.
+		DemuxPayload* payload = DemuxPayload::Create(data, size);
 		SrsCodecSample sample;
 		if (srs_codec_->video_avc_demux(data, size, &sample) == ERROR_SUCCESS) {
 			if (srs_codec_->video_codec_id == SrsCodecVideoAVC) {	// Jus support H264
-				GotVideoSample(timestamp, &sample);
+				GotVideoSample(payload, timestamp, &sample);
 			}
 			else {
 				LOG(LS_ERROR) << "Don't support video format!";
 			}
 		}
+		payload->Release();
+		return ret;
 	}
 	else if (type == SRS_RTMP_TYPE_AUDIO) {
 		SrsCodecSample sample;
 		if (srs_codec_->audio_aac_demux(data, size, &sample) != ERROR_SUCCESS) {
 			if (sample.acodec == SrsCodecAudioMP3 && srs_codec_->audio_mp3_demux(data, size, &sample) != ERROR_SUCCESS) {
 				free(data);
-				return;
+				return ret;
 			}
 			free(data);
-			return;	// Just support AAC.
+			return ret;	// Just support AAC.
 		}
 		SrsCodecAudio acodec = (SrsCodecAudio)srs_codec_->audio_codec_id;
 
 		// ts support audio codec: aac/mp3
 		if (acodec != SrsCodecAudioAAC && acodec != SrsCodecAudioMP3) {
 			free(data);
-			return;
+			return ret;
 		}
 		// for aac: ignore sequence header
 		if (acodec == SrsCodecAudioAAC && sample.aac_packet_type == SrsCodecAudioTypeSequenceHeader 
 			|| srs_codec_->aac_object == SrsAacObjectTypeReserved) {
 			free(data);
-			return;
+			return ret;
 		}
 		GotAudioSample(timestamp, &sample);
 	}
@@ -192,9 +225,10 @@ void AnyRtmpPull::DoReadData()
 	//if (srs_human_print_rtmp_packet(type, timestamp, data, size) != 0) {	
 	//}
 	free(data);
+	return ret;
 }
 
-int AnyRtmpPull::GotVideoSample(u_int32_t timestamp, SrsCodecSample *sample)
+int AnyRtmpPull::GotVideoSample(DemuxPayload* payload, u_int32_t timestamp, SrsCodecSample *sample)
 {
 	int ret = ERROR_SUCCESS;
 	// ignore info frame,
@@ -209,19 +243,23 @@ int AnyRtmpPull::GotVideoSample(u_int32_t timestamp, SrsCodecSample *sample)
 		return ret;
 	}
 
+	//* The NALUs are referenced in the payload, the start codes are static,
+	//* sps/pps are copied for they change with the next sequence header.
+	DemuxFrame* frame = new DemuxFrame(payload);
+
 	// when ts message(samples) contains IDR, insert sps+pps.
 	if (sample->has_idr) {
 		// fresh nalu header before sps.
 		if (srs_codec_->sequenceParameterSetLength > 0) {
-			video_payload_->append((const char*)fresh_nalu_header, 4);
+			frame->Append((const char*)fresh_nalu_header, 4);
 			// sps
-			video_payload_->append(srs_codec_->sequenceParameterSetNALUnit, srs_codec_->sequenceParameterSetLength);
+			frame->AppendCopy(srs_codec_->sequenceParameterSetNALUnit, srs_codec_->sequenceParameterSetLength);
 		}
 		// cont nalu header before pps.
 		if (srs_codec_->pictureParameterSetLength > 0) {
-			video_payload_->append((const char*)fresh_nalu_header, 4);
+			frame->Append((const char*)fresh_nalu_header, 4);
 			// pps
-			video_payload_->append(srs_codec_->pictureParameterSetNALUnit, srs_codec_->pictureParameterSetLength);
+			frame->AppendCopy(srs_codec_->pictureParameterSetNALUnit, srs_codec_->pictureParameterSetLength);
 		}
 	}
 
@@ -231,6 +269,7 @@ int AnyRtmpPull::GotVideoSample(u_int32_t timestamp, SrsCodecSample *sample)
 		int32_t size = sample_unit->size;
 
 		if (!sample_unit->bytes || size <= 0) {
+			delete frame;
 			ret = -1;
 			return ret;
 		}
@@ -249,7 +288,9 @@ int AnyRtmpPull::GotVideoSample(u_int32_t timestamp, SrsCodecSample *sample)
 			continue;
 		default: {
             if (nal_unit_type == SrsAvcNaluTypeReserved) {
-                RescanVideoframe(sample_unit->bytes, sample_unit->size, timestamp);
+                RescanVideoframe(frame, sample_unit->bytes, sample_unit->size);
+                callback_.OnRtmpullH264Data(frame, timestamp);
+                frame = new DemuxFrame(payload);
                 continue;
             }
         }
@@ -259,22 +300,24 @@ int AnyRtmpPull::GotVideoSample(u_int32_t timestamp, SrsCodecSample *sample)
 		if (nal_unit_type == SrsAvcNaluTypeIDR) {
 			// insert cont nalu header before frame.
 #ifdef WEBRTC_IOS
-            video_payload_->append((const char*)fresh_nalu_header, 4);
+            frame->Append((const char*)fresh_nalu_header, 4);
 #else
-			video_payload_->append((const char*)cont_nalu_header, 3);
+			frame->Append((const char*)cont_nalu_header, 3);
 #endif
 		}
 		else {
-			video_payload_->append((const char*)fresh_nalu_header, 4);
+			frame->Append((const char*)fresh_nalu_header, 4);
 		}
 		// sample data
-		video_payload_->append(sample_unit->bytes, sample_unit->size);
+		frame->Append(sample_unit->bytes, sample_unit->size);
 	}
 	//* Fix for mutil nalu.
-	if (video_payload_->_data_len != 0) {
-		callback_.OnRtmpullH264Data((uint8_t*)video_payload_->_data, video_payload_->_data_len, timestamp);
+	if (!frame->Empty()) {
+		callback_.OnRtmpullH264Data(frame, timestamp);
+	}
+	else {
+		delete frame;
 	}
-	video_payload_->reset();
 
 	return ret;
 }
@@ -336,82 +379,34 @@ int AnyRtmpPull::GotAudioSample(u_int32_t timestamp, SrsCodecSample *sample)
 		// adts_buffer_fullness; //11bits
 		adts_header[5] |= 0x1f;
 
-		// copy to audio buffer
-		audio_payload_->append((const char*)adts_header, sizeof(adts_header));
-		audio_payload_->append(sample_unit->bytes, sample_unit->size);
+		// the frame is decoded during the callback, no need to hold the payload.
+		DemuxFrame frame(NULL);
+		frame.AppendCopy((const char*)adts_header, sizeof(adts_header));
+		frame.Append(sample_unit->bytes, sample_unit->size);
 
-		callback_.OnRtmpullAACData((uint8_t*)audio_payload_->_data, audio_payload_->_data_len, timestamp);
-		audio_payload_->reset();
+		callback_.OnRtmpullAACData(frame, timestamp);
 	}
 
 	return ret;
 }
 
-void AnyRtmpPull::RescanVideoframe(const char*pdata, int len, uint32_t timestamp)
+void AnyRtmpPull::RescanVideoframe(DemuxFrame* frame, const char*pdata, int len)
 {
     int nal_type = pdata[4] & 0x1f;
-    const char *p = pdata;
     if (nal_type == 7)
-    {// keyframe
-        int find7 = 0;
-        const char* ptr7 = NULL;
-        int size7 = 0;
-        int find8 = 0;
-        const char* ptr8 = NULL;
-        int size8 = 0;
-        const char* ptr5 = NULL;
-        int size5 = 0;
-        int head01 = 4;
-        for (int i = 4; i < len - 4; i++)
-        {
-            if ((p[i] == 0x0 && p[i + 1] == 0x0 && p[i + 2] == 0x0 && p[i + 3] == 0x1) || (p[i] == 0x0 && p[i + 1] == 0x0 && p[i + 2] == 0x1))
-            {
-                if (p[i + 2] == 0x01)
-                    head01 = 3;
-                else
-                    head01 = 4;
-                if (find7 == 0)
-                {
-                    find7 = i;
-                    ptr7 = p;
-                    size7 = find7;
-                    i++;
-                }
-                else if (find8 == 0)
-                {
-                    find8 = i;
-                    ptr8 = p + find7 ;
-                    size8 = find8 - find7;
-                    const char* ptr = p + i;
-                    if ((ptr[head01] & 0x1f) == 5)
-                    {
-                        ptr5 = p + find8 + head01;
-                        size5 = len - find8 - head01;
-                        break;
-                    }
-                }
-                else
-                {
-                    ptr5 = p + i + head01;
-                    size5 = len - i - head01;
-                    break;
-                }
-            }
+    {// keyframe, prefix each of sps/pps/IDR with fresh nalu header.
+        int nalus[PULL_MAX_NALUS];
+        int nb_nalus[PULL_MAX_NALUS];
+        int count = srs_h264_scan_nalus((char*)pdata, len, nalus, nb_nalus, PULL_MAX_NALUS);
+        for (int i = 0; i < count; i++) {
+            frame->Append((const char*)fresh_nalu_header, 4);
+            frame->Append(pdata + nalus[i], nb_nalus[i]);
         }
-        video_payload_->append(ptr7, size7);
-        video_payload_->append(ptr8, size8);
-        video_payload_->append((const char*)fresh_nalu_header, 4);
-        video_payload_->append(ptr5, size5);
-        callback_.OnRtmpullH264Data((uint8_t*)video_payload_->_data, video_payload_->_data_len, timestamp);
-        video_payload_->reset();
     }
     else 
     {
-        video_payload_->append(pdata, len);
-        callback_.OnRtmpullH264Data((uint8_t*)video_payload_->_data, video_payload_->_data_len, timestamp);
-        video_payload_->reset();
+        frame->Append(pdata, len);
     }
-
 }
 
 void AnyRtmpPull::CallConnect()
@@ -425,6 +420,7 @@ void AnyRtmpPull::CallDisconnect()
 {
     rtc::CritScope l(&cs_rtmp_);
     if (rtmp_) {
+        reactor_->Remove(this);
         srs_rtmp_destroy(rtmp_);
         rtmp_ = NULL;
     }
@@ -434,6 +430,10 @@ void AnyRtmpPull::CallDisconnect()
         if(retry_ct_ <= MAX_RETRY_TIME)
         {
             rtmp_ = srs_rtmp_create(str_url_.c_str());
+            if (rtmp_) {
+                srs_rtmp_set_merged_read(rtmp_, PULL_RECV_BUFFER);
+                reactor_->Connect(this, rtmp_, false);
+            }
         } else {
             if(connected_)
                 callback_.OnRtmpullDisconnect();
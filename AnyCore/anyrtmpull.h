@@ -18,7 +18,8 @@
 */
 #ifndef __ANY_RTMP_PULL_H__
 #define __ANY_RTMP_PULL_H__
-#include "webrtc/base/thread.h"
+#include "demuxframe.h"
+#include "rtmpreactor.h"
 #include "srs_librtmp/srs_kernel_codec.h"
 
 enum RTMPLAYER_STATUS
@@ -30,28 +31,6 @@ enum RTMPLAYER_STATUS
 	RS_PLY_Closed		// ֹͣ
 };
 
-typedef struct DemuxData
-{
-	DemuxData(int size) : _data(NULL), _data_len(0), _data_size(size){
-		_data = new char[_data_size];
-	}
-	virtual ~DemuxData(void){ delete[] _data; }
-	void reset() {
-		_data_len = 0;
-	}
-	int append(const char* pData, int len){
-		if (_data_len + len > _data_size)
-			return 0;
-		memcpy(_data + _data_len, pData, len);
-		_data_len += len;
-		return len;
-	}
-
-	char*_data;
-	int _data_len;
-	int _data_size;
-}DemuxData;
-
 class AnyRtmpPullCallback
 {
 public:
@@ -61,31 +40,42 @@ public:
 	virtual void OnRtmpullConnected() = 0;
 	virtual void OnRtmpullFailed() = 0;
 	virtual void OnRtmpullDisconnect() = 0;
-	virtual void OnRtmpullH264Data(const uint8_t*pdata, int len, uint32_t ts) = 0;
-	virtual void OnRtmpullAACData(const uint8_t*pdata, int len, uint32_t ts) = 0;
+	//* AnnexB frame, the callee takes the frame and deletes it.
+	virtual void OnRtmpullH264Data(DemuxFrame* frame, uint32_t ts) = 0;
+	//* ADTS frame, only valid during the call.
+	virtual void OnRtmpullAACData(const DemuxFrame& frame, uint32_t ts) = 0;
+	//* Each flv tag before demuxed, for the relay, only valid during the call.
+	virtual void OnRtmpullPacket(char type, uint32_t ts, const char* data, int size) {};
 };
 
-class AnyRtmpPull : public rtc::Thread
+class AnyRtmpPull : public RtmpReactorHandler
 {
 public:
 	AnyRtmpPull(AnyRtmpPullCallback&callback, const std::string&url);
 	virtual ~AnyRtmpPull(void);
 
 protected:
-	//* For Thread
-	virtual void Run();
+	//* For rtc::MessageHandler, on the reactor.
+	virtual void OnMessage(rtc::Message* msg);
+	//* For RtmpReactorHandler
+	virtual void OnRtmpReadable();
+	virtual void OnRtmpWritable();
+	virtual void OnRtmpConnect(int ret);
 
+	void DoConnected();
 	void DoReadData();
-	int GotVideoSample(u_int32_t timestamp, SrsCodecSample *sample);
+	int DoReadPacket();
+	int GotVideoSample(DemuxPayload* payload, u_int32_t timestamp, SrsCodecSample *sample);
 	int GotAudioSample(u_int32_t timestamp, SrsCodecSample *sample);
     
-    void RescanVideoframe(const char*pdata, int len, uint32_t timestamp);
+    void RescanVideoframe(DemuxFrame* frame, const char*pdata, int len);
 
 	void CallConnect();
 	void CallDisconnect();
 
 private:
 	AnyRtmpPullCallback&	callback_;
+	RtmpReactor*		reactor_;
 	SrsAvcAacCodec*		srs_codec_;
 	bool				running_;
     bool                connected_;
@@ -95,7 +85,5 @@ private:
     rtc::CriticalSection	cs_rtmp_;
 	RTMPLAYER_STATUS	rtmp_status_;
 	void*				rtmp_;
-	DemuxData*			audio_payload_;
-	DemuxData*			video_payload_;
 };
 #endif	// __ANY_RTMP_PULL_H__
\ No newline at end of file
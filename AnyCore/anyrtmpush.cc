@@ -23,14 +23,68 @@
 #include <iostream>
 
 #define MAX_RETRY_TIME	3
+#define PUSH_MAX_BYTES	(512 * 1024)	// Max bytes to send per loop
+#define PUSH_MAX_NALUS	64				// Max NALUs of one frame, the left data is in the last one
+#define DROP_NONREF_MS	3000			// Default queued ms to drop non-reference frames
+#define DROP_GOP_MS		5000			// Default queued ms to drop GOPs
+#define DROP_MAX_MS		10000			// Default max queued ms
+#define PUSH_VIDEO_QUEUE	1024		// Max NALUs waiting for the reactor
+#define PUSH_AUDIO_QUEUE	512			// Max audio frames waiting for the reactor
+#define PUSH_STAT_TIME	1000			// Interval of the status event, ms
+
+enum {
+	MSG_CONNECT,
+	MSG_SEND,		// New data in the queues
+	MSG_STAT,
+	MSG_POLICY		// SetSendQueuePolicy, applied on the reactor
+};
+
+static_assert(ENC_BUFFER_HEADROOM >= SRS_H264_NOCOPY_HEADROOM, "EncBuffer headroom too small for srs_librtmp");
+
+//* AtomicOps has no add or exchange, build them on CompareAndSwap.
+static void AtomicAdd(volatile int* i, int value)
+{
+	int old = rtc::AtomicOps::AcquireLoad(i);
+	while (rtc::AtomicOps::CompareAndSwap(i, old, old + value) != old)
+		old = rtc::AtomicOps::AcquireLoad(i);
+}
+
+static int AtomicTake(volatile int* i)
+{
+	int old = rtc::AtomicOps::AcquireLoad(i);
+	while (rtc::AtomicOps::CompareAndSwap(i, old, 0) != old)
+		old = rtc::AtomicOps::AcquireLoad(i);
+	return old;
+}
+
 AnyRtmpPush::AnyRtmpPush(AnyRtmpushCallback&callback, const std::string&url)
 : callback_(callback)
+, reactor_(NULL)
 , running_(false)
-, need_keyframe_(true)
+, need_keyframe_(1)
 , only_audio_mode_(false)
 , retrys_(0)
-, stat_time_(0)
 , net_band_(0)
+, que_video_enc_(PUSH_VIDEO_QUEUE)
+, que_audio_enc_(PUSH_AUDIO_QUEUE)
+, send_posted_(0)
+, drop_policy_(SDP_NonRef | SDP_Gop)
+, drop_nonref_ms_(DROP_NONREF_MS)
+, drop_gop_ms_(DROP_GOP_MS)
+, drop_max_ms_(DROP_MAX_MS)
+, set_policy_(SDP_NonRef | SDP_Gop)
+, set_nonref_ms_(DROP_NONREF_MS)
+, set_gop_ms_(DROP_GOP_MS)
+, set_max_ms_(DROP_MAX_MS)
+, drop_to_keyframe_(0)
+, wait_keyframe_(false)
+, last_sps_(lst_enc_data_.end())
+, video_back_dts_(0)
+, audio_back_dts_(0)
+, drop_frames_(0)
+, drop_bytes_(0)
+, full_drop_frames_(0)
+, full_drop_bytes_(0)
 , sound_format_(10)
 , sound_rate_(3)	// 3 = 44 kHz
 , sound_size_(1)	// 1 = 16-bit samples
@@ -40,35 +94,32 @@ AnyRtmpPush::AnyRtmpPush(AnyRtmpushCallback&callback, const std::string&url)
 {
 	str_url_ = url;
 	rtmp_ = srs_rtmp_create(str_url_.c_str());
+	reactor_ = RtmpReactor::Get();
 
 	running_ = true;
-	rtc::Thread::Start();
+	reactor_->PostDelayed(RTC_FROM_HERE, PUSH_STAT_TIME, this, MSG_STAT);
+	if (rtmp_) {
+		reactor_->Post(RTC_FROM_HERE, this, MSG_CONNECT);
+	}
 }
 
 AnyRtmpPush::~AnyRtmpPush(void)
 {
 	running_ = false;
-	rtmp_status_ = RS_STM_Closed;
-	rtc::Thread::SleepMs(100);
 	{
 		rtc::CritScope l(&cs_rtmp_);
-		if (rtmp_) {
-			srs_rtmp_disconnect_server(rtmp_);
-		}
+		rtmp_status_ = RS_STM_Closed;
 	}
-	rtc::Thread::Stop();
+	//* Also cancels the setup, the socket is closed after removed from the
+	//* reactor, or its fd may be reused by another session.
+	reactor_->Detach(this);
 	if (rtmp_) {
 		srs_rtmp_destroy(rtmp_);
 		rtmp_ = NULL;
 	}
 
-	std::list<EncData*>::iterator iter = lst_enc_data_.begin();
-	while (iter != lst_enc_data_.end()) {
-		EncData* ptr = *iter;
-		lst_enc_data_.erase(iter++);
-		delete[] ptr->_data;
-		delete ptr;
-	}
+	//* No producer is left, the streamer deletes us under the lock the encoders push with.
+	ClearEncData();
 }
 
 void AnyRtmpPush::EnableOnlyAudioMode()
@@ -83,6 +134,19 @@ void AnyRtmpPush::SetVideoParameter(int width, int height, int videodatarate, in
     video_datarate_ = videodatarate;
 }
 
+void AnyRtmpPush::SetSendQueuePolicy(int policy, int nonrefMs, int gopMs, int maxMs)
+{
+	//* CheckSendQueue reads the policy on the reactor, so it is only changed there.
+	{
+		rtc::CritScope l(&cs_policy_);
+		set_policy_ = policy;
+		set_nonref_ms_ = nonrefMs;
+		set_gop_ms_ = gopMs;
+		set_max_ms_ = maxMs;
+	}
+	reactor_->Post(RTC_FROM_HERE, this, MSG_POLICY);
+}
+
 void AnyRtmpPush::SetAudioParameter(int samplerate, int pcmbitsize, int channel)
 {
 	sound_samplerate_ = samplerate;
@@ -98,7 +162,9 @@ void AnyRtmpPush::SetAudioParameter(int samplerate, int pcmbitsize, int channel)
 		sound_rate_ = 1;
 		break;
 	default:
-		assert(false);
+		//* Other AAC rates(e.g. 48k, 16k, 8k of the cameras), the AudioSpecificConfig
+		//* keeps the rate of the ADTS header, the flv rate field is ignored for AAC.
+		sound_rate_ = 0;
 		break;
 	};
 
@@ -129,86 +195,39 @@ void AnyRtmpPush::SetAudioParameter(int samplerate, int pcmbitsize, int channel)
 	}
 }
 
-void AnyRtmpPush::SetH264Data(uint8_t* pData, int len, uint32_t ts)
+void AnyRtmpPush::SetH264Data(uint8_t* pData, int len, uint32_t dts, uint32_t pts)
 {
-    
-	uint8_t *p = pData;
-	int nal_type = p[4] & 0x1f;
-	if(nal_type == 7)
-		need_keyframe_ = false;
-	if(need_keyframe_)
+	int nalus[PUSH_MAX_NALUS];
+	int nb_nalus[PUSH_MAX_NALUS];
+	int count = srs_h264_scan_nalus((char*)pData, len, nalus, nb_nalus, PUSH_MAX_NALUS);
+	if (count == 0)
 		return;
-	if(nal_type == 7)
-	{// keyframe
-		int find7 = 0;
-		uint8_t* ptr7 = NULL;
-		int size7 = 0;
-		int find8 = 0;
-		uint8_t* ptr8 = NULL;
-		int size8 = 0;
-		uint8_t* ptr5 = NULL;
-		int size5 = 0;
-		int head01 = 4;
-		for (int i = 4; i < len - 4; i++)
-		{
-			if ((p[i] == 0x0 && p[i + 1] == 0x0 && p[i + 2] == 0x0 && p[i + 3] == 0x1) || (p[i] == 0x0 && p[i + 1] == 0x0 && p[i + 2] == 0x1))
-			{
-			  if (p[i + 2] == 0x01)
-				  head01 = 3;
-			  else
-				  head01 = 4;
-			  if (find7 == 0)
-			  {
-				  find7 = i;
-				  ptr7 = p;
-				  size7 = find7;
-				  i++;
-			  }
-			  else if (find8 == 0)
-			  {
-				  find8 = i;
-				  ptr8 = p + find7;
-				  size8 = find8 - find7;
-				  unsigned char* ptr = p + i;
-				  if ((ptr[head01] & 0x1f) == 5)
-				  {
-					  ptr5 = p + find8;
-					  size5 = len - find8;
-					  break;
-				  }
-			  }
-			  else
-			  {
-				  ptr5 = p + i;
-				  size5 = len - i;
-				  break;
-			  }
-			}
-		}
-		
-		GotH264Nal(ptr7, size7, ts);
-		GotH264Nal(ptr8, size8, ts);
-		GotH264Nal(ptr5, size5, ts);
+	int nal_type = pData[nalus[0]] & 0x1f;
+	if(nal_type == 7) {
+		rtc::AtomicOps::ReleaseStore(&need_keyframe_, 0);
+		rtc::AtomicOps::ReleaseStore(&drop_to_keyframe_, 0);
 	}
-	else 
-	{
-		GotH264Nal(pData, len, ts);
-    }
+	if(rtc::AtomicOps::AcquireLoad(&need_keyframe_) || rtc::AtomicOps::AcquireLoad(&drop_to_keyframe_))
+		return;
+	GotH264Nalus(pData, nalus, nb_nalus, count, dts, pts);
 }
 
 void AnyRtmpPush::SetAacData(uint8_t* pData, int nLen, uint32_t ts)
 {
-	if(need_keyframe_ && !only_audio_mode_)
+	if(rtc::AtomicOps::AcquireLoad(&need_keyframe_) && !only_audio_mode_)
 		return;
-	EncData* pdata = new EncData();
-	pdata->_data = new uint8_t[nLen];
-	memcpy(pdata->_data, pData, nLen);
-	pdata->_dataLen = nLen;
-	pdata->_bVideo = false;
-	pdata->_type = AUDIO_DATA;
-	pdata->_dts = ts;
-	rtc::CritScope l(&cs_list_enc_);
-	lst_enc_data_.push_back(pdata);
+	EncBuffer* buf = EncBuffer::Create(nLen);
+	memcpy(buf->Data(), pData, nLen);
+	buf->SetSize(nLen);
+	PushEncData(AUDIO_DATA, buf, ts, ts);
+}
+
+void AnyRtmpPush::SetAacData(EncBuffer* buf, uint32_t ts)
+{
+	if(rtc::AtomicOps::AcquireLoad(&need_keyframe_) && !only_audio_mode_)
+		return;
+	buf->AddRef();
+	PushEncData(AUDIO_DATA, buf, ts, ts);
 }
 
 uint8_t * put_byte( uint8_t *output, uint8_t nVal )
@@ -284,8 +303,9 @@ enum
 };
 
 void AnyRtmpPush::setMetaData(){
-    uint8_t body[512] = {0};
-    uint8_t* p = (uint8_t*)body;
+    EncBuffer* buf = EncBuffer::Create(512);
+    uint8_t* body = buf->Data();
+    uint8_t* p = body;
     p = put_byte(p, AMF_STRING);
     //p = put_be16(p, AMF_STRING_LEN);
     p = put_amf_string(p, "onMetaData");
@@ -334,114 +354,370 @@ void AnyRtmpPush::setMetaData(){
     p = put_amf_double(p, sound_format_);
 
     int len = p-body;
-    setMetaData((uint8_t*)body, len, 0);
+    buf->SetSize(len);
+    PushEncData(META_DATA, buf, 0, 0);
 }
 
 void AnyRtmpPush::setMetaData(uint8_t* pData, int nLen, uint32_t ts)
 {
-	EncData* pdata = new EncData();
-	pdata->_data = new uint8_t[nLen];
-	memcpy(pdata->_data, pData, nLen);
-	pdata->_dataLen = nLen;
-	pdata->_bVideo = false;
-	pdata->_type = META_DATA;
-	pdata->_dts = ts;
-	rtc::CritScope l(&cs_list_enc_);
-	lst_enc_data_.push_back(pdata);
+	EncBuffer* buf = EncBuffer::Create(nLen);
+	memcpy(buf->Data(), pData, nLen);
+	buf->SetSize(nLen);
+	PushEncData(META_DATA, buf, ts, ts);
+}
+
+void AnyRtmpPush::GotH264Nal(uint8_t* pData, int nLen, uint32_t dts, uint32_t pts)
+{
+	int nalus[PUSH_MAX_NALUS];
+	int nb_nalus[PUSH_MAX_NALUS];
+	int count = srs_h264_scan_nalus((char*)pData, nLen, nalus, nb_nalus, PUSH_MAX_NALUS);
+	if (count == 0 && nLen > 0) {
+		//* Raw NALU without start code
+		nalus[0] = 0;
+		nb_nalus[0] = nLen;
+		count = 1;
+	}
+	GotH264Nalus(pData, nalus, nb_nalus, count, dts, pts);
 }
 
-void AnyRtmpPush::GotH264Nal(uint8_t* pData, int nLen, uint32_t ts)
+void AnyRtmpPush::GotH264Nalus(const uint8_t* pData, const int* nalus, const int* nb_nalus, int count, uint32_t dts, uint32_t pts)
+{
+	//* Copy each NALU without start code to a pooled buffer, it's the only copy
+	//* of video on the publish path, srs_librtmp muxes the flv header in the headroom.
+	for (int i = 0; i < count; i++) {
+		EncBuffer* buf = EncBuffer::Create(nb_nalus[i]);
+		memcpy(buf->Data(), pData + nalus[i], nb_nalus[i]);
+		buf->SetSize(nb_nalus[i]);
+		PushEncData(VIDEO_DATA, buf, dts, pts);
+	}
+}
+
+void AnyRtmpPush::PushEncData(ENC_DATA_TYPE type, EncBuffer* buf, uint32_t dts, uint32_t pts)
 {
 	EncData* pdata = new EncData();
-	pdata->_data = new uint8_t[nLen];
-	memcpy(pdata->_data, pData, nLen);
-	pdata->_dataLen = nLen;
-	pdata->_bVideo = true;
-	pdata->_type = VIDEO_DATA;
-	pdata->_dts = ts;
-	rtc::CritScope l(&cs_list_enc_);
-	lst_enc_data_.push_back(pdata);
+	pdata->_buf = buf;
+	pdata->_dataLen = buf->Size();
+	pdata->_bVideo = (type == VIDEO_DATA);
+	pdata->_type = type;
+	pdata->_dts = dts;
+	pdata->_pts = pts;
+	//* Audio and video come from different threads, each has its own queue.
+	rtc::SpscQueue<EncData*>& que = (type == AUDIO_DATA) ? que_audio_enc_ : que_video_enc_;
+	if (!que.Push(&pdata)) {
+		//* The reactor is stuck, the send queue policy can't run.
+		if (type == VIDEO_DATA)
+			rtc::AtomicOps::ReleaseStore(&drop_to_keyframe_, 1);
+		rtc::AtomicOps::Increment(&full_drop_frames_);
+		AtomicAdd(&full_drop_bytes_, pdata->_dataLen);
+		delete pdata;
+		return;
+	}
+	//* One wakeup for all the data pushed before the reactor takes them.
+	if (rtc::AtomicOps::CompareAndSwap(&send_posted_, 0, 1) == 0) {
+		reactor_->Post(RTC_FROM_HERE, this, MSG_SEND);
+	}
 }
 
-//* For Thread
-void AnyRtmpPush::Run()
+void AnyRtmpPush::PullEncData()
 {
-	while(running_)
-	{
-		{// ProcessMessages
-			this->ProcessMessages(10);
+	//* Merge the two queues by dts, each of them is in dts order.
+	EncData** video = que_video_enc_.Front();
+	EncData** audio = que_audio_enc_.Front();
+	while (video != NULL || audio != NULL) {
+		EncData* pdata = NULL;
+		if (audio == NULL || (video != NULL && (int)((*video)->_dts - (*audio)->_dts) <= 0)) {
+			que_video_enc_.Pop(&pdata);
+			video = que_video_enc_.Front();
 		}
-
-		if(rtmp_ != NULL)
-		{
-			switch (rtmp_status_) {
-			case RS_STM_Init:
-			{
-				if (srs_rtmp_handshake(rtmp_) == 0) {
-					srs_human_trace("SRS: simple handshake ok.");
-					rtmp_status_ = RS_STM_Handshaked;
-				}
-				else {
-					CallDisconnect();
-				}
+		else {
+			que_audio_enc_.Pop(&pdata);
+			audio = que_audio_enc_.Front();
+		}
+		if (pdata->_type == VIDEO_DATA) {
+			bool sps = (pdata->_buf->Data()[0] & 0x1f) == 7;
+			if (sps) {
+				wait_keyframe_ = false;
 			}
-				break;
-			case RS_STM_Handshaked:
-			{
-				if (srs_rtmp_connect_app(rtmp_) == 0) {
-					srs_human_trace("SRS: connect vhost/app ok.");
-					rtmp_status_ = RS_STM_Connected;
-				}
-				else {
-					CallDisconnect();
-				}
+			else if (wait_keyframe_) {
+				//* Pushed before the encoder saw drop_to_keyframe_.
+				DropEncData(pdata);
+				continue;
 			}
-				break;
-			case RS_STM_Connected:
-			{
-				if (srs_rtmp_publish_stream(rtmp_) == 0) {
-					srs_human_trace("SRS: publish stream ok.");
-					rtmp_status_ = RS_STM_Published;
-					CallConnect();
-				}
-				else {
-					CallDisconnect();
-				}
+			video_back_dts_ = pdata->_dts;
+			lst_enc_data_.push_back(pdata);
+			if (sps)
+				last_sps_ = --lst_enc_data_.end();
+		}
+		else {
+			if (pdata->_type == AUDIO_DATA)
+				audio_back_dts_ = pdata->_dts;
+			lst_enc_data_.push_back(pdata);
+		}
+	}
+	CheckSendQueue();
+}
+
+void AnyRtmpPush::ClearEncData()
+{
+	EncData* pdata = NULL;
+	while (que_video_enc_.Pop(&pdata))
+		delete pdata;
+	while (que_audio_enc_.Pop(&pdata))
+		delete pdata;
+	std::list<EncData*>::iterator iter = lst_enc_data_.begin();
+	while (iter != lst_enc_data_.end()) {
+		EncData* ptr = *iter;
+		lst_enc_data_.erase(iter++);
+		delete ptr;
+	}
+	last_sps_ = lst_enc_data_.end();
+}
+
+int AnyRtmpPush::QueuedTime()
+{
+	if (lst_enc_data_.size() < 2)
+		return 0;
+	return (int)(lst_enc_data_.back()->_dts - lst_enc_data_.front()->_dts);
+}
+
+std::list<EncData*>::iterator AnyRtmpPush::FirstVideo()
+{
+	std::list<EncData*>::iterator iter = lst_enc_data_.begin();
+	while (iter != lst_enc_data_.end() && (*iter)->_type != VIDEO_DATA)
+		iter++;
+	return iter;
+}
+
+int AnyRtmpPush::VideoQueuedTime()
+{
+	std::list<EncData*>::iterator first = FirstVideo();
+	if (first == lst_enc_data_.end())
+		return 0;
+	return (int)(video_back_dts_ - (*first)->_dts);
+}
+
+void AnyRtmpPush::CheckSendQueue()
+{
+	if (drop_policy_ == SDP_None)
+		return;
+
+	//* Video and audio are measured apart, the stale frames of one never
+	//* make the other dropped or scanned.
+	int video_queued = VideoQueuedTime();
+	if ((drop_policy_ & SDP_NonRef) && drop_nonref_ms_ > 0 && video_queued > drop_nonref_ms_) {
+		//* nal_ref_idc is 0 for the NALUs no other frame refers to.
+		std::list<EncData*>::iterator iter = lst_enc_data_.begin();
+		while (iter != lst_enc_data_.end()) {
+			EncData* ptr = *iter;
+			if (ptr->_type == VIDEO_DATA && (ptr->_buf->Data()[0] & 0x60) == 0) {
+				lst_enc_data_.erase(iter++);
+				DropEncData(ptr);
 			}
-				break;
-			case RS_STM_Published:
-			{
-				DoSendData();
+			else {
+				iter++;
 			}
-				break;
+		}
+		video_queued = VideoQueuedTime();
+	}
+
+	//* Video is always bounded by the max.
+	if (((drop_policy_ & SDP_Gop) && drop_gop_ms_ > 0 && video_queued > drop_gop_ms_)
+		|| (drop_max_ms_ > 0 && video_queued > drop_max_ms_)) {
+		DropVideoToKeyFrame();
+	}
+
+	if ((drop_policy_ & SDP_Audio) && drop_max_ms_ > 0) {
+		//* The oldest audio first, stop at the first one in the max.
+		std::list<EncData*>::iterator iter = lst_enc_data_.begin();
+		while (iter != lst_enc_data_.end()) {
+			EncData* ptr = *iter;
+			if (ptr->_type != AUDIO_DATA) {
+				iter++;
+				continue;
 			}
+			if ((int)(audio_back_dts_ - ptr->_dts) <= drop_max_ms_)
+				break;
+			lst_enc_data_.erase(iter++);
+			DropEncData(ptr);
 		}
 	}
 }
 
-void AnyRtmpPush::CallConnect()
+void AnyRtmpPush::DropVideoToKeyFrame()
 {
-	need_keyframe_ = true;
-	retrys_ = 0;
-	{
-		rtc::CritScope l(&cs_list_enc_);
-		std::list<EncData*>::iterator iter = lst_enc_data_.begin();
-		while (iter != lst_enc_data_.end()) {
+	//* The newest GOP starts with the SPS before its IDR, skip to it.
+	std::list<EncData*>::iterator first = FirstVideo();
+	std::list<EncData*>::iterator iter = first;
+	if (last_sps_ != lst_enc_data_.end() && last_sps_ != first) {
+		while (iter != last_sps_) {
 			EncData* ptr = *iter;
+			if (ptr->_type == VIDEO_DATA) {
+				lst_enc_data_.erase(iter++);
+				DropEncData(ptr);
+			}
+			else {
+				iter++;
+			}
+		}
+		return;
+	}
+
+	//* No later keyframe, keep the one at the front with the NALUs of its
+	//* frame, drop the rest and the coming frames until the next keyframe.
+	if (iter == last_sps_) {
+		uint32_t key_dts = (*iter)->_dts;
+		while (iter != lst_enc_data_.end() && ((*iter)->_type != VIDEO_DATA || (*iter)->_dts == key_dts))
+			iter++;
+	}
+	while (iter != lst_enc_data_.end()) {
+		EncData* ptr = *iter;
+		if (ptr->_type == VIDEO_DATA) {
 			lst_enc_data_.erase(iter++);
-			delete[] ptr->_data;
-			delete ptr;
+			DropEncData(ptr);
+		}
+		else {
+			iter++;
 		}
 	}
+	wait_keyframe_ = true;
+	rtc::AtomicOps::ReleaseStore(&drop_to_keyframe_, 1);
+}
+
+void AnyRtmpPush::DropEncData(EncData* pdata)
+{
+	if (pdata->_type == AUDIO_DATA) {
+		drop_frames_++;
+	}
+	else if (pdata->_type == VIDEO_DATA) {
+		//* Count the slices only, not the sps/pps/sei.
+		int nal_type = pdata->_buf->Data()[0] & 0x1f;
+		if (nal_type == 1 || nal_type == 5)
+			drop_frames_++;
+	}
+	drop_bytes_ += pdata->_dataLen;
+	delete pdata;
+}
+
+//* For rtc::MessageHandler
+void AnyRtmpPush::OnMessage(rtc::Message* msg)
+{
+	switch (msg->message_id) {
+	case MSG_CONNECT:
+		reactor_->Connect(this, rtmp_, true);
+		break;
+	case MSG_SEND:
+		rtc::AtomicOps::ReleaseStore(&send_posted_, 0);
+		if (rtmp_status_ == RS_STM_Published)
+			DoSendData();
+		break;
+	case MSG_STAT:
+		if (rtmp_status_ == RS_STM_Published)
+			DoStatistics();
+		reactor_->PostDelayed(RTC_FROM_HERE, PUSH_STAT_TIME, this, MSG_STAT);
+		break;
+	case MSG_POLICY: {
+		rtc::CritScope l(&cs_policy_);
+		drop_policy_ = set_policy_;
+		drop_nonref_ms_ = set_nonref_ms_;
+		drop_gop_ms_ = set_gop_ms_;
+		drop_max_ms_ = set_max_ms_;
+	}
+		break;
+	}
+}
+
+//* For RtmpReactorHandler
+void AnyRtmpPush::OnRtmpReadable()
+{
+	//* Nothing to play, but the server sends the acks, and closes the socket on error.
+	while (running_) {
+		int size;
+		char type;
+		char* data;
+		u_int32_t timestamp;
+		int ret = srs_rtmp_read_packet(rtmp_, &type, &timestamp, &data, &size);
+		if (srs_rtmp_is_would_block(ret)) {
+			break;
+		}
+		if (ret != 0) {
+			srs_human_trace("read packet failed. ret=%d", ret);
+			CallDisconnect();
+			break;
+		}
+		free(data);
+	}
+}
+
+void AnyRtmpPush::OnRtmpWritable()
+{
+	int ret = srs_rtmp_flush(rtmp_);
+	if (ret != 0) {
+		srs_human_trace("send batch data failed. ret=%d", ret);
+		CallDisconnect();
+		return;
+	}
+	if (srs_rtmp_get_send_pending(rtmp_) == 0) {
+		reactor_->SetWritable(this, false);
+		DoSendData();
+	}
+}
+
+void AnyRtmpPush::OnRtmpConnect(int ret)
+{
+	if (ret != 0) {
+		srs_human_trace("SRS: publish stream failed. ret=%d", ret);
+		CallDisconnect();
+		return;
+	}
+	srs_human_trace("SRS: publish stream ok.");
+	DoConnected();
+}
+
+void AnyRtmpPush::DoConnected()
+{
+	{
+		rtc::CritScope l(&cs_rtmp_);
+		if (rtmp_status_ == RS_STM_Closed)
+			return;
+		rtmp_status_ = RS_STM_Published;
+		reactor_->Add(this, srs_rtmp_get_fd(rtmp_));
+	}
+	CallConnect();
+	//* The messages after the publish response may be read to the buffer already.
+	if (srs_rtmp_has_buffered(rtmp_)) {
+		OnRtmpReadable();
+	}
+}
+
+void AnyRtmpPush::DoStatistics()
+{
+	uint32_t delayMs = QueuedTime();
+
+	drop_frames_ += AtomicTake(&full_drop_frames_);
+	drop_bytes_ += AtomicTake(&full_drop_bytes_);
+	CallStatusEvent(delayMs, net_band_*(8+1), drop_frames_, drop_bytes_);
+	net_band_ = 0;
+	drop_frames_ = 0;
+	drop_bytes_ = 0;
+}
+
+void AnyRtmpPush::CallConnect()
+{
+	rtc::AtomicOps::ReleaseStore(&need_keyframe_, 1);
+	rtc::AtomicOps::ReleaseStore(&drop_to_keyframe_, 0);
+	wait_keyframe_ = false;
+	retrys_ = 0;
+	ClearEncData();
 	callback_.OnRtmpConnected();
 }
 
 void AnyRtmpPush::CallDisconnect()
 {
-	need_keyframe_ = true;
+	rtc::AtomicOps::ReleaseStore(&need_keyframe_, 1);
     {
         rtc::CritScope l(&cs_rtmp_);
         if (rtmp_) {
+            reactor_->Remove(this);
             srs_rtmp_destroy(rtmp_);
             rtmp_ = NULL;
         }
@@ -451,6 +727,9 @@ void AnyRtmpPush::CallDisconnect()
             if(retrys_ <= MAX_RETRY_TIME)
             {
                 rtmp_ = srs_rtmp_create(str_url_.c_str());
+                if (rtmp_) {
+                    reactor_->Connect(this, rtmp_, true);
+                }
                 callback_.OnRtmpReconnecting(retrys_);
             } else {
                 callback_.OnRtmpDisconnect();
@@ -459,29 +738,41 @@ void AnyRtmpPush::CallDisconnect()
     }
 }
 
-void AnyRtmpPush::CallStatusEvent(int delayMs, int netBand)
+void AnyRtmpPush::CallStatusEvent(int delayMs, int netBand, int dropFrames, int dropBytes)
 {
-	callback_.OnRtmpStatusEvent(delayMs, netBand);
+	callback_.OnRtmpStatusEvent(delayMs, netBand, dropFrames, dropBytes);
 }
 
 void AnyRtmpPush::DoSendData()
 {
-	EncData* dataPtr = NULL;
-	{
-		rtc::CritScope l(&cs_list_enc_);
-		if (lst_enc_data_.size() > 0) {
-			dataPtr = lst_enc_data_.front();
-			lst_enc_data_.pop_front();
-		}
+	//* Drain the queue, but keep the loop responsive with a byte budget.
+	//* All packets of one loop are merged to one writev by srs_librtmp.
+	int sent_bytes = 0;
+	bool failed = false;
+	PullEncData();
+	if (srs_rtmp_get_send_pending(rtmp_) > 0) {
+		//* The socket is full, the queue policy goes on until writable.
+		reactor_->SetWritable(this, true);
+		return;
 	}
-
-	if (dataPtr != NULL) {
+	srs_rtmp_batch_begin(rtmp_);
+	while (running_ && !failed && sent_bytes < PUSH_MAX_BYTES) {
+		if (lst_enc_data_.size() == 0)
+			break;
+		EncData* dataPtr = lst_enc_data_.front();
+		if (last_sps_ == lst_enc_data_.begin())
+			last_sps_ = lst_enc_data_.end();
+		lst_enc_data_.pop_front();
+
+		//* The buffer is released by srs_librtmp when sent out, even if error.
+		EncBuffer* buf = dataPtr->_buf;
+		dataPtr->_buf = NULL;
 		if (dataPtr->_type == VIDEO_DATA) {
 
-			char *ptr = (char*)dataPtr->_data;
-			int len = dataPtr->_dataLen;
+			char *ptr = (char*)buf->Data();
+			int len = buf->Size();
 			int ret = 0;
-			ret = srs_h264_write_raw_frames(rtmp_, ptr, len, dataPtr->_dts, dataPtr->_dts);
+			ret = srs_h264_write_raw_frame_nocopy(rtmp_, ptr, len, dataPtr->_dts, dataPtr->_pts, EncBuffer::FreeData, buf);
 
 			if (ret != 0) {
 				if (srs_h264_is_dvbsp_error(ret)) {
@@ -495,48 +786,48 @@ void AnyRtmpPush::DoSendData()
 				}
 				else {
 					srs_human_trace("send h264 raw data failed. ret=%d", ret);
-					CallDisconnect();
-					return;
+					failed = true;
 				}
 			}
 		}
 		else if(dataPtr->_type == AUDIO_DATA){
 			int ret = 0;
-			if ((ret = srs_audio_write_raw_frame(rtmp_,
+			if ((ret = srs_audio_write_raw_frame_nocopy(rtmp_,
 				sound_format_, sound_rate_, sound_size_, sound_type_,
-				(char*)dataPtr->_data, dataPtr->_dataLen, dataPtr->_dts)) != 0) {
+				(char*)buf->Data(), buf->Size(), dataPtr->_dts, EncBuffer::FreeData, buf)) != 0) {
 				srs_human_trace("send audio raw data failed. ret=%d", ret);
-				CallDisconnect();
-				return;
+				failed = true;
 			}
 		}
 		else if(dataPtr->_type == META_DATA){
-            int ret = srs_rtmp_write_packet(rtmp_, SRS_RTMP_TYPE_SCRIPT, dataPtr->_dts, (char*)dataPtr->_data, dataPtr->_dataLen);
+			int ret = srs_rtmp_write_packet_nocopy(rtmp_, SRS_RTMP_TYPE_SCRIPT, dataPtr->_dts, (char*)buf->Data(), buf->Size(), EncBuffer::FreeData, buf);
 			if (ret != 0) {
 				srs_human_trace("send metadata failed. ret=%d", ret);
 			}
-		    return;
 		}
 
+		sent_bytes += dataPtr->_dataLen;
 		net_band_ += dataPtr->_dataLen;
-		delete[] dataPtr->_data;
 		delete dataPtr;
 	}
 
-	//* Statics
-	if(stat_time_ <= rtc::Time())
-	{
-		stat_time_ = rtc::Time() + 1000;
-		uint32_t delayMs = 0;
-
-		rtc::CritScope l(&cs_list_enc_);
-		if (lst_enc_data_.size() > 0) {
-			EncData* frontprt = lst_enc_data_.front();
-			EncData* backptr = lst_enc_data_.back();
-			delayMs = backptr->_dts - frontprt->_dts;
-		}
+	int ret = srs_rtmp_batch_end(rtmp_);
+	if (ret != 0 && !failed) {
+		srs_human_trace("send batch data failed. ret=%d", ret);
+		failed = true;
+	}
+	if (failed) {
+		CallDisconnect();
+		return;
+	}
 
-		CallStatusEvent(delayMs, net_band_*(8+1));
-		net_band_ = 0;
+	if (srs_rtmp_get_send_pending(rtmp_) > 0) {
+		reactor_->SetWritable(this, true);
+	}
+	else if (lst_enc_data_.size() > 0) {
+		//* Budget used up, go on after the other sessions.
+		if (rtc::AtomicOps::CompareAndSwap(&send_posted_, 0, 1) == 0) {
+			reactor_->Post(RTC_FROM_HERE, this, MSG_SEND);
+		}
 	}
 }
\ No newline at end of file
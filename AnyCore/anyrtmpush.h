@@ -18,7 +18,9 @@
 */
 #ifndef __ANY_RTMP_PUSH_H__
 #define __ANY_RTMP_PUSH_H__
-#include "webrtc/base/thread.h"
+#include "encbuffer.h"
+#include "rtmpreactor.h"
+#include "webrtc/base/spsc_queue.h"
 
 enum RTMP_STATUS
 {
@@ -29,6 +31,15 @@ enum RTMP_STATUS
 	RS_STM_Closed		// ر
 };
 
+//* Drop policy of the send queue, when the uplink is slower than the encoders
+enum SEND_DROP_POLICY
+{
+	SDP_None	= 0x00,		// Never drop, the queue is unbounded
+	SDP_NonRef	= 0x01,		// Drop the non-reference video frames first
+	SDP_Gop		= 0x02,		// Drop whole GOPs up to the newest IDR
+	SDP_Audio	= 0x04		// Drop the oldest audio over the max, otherwise never drop audio
+};
+
 enum ENC_DATA_TYPE{
     VIDEO_DATA,
     AUDIO_DATA,
@@ -37,12 +48,17 @@ enum ENC_DATA_TYPE{
 
 typedef struct EncData
 {
-	EncData(void) :_data(NULL), _dataLen(0),
-		_bVideo(false), _dts(0) {}
-	uint8_t*_data;
+	EncData(void) :_buf(NULL), _dataLen(0),
+		_bVideo(false), _dts(0), _pts(0) {}
+	~EncData(void) {
+		if (_buf)
+			_buf->Release();
+	}
+	EncBuffer*_buf;		// Owned, set NULL when handed to srs_librtmp
 	int _dataLen;
 	bool _bVideo;
 	uint32_t _dts;
+	uint32_t _pts;		// Differs from _dts for the reordered video only
 	ENC_DATA_TYPE _type;
 }EncData;
 
@@ -55,10 +71,10 @@ public:
 	virtual void OnRtmpConnected() = 0;
 	virtual void OnRtmpReconnecting(int times) = 0;
 	virtual void OnRtmpDisconnect() = 0;
-	virtual void OnRtmpStatusEvent(int delayMs, int netBand) = 0;
+	virtual void OnRtmpStatusEvent(int delayMs, int netBand, int dropFrames, int dropBytes) = 0;
 };
 
-class AnyRtmpPush :public rtc::Thread
+class AnyRtmpPush :public RtmpReactorHandler
 {
 public:
 	AnyRtmpPush(AnyRtmpushCallback&callback, const std::string&url);
@@ -69,34 +85,74 @@ public:
 	void EnableOnlyAudioMode();
 	void SetAudioParameter(int samplerate/*44100*/, int pcmbitsize/*16*/, int channel/*1*/);
 	void SetVideoParameter(int width, int height, int videodatarate, int framerate);
+	//* Thresholds are in ms of queued media, 0 to disable.
+	void SetSendQueuePolicy(int policy/*SEND_DROP_POLICY*/, int nonrefMs, int gopMs, int maxMs);
 
-	void SetH264Data(uint8_t* pdata, int len, uint32_t ts);
+	//* Timestamps are the capture time in ms.
+	void SetH264Data(uint8_t* pdata, int len, uint32_t dts, uint32_t pts);
 	void SetAacData(uint8_t* pdata, int len, uint32_t ts);
-	void GotH264Nal(uint8_t* pdata, int len, uint32_t ts);
+	void SetAacData(EncBuffer* buf, uint32_t ts);
+	void GotH264Nal(uint8_t* pdata, int len, uint32_t dts, uint32_t pts);
 
 protected:
-	//* For Thread
-	virtual void Run();
-
+	//* For rtc::MessageHandler, on the reactor.
+	virtual void OnMessage(rtc::Message* msg);
+	//* For RtmpReactorHandler
+	virtual void OnRtmpReadable();
+	virtual void OnRtmpWritable();
+	virtual void OnRtmpConnect(int ret);
+
+	void DoConnected();
+	void DoStatistics();
 	void CallConnect();
 	void CallDisconnect();
-	void CallStatusEvent(int delayMs, int netBand);
+	void CallStatusEvent(int delayMs, int netBand, int dropFrames, int dropBytes);
 	void DoSendData();
     void setMetaData();
     void setMetaData(uint8_t* pData, int nLen, uint32_t ts);
+	void GotH264Nalus(const uint8_t* pData, const int* nalus, const int* nb_nalus, int count, uint32_t dts, uint32_t pts);
+	void PushEncData(ENC_DATA_TYPE type, EncBuffer* buf, uint32_t dts, uint32_t pts);
+	//* On the reactor thread only
+	void PullEncData();
+	void ClearEncData();
+	int QueuedTime();
+	std::list<EncData*>::iterator FirstVideo();
+	int VideoQueuedTime();
+	void CheckSendQueue();
+	void DropVideoToKeyFrame();
+	void DropEncData(EncData* pdata);
 
 private:
 	AnyRtmpushCallback&	callback_;
+	RtmpReactor*		reactor_;
 	bool				running_;
-	bool				need_keyframe_;
+	volatile int		need_keyframe_;		// Set on the reactor, cleared by the video encoder thread
 	bool				only_audio_mode_;
 	int					retrys_;
 	std::string			str_url_;
-	uint32_t			stat_time_;
 	uint32_t			net_band_;
 
-	rtc::CriticalSection	cs_list_enc_;
-	std::list<EncData*>		lst_enc_data_;
+	rtc::SpscQueue<EncData*>	que_video_enc_;	// Video and metadata from the video encoder thread
+	rtc::SpscQueue<EncData*>	que_audio_enc_;	// Audio from the audio encoder thread
+	std::list<EncData*>		lst_enc_data_;	// Owned by the reactor thread, merged by dts
+	volatile int			send_posted_;	// 1 when MSG_SEND is posted for the new data
+	int						drop_policy_;
+	int						drop_nonref_ms_;
+	int						drop_gop_ms_;
+	int						drop_max_ms_;
+	int						set_policy_;		// Set by SetSendQueuePolicy under cs_policy_, copied to drop_* on the reactor
+	int						set_nonref_ms_;
+	int						set_gop_ms_;
+	int						set_max_ms_;
+	volatile int			drop_to_keyframe_;	// All queued video dropped, the encoder waits for the next keyframe
+	bool					wait_keyframe_;		// The same on the reactor, for the video pushed before
+	std::list<EncData*>::iterator	last_sps_;	// Newest SPS queued, lst_enc_data_.end() when none
+	uint32_t				video_back_dts_;	// Dts of the newest video queued
+	uint32_t				audio_back_dts_;	// Dts of the newest audio queued
+	uint32_t				drop_frames_;
+	uint32_t				drop_bytes_;
+	volatile int			full_drop_frames_;	// Dropped by the producers on a full queue
+	volatile int			full_drop_bytes_;
 
 private:
 	//* For RTMP
@@ -121,6 +177,7 @@ private:
 	char sound_type_;
 
     rtc::CriticalSection	cs_rtmp_;
+	rtc::CriticalSection	cs_policy_;
 	RTMP_STATUS		rtmp_status_;
 	void*			rtmp_;
 
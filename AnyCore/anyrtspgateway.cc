@@ -0,0 +1,696 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "anyrtspgateway.h"
+#include <string.h>
+#include "liveMedia.hh"
+#include "BasicUsageEnvironment.hh"
+#include "GroupsockHelper.hh"
+#include "webrtc/base/bind.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+#define RTSP_APP_NAME		"AnyRTC"
+#define RTSP_RETRY_DELAY	3000	// ms before reconnecting the rtsp
+#define RTSP_CHECK_TIME		1000
+#define RTSP_DATA_TIMEOUT	10000	// ms without any frame(or setup) to reconnect
+#define RTSP_SYNC_WAIT		2000	// Max ms to wait for the rtcp sync of all tracks before the start
+#define RTSP_KEEPALIVE_TIME	25000	// ms, when the server has no session timeout
+#define RTSP_VIDEO_BUFFER	(1024 * 1024)	// Max size of an access unit
+#define RTSP_AUDIO_BUFFER	8192
+#define RTSP_RECV_BUFFER	(2 * 1024 * 1024)	// Socket buffer of the rtp over udp
+#define ADTS_HEADER_SIZE	7
+
+enum {
+	MSG_CONNECT = 0,
+	MSG_RETRY,
+	MSG_CHECK,
+	MSG_KEEPALIVE
+};
+
+static const int kAacSampleRates[] = {
+	96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+static int64_t TimevalToUs(const struct timeval& tv)
+{
+	return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+//* RTSPClient of a gateway, the response handlers are static.
+class GatewayRtspClient : public RTSPClient
+{
+public:
+	static GatewayRtspClient* createNew(UsageEnvironment& env, const char* url, AnyRtspGateway* gateway) {
+		return new GatewayRtspClient(env, url, gateway);
+	}
+
+	static void OnDescribe(RTSPClient* client, int code, char* result) {
+		((GatewayRtspClient*)client)->gateway_->OnDescribe(code, result);
+	}
+	static void OnSetup(RTSPClient* client, int code, char* result) {
+		((GatewayRtspClient*)client)->gateway_->OnSetup(code, result);
+	}
+	static void OnPlay(RTSPClient* client, int code, char* result) {
+		((GatewayRtspClient*)client)->gateway_->OnPlay(code, result);
+	}
+	static void OnKeepAlive(RTSPClient* client, int code, char* result) {
+		((GatewayRtspClient*)client)->gateway_->OnKeepAlive(code, result);
+	}
+
+protected:
+	GatewayRtspClient(UsageEnvironment& env, const char* url, AnyRtspGateway* gateway)
+		: RTSPClient(env, url, 0, RTSP_APP_NAME, 0, -1)
+		, gateway_(gateway) {}
+
+private:
+	AnyRtspGateway*	gateway_;
+};
+
+//* Sink of one track. The video nalus are received one by one right after each
+//* other with start codes, into one access unit ended by the rtp marker or the
+//* next presentation time, the audio frames after the room of an ADTS header,
+//* so there's no copy before AnyRtmpPush.
+class GatewaySink : public MediaSink
+{
+public:
+	GatewaySink(UsageEnvironment& env, AnyRtspGateway* gateway, MediaSubsession& sub, bool video);
+	virtual ~GatewaySink(void);
+
+	//* Parses the sprop-parameter-sets or the AAC config, false if unusable.
+	bool Init();
+	bool IsVideo() const { return video_; };
+	bool Synced() const {
+		return sub_.rtpSource() != NULL && sub_.rtpSource()->hasBeenSynchronizedUsingRTCP();
+	}
+	int SampleRate() const { return sample_rate_; };
+	int Channels() const { return channels_; };
+	//* SPS and PPS with start codes, to send before a keyframe without them.
+	const std::string& ParamSets() const { return param_sets_; };
+	bool AuHasSps() const { return au_has_sps_; };
+
+	static void OnBye(void* clientData);
+	static void OnClosure(void* clientData);
+
+	//* Timeline of the track, by the gateway
+	bool		synced;
+	int64_t		adjust_us;		// Added to the presentation times of live555
+	int64_t		last_us;
+	int64_t		last_delta_us;
+	uint32_t	last_ts;
+	bool		has_last;
+
+protected:
+	//* For MediaSink
+	virtual Boolean continuePlaying();
+
+	static void AfterGettingFrame(void* clientData, unsigned frameSize, unsigned numTruncatedBytes,
+		struct timeval presentationTime, unsigned durationInMicroseconds);
+	void AfterGettingVideo(unsigned frameSize, unsigned numTruncatedBytes, int64_t us);
+	void AfterGettingAudio(unsigned frameSize, unsigned numTruncatedBytes, int64_t us);
+	void FlushAccessUnit();
+	void SetParamSet(std::string& param, const uint8_t* pdata, int len);
+
+private:
+	AnyRtspGateway*		gateway_;
+	MediaSubsession&	sub_;
+	bool				video_;
+	uint8_t*			buffer_;
+	int					buffer_size_;
+
+	//* Video
+	int					au_len_;		// With the start codes
+	int64_t				au_us_;
+	bool				au_key_;
+	bool				au_has_sps_;
+	bool				au_broken_;		// Truncated or too large, dropped
+	std::string			sps_;
+	std::string			pps_;
+	std::string			param_sets_;
+
+	//* Audio
+	uint8_t				adts_[ADTS_HEADER_SIZE];	// Without the frame length
+	int					sample_rate_;
+	int					channels_;
+};
+
+GatewaySink::GatewaySink(UsageEnvironment& env, AnyRtspGateway* gateway, MediaSubsession& sub, bool video)
+	: MediaSink(env)
+	, synced(false)
+	, adjust_us(0)
+	, last_us(0)
+	, last_delta_us(0)
+	, last_ts(0)
+	, has_last(false)
+	, gateway_(gateway)
+	, sub_(sub)
+	, video_(video)
+	, au_len_(0)
+	, au_us_(0)
+	, au_key_(false)
+	, au_has_sps_(false)
+	, au_broken_(false)
+	, sample_rate_(0)
+	, channels_(0)
+{
+	buffer_size_ = video ? RTSP_VIDEO_BUFFER : RTSP_AUDIO_BUFFER;
+	buffer_ = new uint8_t[buffer_size_];
+	memset(adts_, 0, sizeof(adts_));
+}
+
+GatewaySink::~GatewaySink(void)
+{
+	delete[] buffer_;
+}
+
+bool GatewaySink::Init()
+{
+	if (video_) {
+		//* The cameras mostly send the SPS and PPS only in the sdp.
+		unsigned num = 0;
+		SPropRecord* records = parseSPropParameterSets(sub_.fmtp_spropparametersets(), num);
+		for (unsigned i = 0; i < num; i++) {
+			if (records[i].sPropLength == 0)
+				continue;
+			int type = records[i].sPropBytes[0] & 0x1f;
+			if (type == 7)
+				SetParamSet(sps_, records[i].sPropBytes, records[i].sPropLength);
+			else if (type == 8)
+				SetParamSet(pps_, records[i].sPropBytes, records[i].sPropLength);
+		}
+		delete[] records;
+		return true;
+	}
+
+	//* AudioSpecificConfig to the ADTS header
+	unsigned size = 0;
+	unsigned char* config = parseGeneralConfigStr(sub_.fmtp_config(), size);
+	if (config == NULL || size < 2) {
+		delete[] config;
+		return false;
+	}
+	int object_type = config[0] >> 3;
+	int freq_index = ((config[0] & 0x07) << 1) | (config[1] >> 7);
+	int channel_config = (config[1] >> 3) & 0x0f;
+	if ((object_type == 5 || object_type == 29) && size >= 4) {
+		//* HE-AAC, the ADTS header has the AAC-LC core, the decoders find the SBR.
+		object_type = (config[2] >> 2) & 0x1f;
+	}
+	delete[] config;
+	if (freq_index == 0x0f) {
+		//* Explicit rate, the same as the rtp clock for AAC.
+		for (freq_index = 0; freq_index < 13; freq_index++) {
+			if (kAacSampleRates[freq_index] == (int)sub_.rtpTimestampFrequency())
+				break;
+		}
+	}
+	if (object_type < 1 || object_type > 4 || freq_index >= 13 || channel_config == 0)
+		return false;
+	sample_rate_ = kAacSampleRates[freq_index];
+	channels_ = channel_config;
+
+	adts_[0] = 0xff;
+	adts_[1] = 0xf1;	// MPEG-4, no crc
+	adts_[2] = ((object_type - 1) << 6) | (freq_index << 2) | (channel_config >> 2);
+	adts_[3] = (channel_config & 0x03) << 6;
+	adts_[6] = 0xfc;	// One raw data block
+	return true;
+}
+
+void GatewaySink::SetParamSet(std::string& param, const uint8_t* pdata, int len)
+{
+	if (param.size() == (size_t)len && memcmp(param.data(), pdata, len) == 0)
+		return;
+	param.assign((const char*)pdata, len);
+	param_sets_.clear();
+	if (!sps_.empty() && !pps_.empty()) {
+		param_sets_.append("\x00\x00\x00\x01", 4);
+		param_sets_.append(sps_);
+		param_sets_.append("\x00\x00\x00\x01", 4);
+		param_sets_.append(pps_);
+	}
+}
+
+Boolean GatewaySink::continuePlaying()
+{
+	if (fSource == NULL)
+		return False;
+	if (!video_) {
+		fSource->getNextFrame(buffer_ + ADTS_HEADER_SIZE, buffer_size_ - ADTS_HEADER_SIZE,
+			&GatewaySink::AfterGettingFrame, this, &GatewaySink::OnClosure, this);
+		return True;
+	}
+	if (buffer_size_ - au_len_ - 4 < RTSP_VIDEO_BUFFER / 4) {
+		//* The rest may be too small for the next nalu, drop the access unit.
+		au_broken_ = true;
+		au_len_ = 0;
+	}
+	fSource->getNextFrame(buffer_ + au_len_ + 4, buffer_size_ - au_len_ - 4,
+		&GatewaySink::AfterGettingFrame, this, &GatewaySink::OnClosure, this);
+	return True;
+}
+
+void GatewaySink::AfterGettingFrame(void* clientData, unsigned frameSize, unsigned numTruncatedBytes,
+	struct timeval presentationTime, unsigned durationInMicroseconds)
+{
+	GatewaySink* sink = (GatewaySink*)clientData;
+	if (sink->video_)
+		sink->AfterGettingVideo(frameSize, numTruncatedBytes, TimevalToUs(presentationTime));
+	else
+		sink->AfterGettingAudio(frameSize, numTruncatedBytes, TimevalToUs(presentationTime));
+	sink->continuePlaying();
+}
+
+void GatewaySink::AfterGettingVideo(unsigned frameSize, unsigned numTruncatedBytes, int64_t us)
+{
+	uint8_t* nal = buffer_ + au_len_ + 4;
+	int start = au_len_;
+	if (au_len_ > 0 && us != au_us_) {
+		//* The last access unit had no marker, this nalu begins the next one.
+		FlushAccessUnit();
+		memmove(buffer_ + 4, nal, frameSize);
+		nal = buffer_ + 4;
+		start = 0;
+	}
+	if (numTruncatedBytes > 0)
+		au_broken_ = true;
+	if (frameSize == 0)
+		return;
+
+	int type = nal[0] & 0x1f;
+	if (type != 9) {	// The AUD is of no use in flv
+		memcpy(buffer_ + start, "\x00\x00\x00\x01", 4);
+		au_len_ = start + 4 + frameSize;
+		au_us_ = us;
+		if (type == 5) {
+			au_key_ = true;
+		}
+		else if (type == 7) {
+			au_has_sps_ = true;
+			SetParamSet(sps_, nal, frameSize);
+		}
+		else if (type == 8) {
+			SetParamSet(pps_, nal, frameSize);
+		}
+	}
+	//* The marker is of the packet, the nalus of a STAP-A have it all, so only
+	//* a slice ends the access unit.
+	RTPSource* source = sub_.rtpSource();
+	if (au_len_ > 0 && type >= 1 && type <= 5 && source != NULL && source->curPacketMarkerBit()) {
+		FlushAccessUnit();
+	}
+}
+
+void GatewaySink::FlushAccessUnit()
+{
+	if (au_len_ > 0 && !au_broken_) {
+		gateway_->OnVideoFrame(this, buffer_, au_len_, au_us_, au_key_);
+	}
+	au_len_ = 0;
+	au_key_ = false;
+	au_has_sps_ = false;
+	au_broken_ = false;
+}
+
+void GatewaySink::AfterGettingAudio(unsigned frameSize, unsigned numTruncatedBytes, int64_t us)
+{
+	if (numTruncatedBytes > 0 || frameSize == 0)
+		return;
+	int len = frameSize + ADTS_HEADER_SIZE;
+	memcpy(buffer_, adts_, ADTS_HEADER_SIZE);
+	buffer_[3] |= (len >> 11) & 0x03;
+	buffer_[4] = (len >> 3) & 0xff;
+	buffer_[5] = ((len & 0x07) << 5) | 0x1f;
+	gateway_->OnAudioFrame(this, buffer_, len, us);
+}
+
+void GatewaySink::OnBye(void* clientData)
+{
+	GatewaySink* sink = (GatewaySink*)clientData;
+	sink->gateway_->Retry("rtcp bye");
+}
+
+void GatewaySink::OnClosure(void* clientData)
+{
+	GatewaySink* sink = (GatewaySink*)clientData;
+	sink->gateway_->Retry("stream closed");
+}
+
+AnyRtspGateway::AnyRtspGateway(AnyRtspGatewayCallback&callback, const std::string&rtspUrl,
+	const std::string&rtmpUrl, bool rtpOverTcp)
+: callback_(callback)
+, reactor_(NULL)
+, push_(NULL)
+, rtsp_url_(rtspUrl)
+, rtp_over_tcp_(rtpOverTcp)
+, retrys_(0)
+, retry_posted_(false)
+, client_(NULL)
+, session_(NULL)
+, setup_iter_(NULL)
+, setup_sub_(NULL)
+, has_video_(false)
+, has_audio_(false)
+, playing_(false)
+, use_get_parameter_(true)
+, play_time_(0)
+, data_time_(0)
+, started_(false)
+, base_us_(0)
+, ts_offset_(0)
+, last_ts_(0)
+, last_ts_time_(0)
+, has_ts_(false)
+{
+	push_ = new AnyRtmpPush(callback, rtmpUrl);
+	reactor_ = RtspReactor::Get();
+	reactor_->Post(RTC_FROM_HERE, this, MSG_CONNECT);
+	reactor_->PostDelayed(RTC_FROM_HERE, RTSP_CHECK_TIME, this, MSG_CHECK);
+}
+
+AnyRtspGateway::~AnyRtspGateway(void)
+{
+	//* Clear on the reactor, none of our messages can run after it.
+	reactor_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&AnyRtspGateway::DoStop, this));
+	//* No producer is left.
+	delete push_;
+	push_ = NULL;
+}
+
+void AnyRtspGateway::OnMessage(rtc::Message* msg)
+{
+	switch (msg->message_id) {
+	case MSG_CONNECT: {
+		DoConnect();
+	}
+		break;
+	case MSG_RETRY: {
+		retry_posted_ = false;
+		DoClose();
+		callback_.OnRtspReconnecting(++retrys_);
+		//* No timeout before the connect.
+		data_time_ = rtc::TimeMillis() + RTSP_RETRY_DELAY;
+		reactor_->PostDelayed(RTC_FROM_HERE, RTSP_RETRY_DELAY, this, MSG_CONNECT);
+	}
+		break;
+	case MSG_CHECK: {
+		DoCheck();
+	}
+		break;
+	case MSG_KEEPALIVE: {
+		DoKeepAlive();
+	}
+		break;
+	}
+}
+
+void AnyRtspGateway::DoConnect()
+{
+	data_time_ = rtc::TimeMillis();
+	use_get_parameter_ = true;
+	client_ = GatewayRtspClient::createNew(reactor_->Env(), rtsp_url_.c_str(), this);
+	if (client_ == NULL) {
+		Retry("create client");
+		return;
+	}
+	//* The user and password in the url are used by RTSPClient.
+	client_->sendDescribeCommand(&GatewayRtspClient::OnDescribe);
+}
+
+void AnyRtspGateway::DoClose()
+{
+	reactor_->Clear(this, MSG_CONNECT);
+	reactor_->Clear(this, MSG_KEEPALIVE);
+	for (size_t i = 0; i < sinks_.size(); i++) {
+		sinks_[i]->stopPlaying();
+		Medium::close(sinks_[i]);
+	}
+	sinks_.clear();
+	if (session_ != NULL) {
+		MediaSubsessionIterator iter(*session_);
+		MediaSubsession* sub;
+		while ((sub = iter.next()) != NULL) {
+			if (sub->rtcpInstance() != NULL)
+				sub->rtcpInstance()->setByeHandler(NULL, NULL);
+			sub->sink = NULL;
+		}
+		if (client_ != NULL && playing_) {
+			client_->sendTeardownCommand(*session_, NULL);
+		}
+		Medium::close(session_);
+		session_ = NULL;
+	}
+	delete setup_iter_;
+	setup_iter_ = NULL;
+	setup_sub_ = NULL;
+	if (client_ != NULL) {
+		Medium::close(client_);
+		client_ = NULL;
+	}
+	has_video_ = false;
+	has_audio_ = false;
+	playing_ = false;
+	started_ = false;
+}
+
+void AnyRtspGateway::DoStop()
+{
+	DoClose();
+	reactor_->Clear(this);
+}
+
+void AnyRtspGateway::DoCheck()
+{
+	if (rtc::TimeMillis() - data_time_ > RTSP_DATA_TIMEOUT && !retry_posted_) {
+		Retry(playing_ ? "data timeout" : "setup timeout");
+	}
+	reactor_->PostDelayed(RTC_FROM_HERE, RTSP_CHECK_TIME, this, MSG_CHECK);
+}
+
+void AnyRtspGateway::DoKeepAlive()
+{
+	if (client_ == NULL || session_ == NULL)
+		return;
+	if (use_get_parameter_)
+		client_->sendGetParameterCommand(*session_, &GatewayRtspClient::OnKeepAlive, NULL);
+	else
+		client_->sendOptionsCommand(&GatewayRtspClient::OnKeepAlive);
+	unsigned timeout = client_->sessionTimeoutParameter();
+	reactor_->PostDelayed(RTC_FROM_HERE, timeout > 0 ? timeout * 1000 / 2 : RTSP_KEEPALIVE_TIME, this, MSG_KEEPALIVE);
+}
+
+void AnyRtspGateway::Retry(const char* reason)
+{
+	//* Called in the live555 callbacks, the client and session are closed later.
+	if (retry_posted_)
+		return;
+	LOG(LS_WARNING) << "AnyRtspGateway " << rtsp_url_ << " " << reason << ", reconnect";
+	retry_posted_ = true;
+	reactor_->Post(RTC_FROM_HERE, this, MSG_RETRY);
+}
+
+void AnyRtspGateway::OnDescribe(int code, char* result)
+{
+	if (code != 0) {
+		delete[] result;
+		Retry("describe failed");
+		return;
+	}
+	session_ = MediaSession::createNew(reactor_->Env(), result);
+	delete[] result;
+	if (session_ == NULL || !session_->hasSubsessions()) {
+		Retry("bad sdp");
+		return;
+	}
+	setup_iter_ = new MediaSubsessionIterator(*session_);
+	SetupNext();
+}
+
+void AnyRtspGateway::SetupNext()
+{
+	MediaSubsession* sub;
+	while ((sub = setup_iter_->next()) != NULL) {
+		bool video = strcmp(sub->mediumName(), "video") == 0 && strcmp(sub->codecName(), "H264") == 0;
+		const char* mode = sub->attrVal_str("mode");
+		bool audio = strcmp(sub->mediumName(), "audio") == 0 && strcmp(sub->codecName(), "MPEG4-GENERIC") == 0
+			&& strncasecmp(mode, "AAC", 3) == 0;
+		//* The first track of each, flv has no others.
+		if ((!video && !audio) || (video && has_video_) || (audio && has_audio_)) {
+			LOG(LS_INFO) << "AnyRtspGateway skip " << sub->mediumName() << "/" << sub->codecName();
+			continue;
+		}
+		if (!sub->initiate()) {
+			LOG(LS_WARNING) << "AnyRtspGateway initiate " << sub->codecName() << " failed: " << reactor_->Env().getResultMsg();
+			continue;
+		}
+		if (!rtp_over_tcp_ && sub->rtpSource() != NULL) {
+			//* A keyframe of the cameras comes in a burst of packets.
+			increaseReceiveBufferTo(reactor_->Env(), sub->rtpSource()->RTPgs()->socketNum(), RTSP_RECV_BUFFER);
+		}
+		setup_sub_ = sub;
+		client_->sendSetupCommand(*sub, &GatewayRtspClient::OnSetup, False, rtp_over_tcp_);
+		return;
+	}
+
+	setup_sub_ = NULL;
+	if (sinks_.empty()) {
+		Retry("no H264 or AAC track");
+		return;
+	}
+	client_->sendPlayCommand(*session_, &GatewayRtspClient::OnPlay);
+}
+
+void AnyRtspGateway::OnSetup(int code, char* result)
+{
+	delete[] result;
+	MediaSubsession* sub = setup_sub_;
+	if (code != 0) {
+		LOG(LS_WARNING) << "AnyRtspGateway setup " << sub->codecName() << " failed: " << code;
+		SetupNext();
+		return;
+	}
+
+	bool video = strcmp(sub->mediumName(), "video") == 0;
+	GatewaySink* sink = new GatewaySink(reactor_->Env(), this, *sub, video);
+	if (!sink->Init()) {
+		LOG(LS_WARNING) << "AnyRtspGateway bad config of " << sub->codecName();
+		Medium::close(sink);
+		SetupNext();
+		return;
+	}
+	if (video) {
+		has_video_ = true;
+	}
+	else {
+		has_audio_ = true;
+		push_->SetAudioParameter(sink->SampleRate(), 16, sink->Channels() > 1 ? 2 : 1);
+	}
+	sub->sink = sink;
+	sinks_.push_back(sink);
+	if (sub->rtcpInstance() != NULL)
+		sub->rtcpInstance()->setByeHandler(&GatewaySink::OnBye, sink);
+	sink->startPlaying(*sub->readSource(), NULL, NULL);
+	SetupNext();
+}
+
+void AnyRtspGateway::OnPlay(int code, char* result)
+{
+	delete[] result;
+	if (code != 0) {
+		Retry("play failed");
+		return;
+	}
+	playing_ = true;
+	retrys_ = 0;
+	play_time_ = rtc::TimeMillis();
+	data_time_ = play_time_;
+	if (!has_video_)
+		push_->EnableOnlyAudioMode();
+	callback_.OnRtspConnected();
+
+	unsigned timeout = client_->sessionTimeoutParameter();
+	reactor_->PostDelayed(RTC_FROM_HERE, timeout > 0 ? timeout * 1000 / 2 : RTSP_KEEPALIVE_TIME, this, MSG_KEEPALIVE);
+}
+
+void AnyRtspGateway::OnKeepAlive(int code, char* result)
+{
+	delete[] result;
+	if (code != 0 && use_get_parameter_) {
+		//* Not supported by the server, OPTIONS next time.
+		use_get_parameter_ = false;
+	}
+}
+
+bool AnyRtspGateway::AllSynced()
+{
+	for (size_t i = 0; i < sinks_.size(); i++) {
+		if (!sinks_[i]->Synced())
+			return false;
+	}
+	return true;
+}
+
+bool AnyRtspGateway::MapTimestamp(GatewaySink* sink, int64_t us, bool keyframe, uint32_t* ts)
+{
+	if (!sink->synced && sink->Synced()) {
+		//* The sender report came after the start, the times jump to the
+		//* rtcp timeline, keep the track continuous instead.
+		if (sink->has_last)
+			sink->adjust_us = sink->last_us + sink->last_delta_us - us;
+		sink->synced = true;
+	}
+	us += sink->adjust_us;
+
+	int64_t now = rtc::TimeMillis();
+	if (!started_) {
+		//* Wait for the sender reports to align the tracks, but not forever,
+		//* some cameras send none.
+		if (!AllSynced() && now - play_time_ < RTSP_SYNC_WAIT)
+			return false;
+		if (has_video_ && !keyframe)
+			return false;
+		started_ = true;
+		base_us_ = us;
+		//* Go on from the last session, with the gap of the reconnection.
+		ts_offset_ = has_ts_ ? last_ts_ + (uint32_t)(now - last_ts_time_) : 0;
+	}
+	if (us < base_us_)
+		return false;	// Audio before the first keyframe
+
+	uint32_t t = ts_offset_ + (uint32_t)((us - base_us_) / 1000);
+	if (sink->has_last) {
+		if (us > sink->last_us)
+			sink->last_delta_us = us - sink->last_us;
+		//* No dts in rtp, and the cameras have no B frames, the dts of the
+		//* track must not go back anyway.
+		if (t < sink->last_ts)
+			t = sink->last_ts;
+	}
+	sink->last_us = us;
+	sink->last_ts = t;
+	sink->has_last = true;
+	if (!has_ts_ || t > last_ts_) {
+		last_ts_ = t;
+		last_ts_time_ = now;
+		has_ts_ = true;
+	}
+	*ts = t;
+	return true;
+}
+
+void AnyRtspGateway::OnVideoFrame(GatewaySink* sink, uint8_t* pdata, int len, int64_t us, bool keyframe)
+{
+	data_time_ = rtc::TimeMillis();
+	uint32_t ts = 0;
+	if (!MapTimestamp(sink, us, keyframe, &ts))
+		return;
+	if (keyframe && !sink->AuHasSps() && !sink->ParamSets().empty()) {
+		//* AnyRtmpPush starts at the SPS, and the flv sequence header is made of them.
+		push_->SetH264Data((uint8_t*)sink->ParamSets().data(), sink->ParamSets().size(), ts, ts);
+	}
+	push_->SetH264Data(pdata, len, ts, ts);
+}
+
+void AnyRtspGateway::OnAudioFrame(GatewaySink* sink, uint8_t* pdata, int len, int64_t us)
+{
+	data_time_ = rtc::TimeMillis();
+	uint32_t ts = 0;
+	if (!MapTimestamp(sink, us, false, &ts))
+		return;
+	push_->SetAacData(pdata, len, ts);
+}
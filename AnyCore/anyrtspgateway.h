@@ -0,0 +1,113 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __ANY_RTSP_GATEWAY_H__
+#define __ANY_RTSP_GATEWAY_H__
+#include <string>
+#include <vector>
+#include "anyrtmpush.h"
+#include "rtspreactor.h"
+
+class RTSPClient;
+class MediaSession;
+class MediaSubsession;
+class MediaSubsessionIterator;
+class GatewaySink;
+
+class AnyRtspGatewayCallback : public AnyRtmpushCallback
+{
+public:
+	AnyRtspGatewayCallback(void){};
+	virtual ~AnyRtspGatewayCallback(void){};
+
+	//* On the rtsp reactor thread, the others are of AnyRtmpushCallback.
+	virtual void OnRtspConnected() = 0;
+	virtual void OnRtspReconnecting(int times) = 0;
+};
+
+//* Restreams an rtsp camera or encoder to rtmp without decoding: lib_rtsp
+//* depacketizes H.264 and AAC(MPEG4-GENERIC), the access units are handed to
+//* AnyRtmpPush as they are. The timestamps are the presentation times of
+//* live555, which are in one timeline after the rtcp sender reports.
+//* The rtsp side reconnects on error, bye and data timeout, the timestamps go on
+//* from the last ones, so the rtmp side doesn't see it but the gap.
+//* All the gateways share the rtsp reactors, hundreds of them on one thread.
+class AnyRtspGateway : public rtc::MessageHandler
+{
+public:
+	AnyRtspGateway(AnyRtspGatewayCallback&callback, const std::string&rtspUrl,
+		const std::string&rtmpUrl, bool rtpOverTcp);
+	virtual ~AnyRtspGateway(void);
+
+protected:
+	//* For rtc::MessageHandler, on the rtsp reactor.
+	virtual void OnMessage(rtc::Message* msg);
+
+	void DoConnect();
+	void DoClose();
+	void DoStop();
+	void DoCheck();
+	void DoKeepAlive();
+	void Retry(const char* reason);
+
+	//* The live555 callbacks, on the rtsp reactor.
+	friend class GatewayRtspClient;
+	friend class GatewaySink;
+	void OnDescribe(int code, char* result);
+	void OnSetup(int code, char* result);
+	void OnPlay(int code, char* result);
+	void OnKeepAlive(int code, char* result);
+	void SetupNext();
+	//* us is the presentation time of live555.
+	void OnVideoFrame(GatewaySink* sink, uint8_t* pdata, int len, int64_t us, bool keyframe);
+	void OnAudioFrame(GatewaySink* sink, uint8_t* pdata, int len, int64_t us);
+	bool MapTimestamp(GatewaySink* sink, int64_t us, bool keyframe, uint32_t* ts);
+	bool AllSynced();
+
+private:
+	AnyRtspGatewayCallback&	callback_;
+	RtspReactor*		reactor_;
+	AnyRtmpPush*		push_;
+	std::string			rtsp_url_;
+	bool				rtp_over_tcp_;
+	int					retrys_;
+	bool				retry_posted_;
+
+	//* On the rtsp reactor only
+	RTSPClient*			client_;
+	MediaSession*		session_;
+	MediaSubsessionIterator*	setup_iter_;
+	MediaSubsession*	setup_sub_;
+	std::vector<GatewaySink*>	sinks_;
+	bool				has_video_;
+	bool				has_audio_;
+	bool				playing_;
+	bool				use_get_parameter_;	// Keepalive by GET_PARAMETER, OPTIONS if not supported
+	int64_t				play_time_;			// ms
+	int64_t				data_time_;			// ms, of the last frame of any track
+
+	//* Timeline of the rtmp, kept over the rtsp sessions
+	bool				started_;	// Of this rtsp session
+	int64_t				base_us_;	// Presentation time of ts_offset_
+	uint32_t			ts_offset_;
+	uint32_t			last_ts_;
+	int64_t				last_ts_time_;	// ms, when last_ts_ was sent
+	bool				has_ts_;
+};
+
+#endif	// __ANY_RTSP_GATEWAY_H__
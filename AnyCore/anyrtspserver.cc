@@ -0,0 +1,568 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "anyrtspserver.h"
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include "liveMedia.hh"
+#include "BasicUsageEnvironment.hh"
+#include "GroupsockHelper.hh"
+#include "webrtc/base/atomicops.h"
+#include "webrtc/base/bind.h"
+#include "webrtc/base/logging.h"
+
+#define RTSP_VIDEO_QUEUE		256			// Max frames waiting for the reactor
+#define RTSP_AUDIO_QUEUE		256
+#define RTSP_MAX_DELIVERS		256			// Max frames delivered per loop, keep the reactor responsive
+#define RTSP_SOURCE_QUEUE		512			// Max NALUs or audio frames waiting for a sink
+#define RTSP_MAX_NALU			(512 * 1024)	// Buffer of the rtp sinks for a frame, 60KB by default
+#define RTSP_VIDEO_PAYLOAD		96
+#define RTSP_AUDIO_PAYLOAD		97
+#define RTSP_MULTICAST_PORT		18888		// Video rtp/rtcp of the multicast, the audio +2
+#define RTSP_MULTICAST_TTL		16
+#define RTSP_AUDIO_KBPS			64			// For the rtcp bandwidth
+
+enum {
+	MSG_DELIVER		// New data in the queues
+};
+
+static const int kAacSampleRates[] = {
+	96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+//* Offset of the next start code and its length, -1 if none.
+static int FindStartCode(const uint8_t* p, int len, int* sc_len)
+{
+	for (int i = 0; i + 3 <= len; i++) {
+		if (p[i] == 0 && p[i + 1] == 0) {
+			if (p[i + 2] == 1) {
+				*sc_len = 3;
+				return i;
+			}
+			if (i + 4 <= len && p[i + 2] == 0 && p[i + 3] == 1) {
+				*sc_len = 4;
+				return i;
+			}
+		}
+	}
+	return -1;
+}
+
+//* A NALU without start code or an AAC frame without ADTS header, in the shared
+//* encoded buffer.
+struct LiveFrame
+{
+	EncBuffer*		buf;
+	int				offset;
+	int				len;
+	struct timeval	pts;
+};
+
+//* One track of the encoded media for a sink, the frames are pushed by the
+//* server on the reactor and handed to the sink at once if it's waiting.
+class LiveFrameSource : public FramedSource
+{
+public:
+	static LiveFrameSource* createNew(UsageEnvironment& env, AnyRtspServer* server, bool video) {
+		return new LiveFrameSource(env, server, video);
+	}
+
+	//* Takes a reference of the buffer.
+	void Deliver(const LiveFrame& frame);
+
+protected:
+	LiveFrameSource(UsageEnvironment& env, AnyRtspServer* server, bool video);
+	virtual ~LiveFrameSource(void);
+
+	//* For FramedSource
+	virtual void doGetNextFrame();
+
+	void DeliverNext();
+	void Clear();
+
+private:
+	AnyRtspServer*			server_;
+	bool					video_;
+	bool					need_keyframe_;		// A new viewer starts at the SPS or IDR
+	std::deque<LiveFrame>	frames_;
+};
+
+LiveFrameSource::LiveFrameSource(UsageEnvironment& env, AnyRtspServer* server, bool video)
+	: FramedSource(env)
+	, server_(server)
+	, video_(video)
+	, need_keyframe_(video)
+{
+	if (video)
+		server_->video_sources_.push_back(this);
+	else
+		server_->audio_sources_.push_back(this);
+}
+
+LiveFrameSource::~LiveFrameSource(void)
+{
+	std::vector<LiveFrameSource*>& sources = video_ ? server_->video_sources_ : server_->audio_sources_;
+	std::vector<LiveFrameSource*>::iterator iter = std::find(sources.begin(), sources.end(), this);
+	if (iter != sources.end())
+		sources.erase(iter);
+	Clear();
+}
+
+void LiveFrameSource::Deliver(const LiveFrame& frame)
+{
+	if (need_keyframe_) {
+		int type = frame.buf->Data()[frame.offset] & 0x1f;
+		if (type != 7 && type != 5)
+			return;
+		need_keyframe_ = false;
+	}
+	if (frames_.size() >= RTSP_SOURCE_QUEUE) {
+		//* The sink is stuck, start again at a keyframe.
+		Clear();
+		if (video_) {
+			need_keyframe_ = true;
+			server_->RequestKeyFrame();
+			return;
+		}
+	}
+	frame.buf->AddRef();
+	frames_.push_back(frame);
+	if (isCurrentlyAwaitingData())
+		DeliverNext();
+}
+
+void LiveFrameSource::doGetNextFrame()
+{
+	if (!frames_.empty())
+		DeliverNext();
+}
+
+void LiveFrameSource::DeliverNext()
+{
+	LiveFrame frame = frames_.front();
+	frames_.pop_front();
+	if ((unsigned)frame.len > fMaxSize) {
+		fFrameSize = fMaxSize;
+		fNumTruncatedBytes = frame.len - fMaxSize;
+	}
+	else {
+		fFrameSize = frame.len;
+		fNumTruncatedBytes = 0;
+	}
+	memcpy(fTo, frame.buf->Data() + frame.offset, fFrameSize);
+	frame.buf->Release();
+	fPresentationTime = frame.pts;
+	fDurationInMicroseconds = 0;	// Live, sent as soon as it comes
+	FramedSource::afterGetting(this);
+}
+
+void LiveFrameSource::Clear()
+{
+	while (!frames_.empty()) {
+		frames_.front().buf->Release();
+		frames_.pop_front();
+	}
+}
+
+//* Unicast, all the viewers share the first source.
+class LiveH264Subsession : public OnDemandServerMediaSubsession
+{
+public:
+	LiveH264Subsession(UsageEnvironment& env, AnyRtspServer* server)
+		: OnDemandServerMediaSubsession(env, True), server_(server) {}
+
+protected:
+	virtual void startStream(unsigned clientSessionId, void* streamToken, TaskFunc* rtcpRRHandler,
+		void* rtcpRRHandlerClientData, unsigned short& rtpSeqNum, unsigned& rtpTimestamp,
+		ServerRequestAlternativeByteHandler* serverRequestAlternativeByteHandler,
+		void* serverRequestAlternativeByteHandlerClientData) {
+		OnDemandServerMediaSubsession::startStream(clientSessionId, streamToken, rtcpRRHandler,
+			rtcpRRHandlerClientData, rtpSeqNum, rtpTimestamp,
+			serverRequestAlternativeByteHandler, serverRequestAlternativeByteHandlerClientData);
+		server_->RequestKeyFrame();
+	}
+	virtual FramedSource* createNewStreamSource(unsigned clientSessionId, unsigned& estBitrate) {
+		estBitrate = server_->video_kbps_;
+		return server_->CreateSource(true);
+	}
+	virtual RTPSink* createNewRTPSink(Groupsock* rtpGroupsock, unsigned char rtpPayloadTypeIfDynamic, FramedSource* inputSource) {
+		return server_->CreateVideoSink(rtpGroupsock, rtpPayloadTypeIfDynamic);
+	}
+
+private:
+	AnyRtspServer*	server_;
+};
+
+class LiveAacSubsession : public OnDemandServerMediaSubsession
+{
+public:
+	LiveAacSubsession(UsageEnvironment& env, AnyRtspServer* server)
+		: OnDemandServerMediaSubsession(env, True), server_(server) {}
+
+protected:
+	virtual FramedSource* createNewStreamSource(unsigned clientSessionId, unsigned& estBitrate) {
+		estBitrate = RTSP_AUDIO_KBPS;
+		return server_->CreateSource(false);
+	}
+	virtual RTPSink* createNewRTPSink(Groupsock* rtpGroupsock, unsigned char rtpPayloadTypeIfDynamic, FramedSource* inputSource) {
+		return server_->CreateAudioSink(rtpGroupsock, rtpPayloadTypeIfDynamic);
+	}
+
+private:
+	AnyRtspServer*	server_;
+};
+
+//* Multicast, the sink plays all the time, the rtsp only gives out the group.
+class LiveMulticastSubsession : public PassiveServerMediaSubsession
+{
+public:
+	LiveMulticastSubsession(RTPSink& rtpSink, RTCPInstance* rtcpInstance, AnyRtspServer* server, bool video)
+		: PassiveServerMediaSubsession(rtpSink, rtcpInstance), server_(server), video_(video) {}
+
+protected:
+	virtual void startStream(unsigned clientSessionId, void* streamToken, TaskFunc* rtcpRRHandler,
+		void* rtcpRRHandlerClientData, unsigned short& rtpSeqNum, unsigned& rtpTimestamp,
+		ServerRequestAlternativeByteHandler* serverRequestAlternativeByteHandler,
+		void* serverRequestAlternativeByteHandlerClientData) {
+		PassiveServerMediaSubsession::startStream(clientSessionId, streamToken, rtcpRRHandler,
+			rtcpRRHandlerClientData, rtpSeqNum, rtpTimestamp,
+			serverRequestAlternativeByteHandler, serverRequestAlternativeByteHandlerClientData);
+		if (video_)
+			server_->RequestKeyFrame();
+	}
+
+private:
+	AnyRtspServer*	server_;
+	bool			video_;
+};
+
+AnyRtspServer::AnyRtspServer(AnyRtspServerCallback&callback, int port, const std::string&stream,
+	const std::string&multicast, int samplerate, int channels, int videoKbps)
+: callback_(callback)
+, reactor_(NULL)
+, port_(port)
+, stream_(stream)
+, multicast_(multicast)
+, sample_rate_(samplerate)
+, channels_(channels)
+, video_kbps_(videoKbps)
+, need_keyframe_(true)
+, only_audio_mode_(false)
+, server_(NULL)
+, has_base_(false)
+, base_ts_(0)
+, base_us_(0)
+, mc_video_sink_(NULL)
+, mc_audio_sink_(NULL)
+, mc_video_rtcp_(NULL)
+, mc_audio_rtcp_(NULL)
+, mc_video_source_(NULL)
+, mc_audio_source_(NULL)
+, que_video_enc_(RTSP_VIDEO_QUEUE)
+, que_audio_enc_(RTSP_AUDIO_QUEUE)
+, deliver_posted_(0)
+, drop_frames_(0)
+{
+	reactor_ = RtspReactor::Get();
+	reactor_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&AnyRtspServer::DoOpen, this));
+}
+
+AnyRtspServer::~AnyRtspServer(void)
+{
+	//* No producer is left, the streamer takes us out under the lock the encoders push with.
+	reactor_->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&AnyRtspServer::DoClose, this));
+	ClearEncData();
+}
+
+void AnyRtspServer::EnableOnlyAudioMode()
+{
+	only_audio_mode_ = true;
+}
+
+void AnyRtspServer::SetH264Data(uint8_t* pData, int len, uint32_t dts, uint32_t pts)
+{
+	if (server_ == NULL || len <= 4)
+		return;
+	//* The viewers start at the keyframe, which comes after the sps.
+	int sc_len = 0;
+	int sc = FindStartCode(pData, len, &sc_len);
+	if (sc >= 0 && sc + sc_len < len && (pData[sc + sc_len] & 0x1f) == 7)
+		need_keyframe_ = false;
+	if (need_keyframe_)
+		return;
+	//* The whole access unit in one pooled buffer, the sinks take the NALUs of it.
+	EncBuffer* buf = EncBuffer::Create(len);
+	memcpy(buf->Data(), pData, len);
+	buf->SetSize(len);
+	PushEncData(VIDEO_DATA, buf, dts, pts);
+}
+
+void AnyRtspServer::SetAacData(uint8_t* pData, int len, uint32_t ts)
+{
+	if (server_ == NULL || len <= 7)
+		return;
+	//* Always a copy, the buffer shared with AnyRtmpPush is muxed in place by it.
+	EncBuffer* buf = EncBuffer::Create(len);
+	memcpy(buf->Data(), pData, len);
+	buf->SetSize(len);
+	PushEncData(AUDIO_DATA, buf, ts, ts);
+}
+
+void AnyRtspServer::OnMessage(rtc::Message* msg)
+{
+	switch (msg->message_id) {
+	case MSG_DELIVER:
+		rtc::AtomicOps::ReleaseStore(&deliver_posted_, 0);
+		DoDeliver();
+		break;
+	}
+}
+
+void AnyRtspServer::PushEncData(ENC_DATA_TYPE type, EncBuffer* buf, uint32_t dts, uint32_t pts)
+{
+	EncData* pdata = new EncData();
+	pdata->_buf = buf;
+	pdata->_dataLen = buf->Size();
+	pdata->_bVideo = (type == VIDEO_DATA);
+	pdata->_type = type;
+	pdata->_dts = dts;
+	pdata->_pts = pts;
+	rtc::SpscQueue<EncData*>& que = (type == AUDIO_DATA) ? que_audio_enc_ : que_video_enc_;
+	if (!que.Push(&pdata)) {
+		if (type == VIDEO_DATA)
+			need_keyframe_ = true;
+		rtc::AtomicOps::Increment(&drop_frames_);
+		delete pdata;
+		return;
+	}
+	if (rtc::AtomicOps::CompareAndSwap(&deliver_posted_, 0, 1) == 0) {
+		reactor_->Post(RTC_FROM_HERE, this, MSG_DELIVER);
+	}
+}
+
+void AnyRtspServer::DoOpen()
+{
+	UsageEnvironment& env = reactor_->Env();
+	//* A keyframe is one NALU mostly, bigger than the default of the sinks.
+	if (OutPacketBuffer::maxSize < RTSP_MAX_NALU)
+		OutPacketBuffer::maxSize = RTSP_MAX_NALU;
+
+	server_ = RTSPServer::createNew(env, Port(port_));
+	if (server_ == NULL) {
+		LOG(LS_ERROR) << "AnyRtspServer listen " << port_ << " failed: " << env.getResultMsg();
+		return;
+	}
+	ServerMediaSession* sms = ServerMediaSession::createNew(env, stream_.c_str(), stream_.c_str(),
+		"Live stream of AnyRTC");
+	if (multicast_.empty()) {
+		sms->addSubsession(new LiveH264Subsession(env, this));
+		sms->addSubsession(new LiveAacSubsession(env, this));
+	}
+	else {
+		if (OpenMulticast(mc_video_sink_, mc_video_rtcp_, mc_video_source_, RTSP_MULTICAST_PORT, true))
+			sms->addSubsession(new LiveMulticastSubsession(*mc_video_sink_, mc_video_rtcp_, this, true));
+		if (OpenMulticast(mc_audio_sink_, mc_audio_rtcp_, mc_audio_source_, RTSP_MULTICAST_PORT + 2, false))
+			sms->addSubsession(new LiveMulticastSubsession(*mc_audio_sink_, mc_audio_rtcp_, this, false));
+	}
+	server_->addServerMediaSession(sms);
+
+	char* url = server_->rtspURL(sms);
+	LOG(LS_INFO) << "AnyRtspServer serves " << (url ? url : stream_.c_str());
+	delete[] url;
+}
+
+bool AnyRtspServer::OpenMulticast(RTPSink*& sink, RTCPInstance*& rtcp, FramedSource*& source, int port, bool video)
+{
+	UsageEnvironment& env = reactor_->Env();
+	struct in_addr addr;
+	addr.s_addr = our_inet_addr(multicast_.c_str());
+	Groupsock* rtp_gs = new Groupsock(env, addr, Port(port), RTSP_MULTICAST_TTL);
+	Groupsock* rtcp_gs = new Groupsock(env, addr, Port(port + 1), RTSP_MULTICAST_TTL);
+	rtp_gs->multicastSendOnly();
+	rtcp_gs->multicastSendOnly();
+
+	sink = video ? CreateVideoSink(rtp_gs, RTSP_VIDEO_PAYLOAD) : CreateAudioSink(rtp_gs, RTSP_AUDIO_PAYLOAD);
+	if (sink == NULL) {
+		delete rtp_gs;
+		delete rtcp_gs;
+		return false;
+	}
+	char cname[100];
+	gethostname(cname, sizeof(cname) - 1);
+	cname[sizeof(cname) - 1] = '\0';
+	rtcp = RTCPInstance::createNew(env, rtcp_gs, video ? video_kbps_ : RTSP_AUDIO_KBPS,
+		(unsigned char*)cname, sink, NULL, False);
+	source = CreateSource(video);
+	sink->startPlaying(*source, NULL, NULL);
+	return true;
+}
+
+void AnyRtspServer::DoClose()
+{
+	//* The viewers' sources are closed with their sessions.
+	if (server_ != NULL) {
+		Medium::close(server_);
+		server_ = NULL;
+	}
+	RTPSink* sinks[2] = { mc_video_sink_, mc_audio_sink_ };
+	RTCPInstance* rtcps[2] = { mc_video_rtcp_, mc_audio_rtcp_ };
+	FramedSource* sources[2] = { mc_video_source_, mc_audio_source_ };
+	for (int i = 0; i < 2; i++) {
+		if (sinks[i] == NULL)
+			continue;
+		Groupsock* rtp_gs = &sinks[i]->groupsockBeingUsed();
+		Groupsock* rtcp_gs = rtcps[i]->RTCPgs();
+		//* The H264 sink stops its fragmenter on the source, close the source after it.
+		sinks[i]->stopPlaying();
+		Medium::close(rtcps[i]);
+		Medium::close(sinks[i]);
+		Medium::close(sources[i]);
+		delete rtp_gs;
+		delete rtcp_gs;
+	}
+	mc_video_sink_ = mc_audio_sink_ = NULL;
+	mc_video_rtcp_ = mc_audio_rtcp_ = NULL;
+	mc_video_source_ = mc_audio_source_ = NULL;
+	reactor_->Clear(this);
+
+	if (drop_frames_ > 0) {
+		LOG(LS_WARNING) << "AnyRtspServer dropped " << drop_frames_ << " frames for the busy reactor";
+	}
+}
+
+void AnyRtspServer::DoDeliver()
+{
+	int delivers = 0;
+	EncData* pdata = NULL;
+	while (delivers < RTSP_MAX_DELIVERS && (que_video_enc_.Pop(&pdata) || que_audio_enc_.Pop(&pdata))) {
+		delivers++;
+		uint32_t ts = pdata->_pts;
+		if (!has_base_) {
+			//* The presentation times are in the wall clock, for the rtcp sender reports.
+			struct timeval now;
+			gettimeofday(&now, NULL);
+			base_ts_ = ts;
+			base_us_ = (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+			has_base_ = true;
+		}
+		int64_t us = base_us_ + (int64_t)(int32_t)(ts - base_ts_) * 1000;
+		LiveFrame frame;
+		frame.buf = pdata->_buf;
+		frame.pts.tv_sec = (long)(us / 1000000);
+		frame.pts.tv_usec = (long)(us % 1000000);
+
+		uint8_t* data = frame.buf->Data();
+		int size = frame.buf->Size();
+		if (pdata->_type == VIDEO_DATA) {
+			//* Each NALU without start code, for H264VideoStreamDiscreteFramer.
+			int sc_len = 0;
+			int sc = FindStartCode(data, size, &sc_len);
+			while (sc >= 0) {
+				int start = sc + sc_len;
+				int next_len = 0;
+				int next = FindStartCode(data + start, size - start, &next_len);
+				int end = next >= 0 ? start + next : size;
+				while (end > start && data[end - 1] == 0)
+					end--;	// Trailing zero of the next 4-byte start code
+				if (end > start) {
+					int type = data[start] & 0x1f;
+					if (type == 7)
+						sps_.assign((const char*)data + start, end - start);
+					else if (type == 8)
+						pps_.assign((const char*)data + start, end - start);
+					frame.offset = start;
+					frame.len = end - start;
+					for (size_t i = 0; i < video_sources_.size(); i++)
+						video_sources_[i]->Deliver(frame);
+				}
+				sc = next >= 0 ? start + next : -1;
+				sc_len = next_len;
+			}
+		}
+		else {
+			//* Raw AAC for MPEG4-GENERIC, the ADTS header has a crc when protection_absent is 0.
+			int header = (data[1] & 0x01) ? 7 : 9;
+			if (size > header) {
+				frame.offset = header;
+				frame.len = size - header;
+				for (size_t i = 0; i < audio_sources_.size(); i++)
+					audio_sources_[i]->Deliver(frame);
+			}
+		}
+		delete pdata;
+	}
+
+	if (que_video_enc_.Front() != NULL || que_audio_enc_.Front() != NULL) {
+		//* Go on after the other messages of the reactor.
+		if (rtc::AtomicOps::CompareAndSwap(&deliver_posted_, 0, 1) == 0) {
+			reactor_->Post(RTC_FROM_HERE, this, MSG_DELIVER);
+		}
+	}
+}
+
+void AnyRtspServer::ClearEncData()
+{
+	EncData* pdata = NULL;
+	while (que_video_enc_.Pop(&pdata))
+		delete pdata;
+	while (que_audio_enc_.Pop(&pdata))
+		delete pdata;
+}
+
+RTPSink* AnyRtspServer::CreateVideoSink(Groupsock* gs, unsigned char payloadType)
+{
+	//* The sprop-parameter-sets of the sdp, if the encoder has run, the SPS and PPS
+	//* are in band anyway.
+	if (!sps_.empty() && !pps_.empty()) {
+		return H264VideoRTPSink::createNew(reactor_->Env(), gs, payloadType,
+			(const u_int8_t*)sps_.data(), sps_.size(), (const u_int8_t*)pps_.data(), pps_.size());
+	}
+	return H264VideoRTPSink::createNew(reactor_->Env(), gs, payloadType);
+}
+
+RTPSink* AnyRtspServer::CreateAudioSink(Groupsock* gs, unsigned char payloadType)
+{
+	//* AudioSpecificConfig of AAC-LC, as the encoder's.
+	int index = 0;
+	while (index < 13 && kAacSampleRates[index] != sample_rate_)
+		index++;
+	if (index == 13 || channels_ < 1 || channels_ > 7) {
+		LOG(LS_ERROR) << "AnyRtspServer unsupported audio " << sample_rate_ << "Hz " << channels_ << "ch";
+		return NULL;
+	}
+	int config = (2 << 11) | (index << 7) | (channels_ << 3);
+	char config_str[8];
+	snprintf(config_str, sizeof(config_str), "%04X", config);
+	return MPEG4GenericRTPSink::createNew(reactor_->Env(), gs, payloadType, sample_rate_,
+		"audio", "AAC-hbr", config_str, channels_);
+}
+
+FramedSource* AnyRtspServer::CreateSource(bool video)
+{
+	LiveFrameSource* source = LiveFrameSource::createNew(reactor_->Env(), this, video);
+	if (!video)
+		return source;
+	return H264VideoStreamDiscreteFramer::createNew(reactor_->Env(), source);
+}
+
+void AnyRtspServer::RequestKeyFrame()
+{
+	if (!only_audio_mode_)
+		callback_.OnRtspKeyFrameRequest();
+}
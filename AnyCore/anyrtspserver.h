@@ -0,0 +1,119 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __ANY_RTSP_SERVER_H__
+#define __ANY_RTSP_SERVER_H__
+#include <string>
+#include <vector>
+#include "anyrtmpush.h"
+#include "rtspreactor.h"
+
+class RTSPServer;
+class Groupsock;
+class RTPSink;
+class RTCPInstance;
+class FramedSource;
+class LiveFrameSource;
+
+class AnyRtspServerCallback
+{
+public:
+	AnyRtspServerCallback(void){};
+	virtual ~AnyRtspServerCallback(void){};
+
+	//* On the rtsp reactor thread, a new viewer waits for the next keyframe otherwise.
+	virtual void OnRtspKeyFrameRequest() = 0;
+};
+
+//* Serves the encoded media live over rtsp by lib_rtsp, beside the rtmp push
+//* of the same encoders: the frames are packetized by H264VideoRTPSink and
+//* MPEG4GenericRTPSink without another encode. All unicast viewers share one
+//* source of each track, or the stream is sent once to a multicast group and
+//* the rtsp only hands out its sdp. The frames are copied to the reactor by
+//* a queue of each encoder thread, like AnyHlsWriter.
+class AnyRtspServer : public rtc::MessageHandler
+{
+public:
+	//* rtsp://<ip>:port/stream, multicast is the group address or empty for unicast.
+	AnyRtspServer(AnyRtspServerCallback&callback, int port, const std::string&stream,
+		const std::string&multicast, int samplerate, int channels, int videoKbps);
+	virtual ~AnyRtspServer(void);
+
+	bool IsOpen() const { return server_ != NULL; };
+	void EnableOnlyAudioMode();
+
+	//* Timestamps are the capture time in ms, the data is copied.
+	void SetH264Data(uint8_t* pdata, int len, uint32_t dts, uint32_t pts);
+	void SetAacData(uint8_t* pdata, int len, uint32_t ts);
+
+protected:
+	//* For rtc::MessageHandler
+	virtual void OnMessage(rtc::Message* msg);
+
+	void PushEncData(ENC_DATA_TYPE type, EncBuffer* buf, uint32_t dts, uint32_t pts);
+	//* On the reactor only
+	void DoOpen();
+	void DoClose();
+	void DoDeliver();
+	void ClearEncData();
+
+	friend class LiveFrameSource;
+	friend class LiveH264Subsession;
+	friend class LiveAacSubsession;
+	friend class LiveMulticastSubsession;
+	RTPSink* CreateVideoSink(Groupsock* gs, unsigned char payloadType);
+	RTPSink* CreateAudioSink(Groupsock* gs, unsigned char payloadType);
+	FramedSource* CreateSource(bool video);
+	void RequestKeyFrame();
+	bool OpenMulticast(RTPSink*& sink, RTCPInstance*& rtcp, FramedSource*& source, int port, bool video);
+
+private:
+	AnyRtspServerCallback&	callback_;
+	RtspReactor*		reactor_;
+	int					port_;
+	std::string			stream_;
+	std::string			multicast_;
+	int					sample_rate_;
+	int					channels_;
+	int					video_kbps_;
+	bool				need_keyframe_;
+	bool				only_audio_mode_;
+
+	//* The live555 objects, on the reactor only
+	RTSPServer*			server_;
+	std::vector<LiveFrameSource*>	video_sources_;	// Of the viewers, or the multicast
+	std::vector<LiveFrameSource*>	audio_sources_;
+	std::string			sps_;
+	std::string			pps_;
+	bool				has_base_;
+	uint32_t			base_ts_;		// Capture time of the first frame
+	int64_t				base_us_;		// Wall clock of base_ts_, the presentation time of the rtcp
+	RTPSink*			mc_video_sink_;
+	RTPSink*			mc_audio_sink_;
+	RTCPInstance*		mc_video_rtcp_;
+	RTCPInstance*		mc_audio_rtcp_;
+	FramedSource*		mc_video_source_;
+	FramedSource*		mc_audio_source_;
+
+	rtc::SpscQueue<EncData*>	que_video_enc_;	// Video from the video encoder thread
+	rtc::SpscQueue<EncData*>	que_audio_enc_;	// Audio from the audio encoder thread
+	volatile int			deliver_posted_;	// 1 when MSG_DELIVER is posted for the new data
+	volatile int			drop_frames_;	// Dropped for the reactor is slower than the encoders
+};
+
+#endif	// __ANY_RTSP_SERVER_H__
@@ -18,42 +18,35 @@
 */
 #include <iostream>
 #include "avcodec.h"
+#include "webrtc/base/logging.h"
 #include "webrtc/media/base/videoframe.h"
 #include "webrtc/modules/video_coding/codecs/h264/include/h264.h"
 
 
 static const size_t kEventMaxWaitTimeMs = 100;
 static const size_t kMaxDataSizeSamples = 3840;
+static const size_t kMaxAacFrameSize = 1024;
+static const short kNoiseGate = 49;
+static const int kGainUnityQ12 = 4096;
+static const unsigned int kAacFrameSamples = 1024;	// Until the encoder tells its own
+static const int kMaxAudioDriftMs = 100;	// Capture jumped, follow it
+static const size_t kMaxReorderFrames = 16;
 
 namespace webrtc {
-	class AudioPcm{
-	public:
-		AudioPcm(const void* audioSamples, size_t nSamples,
-			size_t nChannels, uint32_t samplesPerSec) :audio_samples_(NULL){
-			audio_samples_ = new char[nSamples*sizeof(int16_t)*nChannels];
-			memcpy(audio_samples_, audioSamples, nSamples*sizeof(int16_t)*nChannels);
-			sample_per_channel = nSamples;
-			channels_ = nChannels;
-			samples_hz_ = samplesPerSec;
-		}
-		virtual ~AudioPcm(void){
-			if (audio_samples_) {
-				delete (char *)audio_samples_;
-				audio_samples_ = NULL;
-			}
-		}
-		void* audio_samples_;
-		int sample_per_channel; 
-		int channels_;
-		uint32_t samples_hz_;
-	};
 A_AACEncoder::A_AACEncoder(AVCodecCallback&callback)
 : callback_(callback)
 , encoder_(nullptr)
+, frame_bytes_(kMaxAacFrameSize)
+, frame_samples_(kAacFrameSamples)
+, gain_q12_(kGainUnityQ12)
 , muted_(false)
 , encoded_(false)
 , audio_record_sample_hz_(44100)
 , audio_record_channels_(2)
+, got_capture_(false)
+, capture_base_ms_(0)
+, input_samples_(0)
+, output_frames_(0)
 {
     if (!running_) {
         running_ = true;
@@ -72,14 +65,6 @@ A_AACEncoder::~A_AACEncoder(void)
 		aac_encoder_close(encoder_);
 		encoder_ = NULL;
 	}
-
-	rtc::CritScope cs(&buffer_critsect_);
-	while (audio_buffer_.size() > 0) {
-		AudioPcm* pcm = (AudioPcm*)audio_buffer_.front();
-		audio_buffer_.pop_front();
-
-		delete pcm;
-	}
 }
 
 bool A_AACEncoder::Init(int num_channels, int sample_rate, int pcm_bit_size)
@@ -89,6 +74,13 @@ bool A_AACEncoder::Init(int num_channels, int sample_rate, int pcm_bit_size)
 	audio_record_sample_hz_ = sample_rate;
 	audio_record_channels_ = num_channels;
 	encoder_ = aac_encoder_open(num_channels, sample_rate, pcm_bit_size, false);
+	unsigned int frame_samples = 0, frame_bytes = 0;
+	if (encoder_ && aac_encoder_get_info(encoder_, &frame_samples, &frame_bytes) == 0) {
+		if (frame_samples > 0)
+			frame_samples_ = frame_samples;
+		if (frame_bytes > 0)
+			frame_bytes_ = frame_bytes;
+	}
 
 	std::cout << "aacencode init " << num_channels << sample_rate << pcm_bit_size;
 
@@ -100,82 +92,100 @@ bool A_AACEncoder::Init(int num_channels, int sample_rate, int pcm_bit_size)
 	return true;
 }
 
+void A_AACEncoder::SetGain(float gain)
+{
+	if (gain < 0.0f)
+		gain = 0.0f;
+	else if (gain > 7.99f)
+		gain = 7.99f;
+	gain_q12_ = (int)(gain * kGainUnityQ12 + 0.5f);
+}
+
 void A_AACEncoder::StartEncoder()
 {
     rtc::CritScope cs(&buffer_critsect_);
-    while (audio_buffer_.size() > 0) {
-        AudioPcm* pcm = (AudioPcm*)audio_buffer_.front();
-        audio_buffer_.pop_front();
-        
-        delete pcm;
-    }
     encoded_ = true;
+    got_capture_ = false;
 }
     void A_AACEncoder::StopEncoder()
 {
 	rtc::CritScope cs(&buffer_critsect_);
     encoded_ = false;
-	while (audio_buffer_.size() > 0) {
-		AudioPcm* pcm = (AudioPcm*)audio_buffer_.front();
-		audio_buffer_.pop_front();
-
-		delete pcm;
-	}
 }
 int A_AACEncoder::Encode(const void* audioSamples, const size_t nSamples, const size_t nBytesPerSample, 
-		const size_t nChannels, const uint32_t samplesPerSec, const uint32_t totalDelayMS)
+		const size_t nChannels, const uint32_t samplesPerSec, const uint32_t captureMs)
 {
 	int status = 0;
 	if(encoder_)
 	{
-		unsigned int outlen = 0;
-		uint32_t curtime = rtc::Time();
-		uint8_t encoded[1024];
-		if(muted_)
-		{// mute audio
-			memset((uint8_t*)audioSamples, 0, nSamples*nBytesPerSample*nChannels);
+		//* The encoder buffers samples, so the frames are stamped by the samples counted
+		//* from the capture time, which only follows the capture when it jumps.
+		if (!got_capture_) {
+			got_capture_ = true;
+			capture_base_ms_ = captureMs;
+			input_samples_ = 0;
+			output_frames_ = 0;
 		}
-		else
-		{
-			const short NOISE_SIZE = 49;
-			short* pdata = (short*)audioSamples;
-			for (size_t i = 0; i < nSamples*nBytesPerSample*nChannels/2; ++i) {
-				if (pdata[i]<NOISE_SIZE && pdata[i]>-NOISE_SIZE) {
-					pdata[i] = 0;
-				}
-				else if (pdata[i]>NOISE_SIZE) {
-					pdata[i] = pdata[i] - NOISE_SIZE;
-				}
-				else if (pdata[i]<-NOISE_SIZE) {
-					pdata[i] = pdata[i] + NOISE_SIZE;
-				}
+		else {
+			uint32_t expected = capture_base_ms_ + (uint32_t)(input_samples_ * 1000 / samplesPerSec);
+			int drift = (int)(captureMs - expected);
+			if (drift > kMaxAudioDriftMs || drift < -kMaxAudioDriftMs) {
+				capture_base_ms_ += drift;
 			}
-
-			//unsigned char *pInData = (unsigned char *)audioSamples;
-			//int nInLen = nSamples*nBytesPerSample*nChannels;
-			//for (size_t i = 0; i < nSamples*nBytesPerSample*nChannels; i += 160) {
-			//	if (nInLen - i >= 320) {
-			//		short shBufferIn[160] = { 0 };
-			//		short shBufferOut[160] = { 0 };
-			//		memcpy(shBufferIn, (char*)(pInData + i), 160 * sizeof(short));
-
-			//		//void WebRtcNsx_Process(NsxHandle* nsxInst,
-			//		//	const short* const* speechFrame,
-			//		//	int num_bands,
-			//		//	short* const* outFrame);
-
-			//		memcpy(shBufferIn, (char*)(pInData + i), 160 * sizeof(short));
-			//		WebRtcNsx_Process(m_pNSinst, (const short* const*)shBufferIn, 5, (short* const*)shBufferOut);
-			//		memcpy(pInData + i, shBufferOut, 160 * sizeof(short));
-			//	}
-			//}
-		}
-		status = aac_encoder_encode_frame(encoder_, (uint8_t*)audioSamples, nSamples*nBytesPerSample*nChannels, encoded, &outlen);
-		if(outlen > 0)
-		{
-			//ALOGE("Encode aac len:%d", outlen);
-			callback_.OnEncodeDataCallback(true, encoded, outlen, curtime);
 		}
+		input_samples_ += nSamples;
+		//* Mute, or noise gate and gain, vectorized in the plugin.
+		aac_pcm_process((short*)audioSamples, nSamples*nBytesPerSample*nChannels/2, gain_q12_, kNoiseGate, muted_);
+		//unsigned char *pInData = (unsigned char *)audioSamples;
+		//int nInLen = nSamples*nBytesPerSample*nChannels;
+		//for (size_t i = 0; i < nSamples*nBytesPerSample*nChannels; i += 160) {
+		//	if (nInLen - i >= 320) {
+		//		short shBufferIn[160] = { 0 };
+		//		short shBufferOut[160] = { 0 };
+		//		memcpy(shBufferIn, (char*)(pInData + i), 160 * sizeof(short));
+
+		//		//void WebRtcNsx_Process(NsxHandle* nsxInst,
+		//		//	const short* const* speechFrame,
+		//		//	int num_bands,
+		//		//	short* const* outFrame);
+
+		//		memcpy(shBufferIn, (char*)(pInData + i), 160 * sizeof(short));
+		//		WebRtcNsx_Process(m_pNSinst, (const short* const*)shBufferIn, 5, (short* const*)shBufferOut);
+		//		memcpy(pInData + i, shBufferOut, 160 * sizeof(short));
+		//	}
+		//}
+		//* Encode the frames of the pcm one by one straight into pooled buffers, which
+		//* go to the callback without copy. They are not slices of one batch buffer,
+		//* so a frame queued by the pusher doesn't hold the memory of the others.
+		const uint8_t* pcm = (const uint8_t*)audioSamples;
+		unsigned int pcmLen = nSamples*nBytesPerSample*nChannels;
+		aac_enc_frame_t frame;
+		EncBuffer* encoded = NULL;
+		do {
+			if (encoded == NULL)
+				encoded = EncBuffer::Create(frame_bytes_);
+			unsigned int used = 0;
+			int got = aac_encoder_encode_frames(encoder_, pcm, pcmLen, &used, encoded->Data(), frame_bytes_, &frame, 1);
+			if (got < 0) {
+				status = -1;
+				break;
+			}
+			if (got > 0) {
+				encoded->SetSize(frame.size);
+				uint32_t pts = capture_base_ms_ + (uint32_t)(output_frames_ * frame_samples_ * 1000 / samplesPerSec);
+				output_frames_++;
+				callback_.OnEncodeBufferCallback(true, encoded, pts);
+				encoded->Release();
+				encoded = NULL;
+			}
+			status += got;
+			if (used == 0)
+				break;
+			pcm += used;
+			pcmLen -= used;
+		} while (pcmLen > 0);
+		if (encoded != NULL)
+			encoded->Release();
 	}
 
 	return status;
@@ -189,10 +199,10 @@ void A_AACEncoder::OnData(const Data& audio)
 			int16_t temp_output[kMaxDataSizeSamples];
 			int samples_per_channel_int = resampler_record_.Resample10Msec((int16_t*)audio.data, audio.sample_rate * audio.channels,
 				audio_record_sample_hz_ * audio_record_channels_, 1, kMaxDataSizeSamples, temp_output);
-			Encode(temp_output, audio_record_sample_hz_ / 100, 2, audio_record_channels_, audio_record_sample_hz_, 0);
+			Encode(temp_output, audio_record_sample_hz_ / 100, 2, audio_record_channels_, audio_record_sample_hz_, audio.timestamp);
 		}
 		else {
-			Encode((int16_t*)audio.data, audio.samples_per_channel, 2, audio_record_channels_, audio_record_sample_hz_, 0);
+			Encode((int16_t*)audio.data, audio.samples_per_channel, 2, audio_record_channels_, audio_record_sample_hz_, audio.timestamp);
 		}
     }
 }
@@ -208,6 +218,13 @@ V_H264Encoder::V_H264Encoder(AVCodecCallback&callback)
 , delay_ms_(0)
 , adjust_v_bitrate_(0)
 , render_buffers_(new VideoRenderFrames(0))
+, low_latency_(false)
+, stale_frames_(0)
+, frame_event_(false, false)
+, reset_dts_(0)
+, got_dts_(false)
+, last_dts_(0)
+, reorder_frames_(0)
 , video_encoder_factory_(NULL)
 , encoder_(NULL)
 {
@@ -238,12 +255,14 @@ V_H264Encoder::~V_H264Encoder(void)
 {
 	if (running_) {
 		running_ = false;
+		frame_event_.Set();
 		rtc::Thread::Stop();
 	}
 	
 	{
 		rtc::CritScope cs_buffer(&buffer_critsect_);
 		render_buffers_.reset();
+		latest_frame_ = rtc::Optional<VideoFrame>();
 	}
 
 	if(encoder_)
@@ -376,6 +395,7 @@ void V_H264Encoder::StartEncoder()
     //render_buffers_->ReleaseAllFrames();
     need_keyframe_ = true;
     encoded_ = true;
+    rtc::AtomicOps::ReleaseStore(&reset_dts_, 1);
 	
 }
 void V_H264Encoder::StopEncoder()
@@ -390,11 +410,77 @@ void V_H264Encoder::RequestKeyFrame()
 	need_keyframe_ = true;
 }
 
+void V_H264Encoder::SetLowLatency(bool enabled)
+{
+	rtc::CritScope cs_buffer(&buffer_critsect_);
+	if (low_latency_ == enabled)
+		return;
+	low_latency_ = enabled;
+	//* Drop the frames of the other mode.
+	render_buffers_.reset(new VideoRenderFrames(0));
+	latest_frame_ = rtc::Optional<VideoFrame>();
+	frame_event_.Set();
+}
+
+void V_H264Encoder::EncodeFrame(const VideoFrame& frame)
+{
+	if(h264_.width != frame.width() || h264_.height != frame.height())
+	{
+		h264_.width = frame.width();
+		h264_.height = frame.height();
+		if(encoder_)
+		{
+			encoder_->Release();
+			encoder_ = NULL;
+		}
+		
+	}
+	if(encoder_ == NULL)
+	{
+		CreateVideoEncoder();
+	}
+	CodecSpecificInfo codec_info;
+	std::vector<FrameType> next_frame_types(1, kVideoFrameDelta);
+	if(need_keyframe_) {
+		need_keyframe_ = false;
+		next_frame_types[0] = kVideoFrameKey;
+	}
+	
+	if(encoder_)
+	{
+		int ret = encoder_->Encode(frame, &codec_info, &next_frame_types);
+		if(ret != 0)
+		{
+			//printf("Encode ret :%d", ret);
+		}
+	}
+}
+
 //* For Thread
 void V_H264Encoder::Run()
 {
 	while(running_)
 	{
+		bool low_latency = false;
+		{
+			rtc::CritScope cs(&buffer_critsect_);
+			low_latency = low_latency_;
+		}
+		if (low_latency) {
+			//* Sleep until OnFrame fills the mailbox, encode the frame at once.
+			frame_event_.Wait(kEventMaxWaitTimeMs);
+			rtc::Optional<VideoFrame> frame_to_encode;
+			{
+				rtc::CritScope cs(&buffer_critsect_);
+				frame_to_encode = std::move(latest_frame_);
+				latest_frame_ = rtc::Optional<VideoFrame>();
+			}
+			if (frame_to_encode) {
+				EncodeFrame(*frame_to_encode);
+			}
+			continue;
+		}
+
 		int64_t cur_time = rtc::TimeMillis();
 		// Get a new frame to render and the time for the frame after this one.
 		rtc::Optional<VideoFrame> frame_to_render;
@@ -406,36 +492,7 @@ void V_H264Encoder::Run()
 		}
 
 		if (frame_to_render) {
-			if(h264_.width != frame_to_render->width() || h264_.height != frame_to_render->height())
-			{
-				h264_.width = frame_to_render->width();
-				h264_.height = frame_to_render->height();
-				if(encoder_)
-				{
-					encoder_->Release();
-					encoder_ = NULL;
-				}
-				
-			}
-			if(encoder_ == NULL)
-			{
-				CreateVideoEncoder();
-			}
-			CodecSpecificInfo codec_info;
-			std::vector<FrameType> next_frame_types(1, kVideoFrameDelta);
-			if(need_keyframe_) {
-				need_keyframe_ = false;
-				next_frame_types[0] = kVideoFrameKey;
-			}
-			
-			if(encoder_)
-			{
-				int ret = encoder_->Encode(*frame_to_render, &codec_info, &next_frame_types);
-				if(ret != 0)
-				{
-					//printf("Encode ret :%d", ret);
-				}
-			}
+			EncodeFrame(*frame_to_render);
 		}
 
 		// Set timer for next frame to render.
@@ -459,8 +516,23 @@ void V_H264Encoder::Run()
 void V_H264Encoder::OnFrame(const cricket::VideoFrame& frame)
 {
     rtc::CritScope csB(&buffer_critsect_);
-    if (encoded_) {
-        webrtc::VideoFrame video_frame(frame.video_frame_buffer(), 0, rtc::TimeMillis() + 150, frame.rotation());
+    //* The capture time goes through the encoder as the frame timestamp.
+    uint32_t capture_ms = frame.timestamp_us() > 0 ? (uint32_t)(frame.timestamp_us() / rtc::kNumMicrosecsPerMillisec) : rtc::Time();
+    if (encoded_ && low_latency_) {
+        webrtc::VideoFrame video_frame(frame.video_frame_buffer(), capture_ms, rtc::TimeMillis(), frame.rotation());
+        if (!video_frame.IsZeroSize()) {
+            if (latest_frame_) {
+                //* Still busy with the one before, the waiting frame is stale.
+                if (++stale_frames_ % 100 == 1) {
+                    LOG(LS_INFO) << "V_H264Encoder dropped stale frames: " << stale_frames_;
+                }
+            }
+            latest_frame_ = rtc::Optional<VideoFrame>(video_frame);
+            frame_event_.Set();
+        }
+    }
+    else if (encoded_) {
+        webrtc::VideoFrame video_frame(frame.video_frame_buffer(), capture_ms, rtc::TimeMillis() + 150, frame.rotation());
         if (!video_frame.IsZeroSize()) {
             if (render_buffers_->AddFrame(video_frame) == 1) {
             // OK
@@ -473,9 +545,44 @@ int32_t V_H264Encoder::Encoded(const EncodedImage& encoded_image,
                           const CodecSpecificInfo* codec_specific_info,
                           const RTPFragmentationHeader* fragmentation)
 {
-	callback_.OnEncodeDataCallback(false, encoded_image._buffer, encoded_image._length, rtc::Time());
+	//* External encoders may not keep the timestamp, stamp it now then.
+	uint32_t pts = encoded_image._timeStamp != 0 ? encoded_image._timeStamp : rtc::Time();
+	uint32_t dts = NextDts(pts);
+	callback_.OnEncodeVideoCallback(encoded_image._buffer, encoded_image._length, dts, pts);
 	return 0;
 }
 
+uint32_t V_H264Encoder::NextDts(uint32_t pts)
+{
+	//* The dts of a frame is the smallest pts not used yet, once the reorder
+	//* window is full, so dts never passes pts and never goes back.
+	if (rtc::AtomicOps::CompareAndSwap(&reset_dts_, 1, 0)) {
+		got_dts_ = false;
+		reorder_pts_.clear();
+	}
+	reorder_pts_.insert(pts);
+	uint32_t dts = 0;
+	if (reorder_pts_.size() > reorder_frames_) {
+		dts = *reorder_pts_.begin();
+		reorder_pts_.erase(reorder_pts_.begin());
+	}
+	else {
+		//* Filling the window, space the dts a frame apart before the first pts.
+		int frame_ms = 1000 / (h264_.maxFramerate > 0 ? h264_.maxFramerate : 30);
+		dts = *reorder_pts_.begin() - (uint32_t)((reorder_frames_ + 1 - reorder_pts_.size()) * frame_ms);
+	}
+	if (got_dts_ && (int)(dts - last_dts_) < 0) {
+		dts = last_dts_;
+	}
+	if ((int)(pts - dts) < 0 && reorder_frames_ < kMaxReorderFrames) {
+		//* Reordered deeper than the window, this frame has a negative composition time.
+		reorder_frames_++;
+		LOG(LS_INFO) << "V_H264Encoder reorder window grows to " << reorder_frames_ << " frames";
+	}
+	got_dts_ = true;
+	last_dts_ = dts;
+	return dts;
+}
+
 
 }	// namespace webrtc
\ No newline at end of file
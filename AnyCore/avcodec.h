@@ -18,12 +18,14 @@
 */
 #ifndef __AV_CODEC_H__
 #define __AV_CODEC_H__
+#include <set>
 #include "webrtc/audio_sink.h"
 #include "webrtc/video_decoder.h"
 #include "webrtc/video_encoder.h"
 #include "webrtc/video_frame.h"
 #include "webrtc/api/mediastreaminterface.h"
 #include "webrtc/base/criticalsection.h"
+#include "webrtc/base/event.h"
 #include "webrtc/base/thread.h"
 #include "webrtc/base/scoped_ptr.h"
 #include "webrtc/base/thread_annotations.h"
@@ -34,6 +36,7 @@
 #include "webrtc/media/engine/webrtcvideoencoderfactory.h"
 #include "webrtc\modules/audio_processing/ns\noise_suppression.h"
 #include "webrtc\modules/audio_processing/ns/noise_suppression_x.h"
+#include "encbuffer.h"
 #include "pluginaac.h"
 
 namespace webrtc {
@@ -44,7 +47,16 @@ public:
 	AVCodecCallback(void){};
 	virtual ~AVCodecCallback(void){};
 
+	//* All timestamps are the capture time in ms, on the rtc::Time() clock.
 	virtual void OnEncodeDataCallback(bool audio, uint8_t *p, uint32_t length, uint32_t ts) = 0;
+	//* The buffer is only valid in the call, AddRef it to keep without copy.
+	virtual void OnEncodeBufferCallback(bool audio, EncBuffer* buf, uint32_t ts) {
+		OnEncodeDataCallback(audio, buf->Data(), buf->Size(), ts);
+	};
+	//* Encoded video in decode order, pts differs from dts when frames are reordered.
+	virtual void OnEncodeVideoCallback(uint8_t *p, uint32_t length, uint32_t dts, uint32_t pts) {
+		OnEncodeDataCallback(false, p, length, dts);
+	};
 };
 
 class A_AACEncoder : public webrtc::AudioSinkInterface
@@ -55,11 +67,14 @@ public:
 
 	bool Init(int num_channels, int sample_rate, int pcm_bit_size);
 	void Muted(bool enable){muted_ = enable;};
+	//* Gain of the captured pcm, 1.0 keeps the level.
+	void SetGain(float gain);
 	void StartEncoder();
 	void StopEncoder();
 
+	//* captureMs: capture time of the first sample.
 	int Encode(const void* audioSamples, const size_t nSamples, const size_t nBytesPerSample, 
-		const size_t nChannels, const uint32_t samplesPerSec, const uint32_t totalDelayMS);
+		const size_t nChannels, const uint32_t samplesPerSec, const uint32_t captureMs);
 
 protected:
 
@@ -75,13 +90,21 @@ private:
 	//NsxHandle* m_pNSinst;
 
 	aac_enc_t	encoder_;
+	unsigned int frame_bytes_;		// Max bytes of an aac frame
+	unsigned int frame_samples_;	// Samples of an aac frame, per channel
+	int			gain_q12_;
 
 	webrtc::acm2::ACMResampler resampler_record_;
 	int						audio_record_sample_hz_;
 	int						audio_record_channels_;        
 
-	rtc::CriticalSection buffer_critsect_;
-	std::list<void*>	audio_buffer_;
+	//* Timestamps of the aac frames, counted in samples from the first capture time
+	bool					got_capture_;
+	uint32_t				capture_base_ms_;
+	int64_t					input_samples_;
+	int64_t					output_frames_;
+
+	rtc::CriticalSection buffer_critsect_;	// Guards encoded_ and encoder_ against OnData
 };
 
 class V_H264Encoder : public rtc::Thread, public rtc::VideoSinkInterface<cricket::VideoFrame> , public EncodedImageCallback
@@ -99,6 +122,9 @@ public:
 	void StartEncoder();
 	void StopEncoder();
 	void RequestKeyFrame();
+	//* Encode each frame as it arrives instead of at its render time,
+	//* frames coming while the encoder is busy are dropped but the latest.
+	void SetLowLatency(bool enabled);
 
 	//* For Thread
 	virtual void Run();
@@ -110,6 +136,11 @@ public:
                           const CodecSpecificInfo* codec_specific_info,
                           const RTPFragmentationHeader* fragmentation);
 
+private:
+	void EncodeFrame(const VideoFrame& frame);
+	//* Dts of the encoded frame with |pts|, the encoder gives them in decode order.
+	uint32_t NextDts(uint32_t pts);
+
 private:
 	bool		running_;
 	bool		need_keyframe_;
@@ -124,6 +155,17 @@ private:
 	rtc::CriticalSection buffer_critsect_;
 	rtc::scoped_ptr<VideoRenderFrames> render_buffers_
       GUARDED_BY(buffer_critsect_);
+	//* Latest-frame mailbox of the low latency mode
+	bool		low_latency_ GUARDED_BY(buffer_critsect_);
+	rtc::Optional<VideoFrame> latest_frame_ GUARDED_BY(buffer_critsect_);
+	int			stale_frames_ GUARDED_BY(buffer_critsect_);
+	rtc::Event	frame_event_;
+	volatile int	reset_dts_;		// Set by StartEncoder, taken by NextDts
+	//* For NextDts, on the thread calling Encoded
+	bool		got_dts_;
+	uint32_t	last_dts_;
+	size_t		reorder_frames_;
+	std::multiset<uint32_t>	reorder_pts_;
 };
 
 }	// namespace webrtc
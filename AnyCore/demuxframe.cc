@@ -0,0 +1,105 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "demuxframe.h"
+#include <stdlib.h>
+#include <string.h>
+#include "webrtc/base/atomicops.h"
+
+#define DEMUX_SLICES	16		// Slices reserved per frame, grows when more
+#define DEMUX_SIDE_SIZE	128		// Side bytes reserved per frame, grows when more
+
+DemuxPayload* DemuxPayload::Create(char* data, int size)
+{
+	return new DemuxPayload(data, size);
+}
+
+DemuxPayload::DemuxPayload(char* data, int size)
+: data_(data)
+, size_(size)
+, ref_count_(1)
+{
+}
+
+DemuxPayload::~DemuxPayload(void)
+{
+	free(data_);
+}
+
+void DemuxPayload::AddRef()
+{
+	rtc::AtomicOps::Increment(&ref_count_);
+}
+
+void DemuxPayload::Release()
+{
+	if (rtc::AtomicOps::Decrement(&ref_count_) == 0) {
+		delete this;
+	}
+}
+
+//===================================================
+//* DemuxFrame
+DemuxFrame::DemuxFrame(DemuxPayload* payload)
+: payload_(payload)
+, size_(0)
+{
+	if (payload_)
+		payload_->AddRef();
+	slices_.reserve(DEMUX_SLICES);
+	side_.reserve(DEMUX_SIDE_SIZE);
+}
+
+DemuxFrame::~DemuxFrame(void)
+{
+	if (payload_)
+		payload_->Release();
+}
+
+void DemuxFrame::Append(const char* data, int len)
+{
+	if (len <= 0)
+		return;
+	Slice slice = { data, 0, len };
+	slices_.push_back(slice);
+	size_ += len;
+}
+
+void DemuxFrame::AppendCopy(const char* data, int len)
+{
+	if (len <= 0)
+		return;
+	//* Keep the offset only, the side buffer may move when grows.
+	Slice slice = { NULL, (int)side_.size(), len };
+	side_.append(data, len);
+	slices_.push_back(slice);
+	size_ += len;
+}
+
+int DemuxFrame::CopyTo(uint8_t* dst, int len) const
+{
+	int copied = 0;
+	for (size_t i = 0; i < slices_.size() && copied < len; i++) {
+		const Slice& slice = slices_[i];
+		const char* src = slice.data ? slice.data : side_.data() + slice.offset;
+		int n = slice.len < len - copied ? slice.len : len - copied;
+		memcpy(dst + copied, src, n);
+		copied += n;
+	}
+	return copied;
+}
@@ -0,0 +1,84 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __DEMUX_FRAME_H__
+#define __DEMUX_FRAME_H__
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//* Ref-counted payload of one rtmp packet, as malloced by srs_rtmp_read_packet.
+class DemuxPayload
+{
+public:
+	//* Take the malloced data, ref count 1.
+	static DemuxPayload* Create(char* data, int size);
+
+	void AddRef();
+	void Release();
+
+	const char* Data() const { return data_; };
+	int Size() const { return size_; };
+
+private:
+	DemuxPayload(char* data, int size);
+	~DemuxPayload(void);
+
+	char*			data_;
+	int				size_;
+	volatile int	ref_count_;
+};
+
+//* Scatter/gather view of one AnnexB or ADTS frame.
+//* The slices reference the rtmp payload, the start codes, SPS/PPS and ADTS
+//* headers are kept in a small side buffer, so the frame is made contiguous
+//* only once, by the decoder.
+class DemuxFrame
+{
+public:
+	//* Hold a reference of payload, NULL if all referenced bytes outlive the frame.
+	explicit DemuxFrame(DemuxPayload* payload);
+	~DemuxFrame(void);
+
+	//* Reference the bytes, in the payload or static.
+	void Append(const char* data, int len);
+	//* Copy the bytes to the side buffer.
+	void AppendCopy(const char* data, int len);
+
+	int Size() const { return size_; };
+	bool Empty() const { return size_ == 0; };
+	//* Copy at most len bytes from the start of frame, return the bytes copied.
+	int CopyTo(uint8_t* dst, int len) const;
+
+private:
+	DemuxFrame(const DemuxFrame&);
+	DemuxFrame& operator=(const DemuxFrame&);
+
+	struct Slice {
+		const char* data;	// NULL for the bytes at offset of side buffer
+		int offset;
+		int len;
+	};
+
+	DemuxPayload*		payload_;
+	std::vector<Slice>	slices_;
+	std::string			side_;
+	int					size_;
+};
+
+#endif	// __DEMUX_FRAME_H__
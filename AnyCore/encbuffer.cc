@@ -0,0 +1,131 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "encbuffer.h"
+#include <assert.h>
+#include "webrtc/base/atomicops.h"
+
+EncBuffer* EncBuffer::Create(int size)
+{
+	return EncBufferPool::Inst().Alloc(size);
+}
+
+void EncBuffer::FreeData(char* data, void* param)
+{
+	((EncBuffer*)param)->Release();
+}
+
+EncBuffer::EncBuffer(int slab, int capacity)
+: slab_(slab)
+, capacity_(capacity)
+, size_(0)
+, ref_count_(0)
+, mem_(NULL)
+{
+	mem_ = new uint8_t[ENC_BUFFER_HEADROOM + capacity];
+}
+
+EncBuffer::~EncBuffer(void)
+{
+	delete[] mem_;
+}
+
+void EncBuffer::AddRef()
+{
+	rtc::AtomicOps::Increment(&ref_count_);
+}
+
+void EncBuffer::Release()
+{
+	if (rtc::AtomicOps::Decrement(&ref_count_) == 0) {
+		EncBufferPool::Inst().Recycle(this);
+	}
+}
+
+void EncBuffer::SetSize(int size)
+{
+	assert(size >= 0 && size <= capacity_);
+	size_ = size;
+}
+
+//===================================================
+//* EncBufferPool
+EncBufferPool& EncBufferPool::Inst()
+{
+	static EncBufferPool gInst;
+	return gInst;
+}
+
+EncBufferPool::EncBufferPool(void)
+{
+}
+
+EncBufferPool::~EncBufferPool(void)
+{
+	for (int i = 0; i < ENC_POOL_SLABS; i++) {
+		rtc::CritScope l(&cs_slab_[i]);
+		while (free_slab_[i].size() > 0) {
+			delete free_slab_[i].back();
+			free_slab_[i].pop_back();
+		}
+	}
+}
+
+EncBuffer* EncBufferPool::Alloc(int size)
+{
+	int slab = 0;
+	while (slab < ENC_POOL_SLABS && (1 << (ENC_POOL_MIN_SHIFT + slab)) < size) {
+		slab++;
+	}
+
+	EncBuffer* buf = NULL;
+	if (slab < ENC_POOL_SLABS) {
+		{
+			rtc::CritScope l(&cs_slab_[slab]);
+			if (free_slab_[slab].size() > 0) {
+				buf = free_slab_[slab].back();
+				free_slab_[slab].pop_back();
+			}
+		}
+		if (buf == NULL) {
+			buf = new EncBuffer(slab, 1 << (ENC_POOL_MIN_SHIFT + slab));
+		}
+	}
+	else {
+		buf = new EncBuffer(-1, size);
+	}
+	buf->size_ = 0;
+	buf->ref_count_ = 1;
+	return buf;
+}
+
+void EncBufferPool::Recycle(EncBuffer* buf)
+{
+	if (buf->slab_ >= 0) {
+		//* Keep at most ENC_POOL_MAX_BYTES idle in each slab, at least 4 buffers.
+		size_t max_free = ENC_POOL_MAX_BYTES / buf->capacity_;
+		if (max_free < 4)
+			max_free = 4;
+		rtc::CritScope l(&cs_slab_[buf->slab_]);
+		if (free_slab_[buf->slab_].size() < max_free) {
+			free_slab_[buf->slab_].push_back(buf);
+			return;
+		}
+	}
+	delete buf;
+}
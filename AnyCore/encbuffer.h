@@ -0,0 +1,78 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __ENC_BUFFER_H__
+#define __ENC_BUFFER_H__
+#include <stdint.h>
+#include <vector>
+#include "webrtc/base/criticalsection.h"
+
+#define ENC_BUFFER_HEADROOM		16		// Bytes reserved before Data(), for muxer headers written in place
+#define ENC_POOL_MIN_SHIFT		10		// Smallest slab: 1KB
+#define ENC_POOL_MAX_SHIFT		20		// Largest slab: 1MB, bigger buffers are not pooled
+#define ENC_POOL_SLABS			(ENC_POOL_MAX_SHIFT - ENC_POOL_MIN_SHIFT + 1)
+#define ENC_POOL_MAX_BYTES		(4 * 1024 * 1024)	// Max idle bytes kept per slab
+
+//* Ref-counted buffer of one encoded frame, recycled to EncBufferPool on last Release.
+//* The encoders write into Data() directly, and the buffer is handed through
+//* AnyRtmpPush to srs_librtmp without copy.
+class EncBuffer
+{
+public:
+	//* Get a buffer from EncBufferPool, with capacity >= size and ref count 1.
+	static EncBuffer* Create(int size);
+	//* Release the buffer passed as param, for srs_free_t of srs_librtmp.
+	static void FreeData(char* data, void* param);
+
+	void AddRef();
+	void Release();
+
+	uint8_t* Data() { return mem_ + ENC_BUFFER_HEADROOM; };
+	int Size() const { return size_; };
+	int Capacity() const { return capacity_; };
+	void SetSize(int size);
+
+private:
+	friend class EncBufferPool;
+	EncBuffer(int slab, int capacity);
+	~EncBuffer(void);
+
+	int				slab_;		// Index of slab in pool, -1 means not pooled
+	int				capacity_;
+	int				size_;
+	volatile int	ref_count_;
+	uint8_t*		mem_;
+};
+
+class EncBufferPool
+{
+public:
+	static EncBufferPool& Inst();
+
+	EncBuffer* Alloc(int size);
+	void Recycle(EncBuffer* buf);
+
+private:
+	EncBufferPool(void);
+	~EncBufferPool(void);
+
+	rtc::CriticalSection	cs_slab_[ENC_POOL_SLABS];
+	std::vector<EncBuffer*>	free_slab_[ENC_POOL_SLABS];
+};
+
+#endif	// __ENC_BUFFER_H__
@@ -0,0 +1,410 @@
+/**********
+This library is free software; you can redistribute it and/or modify it under
+the terms of the GNU Lesser General Public License as published by the
+Free Software Foundation; either version 2.1 of the License, or (at your
+option) any later version. (See <http://www.gnu.org/copyleft/lesser.html>.)
+
+This library is distributed in the hope that it will be useful, but WITHOUT
+ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this library; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301  USA
+**********/
+// Copyright (c) 1996-2014 Live Networks, Inc.  All rights reserved.
+// Basic Usage Environment: for a simple, non-scripted, console application
+// Implementation of the "epoll"-based task scheduler (Linux only)
+
+#include "BasicUsageEnvironment.hh"
+
+#if defined(__linux__)
+#include "HashTable.hh"
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <time.h>
+
+// The maximum number of ready sockets that we collect in one "epoll_wait()" call:
+#define MAX_EPOLL_EVENTS 256
+#define INITIAL_MAX_TIMERS 64
+
+#ifndef MILLION
+#define MILLION 1000000
+#endif
+
+// "epoll_event.data" carries the socket number in its low word and the registration's generation in its
+// high word, so that events reported for a socket that was unregistered (or closed and reused) by an
+// earlier handler in the same batch can be recognized and skipped:
+#define EPOLL_DATA(socketNum, generation) (((uint64_t)(generation) << 32) | (uint32_t)(socketNum))
+#define EPOLL_DATA_TIMER ((uint64_t)-1)
+#define EPOLL_DATA_WAKEUP ((uint64_t)-2)
+
+struct EpollTaskScheduler::SocketHandler {
+  int conditionSet;
+  BackgroundHandlerProc* handlerProc;
+  void* clientData;
+  u_int32_t generation;
+};
+
+struct EpollTaskScheduler::TimerEntry {
+  int64_t dueTime; // microseconds, on the monotonic clock
+  intptr_t token; // also orders tasks that are due at the same time, in the order they were scheduled
+  TaskFunc* proc;
+  void* clientData;
+  unsigned index; // our position in "fTimers"
+};
+
+static int64_t monotonicNow() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec*MILLION + ts.tv_nsec/1000;
+}
+
+static int epollEvents(int conditionSet) {
+  int events = 0;
+  if (conditionSet&SOCKET_READABLE) events |= EPOLLIN;
+  if (conditionSet&SOCKET_WRITABLE) events |= EPOLLOUT;
+  if (conditionSet&SOCKET_EXCEPTION) events |= EPOLLPRI;
+  return events;
+}
+
+////////// EpollTaskScheduler //////////
+
+EpollTaskScheduler* EpollTaskScheduler::createNew() {
+  EpollTaskScheduler* scheduler = new EpollTaskScheduler();
+  if (scheduler->fEpollFd < 0 || scheduler->fTimerFd < 0 || scheduler->fWakeupFd < 0) {
+    delete scheduler;
+    return NULL;
+  }
+  return scheduler;
+}
+
+EpollTaskScheduler::EpollTaskScheduler()
+  : fEpollFd(-1), fTimerFd(-1), fWakeupFd(-1),
+    fSocketHandlers(NULL), fSocketHandlersSize(0),
+    fNumTimers(0), fMaxTimers(INITIAL_MAX_TIMERS), fTimerTokenCounter(0), fArmedTime(0) {
+  fTimers = new TimerEntry*[fMaxTimers];
+  fTimerTokens = HashTable::create(ONE_WORD_HASH_KEYS);
+
+  fEpollFd = epoll_create1(EPOLL_CLOEXEC);
+  fTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+  fWakeupFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+  if (fEpollFd < 0 || fTimerFd < 0 || fWakeupFd < 0) return;
+
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u64 = EPOLL_DATA_TIMER;
+  epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fTimerFd, &ev);
+  ev.data.u64 = EPOLL_DATA_WAKEUP;
+  epoll_ctl(fEpollFd, EPOLL_CTL_ADD, fWakeupFd, &ev);
+}
+
+EpollTaskScheduler::~EpollTaskScheduler() {
+  for (unsigned i = 0; i < fNumTimers; ++i) delete fTimers[i];
+  delete[] fTimers;
+  delete fTimerTokens;
+  delete[] fSocketHandlers;
+
+  if (fWakeupFd >= 0) close(fWakeupFd);
+  if (fTimerFd >= 0) close(fTimerFd);
+  if (fEpollFd >= 0) close(fEpollFd);
+}
+
+TaskToken EpollTaskScheduler::scheduleDelayedTask(int64_t microseconds,
+						  TaskFunc* proc,
+						  void* clientData) {
+  if (microseconds < 0) microseconds = 0;
+  TimerEntry* timer = new TimerEntry;
+  timer->dueTime = monotonicNow() + microseconds;
+  timer->token = ++fTimerTokenCounter;
+  timer->proc = proc;
+  timer->clientData = clientData;
+  pushTimer(timer);
+  fTimerTokens->Add((char const*)timer->token, timer);
+  return (void*)(timer->token);
+}
+
+void EpollTaskScheduler::unscheduleDelayedTask(TaskToken& prevTask) {
+  TimerEntry* timer = (TimerEntry*)fTimerTokens->Lookup((char const*)prevTask);
+  prevTask = NULL;
+  if (timer == NULL) return; // already handled, or never scheduled
+
+  fTimerTokens->Remove((char const*)timer->token);
+  removeTimer(timer->index);
+  delete timer;
+}
+
+void EpollTaskScheduler::triggerEvent(EventTriggerId eventTriggerId, void* clientData) {
+  BasicTaskScheduler0::triggerEvent(eventTriggerId, clientData);
+
+  // Wake up "epoll_wait()", in case we're being called from an external thread:
+  uint64_t one = 1;
+  if (write(fWakeupFd, &one, sizeof one) < 0) {
+    // The counter can only saturate if nobody is reading it; the loop is awake anyway
+  }
+}
+
+void EpollTaskScheduler::SingleStep(unsigned maxDelayTime) {
+  int timeout = -1; // milliseconds; the timerfd wakes us for delayed tasks
+  if (fTriggersAwaitingHandling != 0) {
+    timeout = 0;
+  } else if (fNumTimers > 0 && fTimers[0]->dueTime <= monotonicNow()) {
+    timeout = 0;
+  } else {
+    armTimer();
+    // "maxDelayTime" is only a polling hint, so millisecond granularity (rounded up) is enough for it:
+    if (maxDelayTime > 0) timeout = (maxDelayTime + 999)/1000;
+  }
+
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+  int numEvents = epoll_wait(fEpollFd, events, MAX_EPOLL_EVENTS, timeout);
+  if (numEvents < 0) {
+    if (errno != EINTR) {
+      // Unexpected error - treat this as fatal:
+      perror("EpollTaskScheduler::SingleStep(): epoll_wait() fails");
+      internalError();
+    }
+    numEvents = 0;
+  }
+
+  // Call the handler of every ready socket.  Unlike "select()", the cost of this does not
+  // depend upon the number of sockets that are being watched:
+  for (int i = 0; i < numEvents; ++i) {
+    uint64_t data = events[i].data.u64;
+    if (data == EPOLL_DATA_TIMER) {
+      uint64_t expirations;
+      if (read(fTimerFd, &expirations, sizeof expirations) < 0) {}
+      fArmedTime = 0;
+      continue;
+    }
+    if (data == EPOLL_DATA_WAKEUP) {
+      uint64_t count;
+      if (read(fWakeupFd, &count, sizeof count) < 0) {}
+      continue;
+    }
+
+    int sock = (int)(uint32_t)data;
+    if (sock >= fSocketHandlersSize) continue;
+    SocketHandler& handler = fSocketHandlers[sock]; // alias
+    if (handler.generation != (u_int32_t)(data >> 32) || handler.handlerProc == NULL) continue; // stale
+
+    int resultConditionSet = 0;
+    if (events[i].events&EPOLLIN) resultConditionSet |= SOCKET_READABLE;
+    if (events[i].events&EPOLLOUT) resultConditionSet |= SOCKET_WRITABLE;
+    if (events[i].events&EPOLLPRI) resultConditionSet |= SOCKET_EXCEPTION;
+    // Like "select()", report errors and hangups as readability/writability, so that the handler sees them:
+    if (events[i].events&(EPOLLERR|EPOLLHUP)) resultConditionSet |= SOCKET_READABLE|SOCKET_WRITABLE;
+    resultConditionSet &= handler.conditionSet;
+    if (resultConditionSet != 0) {
+      fLastHandledSocketNum = sock;
+      (*handler.handlerProc)(handler.clientData, resultConditionSet);
+          // Note: "handler" may no longer be valid here, because the handler function can change socket handling
+    }
+  }
+
+  // Also handle any newly-triggered events (after the socket handlers, as "BasicTaskScheduler" does):
+  if (fTriggersAwaitingHandling != 0) handleTriggeredEvents();
+
+  // Also handle any delayed events that have come due:
+  handleDueTimers();
+}
+
+void EpollTaskScheduler::handleTriggeredEvents() {
+  // Each pass handles (and clears) one trigger; bound the number of passes, in case another thread
+  // keeps triggering events while we're handling them:
+  for (unsigned n = 0; n < MAX_NUM_EVENT_TRIGGERS && fTriggersAwaitingHandling != 0; ++n) {
+    if (fTriggersAwaitingHandling == fLastUsedTriggerMask) {
+      // Common-case optimization for a single event trigger:
+      fTriggersAwaitingHandling = 0;
+      if (fTriggeredEventHandlers[fLastUsedTriggerNum] != NULL) {
+	(*fTriggeredEventHandlers[fLastUsedTriggerNum])(fTriggeredEventClientDatas[fLastUsedTriggerNum]);
+      }
+      continue;
+    }
+
+    // Look for an event trigger that needs handling (making sure that we make forward progress through all possible triggers):
+    unsigned i = fLastUsedTriggerNum;
+    EventTriggerId mask = fLastUsedTriggerMask;
+
+    do {
+      i = (i+1)%MAX_NUM_EVENT_TRIGGERS;
+      mask >>= 1;
+      if (mask == 0) mask = 0x80000000;
+
+      if ((fTriggersAwaitingHandling&mask) != 0) {
+	fTriggersAwaitingHandling &=~ mask;
+	if (fTriggeredEventHandlers[i] != NULL) {
+	  (*fTriggeredEventHandlers[i])(fTriggeredEventClientDatas[i]);
+	}
+
+	fLastUsedTriggerMask = mask;
+	fLastUsedTriggerNum = i;
+	break;
+      }
+    } while (i != fLastUsedTriggerNum);
+  }
+}
+
+void EpollTaskScheduler::handleDueTimers() {
+  if (fNumTimers == 0) return;
+
+  // Handle only the tasks that were already in the heap when we started, so that a task that
+  // keeps rescheduling itself with no delay cannot starve the sockets:
+  int64_t timeNow = monotonicNow();
+  for (unsigned n = fNumTimers; n > 0 && fNumTimers > 0; --n) {
+    TimerEntry* timer = fTimers[0];
+    if (timer->dueTime > timeNow) break;
+
+    // Remove the task first, in case its handler accesses the heap:
+    fTimerTokens->Remove((char const*)timer->token);
+    removeTimer(0);
+    (*timer->proc)(timer->clientData);
+    delete timer;
+  }
+}
+
+void EpollTaskScheduler::armTimer() {
+  if (fNumTimers == 0 || fTimers[0]->dueTime == fArmedTime) return;
+  // (An earlier, already-armed deadline is harmless: we just wake up early, and re-arm.)
+
+  int64_t dueTime = fTimers[0]->dueTime;
+  struct itimerspec its;
+  its.it_interval.tv_sec = its.it_interval.tv_nsec = 0;
+  its.it_value.tv_sec = dueTime/MILLION;
+  its.it_value.tv_nsec = (dueTime%MILLION)*1000;
+  if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) its.it_value.tv_nsec = 1; // 0 would disarm
+  if (timerfd_settime(fTimerFd, TFD_TIMER_ABSTIME, &its, NULL) == 0) fArmedTime = dueTime;
+}
+
+void EpollTaskScheduler::pushTimer(TimerEntry* timer) {
+  if (fNumTimers == fMaxTimers) {
+    TimerEntry** newTimers = new TimerEntry*[2*fMaxTimers];
+    for (unsigned i = 0; i < fNumTimers; ++i) newTimers[i] = fTimers[i];
+    delete[] fTimers;
+    fTimers = newTimers;
+    fMaxTimers *= 2;
+  }
+
+  timer->index = fNumTimers;
+  fTimers[fNumTimers++] = timer;
+  siftUp(timer->index);
+}
+
+void EpollTaskScheduler::removeTimer(unsigned index) {
+  --fNumTimers;
+  if (index == fNumTimers) return; // it was the last entry
+
+  fTimers[index] = fTimers[fNumTimers];
+  fTimers[index]->index = index;
+  siftUp(index);
+  siftDown(fTimers[index]->index);
+}
+
+static inline Boolean timerBefore(int64_t dueTime1, intptr_t token1, int64_t dueTime2, intptr_t token2) {
+  return dueTime1 < dueTime2 || (dueTime1 == dueTime2 && token1 < token2);
+}
+
+void EpollTaskScheduler::siftUp(unsigned index) {
+  TimerEntry* timer = fTimers[index];
+  while (index > 0) {
+    unsigned parent = (index-1)/2;
+    if (!timerBefore(timer->dueTime, timer->token, fTimers[parent]->dueTime, fTimers[parent]->token)) break;
+    fTimers[index] = fTimers[parent];
+    fTimers[index]->index = index;
+    index = parent;
+  }
+  fTimers[index] = timer;
+  timer->index = index;
+}
+
+void EpollTaskScheduler::siftDown(unsigned index) {
+  TimerEntry* timer = fTimers[index];
+  while (1) {
+    unsigned child = 2*index+1;
+    if (child >= fNumTimers) break;
+    if (child+1 < fNumTimers
+	&& timerBefore(fTimers[child+1]->dueTime, fTimers[child+1]->token, fTimers[child]->dueTime, fTimers[child]->token)) {
+      ++child;
+    }
+    if (!timerBefore(fTimers[child]->dueTime, fTimers[child]->token, timer->dueTime, timer->token)) break;
+    fTimers[index] = fTimers[child];
+    fTimers[index]->index = index;
+    index = child;
+  }
+  fTimers[index] = timer;
+  timer->index = index;
+}
+
+void EpollTaskScheduler::growSocketHandlers(int socketNum) {
+  if (socketNum < fSocketHandlersSize) return;
+
+  int newSize = fSocketHandlersSize > 0 ? fSocketHandlersSize : 64;
+  while (newSize <= socketNum) newSize *= 2;
+  SocketHandler* newHandlers = new SocketHandler[newSize];
+  for (int i = 0; i < newSize; ++i) {
+    if (i < fSocketHandlersSize) {
+      newHandlers[i] = fSocketHandlers[i];
+    } else {
+      newHandlers[i].conditionSet = 0;
+      newHandlers[i].handlerProc = NULL;
+      newHandlers[i].clientData = NULL;
+      newHandlers[i].generation = 0;
+    }
+  }
+  delete[] fSocketHandlers;
+  fSocketHandlers = newHandlers;
+  fSocketHandlersSize = newSize;
+}
+
+void EpollTaskScheduler
+  ::setBackgroundHandling(int socketNum, int conditionSet, BackgroundHandlerProc* handlerProc, void* clientData) {
+  if (socketNum < 0) return;
+  if (conditionSet == 0 && socketNum >= fSocketHandlersSize) return; // nothing to clear
+  growSocketHandlers(socketNum);
+
+  SocketHandler& handler = fSocketHandlers[socketNum]; // alias
+  Boolean wasRegistered = handler.conditionSet != 0;
+  ++handler.generation; // invalidates any events that are still pending for the old registration
+
+  if (conditionSet == 0) {
+    // (This fails harmlessly if the socket has already been closed; the kernel then dropped it from the set itself.)
+    if (wasRegistered) epoll_ctl(fEpollFd, EPOLL_CTL_DEL, socketNum, NULL);
+    handler.conditionSet = 0;
+    handler.handlerProc = NULL;
+    handler.clientData = NULL;
+    return;
+  }
+
+  handler.conditionSet = conditionSet;
+  handler.handlerProc = handlerProc;
+  handler.clientData = clientData;
+
+  struct epoll_event ev;
+  ev.events = epollEvents(conditionSet);
+  ev.data.u64 = EPOLL_DATA(socketNum, handler.generation);
+  // Our view of the set can be out of date if a socket was closed (and its number reused)
+  // without its handling being turned off first, so fall back between MOD and ADD:
+  int result = epoll_ctl(fEpollFd, wasRegistered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, socketNum, &ev);
+  if (result < 0 && errno == ENOENT) {
+    result = epoll_ctl(fEpollFd, EPOLL_CTL_ADD, socketNum, &ev);
+  } else if (result < 0 && errno == EEXIST) {
+    result = epoll_ctl(fEpollFd, EPOLL_CTL_MOD, socketNum, &ev);
+  }
+  if (result < 0) {
+    perror("EpollTaskScheduler::setBackgroundHandling(): epoll_ctl() fails");
+  }
+}
+
+void EpollTaskScheduler::moveSocketHandling(int oldSocketNum, int newSocketNum) {
+  if (oldSocketNum < 0 || newSocketNum < 0) return; // sanity check
+  if (oldSocketNum >= fSocketHandlersSize || fSocketHandlers[oldSocketNum].conditionSet == 0) return;
+
+  SocketHandler handler = fSocketHandlers[oldSocketNum];
+  setBackgroundHandling(oldSocketNum, 0, NULL, NULL);
+  setBackgroundHandling(newSocketNum, handler.conditionSet, handler.handlerProc, handler.clientData);
+}
+
+#endif
@@ -83,4 +83,72 @@ private:
 #endif
 };
 
+
+#if defined(__linux__)
+class HashTable; // forward
+
+// A Linux-only alternative to "BasicTaskScheduler" for servers with many sockets and timers:
+// sockets are watched with "epoll" (no FD_SETSIZE limit, O(ready sockets) per wakeup),
+// delayed tasks are kept in a binary heap (O(log n) schedule/unschedule) and fire from a "timerfd",
+// and "triggerEvent()" wakes the loop immediately through an "eventfd" instead of a polling tick.
+// It is selected when the environment is created:
+//     TaskScheduler* scheduler = EpollTaskScheduler::createNew();
+//     UsageEnvironment* env = BasicUsageEnvironment::createNew(*scheduler);
+class EpollTaskScheduler: public BasicTaskScheduler0 {
+public:
+  static EpollTaskScheduler* createNew();
+    // Returns NULL if the kernel objects (epoll, timerfd, eventfd) could not be created.
+  virtual ~EpollTaskScheduler();
+
+  // Redefined virtual functions:
+  virtual TaskToken scheduleDelayedTask(int64_t microseconds, TaskFunc* proc,
+					void* clientData);
+  virtual void unscheduleDelayedTask(TaskToken& prevTask);
+  virtual void triggerEvent(EventTriggerId eventTriggerId, void* clientData = NULL);
+
+protected:
+  EpollTaskScheduler();
+      // called only by "createNew()"
+
+protected:
+  // Redefined virtual functions:
+  virtual void SingleStep(unsigned maxDelayTime);
+
+  virtual void setBackgroundHandling(int socketNum, int conditionSet, BackgroundHandlerProc* handlerProc, void* clientData);
+  virtual void moveSocketHandling(int oldSocketNum, int newSocketNum);
+
+private:
+  struct SocketHandler;
+  struct TimerEntry;
+
+  void growSocketHandlers(int socketNum);
+  void handleTriggeredEvents();
+  void handleDueTimers();
+
+  // Binary min-heap on (due time, token):
+  void pushTimer(TimerEntry* timer);
+  void removeTimer(unsigned index);
+  void siftUp(unsigned index);
+  void siftDown(unsigned index);
+  void armTimer();
+
+private:
+  int fEpollFd;
+  int fTimerFd;
+  int fWakeupFd;
+
+  // Socket handlers, indexed by socket number:
+  SocketHandler* fSocketHandlers;
+  int fSocketHandlersSize;
+
+  // Delayed tasks:
+  TimerEntry** fTimers;
+  unsigned fNumTimers;
+  unsigned fMaxTimers;
+  HashTable* fTimerTokens; // token -> TimerEntry
+  intptr_t fTimerTokenCounter;
+  int64_t fArmedTime; // when "fTimerFd" fires next (0 if disarmed)
+};
+#endif
+
 #endif
@@ -68,6 +68,21 @@ Boolean OutputSocket::write(netAddressBits address, Port port, u_int8_t ttl,
   return True;
 }
 
+Boolean OutputSocket::writeBatch(netAddressBits address, Port port, u_int8_t ttl,
+				 unsigned char* const* buffers, unsigned const* bufferSizes,
+				 unsigned numBuffers) {
+  if (numBuffers == 0) return True;
+  if ((unsigned)ttl != fLastSentTTL || sourcePortNum() == 0) {
+    // Send the first datagram the normal way, to set the TTL (and learn our source port):
+    if (!write(address, port, ttl, buffers[0], bufferSizes[0])) return False;
+    ++buffers; ++bufferSizes; --numBuffers;
+  }
+
+  struct in_addr destAddr; destAddr.s_addr = address;
+  return writeSocketBatch(env(), socketNum(), destAddr, port,
+			  buffers, bufferSizes, numBuffers);
+}
+
 // By default, we don't do reads:
 Boolean OutputSocket
 ::handleRead(unsigned char* /*buffer*/, unsigned /*bufferMaxSize*/,
@@ -101,7 +116,8 @@ Groupsock::Groupsock(UsageEnvironment& env, struct in_addr const& groupAddr,
 		     Port port, u_int8_t ttl)
   : OutputSocket(env, port),
     deleteIfNoMembers(False), isSlave(False),
-    fIncomingGroupEId(groupAddr, port.num(), ttl), fDests(NULL), fTTL(ttl) {
+    fIncomingGroupEId(groupAddr, port.num(), ttl), fDests(NULL), fTTL(ttl),
+    fBatchBuffer(NULL), fBatchBufferUsed(0), fNumBatchPackets(0), fBatchTTL(ttl) {
   addDestination(groupAddr, port);
 
   if (!socketJoinGroup(env, socketNum(), groupAddr.s_addr)) {
@@ -129,7 +145,8 @@ Groupsock::Groupsock(UsageEnvironment& env, struct in_addr const& groupAddr,
   : OutputSocket(env, port),
     deleteIfNoMembers(False), isSlave(False),
     fIncomingGroupEId(groupAddr, sourceFilterAddr, port.num()),
-    fDests(NULL), fTTL(255) {
+    fDests(NULL), fTTL(255),
+    fBatchBuffer(NULL), fBatchBufferUsed(0), fNumBatchPackets(0), fBatchTTL(255) {
   addDestination(groupAddr, port);
 
   // First try a SSM join.  If that fails, try a regular join:
@@ -152,6 +169,8 @@ Groupsock::Groupsock(UsageEnvironment& env, struct in_addr const& groupAddr,
 }
 
 Groupsock::~Groupsock() {
+  flushOutput(env());
+
   if (isSSM()) {
     if (!socketLeaveGroupSSM(env(), socketNum(), groupAddress().s_addr,
 			     sourceFilterAddress().s_addr)) {
@@ -162,6 +181,7 @@ Groupsock::~Groupsock() {
   }
 
   delete fDests;
+  delete[] fBatchBuffer;
 
   if (DebugLevel >= 2) env() << *this << ": deleting\n";
 }
@@ -170,6 +190,7 @@ void
 Groupsock::changeDestinationParameters(struct in_addr const& newDestAddr,
 				       Port newDestPort, int newDestTTL) {
   if (fDests == NULL) return;
+  flushOutput(env());
 
   struct in_addr destAddr = fDests->fGroupEId.groupAddress();
   if (newDestAddr.s_addr != 0) {
@@ -216,6 +237,7 @@ void Groupsock::addDestination(struct in_addr const& addr, Port const& port) {
 }
 
 void Groupsock::removeDestination(struct in_addr const& addr, Port const& port) {
+  flushOutput(env());
   for (destRecord** destsPtr = &fDests; *destsPtr != NULL;
        destsPtr = &((*destsPtr)->fNext)) {
     if (addr.s_addr == (*destsPtr)->fGroupEId.groupAddress().s_addr
@@ -231,6 +253,7 @@ void Groupsock::removeDestination(struct in_addr const& addr, Port const& port)
 }
 
 void Groupsock::removeAllDestinations() {
+  flushOutput(env());
   delete fDests; fDests = NULL;
 }
 
@@ -248,6 +271,9 @@ void Groupsock::multicastSendOnly() {
 Boolean Groupsock::output(UsageEnvironment& env, u_int8_t ttlToSend,
 			  unsigned char* buffer, unsigned bufferSize,
 			  DirectedNetInterface* interfaceNotToFwdBackTo) {
+  // Don't let this datagram overtake any that are still queued:
+  if (fNumBatchPackets > 0 && !flushOutput(env)) return False;
+
   do {
     // First, do the datagram send, to each destination:
     Boolean writeSuccess = True;
@@ -289,6 +315,59 @@ Boolean Groupsock::output(UsageEnvironment& env, u_int8_t ttlToSend,
   return False;
 }
 
+Boolean Groupsock::outputBatched(UsageEnvironment& env, u_int8_t ttlToSend,
+				 unsigned char* buffer, unsigned bufferSize) {
+  if (!members().IsEmpty() || DebugLevel >= 3 || bufferSize > GROUPSOCK_BATCH_BUFFER_SIZE) {
+    // Relaying (or tracing) is done per datagram, so send this one now:
+    return output(env, ttlToSend, buffer, bufferSize);
+  }
+
+  if (fNumBatchPackets > 0
+      && (fNumBatchPackets == GROUPSOCK_MAX_BATCH_PACKETS || ttlToSend != fBatchTTL
+	  || fBatchBufferUsed + bufferSize > GROUPSOCK_BATCH_BUFFER_SIZE)) {
+    if (!flushOutput(env)) return False;
+  }
+
+  if (fBatchBuffer == NULL) fBatchBuffer = new unsigned char[GROUPSOCK_BATCH_BUFFER_SIZE];
+  memcpy(&fBatchBuffer[fBatchBufferUsed], buffer, bufferSize);
+  fBatchPackets[fNumBatchPackets] = &fBatchBuffer[fBatchBufferUsed];
+  fBatchPacketSizes[fNumBatchPackets] = bufferSize;
+  fBatchBufferUsed += bufferSize;
+  ++fNumBatchPackets;
+  fBatchTTL = ttlToSend;
+
+  return True;
+}
+
+Boolean Groupsock::flushOutput(UsageEnvironment& env) {
+  if (fNumBatchPackets == 0) return True;
+
+  unsigned const numPackets = fNumBatchPackets;
+  fNumBatchPackets = 0;
+  fBatchBufferUsed = 0; // the datagrams stay in place until the next "outputBatched()"
+
+  Boolean writeSuccess = True;
+  for (destRecord* dests = fDests; dests != NULL; dests = dests->fNext) {
+    if (!writeBatch(dests->fGroupEId.groupAddress().s_addr, dests->fPort, fBatchTTL,
+		    fBatchPackets, fBatchPacketSizes, numPackets)) {
+      writeSuccess = False;
+      break;
+    }
+  }
+  if (!writeSuccess) {
+    if (DebugLevel >= 0) { // this is a fatal error
+      env.setResultMsg("Groupsock write failed: ", env.getResultMsg());
+    }
+    return False;
+  }
+
+  for (unsigned i = 0; i < numPackets; ++i) {
+    statsOutgoing.countPacket(fBatchPacketSizes[i]);
+    statsGroupOutgoing.countPacket(fBatchPacketSizes[i]);
+  }
+  return True;
+}
+
 Boolean Groupsock::handleRead(unsigned char* buffer, unsigned bufferMaxSize,
 			      unsigned& bytesRead,
 			      struct sockaddr_in& fromAddress) {
@@ -352,6 +352,117 @@ Boolean writeSocket(UsageEnvironment& env,
   return False;
 }
 
+#if defined(__linux__) && !defined(__ANDROID__)
+#include <sys/uio.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103 // from <linux/udp.h>; older C libraries don't define it
+#endif
+
+#define MAX_BATCH_DATAGRAMS 64 // per "sendmmsg()" call; also the kernel's "UDP_MAX_SEGMENTS"
+#define MAX_SEGMENTED_MESSAGE_SIZE 65000 // keep below the 64 kB IP datagram limit
+
+// Set once a "UDP_SEGMENT" send has failed, so that we don't try segmentation again:
+static Boolean udpSegmentationUnavailable = False;
+
+Boolean writeSocketBatch(UsageEnvironment& env,
+			 int socket, struct in_addr address, Port port,
+			 unsigned char* const* buffers, unsigned const* bufferSizes,
+			 unsigned numBuffers) {
+  MAKE_SOCKADDR_IN(dest, address.s_addr, port.num());
+  // Segmented datagrams aren't looped back to local multicast receivers, so segment only unicast:
+  Boolean const segment = !udpSegmentationUnavailable && !IsMulticastAddress(address.s_addr);
+
+  while (numBuffers > 0) {
+    unsigned const numToSend = numBuffers < MAX_BATCH_DATAGRAMS ? numBuffers : MAX_BATCH_DATAGRAMS;
+    struct mmsghdr msgs[MAX_BATCH_DATAGRAMS];
+    struct iovec iovs[MAX_BATCH_DATAGRAMS];
+    unsigned firstBuffer[MAX_BATCH_DATAGRAMS+1];
+    union {
+      char buf[CMSG_SPACE(sizeof (u_int16_t))];
+      struct cmsghdr align;
+    } controls[MAX_BATCH_DATAGRAMS];
+    Boolean segmented = False;
+
+    // Build one message per datagram - or, with segmentation, per run of equal-sized datagrams
+    // (the last one in a run may be shorter):
+    unsigned numMsgs = 0, i = 0;
+    while (i < numToSend) {
+      unsigned const segmentSize = bufferSizes[i];
+      unsigned numSegments = 1, messageSize = segmentSize;
+      if (segment && !udpSegmentationUnavailable) {
+	while (i + numSegments < numToSend
+	       && bufferSizes[i+numSegments] <= segmentSize
+	       && messageSize + bufferSizes[i+numSegments] <= MAX_SEGMENTED_MESSAGE_SIZE) {
+	  messageSize += bufferSizes[i+numSegments];
+	  if (bufferSizes[i+numSegments++] < segmentSize) break;
+	}
+      }
+
+      struct msghdr& msg = msgs[numMsgs].msg_hdr;
+      memset(&msg, 0, sizeof msg);
+      msg.msg_name = &dest;
+      msg.msg_namelen = sizeof dest;
+      msg.msg_iov = &iovs[i];
+      msg.msg_iovlen = numSegments;
+      for (unsigned j = 0; j < numSegments; ++j) {
+	iovs[i+j].iov_base = buffers[i+j];
+	iovs[i+j].iov_len = bufferSizes[i+j];
+      }
+      if (numSegments > 1) {
+	msg.msg_control = controls[numMsgs].buf;
+	msg.msg_controllen = sizeof controls[numMsgs].buf;
+	struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+	cm->cmsg_level = IPPROTO_UDP;
+	cm->cmsg_type = UDP_SEGMENT;
+	cm->cmsg_len = CMSG_LEN(sizeof (u_int16_t));
+	u_int16_t gsoSize = (u_int16_t)segmentSize;
+	memcpy(CMSG_DATA(cm), &gsoSize, sizeof gsoSize);
+	segmented = True;
+      }
+      firstBuffer[numMsgs++] = i;
+      i += numSegments;
+    }
+    firstBuffer[numMsgs] = i;
+
+    unsigned numSent = 0;
+    while (numSent < numMsgs) {
+      int result = sendmmsg(socket, &msgs[numSent], numMsgs - numSent, 0);
+      if (result <= 0) {
+	int err = env.getErrno();
+	if (segmented && (err == EIO || err == EINVAL || err == ENOPROTOOPT || err == EOPNOTSUPP)) {
+	  // The kernel (or the outgoing interface) can't segment; resend the rest without it:
+	  udpSegmentationUnavailable = True;
+	  break;
+	}
+	char tmpBuf[100];
+	sprintf(tmpBuf, "writeSocketBatch(%d), sendmmsg() error: ", socket);
+	socketErr(env, tmpBuf);
+	return False;
+      }
+      numSent += result;
+    }
+
+    unsigned numBuffersSent = firstBuffer[numSent];
+    buffers += numBuffersSent;
+    bufferSizes += numBuffersSent;
+    numBuffers -= numBuffersSent;
+  }
+
+  return True;
+}
+#else
+Boolean writeSocketBatch(UsageEnvironment& env,
+			 int socket, struct in_addr address, Port port,
+			 unsigned char* const* buffers, unsigned const* bufferSizes,
+			 unsigned numBuffers) {
+  for (unsigned i = 0; i < numBuffers; ++i) {
+    if (!writeSocket(env, socket, address, port, buffers[i], bufferSizes[i])) return False;
+  }
+
+  return True;
+}
+#endif
+
 static unsigned getBufferSize(UsageEnvironment& env, int bufOptName,
 			      int socket) {
   unsigned curSize;
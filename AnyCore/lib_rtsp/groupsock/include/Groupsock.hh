@@ -43,6 +43,9 @@ public:
 
   Boolean write(netAddressBits address, Port port, u_int8_t ttl,
 		unsigned char* buffer, unsigned bufferSize);
+  Boolean writeBatch(netAddressBits address, Port port, u_int8_t ttl,
+		     unsigned char* const* buffers, unsigned const* bufferSizes,
+		     unsigned numBuffers);
 
 protected:
   OutputSocket(UsageEnvironment& env, Port port);
@@ -71,6 +74,10 @@ public:
   Port fPort;
 };
 
+// The maximum number of datagrams (and bytes) that "Groupsock::outputBatched()" queues before sending:
+#define GROUPSOCK_MAX_BATCH_PACKETS 64
+#define GROUPSOCK_BATCH_BUFFER_SIZE (GROUPSOCK_MAX_BATCH_PACKETS*1500)
+
 // A "Groupsock" is used to both send and receive packets.
 // As the name suggests, it was originally designed to send/receive
 // multicast, but it can send/receive unicast as well.
@@ -120,6 +127,14 @@ public:
 		 unsigned char* buffer, unsigned bufferSize,
 		 DirectedNetInterface* interfaceNotToFwdBackTo = NULL);
 
+  // Like "output()", but the datagram is copied into a queue, and sent - to every destination -
+  // (together with the other queued datagrams) only by "flushOutput()" (or when the queue fills up).
+  // This lets a sender hand the packets of a whole frame (or of several frames) to the kernel
+  // with one system call per destination.  (Any call to "output()" flushes the queue first.)
+  Boolean outputBatched(UsageEnvironment& env, u_int8_t ttl,
+			unsigned char* buffer, unsigned bufferSize);
+  Boolean flushOutput(UsageEnvironment& env);
+
   DirectedNetInterfaceSet& members() { return fMembers; }
 
   Boolean deleteIfNoMembers;
@@ -153,6 +168,14 @@ private:
   destRecord* fDests;
   u_int8_t fTTL;
   DirectedNetInterfaceSet fMembers;
+
+  // Datagrams queued by "outputBatched()":
+  unsigned char* fBatchBuffer; // allocated on first use
+  unsigned fBatchBufferUsed;
+  unsigned char* fBatchPackets[GROUPSOCK_MAX_BATCH_PACKETS];
+  unsigned fBatchPacketSizes[GROUPSOCK_MAX_BATCH_PACKETS];
+  unsigned fNumBatchPackets;
+  u_int8_t fBatchTTL;
 };
 
 UsageEnvironment& operator<<(UsageEnvironment& s, const Groupsock& g);
@@ -43,6 +43,15 @@ Boolean writeSocket(UsageEnvironment& env,
 		    unsigned char* buffer, unsigned bufferSize);
     // An optimized version of "writeSocket" that omits the "setsockopt()" call to set the TTL.
 
+Boolean writeSocketBatch(UsageEnvironment& env,
+			 int socket, struct in_addr address, Port port,
+			 unsigned char* const* buffers, unsigned const* bufferSizes,
+			 unsigned numBuffers);
+    // Sends several datagrams to the same destination, in order (and - like the optimized "writeSocket()" -
+    // without setting the TTL).  On Linux, this is done with a single "sendmmsg()" system call, and runs of
+    // equal-sized datagrams are further coalesced with UDP generic segmentation offload ("UDP_SEGMENT")
+    // if the kernel supports it.  Elsewhere, it falls back to calling "writeSocket()" for each datagram.
+
 unsigned getSendBufferSize(UsageEnvironment& env, int socket);
 unsigned getReceiveBufferSize(UsageEnvironment& env, int socket);
 unsigned setSendBufferTo(UsageEnvironment& env,
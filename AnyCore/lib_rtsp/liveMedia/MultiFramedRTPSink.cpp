@@ -43,7 +43,7 @@ MultiFramedRTPSink::MultiFramedRTPSink(UsageEnvironment& env,
   : RTPSink(env, rtpGS, rtpPayloadType, rtpTimestampFrequency,
 	    rtpPayloadFormatName, numChannels),
     fOutBuf(NULL), fCurFragmentationOffset(0), fPreviousFrameEndedFragmentation(False),
-    fOnSendErrorFunc(NULL), fOnSendErrorData(NULL) {
+    fFrameDeliveredFlag(NULL), fOnSendErrorFunc(NULL), fOnSendErrorData(NULL) {
   setPacketSizes(1000, 1448);
       // Default max packet size (1500, minus allowance for IP, UDP, UMTP headers)
       // (Also, make it a multiple of 4 bytes, just in case that matters.)
@@ -154,6 +154,7 @@ Boolean MultiFramedRTPSink::continuePlaying() {
 }
 
 void MultiFramedRTPSink::stopPlaying() {
+  flushPackets();
   fOutBuf->resetPacketStart();
   fOutBuf->resetOffset();
   fOutBuf->resetOverflowData();
@@ -212,8 +213,17 @@ void MultiFramedRTPSink::packFrame() {
     fOutBuf->skipBytes(fCurFrameSpecificHeaderSize);
     fTotalFrameSpecificHeaderSizes += fCurFrameSpecificHeaderSize;
 
+    // Note whether the source delivers the frame (or closes) before "getNextFrame()" returns.
+    // (We use a flag on the stack, because in the latter case we may have been deleted.)
+    Boolean frameDelivered = False;
+    fFrameDeliveredFlag = &frameDelivered;
     fSource->getNextFrame(fOutBuf->curPtr(), fOutBuf->totalBytesAvailable(),
 			  afterGettingFrame, this, ourHandleClosure, this);
+    if (!frameDelivered) {
+      // The frame will arrive later, so don't hold back the packets that we've already queued:
+      fFrameDeliveredFlag = NULL;
+      flushPackets();
+    }
   }
 }
 
@@ -231,6 +241,11 @@ void MultiFramedRTPSink
 ::afterGettingFrame1(unsigned frameSize, unsigned numTruncatedBytes,
 		     struct timeval presentationTime,
 		     unsigned durationInMicroseconds) {
+  if (fFrameDeliveredFlag != NULL) {
+    *fFrameDeliveredFlag = True;
+    fFrameDeliveredFlag = NULL;
+  }
+
   if (fIsFirstPacket) {
     // Record the fact that we're starting to play now:
     gettimeofday(&fNextSendTime, NULL);
@@ -360,7 +375,9 @@ void MultiFramedRTPSink::sendPacketIfNecessary() {
 #ifdef TEST_LOSS
     if ((our_random()%10) != 0) // simulate 10% packet loss #####
 #endif
-      if (!fRTPInterface.sendPacket(fOutBuf->packet(), fOutBuf->curPacketSize())) {
+      // Queue the packet; it's sent - together with any others that follow it without a delay -
+      // by "flushPackets()":
+      if (!fRTPInterface.queuePacket(fOutBuf->packet(), fOutBuf->curPacketSize())) {
 	// if failure handler has been specified, call it
 	if (fOnSendErrorFunc != NULL) (*fOnSendErrorFunc)(fOnSendErrorData);
       }
@@ -390,6 +407,7 @@ void MultiFramedRTPSink::sendPacketIfNecessary() {
 
   if (fNoFramesLeft) {
     // We're done:
+    flushPackets();
     onSourceClosure();
   } else {
     // We have more frames left to send.  Figure out when the next frame
@@ -403,11 +421,21 @@ void MultiFramedRTPSink::sendPacketIfNecessary() {
       uSecondsToGo = 0;
     }
 
+    // Send what we've queued now, unless the next packet follows immediately:
+    if (uSecondsToGo > 0) flushPackets();
+
     // Delay this amount of time:
     nextTask() = envir().taskScheduler().scheduleDelayedTask(uSecondsToGo, (TaskFunc*)sendNext, this);
   }
 }
 
+void MultiFramedRTPSink::flushPackets() {
+  if (!fRTPInterface.flushPackets()) {
+    // if failure handler has been specified, call it
+    if (fOnSendErrorFunc != NULL) (*fOnSendErrorFunc)(fOnSendErrorData);
+  }
+}
+
 // The following is called after each delay between packet sends:
 void MultiFramedRTPSink::sendNext(void* firstArg) {
   MultiFramedRTPSink* sink = (MultiFramedRTPSink*)firstArg;
@@ -416,6 +444,10 @@ void MultiFramedRTPSink::sendNext(void* firstArg) {
 
 void MultiFramedRTPSink::ourHandleClosure(void* clientData) {
   MultiFramedRTPSink* sink = (MultiFramedRTPSink*)clientData;
+  if (sink->fFrameDeliveredFlag != NULL) {
+    *sink->fFrameDeliveredFlag = True;
+    sink->fFrameDeliveredFlag = NULL;
+  }
   // There are no frames left, but we may have a partially built packet
   //  to send
   sink->fNoFramesLeft = True;
@@ -215,6 +215,30 @@ Boolean RTPInterface::sendPacket(unsigned char* packet, unsigned packetSize) {
   if (!fGS->output(envir(), fGS->ttl(), packet, packetSize)) success = False;
 
   // Also, send over each of our TCP sockets:
+  if (!sendPacketOverTCPStreams(packet, packetSize)) success = False;
+
+  return success;
+}
+
+Boolean RTPInterface::queuePacket(unsigned char* packet, unsigned packetSize) {
+  Boolean success = True; // we'll return False instead if any of the sends fail
+
+  // Queue the UDP packet (it's sent by "flushPackets()"):
+  if (!fGS->outputBatched(envir(), fGS->ttl(), packet, packetSize)) success = False;
+
+  // Also, send over each of our TCP sockets:
+  if (!sendPacketOverTCPStreams(packet, packetSize)) success = False;
+
+  return success;
+}
+
+Boolean RTPInterface::flushPackets() {
+  return fGS->flushOutput(envir());
+}
+
+Boolean RTPInterface::sendPacketOverTCPStreams(unsigned char* packet, unsigned packetSize) {
+  Boolean success = True; // we'll return False instead if any of the sends fail
+
   tcpStreamRecord* nextStream;
   for (tcpStreamRecord* stream = fTCPStreams; stream != NULL; stream = nextStream) {
     nextStream = stream->fNext; // Set this now, in case the following deletes "stream":
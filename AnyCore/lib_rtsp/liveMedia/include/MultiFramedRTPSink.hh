@@ -101,6 +101,7 @@ private:
   void buildAndSendPacket(Boolean isFirstPacket);
   void packFrame();
   void sendPacketIfNecessary();
+  void flushPackets();
   static void sendNext(void* firstArg);
   friend void sendNext(void*);
 
@@ -132,6 +133,7 @@ private:
   unsigned fCurFrameSpecificHeaderSize; // size in bytes of cur frame-specific header
   unsigned fTotalFrameSpecificHeaderSizes; // size of all frame-specific hdrs in pkt
   unsigned fOurMaxPacketSize;
+  Boolean* fFrameDeliveredFlag; // set while "packFrame()" is inside "getNextFrame()"
 
   onSendErrorFunc* fOnSendErrorFunc;
   void* fOnSendErrorData;
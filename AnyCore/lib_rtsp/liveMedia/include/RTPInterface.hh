@@ -67,6 +67,11 @@ public:
   static void clearServerRequestAlternativeByteHandler(UsageEnvironment& env, int socketNum);
 
   Boolean sendPacket(unsigned char* packet, unsigned packetSize);
+  Boolean queuePacket(unsigned char* packet, unsigned packetSize);
+      // Like "sendPacket()", except that the UDP datagram is only queued in our "Groupsock";
+      // it's sent - with any others queued before it - by "flushPackets()".
+      // (Packets for RTP-over-TCP streams are still sent immediately.)
+  Boolean flushPackets();
   void startNetworkReading(TaskScheduler::BackgroundHandlerProc*
                            handlerProc);
   Boolean handleRead(unsigned char* buffer, unsigned bufferMaxSize,
@@ -90,6 +95,7 @@ public:
   }
 
 private:
+  Boolean sendPacketOverTCPStreams(unsigned char* packet, unsigned packetSize);
   // Helper functions for sending a RTP or RTCP packet over a TCP connection:
   Boolean sendRTPorRTCPPacketOverTCP(unsigned char* packet, unsigned packetSize,
 				     int socketNum, unsigned char streamChannelId);
@@ -23,10 +23,28 @@
 
 // the AAC Encoder handler.
 typedef void* aac_enc_t;
+// One aac frame encoded by aac_encoder_encode_frames.
+typedef struct aac_enc_frame_t
+{
+	unsigned int offset;	// Offset of the frame in outbuf
+	unsigned int size;
+	long long pts;			// First sample of the frame, in samples per channel since open
+} aac_enc_frame_t;
 // @AnyRTC Interface
 PLUGIN_AAC_API aac_enc_t aac_encoder_open(unsigned char ucAudioChannel, unsigned int u32AudioSamplerate, unsigned int u32PCMBitSize, bool mp4);
 PLUGIN_AAC_API void aac_encoder_close(void*pHandle);
+// Samples per channel of a frame, and the max bytes of an encoded frame.
+PLUGIN_AAC_API int aac_encoder_get_info(void*pHandle, unsigned int* frameSamples, unsigned int* maxFrameBytes);
+// Encode at most one frame, the rest short of a frame is kept for the next call,
+// the pcm from a second frame on is dropped.
 PLUGIN_AAC_API int aac_encoder_encode_frame(void*pHandle, unsigned char* inbuf, unsigned int inlen, unsigned char* outbuf, unsigned int* outlen);
+// Encode any amount of pcm, the frames are written back to back in outbuf.
+// Stops early when outbuf or frames may overflow, *inused tells the pcm consumed.
+// Return the frames encoded, or -1 on error.
+PLUGIN_AAC_API int aac_encoder_encode_frames(void*pHandle, const unsigned char* inbuf, unsigned int inlen, unsigned int* inused,
+	unsigned char* outbuf, unsigned int outsize, aac_enc_frame_t* frames, int maxFrames);
+// Pre-process 16bit pcm in place: mute, or a soft noise gate then gain in Q12 (4096 = 1.0).
+PLUGIN_AAC_API void aac_pcm_process(short* pcm, unsigned int samples, int gainQ12, short gate, bool mute);
 
 // the AAC Decoder handler.
 typedef void* aac_dec_t;
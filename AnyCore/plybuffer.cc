@@ -17,28 +17,115 @@
 * See the GNU LICENSE file for more info.
 */
 #include "plybuffer.h"
+#include <algorithm>
 #include "webrtc/base/logging.h"
 
 #define PLY_MIN_TIME	500		// 0.5s
 #define PLY_MAX_TIME	600000		// 10minute
 #define PLY_RED_TIME	250		// redundancy time
 #define PLY_MAX_DELAY	1000		// 1 second
-#define PLY_MAX_CACHE   16      	// 16s
+#define PLY_MAX_TARGET	5000		// Default max target delay
+#define PLY_CATCHUP_TIME	200		// Speed up when buffered over target + this
+#define PLY_DROP_TIME	2000		// Drop to target when buffered over target + this
+#define PLY_CATCHUP_RATE	10		// Play 1 more 10ms packet every 10, 10% faster
+#define PLY_JITTER_WINDOW	512		// Packets, about 10s of audio
+#define PLY_JITTER_PERCENT	95		// Percentile of the jitter to absorb
+#define PLY_JITTER_INTERVAL	1000	// Estimate once every second
+#define PLY_JITTER_RESET	60000	// Transit jump of the stream time, restart the estimate
+#define PLY_AUDIO_QUEUE	8192		// 10ms pcm packets, 80s
+#define PLY_VIDEO_QUEUE	2048		// Video frames, 68s at 30fps
+
+#define PLY_MAX_WAIT	100		// Max ms between two wakeups
+#define PLY_MIN_WAIT	1
 
 #define PB_TICK	1011
 
+enum {
+	PW_None = 0,
+	PW_Video,		//	Video packet is due
+	PW_Any,			//	Any packet may change the state
+};
+
+PlyJitter::PlyJitter()
+	: pos_(0)
+	, got_base_(false)
+	, base_transit_(0)
+	, next_estimate_(0)
+	, jitter_(0)
+{
+	samples_.reserve(PLY_JITTER_WINDOW);
+	sorted_.reserve(PLY_JITTER_WINDOW);
+}
+
+void PlyJitter::Reset()
+{
+	samples_.clear();
+	pos_ = 0;
+	got_base_ = false;
+	next_estimate_ = 0;
+}
+
+void PlyJitter::Update(uint32_t dts, uint32_t now)
+{
+	//* Transit relative to the first packet, sender and receiver clocks are unrelated.
+	uint32_t transit = now - dts;
+	if (!got_base_) {
+		got_base_ = true;
+		base_transit_ = transit;
+		next_estimate_ = now + PLY_JITTER_INTERVAL;
+	}
+	int sample = (int)(transit - base_transit_);
+	if (sample > PLY_JITTER_RESET || sample < -PLY_JITTER_RESET) {
+		LOG(LS_INFO) << "PlyJitter stream time jumped: " << sample << "ms, restart";
+		Reset();
+		Update(dts, now);
+		return;
+	}
+	if (samples_.size() < PLY_JITTER_WINDOW) {
+		samples_.push_back(sample);
+	}
+	else {
+		samples_[pos_] = sample;
+		pos_ = (pos_ + 1) % PLY_JITTER_WINDOW;
+	}
+
+	if ((int)(now - next_estimate_) < 0)
+		return;
+	next_estimate_ = now + PLY_JITTER_INTERVAL;
+	sorted_.assign(samples_.begin(), samples_.end());
+	int min_transit = *std::min_element(sorted_.begin(), sorted_.end());
+	std::vector<int>::iterator nth = sorted_.begin() + (sorted_.size() - 1) * PLY_JITTER_PERCENT / 100;
+	std::nth_element(sorted_.begin(), nth, sorted_.end());
+	jitter_ = *nth - min_transit;
+}
+
+//===================================================
+//* PlyBuffer
 PlyBuffer::PlyBuffer(PlyBufferCallback&callback, rtc::Thread*worker)
 	: callback_(callback)
 	, worker_thread_(NULL)
 	, got_audio_(false)
-	, cache_time_(1000)	// default 1000ms(1s)
-	, cache_delta_(1)
+	, cache_time_(PLY_MAX_TARGET)
     , buf_cache_time_(0)
+	, target_delay_(PLY_MIN_TIME)
+	, min_delay_(0)
+	, min_delay_cur_(-1)
+	, min_delay_time_(0)
+	, catchup_(PC_None)
+	, catchup_count_(0)
+	, catchup_remain_(0)
+	, last_decode_time_(0)
+	, last_pcm_dts_(0)
+	, wait_data_(PW_Any)
 	, ply_status_(PS_Fast)
 	, sys_fast_video_time_(0)
 	, rtmp_fast_video_time_(0)
-	, rtmp_cache_time_(0)
+	, cache_start_time_(0)
 	, play_cur_time_(0)
+	, audio_first_dts_(0)
+	, audio_back_dts_(0)
+	, que_audio_buffer_(PLY_AUDIO_QUEUE)
+	, que_video_buffer_(PLY_VIDEO_QUEUE)
 {
 	ASSERT(worker != NULL);
 	worker_thread_ = worker;
@@ -48,76 +135,135 @@ PlyBuffer::PlyBuffer(PlyBufferCallback&callback, rtc::Thread*worker)
 
 PlyBuffer::~PlyBuffer()
 {
-	std::list<PlyPacket*>::iterator iter = lst_audio_buffer_.begin();
-	while (iter != lst_audio_buffer_.end()) {
-		PlyPacket* pkt = *iter;
-		lst_audio_buffer_.erase(iter++);
+	PlyPacket* pkt = NULL;
+	while (que_audio_buffer_.Pop(&pkt))
 		delete pkt;
-	}
-	iter = lst_video_buffer_.begin();
-	while (iter != lst_video_buffer_.end()) {
-		PlyPacket* pkt = *iter;
-		lst_video_buffer_.erase(iter++);
+	while (que_video_buffer_.Pop(&pkt))
 		delete pkt;
-	}
 }
 
 void PlyBuffer::SetCacheSize(int miliseconds/*ms*/)
 {
-	if (miliseconds > 500 && miliseconds <= 600000) {	//* 0.5s ~ 10 minute
+	//* Upper bound of the target delay, the jitter decides the real one.
+	if (miliseconds > PLY_MIN_TIME && miliseconds <= PLY_MAX_TIME) {	//* 0.5s ~ 10 minute
 		cache_time_ = miliseconds;
 	}
 }
 int PlyBuffer::GetPlayAudio(void* audioSamples)
 {
 	int ret = 0;
-	rtc::CritScope cs(&cs_list_audio_);
-	if (lst_audio_buffer_.size() > 0) {
-		PlyPacket* pkt_front = lst_audio_buffer_.front();
+	PlyPacket* pkt_front = NULL;
+	if (que_audio_buffer_.Pop(&pkt_front)) {
 		ret = pkt_front->_data_len;
-		play_cur_time_ = pkt_front->_dts;
+		rtc::AtomicOps::ReleaseStore(&play_cur_time_, (int)pkt_front->_dts);
 		memcpy(audioSamples, pkt_front->_data, pkt_front->_data_len);
-		lst_audio_buffer_.pop_front();
 		delete pkt_front;
 	}
+	else {
+		return ret;
+	}
+
+	PlyCatchup catchup = (PlyCatchup)rtc::AtomicOps::AcquireLoad(&catchup_);
+	if (catchup == PC_Drop) {
+		//* Far behind, jump to the target delay instead of playing it all.
+		uint32_t back_dts = (uint32_t)rtc::AtomicOps::AcquireLoad(&audio_back_dts_);
+		int target_delay = rtc::AtomicOps::AcquireLoad(&target_delay_);
+		PlyPacket** pkt_next = que_audio_buffer_.Front();
+		while (pkt_next != NULL && (int)(back_dts - (*pkt_next)->_dts) > target_delay) {
+			que_audio_buffer_.Pop(&pkt_front);
+			rtc::AtomicOps::ReleaseStore(&play_cur_time_, (int)pkt_front->_dts);
+			delete pkt_front;
+			pkt_next = que_audio_buffer_.Front();
+		}
+	}
+	else if (catchup == PC_Speed) {
+		if (++catchup_count_ >= PLY_CATCHUP_RATE) {
+			//* Play 20ms in 10ms: cross fade this packet into the next one.
+			PlyPacket** pkt_next = que_audio_buffer_.Front();
+			if (pkt_next != NULL && (*pkt_next)->_data_len == ret) {
+				int16_t* dst = (int16_t*)audioSamples;
+				const int16_t* src = (const int16_t*)(*pkt_next)->_data;
+				int samples = ret / sizeof(int16_t);
+				for (int i = 0; i < samples; i++) {
+					dst[i] = (int16_t)((dst[i] * (samples - i) + src[i] * i) / samples);
+				}
+				que_audio_buffer_.Pop(&pkt_front);
+				rtc::AtomicOps::ReleaseStore(&play_cur_time_, (int)pkt_front->_dts);
+				delete pkt_front;
+			}
+			catchup_count_ = 0;
+		}
+	}
 
 	return ret;
 }
-void PlyBuffer::CacheH264Data(const uint8_t*pdata, int len, uint32_t ts)
+void PlyBuffer::CacheH264Data(DemuxFrame* frame, uint32_t ts)
 {
 	PlyPacket* pkt = new PlyPacket(true);
-	pkt->SetData(pdata, len, ts);
+	pkt->SetFrame(frame, ts);
+	if (!got_audio_)
+		jitter_.Update(ts, rtc::Time());
 	if (sys_fast_video_time_ == 0)
 	{
 		sys_fast_video_time_ = rtc::Time();
 		rtmp_fast_video_time_ = ts;
 	}
-	rtc::CritScope cs(&cs_list_video_);
-	lst_video_buffer_.push_back(pkt);
+	if (!que_video_buffer_.Push(&pkt)) {
+		LOG(LS_WARNING) << "PlyBuffer video queue is full, drop frame ts: " << ts;
+		delete pkt;
+		return;
+	}
+	WakeOnData(true);
 }
 
 void PlyBuffer::CachePcmData(const uint8_t*pdata, int len, uint32_t ts)
 {
 	PlyPacket* pkt = new PlyPacket(false);
 	pkt->SetData(pdata, len, ts);
-	rtc::CritScope cs(&cs_list_audio_);
-	got_audio_ = true;
-	lst_audio_buffer_.push_back(pkt);
+	if (!que_audio_buffer_.Push(&pkt)) {
+		LOG(LS_WARNING) << "PlyBuffer audio queue is full, drop pcm ts: " << ts;
+		delete pkt;
+		return;
+	}
+	if (!got_audio_) {
+		audio_first_dts_ = ts;
+		got_audio_ = true;
+	}
+	rtc::AtomicOps::ReleaseStore(&audio_back_dts_, (int)ts);
+	if (ts != last_pcm_dts_) {
+		//* One aac frame is cached as several 10ms packets of the same ts.
+		last_pcm_dts_ = ts;
+		jitter_.Update(ts, rtc::Time());
+	}
 	if (sys_fast_video_time_ == 0) {
-		PlyPacket* pkt_front = lst_audio_buffer_.front();
-		PlyPacket* pkt_back = lst_audio_buffer_.back();
-		if ((pkt_back->_dts - pkt_front->_dts) >= PLY_MAX_DELAY) {
+		//* Nothing is played before sys_fast_video_time_ is set, the first packet is the front.
+		if ((ts - audio_first_dts_) >= PLY_MAX_DELAY) {
 			sys_fast_video_time_ = rtc::Time();
 			rtmp_fast_video_time_ = ts;
 		}
 	}
+	WakeOnData(false);
+}
+
+void PlyBuffer::WakeOnData(bool video)
+{
+	//* Only the first packet after the worker goes to wait posts a tick.
+	if (rtc::AtomicOps::CompareAndSwap(&wait_data_, PW_Any, PW_None) == PW_Any ||
+		(video && rtc::AtomicOps::CompareAndSwap(&wait_data_, PW_Video, PW_None) == PW_Video)) {
+		worker_thread_->Post(RTC_FROM_HERE, this, PB_TICK);
+	}
 }
 
 void PlyBuffer::OnMessage(rtc::Message* msg)
 {
 	if (msg->message_id == PB_TICK) {
-		DoDecode();
-		worker_thread_->PostDelayed(RTC_FROM_HERE, 5, this, PB_TICK);
+		//* Woken either by the timer or by data, keep one tick pending.
+		worker_thread_->Clear(this, PB_TICK);
+		rtc::AtomicOps::ReleaseStore(&wait_data_, PW_None);
+		int delay = DoDecode();
+		if (delay < PLY_MIN_WAIT)
+			delay = PLY_MIN_WAIT;
+		worker_thread_->PostDelayed(RTC_FROM_HERE, delay, this, PB_TICK);
 	}
 }
 
@@ -126,119 +272,183 @@ int	PlyBuffer::GetCacheTime()
 	return cache_time_;
 }
 
-void PlyBuffer::DoDecode()
+uint32_t PlyBuffer::GetAudioBufTime()
+{
+	//* The audio device thread owns the front, play_cur_time_ stands for it.
+	if (que_audio_buffer_.Empty())
+		return 0;
+	return (uint32_t)rtc::AtomicOps::AcquireLoad(&audio_back_dts_)
+		- (uint32_t)rtc::AtomicOps::AcquireLoad(&play_cur_time_);
+}
+
+uint32_t PlyBuffer::GetVideoBufTime()
+{
+	PlyPacket** pkt_front = que_video_buffer_.Front();
+	PlyPacket** pkt_back = que_video_buffer_.Back();
+	if (pkt_front == NULL || pkt_back == NULL)
+		return 0;
+	return (*pkt_back)->_dts - (*pkt_front)->_dts;
+}
+
+void PlyBuffer::UpdateCatchup(uint32_t media_buf_time)
+{
+	//* Hysteresis: start over target + PLY_CATCHUP_TIME, stop at the target.
+	int over = (int)media_buf_time - target_delay_;
+	if (over > PLY_DROP_TIME) {
+		if (catchup_ != PC_Drop)
+			LOG(LS_INFO) << "PlyBuffer " << over << "ms over target: " << target_delay_ << "ms, drop";
+		rtc::AtomicOps::ReleaseStore(&catchup_, PC_Drop);
+	}
+	else if (over > PLY_CATCHUP_TIME) {
+		rtc::AtomicOps::ReleaseStore(&catchup_, PC_Speed);
+	}
+	else if (over <= 0) {
+		rtc::AtomicOps::ReleaseStore(&catchup_, PC_None);
+	}
+}
+
+void PlyBuffer::UpdateMinDelay(uint32_t media_buf_time, uint32_t curTime)
+{
+	if (min_delay_cur_ < 0 || (int)media_buf_time < min_delay_cur_)
+		min_delay_cur_ = media_buf_time;
+	if (curTime >= min_delay_time_) {
+		min_delay_time_ = curTime + 1000;
+		min_delay_ = min_delay_cur_;
+		min_delay_cur_ = -1;
+	}
+}
+
+int PlyBuffer::DoDecode()
 {
 	uint32_t curTime = rtc::Time();
-	if (sys_fast_video_time_ == 0)
-		return;
+	uint32_t tickGap = curTime - last_decode_time_;
+	last_decode_time_ = curTime;
+	int wait_data = PW_Any;
+	int delay = PLY_MAX_WAIT;
+	if (sys_fast_video_time_ == 0) {
+		rtc::AtomicOps::ReleaseStore(&wait_data_, wait_data);
+		return delay;
+	}
+	{//* Target delay: the arrival jitter with some redundancy.
+		int target = jitter_.Jitter() + PLY_RED_TIME;
+		if (target < PLY_MIN_TIME)
+			target = PLY_MIN_TIME;
+		if (target > cache_time_)
+			target = cache_time_;
+		rtc::AtomicOps::ReleaseStore(&target_delay_, target);
+	}
 	if (ply_status_ == PS_Fast) {
-		PlyPacket* pkt = NULL;
 		uint32_t videoSysGap = curTime - sys_fast_video_time_;
-		uint32_t videoPlyTime = rtmp_fast_video_time_ + videoSysGap;
-		if (videoSysGap >= PLY_RED_TIME) {
-			//* Start play a/v
-			rtc::CritScope cs(&cs_list_audio_);
-			if (lst_audio_buffer_.size() > 0) {
-				PlyPacket* pkt_front = lst_audio_buffer_.front();
-				PlyPacket* pkt_back = lst_audio_buffer_.back();
-				if ((pkt_back->_dts - pkt_front->_dts) > PLY_RED_TIME) {
+		if (videoSysGap < PLY_RED_TIME) {
+			delay = PLY_RED_TIME - videoSysGap;
+		}
+		else {
+			//* Start play a/v, audio isn't played yet so the first packet is the front.
+			if (!que_audio_buffer_.Empty()) {
+				if (((uint32_t)rtc::AtomicOps::AcquireLoad(&audio_back_dts_) - audio_first_dts_) > PLY_RED_TIME) {
 					ply_status_ = PS_Normal;
-					play_cur_time_ = pkt_front->_dts;
+					rtc::AtomicOps::ReleaseStore(&play_cur_time_, (int)audio_first_dts_);
 					callback_.OnPlay();
+					delay = 0;
 				}
 			}
 			else {
 				if (videoSysGap >= PLY_RED_TIME * 4)
 				{
-					rtc::CritScope cs(&cs_list_video_);
-					if (lst_video_buffer_.size() > 0) {
-						PlyPacket* pkt_front = lst_video_buffer_.front();
+					PlyPacket** pkt_front = que_video_buffer_.Front();
+					if (pkt_front != NULL) {
 						ply_status_ = PS_Normal;
-						play_cur_time_ = pkt_front->_dts;
+						rtc::AtomicOps::ReleaseStore(&play_cur_time_, (int)(*pkt_front)->_dts);
 						callback_.OnPlay();
+						delay = 0;
 					}
 				}
+				else {
+					delay = PLY_RED_TIME * 4 - videoSysGap;
+				}
 			}
 		}
 	}
 	else if (ply_status_ == PS_Normal) {
 		PlyPacket* pkt_video = NULL;
 		uint32_t media_buf_time = 0;
-		uint32_t play_video_time = play_cur_time_;
-		{//* Get audio 
-			rtc::CritScope cs(&cs_list_audio_);
-			if (lst_audio_buffer_.size() > 0) {
-				media_buf_time = lst_audio_buffer_.back()->_dts - lst_audio_buffer_.front()->_dts;
-			}
-		}
+		uint32_t play_video_time = (uint32_t)rtc::AtomicOps::AcquireLoad(&play_cur_time_);
+		media_buf_time = GetAudioBufTime();
 		if (media_buf_time == 0 && !got_audio_) {
-			rtc::CritScope cs(&cs_list_video_);
-			if (lst_video_buffer_.size() > 0) {
-				media_buf_time = lst_video_buffer_.back()->_dts - lst_video_buffer_.front()->_dts;
+			media_buf_time = GetVideoBufTime();
+			if (!que_video_buffer_.Empty()) {
+				//* No audio clock to speed up, move the video clock instead.
+				if (catchup_ == PC_Drop) {
+					sys_fast_video_time_ -= media_buf_time - target_delay_;
+				}
+				else if (catchup_ == PC_Speed) {
+					catchup_remain_ += tickGap;
+					sys_fast_video_time_ -= catchup_remain_ / PLY_CATCHUP_RATE;
+					catchup_remain_ %= PLY_CATCHUP_RATE;
+				}
 				uint32_t videoSysGap = curTime - sys_fast_video_time_;
 				play_video_time = rtmp_fast_video_time_ + videoSysGap;
 			}
 		}
+		UpdateCatchup(media_buf_time);
+		UpdateMinDelay(media_buf_time, curTime);
 	
-		{//* Get video 
-			rtc::CritScope cs(&cs_list_video_);
-			if (lst_video_buffer_.size() > 0) {
-				pkt_video = lst_video_buffer_.front();
-				if (pkt_video->_dts <= play_video_time) {
-					lst_video_buffer_.pop_front();
-				}
-				else {
-					pkt_video = NULL;
-				}
-			}
-		}
-
-		if (pkt_video) {
+		//* Get video, all the frames due: the clock jumps when catching up.
+		PlyPacket** pkt_front = que_video_buffer_.Front();
+		while (pkt_front != NULL && (*pkt_front)->_dts <= play_video_time) {
+			que_video_buffer_.Pop(&pkt_video);
 			if (!callback_.OnNeedDecodeData(pkt_video)) {
 				delete pkt_video;
 			}
+			pkt_video = NULL;
+			pkt_front = que_video_buffer_.Front();
+		}
+		//* Wake at the dts of the next frame, or when it arrives.
+		if (pkt_front != NULL) {
+			int due = (int)((*pkt_front)->_dts - play_video_time);
+			if (due < delay)
+				delay = due;
+			wait_data = PW_None;
+		}
+		else {
+			wait_data = PW_Video;
 		}
 
 		if (media_buf_time <= PLY_RED_TIME) {
-			// Play buffer is so small, then we need buffer it?
+			//* Underrun, rebuffer to the target delay.
 			callback_.OnPause();
 			ply_status_ = PS_Cache;
-            cache_time_ = cache_delta_ * 1000;
-            if(cache_delta_ < PLY_MAX_CACHE)
-                cache_delta_ *= 2;
-			rtmp_cache_time_ = rtc::Time() + cache_time_;
+			rtc::AtomicOps::ReleaseStore(&catchup_, PC_None);
+			cache_start_time_ = curTime;
+			wait_data = PW_Any;
+			LOG(LS_INFO) << "PlyBuffer underrun, cache to target: " << target_delay_ << "ms";
+		}
+		else if (got_audio_) {
+			//* Audio is drained by the device, check again before it underruns.
+			int underrun = (int)media_buf_time - PLY_RED_TIME;
+			if (underrun < delay)
+				delay = underrun;
 		}
         buf_cache_time_ = media_buf_time;
 	}
 	else if (ply_status_ == PS_Cache) {
-		if (rtmp_cache_time_ <= rtc::Time()) {
-			uint32_t media_buf_time = 0;
-			{
-				rtc::CritScope cs(&cs_list_audio_);
-				if (lst_audio_buffer_.size() > 0) {
-					media_buf_time = lst_audio_buffer_.back()->_dts - lst_audio_buffer_.front()->_dts;
-				}
-			}
-			if (media_buf_time == 0 && !got_audio_) {
-				rtc::CritScope cs(&cs_list_video_);
-				if (lst_video_buffer_.size() > 0) {
-					media_buf_time = lst_video_buffer_.back()->_dts - lst_video_buffer_.front()->_dts;
-				}
-			}
+		uint32_t media_buf_time = GetAudioBufTime();
+		if (media_buf_time == 0 && !got_audio_) {
+			media_buf_time = GetVideoBufTime();
+		}
+		UpdateMinDelay(media_buf_time, curTime);
 
-			if (media_buf_time >= cache_time_ - PLY_RED_TIME) {
-				ply_status_ = PS_Normal;
-				if (cache_delta_ == PLY_MAX_CACHE)
-					cache_delta_ /= 2;
-				callback_.OnPlay();
-			}
-			else {
-				rtmp_cache_time_ = rtc::Time() + cache_time_;
-			}
+		if ((int)media_buf_time >= target_delay_) {
+			ply_status_ = PS_Normal;
 			if (!got_audio_) {
-				sys_fast_video_time_ += cache_time_;
+				//* Video clock is stopped while caching.
+				sys_fast_video_time_ += curTime - cache_start_time_;
 			}
-			buf_cache_time_ = media_buf_time;
+			callback_.OnPlay();
+			delay = 0;
 		}
+		buf_cache_time_ = media_buf_time;
 	}
+	rtc::AtomicOps::ReleaseStore(&wait_data_, wait_data);
+	return delay;
 }
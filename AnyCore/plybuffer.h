@@ -20,18 +20,37 @@
 #define __PLAYER_BUFER_H__
 #include <list>
 #include <stdint.h>
-#include "webrtc/base/criticalsection.h"
+#include <vector>
+#include "demuxframe.h"
+#include "webrtc/base/atomicops.h"
 #include "webrtc/base/messagehandler.h"
+#include "webrtc/base/spsc_queue.h"
 #include "webrtc/base/thread.h"
 
 typedef struct PlyPacket
 {
-	PlyPacket(bool isvideo) :_data(NULL), _data_len(0),
+	PlyPacket(bool isvideo) :_data(NULL), _frame(NULL), _data_len(0),
 		_b_video(isvideo), _dts(0) {}
 
 	virtual ~PlyPacket(void){
 		if (_data)
 			delete[] _data;
+		if (_frame)
+			delete _frame;
+	}
+	//* Take the frame, it's made contiguous only by CopyData.
+	void SetFrame(DemuxFrame* frame, uint32_t ts) {
+		_dts = ts;
+		_frame = frame;
+		_data_len = frame->Size();
+	}
+	//* Copy at most len bytes of the data or frame, return the bytes copied.
+	int CopyData(uint8_t* dst, int len) const {
+		if (_frame)
+			return _frame->CopyTo(dst, len);
+		int n = _data_len < len ? _data_len : len;
+		memcpy(dst, _data, n);
+		return n;
 	}
 	void SetData(const uint8_t*pdata, int len, uint32_t ts) {
 		_dts = ts;
@@ -47,6 +66,7 @@ typedef struct PlyPacket
 		}
 	}
 	uint8_t*_data;
+	DemuxFrame*_frame;
 	int _data_len;
 	bool _b_video;
 	uint32_t _dts;
@@ -58,6 +78,34 @@ enum PlyStuts {
 	PS_Cache,
 };
 
+enum PlyCatchup {
+	PC_None = 0,
+	PC_Speed,		//	Play audio a little faster
+	PC_Drop,		//	Too far behind, drop to the target delay
+};
+
+//* Estimate the arrival jitter from packet dts against the wall clock.
+//* Transit time (arrival - dts) of the last PLY_JITTER_WINDOW packets is kept,
+//* the jitter is its percentile over the window minimum.
+class PlyJitter
+{
+public:
+	PlyJitter();
+
+	void Reset();
+	void Update(uint32_t dts, uint32_t now);
+	int Jitter() const { return jitter_; };
+
+private:
+	std::vector<int>	samples_;
+	std::vector<int>	sorted_;
+	size_t				pos_;
+	bool				got_base_;
+	uint32_t			base_transit_;
+	uint32_t			next_estimate_;
+	int					jitter_;
+};
+
 class PlyBufferCallback {
 public:
 	PlyBufferCallback(void){};
@@ -78,7 +126,9 @@ public:
 	int GetPlayAudio(void* audioSamples);
     PlyStuts PlayerStatus(){return ply_status_;};
     int GetPlayCacheTime(){return buf_cache_time_;};
-	void CacheH264Data(const uint8_t*pdata, int len, uint32_t ts);
+	int GetTargetDelay(){return rtc::AtomicOps::AcquireLoad(&target_delay_);};
+	int GetMinDelay(){return min_delay_;};
+	void CacheH264Data(DemuxFrame* frame, uint32_t ts);
 	void CachePcmData(const uint8_t*pdata, int len, uint32_t ts);
 
 protected:
@@ -86,24 +136,42 @@ protected:
 	virtual void OnMessage(rtc::Message* msg);
 
 	int	GetCacheTime();
-	void DoDecode();
+	uint32_t GetAudioBufTime();
+	uint32_t GetVideoBufTime();
+	void UpdateCatchup(uint32_t media_buf_time);
+	void UpdateMinDelay(uint32_t media_buf_time, uint32_t curTime);
+	void WakeOnData(bool video);
+	//* Return the ms to the next wakeup.
+	int DoDecode();
 
 private:
 	PlyBufferCallback		&callback_;
 	bool					got_audio_;
-	int						cache_time_;
-	int						cache_delta_;
+	int						cache_time_;		// Max target delay
     int                     buf_cache_time_;
+	volatile int			target_delay_;		// Written by the worker thread only
+	int						min_delay_;			// Min buffered in the last second
+	int						min_delay_cur_;
+	uint32_t				min_delay_time_;
+	volatile int			catchup_;			// PlyCatchup, written by the worker thread only
+	int						catchup_count_;		// Audio device thread only
+	uint32_t				catchup_remain_;
+	uint32_t				last_decode_time_;
+	uint32_t				last_pcm_dts_;
+	volatile int			wait_data_;			// Data to wake the worker thread for, PW_*
+	PlyJitter				jitter_;			// CacheH264Data/CachePcmData thread only
 	PlyStuts				ply_status_;
 	rtc::Thread				*worker_thread_;
 	uint32_t				sys_fast_video_time_;	// 뿪ʱ
 	uint32_t				rtmp_fast_video_time_;
-	uint32_t				rtmp_cache_time_;
-	uint32_t				play_cur_time_;
-	rtc::CriticalSection	cs_list_audio_;
-	std::list<PlyPacket*>	lst_audio_buffer_;
-	rtc::CriticalSection	cs_list_video_;
-	std::list<PlyPacket*>	lst_video_buffer_;
+	uint32_t				cache_start_time_;
+	volatile int			play_cur_time_;		// Dts, written by the audio device thread when playing
+	uint32_t				audio_first_dts_;	// Written by the CachePcmData thread only
+	volatile int			audio_back_dts_;	// Dts, written by the CachePcmData thread only
+	//* Audio: CachePcmData thread -> audio device thread (GetPlayAudio)
+	rtc::SpscQueue<PlyPacket*>	que_audio_buffer_;
+	//* Video: CacheH264Data thread -> worker thread
+	rtc::SpscQueue<PlyPacket*>	que_video_buffer_;
 };
 
 #endif	// __PLAYER_BUFER_H__
\ No newline at end of file
@@ -20,6 +20,14 @@
 #include "anyrtmpcore.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/media/engine/webrtcvideoframe.h"
+#include "webrtc/system_wrappers/include/cpu_info.h"
+
+#define PLY_H264_QUEUE	256		// Max frames waiting for the decoder
+#define PLY_H264_PADDING	8		// Zero bytes after the frame to decode
+#define PLY_H264_HEAD	32		// Bytes to peek for the nal and slice type
+#define PLY_IDLE_WAIT	1000	// Max ms to sleep without messages
+#define PLY_H264_LAG_B	300		// Decode behind by this, drop B frames
+#define PLY_H264_MAX_LAG	1000	// Decode behind by this, skip to the newest keyframe
 
 #ifndef WEBRTC_WIN
 //֡
@@ -196,6 +204,12 @@ PlyDecoder::PlyDecoder()
 	: running_(false)
 	, playing_(false)
 	, h264_decoder_(NULL)
+	, que_h264_buffer_(PLY_H264_QUEUE)
+	, h264_keys_pushed_(0)
+	, h264_keys_popped_(0)
+	, h264_skip_key_(0)
+	, h264_data_(NULL)
+	, h264_data_size_(0)
 	, video_render_(NULL)
 	, aac_decoder_(NULL)
 	, a_cache_len_(0)
@@ -204,19 +218,22 @@ PlyDecoder::PlyDecoder()
 	, aac_frame_per10ms_size_(0)
 {
 	{
+		//* Frame threads: the few frames of output delay are nothing against the play buffer.
+		int cores = webrtc::CpuInfo::DetectNumberOfCores();
 		h264_decoder_ = webrtc::H264Decoder::Create();
+		h264_decoder_->SetThreadType(webrtc::H264Decoder::kThreadAuto);
 		webrtc::VideoCodec codecSetting;
 		codecSetting.codecType = webrtc::kVideoCodecH264;
 		codecSetting.width = 640;
 		codecSetting.height = 480;
-		h264_decoder_->InitDecode(&codecSetting, 1);
+		h264_decoder_->InitDecode(&codecSetting, cores);
 		h264_decoder_->RegisterDecodeCompleteCallback(this);
 		webrtc::VideoCodec setting;
 		setting.width = 640;
 		setting.height = 480;
 		setting.codecType = webrtc::kVideoCodecH264;
 		setting.maxFramerate = 30;
-		if (h264_decoder_->InitDecode(&setting, 1) != 0) {
+		if (h264_decoder_->InitDecode(&setting, cores) != 0) {
 			//@AnyRTC - Error
 		}
 	}
@@ -238,6 +255,9 @@ PlyDecoder::~PlyDecoder()
 		delete ply_buffer_;
 		ply_buffer_ = NULL;
 	}
+	PlyPacket* pkt = NULL;
+	while (que_h264_buffer_.Pop(&pkt))
+		delete pkt;
 	if (aac_decoder_) {
 		aac_decoder_close(aac_decoder_);
 		aac_decoder_ = NULL;
@@ -246,6 +266,7 @@ PlyDecoder::~PlyDecoder()
 		delete h264_decoder_;
 		h264_decoder_ = NULL;
 	}
+	delete[] h264_data_;
 }
 
 bool PlyDecoder::IsPlaying()
@@ -267,14 +288,39 @@ int  PlyDecoder::CacheTime()
     return 0;
 }
 
-void PlyDecoder::AddH264Data(const uint8_t*pdata, int len, uint32_t ts)
+int  PlyDecoder::TargetDelay()
+{
+    if (ply_buffer_ != NULL) {
+        return ply_buffer_->GetTargetDelay();
+    }
+    return 0;
+}
+
+int  PlyDecoder::MinDelay()
+{
+    if (ply_buffer_ != NULL) {
+        return ply_buffer_->GetMinDelay();
+    }
+    return 0;
+}
+
+void PlyDecoder::AddH264Data(DemuxFrame* frame, uint32_t ts)
 {
 	if (ply_buffer_) {
-		ply_buffer_->CacheH264Data(pdata, len, ts);
+		ply_buffer_->CacheH264Data(frame, ts);
+	}
+	else {
+		delete frame;
 	}
 }
-void PlyDecoder::AddAACData(const uint8_t*pdata, int len, uint32_t ts)
+void PlyDecoder::AddAACData(const DemuxFrame& frame, uint32_t ts)
 {
+	if (frame.Size() > (int)sizeof(aac_data_)) {
+		LOG(LS_WARNING) << "PlyDecoder drop aac frame too large: " << frame.Size();
+		return;
+	}
+	const uint8_t*pdata = aac_data_;
+	int len = frame.CopyTo(aac_data_, sizeof(aac_data_));
 	if (ply_buffer_) {
 		if (aac_decoder_ == NULL) {
 			aac_decoder_ = aac_decoder_open((unsigned char*)pdata, len, &aac_channels_, &aac_sample_hz_);
@@ -316,25 +362,42 @@ void PlyDecoder::Run()
 	while (running_)
 	{
 		{// ProcessMessages
-			this->ProcessMessages(1);
+			//* Sleep until the next PlyBuffer tick when there is nothing to decode,
+			//* the decode queue is only fed by the messages of this thread.
+			rtc::Message msg;
+			if (Get(&msg, que_h264_buffer_.Empty() ? PLY_IDLE_WAIT : 0))
+				Dispatch(&msg);
 		}
 		PlyPacket* pkt = NULL;
-		{
-			rtc::CritScope cs(&cs_list_h264_);
-			if (lst_h264_buffer_.size() > 0)
-			{
-				pkt = lst_h264_buffer_.front();
-				lst_h264_buffer_.pop_front();
+		if (que_h264_buffer_.Pop(&pkt)) {
+			uint8_t head[5] = { 0 };
+			pkt->CopyData(head, sizeof(head));
+			int frameType = head[4] & 0x1f;
+			if (frameType == 7)
+				h264_keys_popped_++;
+			if (h264_keys_popped_ - h264_skip_key_ < 0) {
+				//* Decode is too far behind, skip to the keyframe chosen by OnNeedDecodeData.
+				delete pkt;
+				continue;
 			}
-		}
-		if (pkt != NULL) {
+
 			if (h264_decoder_)
 			{
-				int frameType = pkt->_data[4] & 0x1f;
+				//* The only copy of video on the pull path, the frame is scattered in the rtmp payload.
+				int size = pkt->_data_len + PLY_H264_PADDING;
+				if (h264_data_size_ < size) {
+					delete[] h264_data_;
+					h264_data_ = new uint8_t[size];
+					h264_data_size_ = size;
+				}
+				pkt->CopyData(h264_data_, pkt->_data_len);
+				memset(h264_data_ + pkt->_data_len, 0, PLY_H264_PADDING);
 				webrtc::EncodedImage encoded_image;
-				encoded_image._buffer = (uint8_t*)pkt->_data;
+				encoded_image._buffer = h264_data_;
 				encoded_image._length = pkt->_data_len;
-				encoded_image._size = pkt->_data_len + 8;
+				encoded_image._size = size;
+				//* Carried to Decoded through the decoder, the frame threads reorder the output.
+				encoded_image._timeStamp = pkt->_dts;
 				if (frameType == 7) {
 					encoded_image._frameType = webrtc::kVideoFrameKey;
 				}
@@ -363,11 +426,13 @@ void PlyDecoder::OnPause()
 }
 bool PlyDecoder::OnNeedDecodeData(PlyPacket* pkt)
 {
-	const uint8_t*pdata = pkt->_data;
 	if (pkt->_b_video) {
+		//* Peek the head only, the frame is made contiguous when decode.
+		uint8_t pdata[PLY_H264_HEAD] = { 0 };
+		int head_len = pkt->CopyData(pdata, sizeof(pdata));
 #ifndef WEBRTC_WIN
         bs_t s;
-        bs_init(&s,pkt->_data + 4 + 1,pkt->_data_len - 4 -1);
+        bs_init(&s,pdata + 4 + 1,head_len - 4 -1);
         {
             /* i_first_mb */
             bs_read_ue( &s );
@@ -393,33 +458,46 @@ bool PlyDecoder::OnNeedDecodeData(PlyPacket* pkt)
                     break;  
             }
             
-            if(ft == FRAME_B) {
+            if(ft == FRAME_B && DecodeLag(pkt->_dts) > PLY_H264_LAG_B) {
                 return false;
             }
         }
 #endif
         int type = pdata[4] & 0x1f;
-		rtc::CritScope cs(&cs_list_h264_);
 		if (type == 7) {
-			//* Skip all buffer data, beacause decode is so slow!!!
-			std::list<PlyPacket*>::iterator iter = lst_h264_buffer_.begin();
-			while (iter != lst_h264_buffer_.end()) {
-				PlyPacket* plypkt = *iter;
-				lst_h264_buffer_.erase(iter++);
-				delete plypkt;
+			//* Both ends of the queue are on this thread, the lag is up to date.
+			int lag = DecodeLag(pkt->_dts);
+			if (!que_h264_buffer_.Push(&pkt)) {
+				return false;
 			}
-        }
-		lst_h264_buffer_.push_back(pkt);
+			h264_keys_pushed_++;
+			if (lag > PLY_H264_MAX_LAG) {
+				LOG(LS_WARNING) << "PlyDecoder is " << lag << "ms behind, skip to keyframe";
+				h264_skip_key_ = h264_keys_pushed_;
+			}
+		}
+		else if (!que_h264_buffer_.Push(&pkt)) {
+			return false;
+		}
 	}
 
 	return true;
 }
 
+int PlyDecoder::DecodeLag(uint32_t dts)
+{
+	PlyPacket** pkt_front = que_h264_buffer_.Front();
+	if (pkt_front == NULL)
+		return 0;
+	return (int)(dts - (*pkt_front)->_dts);
+}
+
 int32_t PlyDecoder::Decoded(webrtc::VideoFrame& decodedImage)
 {
+	//* timestamp() is the dts of the packet this frame was decoded from.
 	const cricket::WebRtcVideoFrame render_frame(
-		decodedImage.video_frame_buffer(),
-		decodedImage.render_time_ms() * rtc::kNumNanosecsPerMillisec, decodedImage.rotation());
+		decodedImage.video_frame_buffer(), decodedImage.rotation(),
+		(int64_t)decodedImage.timestamp() * rtc::kNumMicrosecsPerMillisec);
 
 	if (video_render_ != NULL) {
 		video_render_->OnFrame(render_frame);
@@ -38,9 +38,11 @@ public:
 	void SetVideoRender(rtc::VideoSinkInterface<cricket::VideoFrame> *render){ video_render_ = render; };
     bool IsPlaying();
     int  CacheTime();
+    int  TargetDelay();
+    int  MinDelay();
 
-	void AddH264Data(const uint8_t*pdata, int len, uint32_t ts);
-	void AddAACData(const uint8_t*pdata, int len, uint32_t ts);
+	void AddH264Data(DemuxFrame* frame, uint32_t ts);
+	void AddAACData(const DemuxFrame& frame, uint32_t ts);
 	int GetPcmData(void* audioSamples, uint32_t& samplesPerSec, size_t& nChannels);
 
 protected:
@@ -55,19 +57,27 @@ protected:
 	//* For webrtc::DecodedImageCallback
 	virtual int32_t Decoded(webrtc::VideoFrame& decodedImage);
 
+	//* Dts span from the oldest frame waiting for the decoder, ms.
+	int DecodeLag(uint32_t dts);
+
 private:
 	bool			running_;
 	bool			playing_;
 	PlyBuffer*		ply_buffer_;
 	
 	//* For video
-	webrtc::VideoDecoder	*h264_decoder_;
-	rtc::CriticalSection	cs_list_h264_;
-	std::list<PlyPacket*>	lst_h264_buffer_;
+	webrtc::H264Decoder		*h264_decoder_;
+	rtc::SpscQueue<PlyPacket*>	que_h264_buffer_;	// OnNeedDecodeData -> Run, both on this thread
+	int						h264_keys_pushed_;	// SPS pushed, written by OnNeedDecodeData only
+	int						h264_keys_popped_;	// SPS popped, written by Run only
+	int						h264_skip_key_;		// Skip to this SPS, decode is too far behind
+	uint8_t*				h264_data_;		// The contiguous frame to decode
+	int						h264_data_size_;
 	rtc::VideoSinkInterface<cricket::VideoFrame>	*video_render_;
 
 	//* For audio
 	aac_dec_t		aac_decoder_;
+	uint8_t			aac_data_[8192];	// The contiguous frame to decode
 	uint8_t			audio_cache_[8192];
 	int				a_cache_len_;
 	uint32_t		aac_sample_hz_;
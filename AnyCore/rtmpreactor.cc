@@ -0,0 +1,567 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "rtmpreactor.h"
+#include <map>
+#include <vector>
+#if defined(WEBRTC_LINUX) || defined(WEBRTC_ANDROID)
+#define RTMP_REACTOR_EPOLL
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#elif defined(WEBRTC_POSIX)
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#else
+#include <winsock2.h>
+#endif
+#include "srs_librtmp.h"
+#include "webrtc/base/atomicops.h"
+#include "webrtc/base/bind.h"
+#include "webrtc/base/checks.h"
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/nethelpers.h"
+#include "webrtc/base/socketserver.h"
+#include "webrtc/base/timeutils.h"
+
+#define REACTOR_MAX_EVENTS	256		// Max events of one wait
+#define REACTOR_POLL_MS		10		// Max wait of WSAPoll, it can't be woken up
+
+struct RtmpReactorEntry
+{
+	RtmpReactorHandler*	handler;	// NULL when removed, deleted after the events of the wait
+	int					fd;
+	bool				writable;
+};
+
+//* Socket server of the reactor thread, the rtc::Thread waits the sockets
+//* and the messages at once by it.
+class RtmpSocketServer : public rtc::SocketServer
+{
+public:
+	RtmpSocketServer(void);
+	virtual ~RtmpSocketServer(void);
+
+	void Add(RtmpReactorHandler* handler, int fd);
+	void SetWritable(RtmpReactorHandler* handler, bool enable);
+	void Remove(RtmpReactorHandler* handler);
+
+	//* For rtc::SocketServer
+	virtual bool Wait(int cms, bool process_io);
+	virtual void WakeUp();
+	virtual rtc::Socket* CreateSocket(int type) { RTC_NOTREACHED(); return NULL; };
+	virtual rtc::Socket* CreateSocket(int family, int type) { RTC_NOTREACHED(); return NULL; };
+	virtual rtc::AsyncSocket* CreateAsyncSocket(int type) { RTC_NOTREACHED(); return NULL; };
+	virtual rtc::AsyncSocket* CreateAsyncSocket(int family, int type) { RTC_NOTREACHED(); return NULL; };
+
+private:
+	void Dispatch(RtmpReactorEntry* entry, bool readable, bool writable);
+	void DeleteRemoved();
+
+	typedef std::map<RtmpReactorHandler*, RtmpReactorEntry*> EntryMap;
+	EntryMap							entries_;
+	std::vector<RtmpReactorEntry*>		removed_;
+#if defined(RTMP_REACTOR_EPOLL)
+	int					epoll_fd_;
+	int					wakeup_fd_;		// eventfd
+#elif defined(WEBRTC_POSIX)
+	int					wakeup_fds_[2];	// pipe
+	std::vector<pollfd>	poll_fds_;
+	std::vector<RtmpReactorEntry*>	poll_entries_;
+#else
+	volatile int		wakeup_;
+	std::vector<WSAPOLLFD>	poll_fds_;
+	std::vector<RtmpReactorEntry*>	poll_entries_;
+#endif
+};
+
+RtmpSocketServer::RtmpSocketServer(void)
+{
+#if defined(RTMP_REACTOR_EPOLL)
+	epoll_fd_ = epoll_create(REACTOR_MAX_EVENTS);
+	wakeup_fd_ = eventfd(0, EFD_NONBLOCK);
+	//* The wakeup has no entry.
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &ev);
+#elif defined(WEBRTC_POSIX)
+	if (pipe(wakeup_fds_) == 0) {
+		fcntl(wakeup_fds_[0], F_SETFL, fcntl(wakeup_fds_[0], F_GETFL) | O_NONBLOCK);
+		fcntl(wakeup_fds_[1], F_SETFL, fcntl(wakeup_fds_[1], F_GETFL) | O_NONBLOCK);
+	}
+#else
+	wakeup_ = 0;
+#endif
+}
+
+RtmpSocketServer::~RtmpSocketServer(void)
+{
+	EntryMap::iterator iter = entries_.begin();
+	for (; iter != entries_.end(); iter++) {
+		removed_.push_back(iter->second);
+	}
+	entries_.clear();
+	DeleteRemoved();
+#if defined(RTMP_REACTOR_EPOLL)
+	close(wakeup_fd_);
+	close(epoll_fd_);
+#elif defined(WEBRTC_POSIX)
+	close(wakeup_fds_[0]);
+	close(wakeup_fds_[1]);
+#endif
+}
+
+void RtmpSocketServer::Add(RtmpReactorHandler* handler, int fd)
+{
+	RTC_DCHECK(entries_.find(handler) == entries_.end());
+	RtmpReactorEntry* entry = new RtmpReactorEntry();
+	entry->handler = handler;
+	entry->fd = fd;
+	entry->writable = false;
+	entries_[handler] = entry;
+#if defined(RTMP_REACTOR_EPOLL)
+	epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = entry;
+	epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+#endif
+}
+
+void RtmpSocketServer::SetWritable(RtmpReactorHandler* handler, bool enable)
+{
+	EntryMap::iterator iter = entries_.find(handler);
+	if (iter == entries_.end() || iter->second->writable == enable)
+		return;
+	RtmpReactorEntry* entry = iter->second;
+	entry->writable = enable;
+#if defined(RTMP_REACTOR_EPOLL)
+	epoll_event ev;
+	ev.events = EPOLLIN | (enable ? (uint32_t)EPOLLOUT : 0u);
+	ev.data.ptr = entry;
+	epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, entry->fd, &ev);
+#endif
+}
+
+void RtmpSocketServer::Remove(RtmpReactorHandler* handler)
+{
+	EntryMap::iterator iter = entries_.find(handler);
+	if (iter == entries_.end())
+		return;
+	RtmpReactorEntry* entry = iter->second;
+	entries_.erase(iter);
+#if defined(RTMP_REACTOR_EPOLL)
+	//* The fd is still open, the sessions close it after removed.
+	epoll_event ev;
+	epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, entry->fd, &ev);
+#endif
+	//* The events got by the running wait may still point to it.
+	entry->handler = NULL;
+	removed_.push_back(entry);
+}
+
+void RtmpSocketServer::Dispatch(RtmpReactorEntry* entry, bool readable, bool writable)
+{
+	//* The handler may remove itself or others in the callbacks.
+	if (writable && entry->handler && entry->writable) {
+		entry->handler->OnRtmpWritable();
+	}
+	if (readable && entry->handler) {
+		entry->handler->OnRtmpReadable();
+	}
+}
+
+void RtmpSocketServer::DeleteRemoved()
+{
+	for (size_t i = 0; i < removed_.size(); i++) {
+		delete removed_[i];
+	}
+	removed_.clear();
+}
+
+#if defined(RTMP_REACTOR_EPOLL)
+bool RtmpSocketServer::Wait(int cms, bool process_io)
+{
+	epoll_event events[REACTOR_MAX_EVENTS];
+	int n = 0;
+	if (process_io) {
+		n = epoll_wait(epoll_fd_, events, REACTOR_MAX_EVENTS, cms);
+	}
+	else {
+		//* Only the wakeup, for the messages sent by Invoke.
+		pollfd pfd = { wakeup_fd_, POLLIN, 0 };
+		if (poll(&pfd, 1, cms) > 0) {
+			events[0].events = EPOLLIN;
+			events[0].data.ptr = NULL;
+			n = 1;
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		RtmpReactorEntry* entry = (RtmpReactorEntry*)events[i].data.ptr;
+		if (entry == NULL) {
+			uint64_t value;
+			while (read(wakeup_fd_, &value, sizeof(value)) > 0);
+			continue;
+		}
+		Dispatch(entry, (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0,
+			(events[i].events & EPOLLOUT) != 0);
+	}
+	DeleteRemoved();
+	return true;
+}
+
+void RtmpSocketServer::WakeUp()
+{
+	uint64_t value = 1;
+	write(wakeup_fd_, &value, sizeof(value));
+}
+#elif defined(WEBRTC_POSIX)
+bool RtmpSocketServer::Wait(int cms, bool process_io)
+{
+	poll_fds_.clear();
+	poll_entries_.clear();
+	pollfd pfd = { wakeup_fds_[0], POLLIN, 0 };
+	poll_fds_.push_back(pfd);
+	poll_entries_.push_back(NULL);
+	if (process_io) {
+		EntryMap::iterator iter = entries_.begin();
+		for (; iter != entries_.end(); iter++) {
+			pfd.fd = iter->second->fd;
+			pfd.events = POLLIN | (iter->second->writable ? POLLOUT : 0);
+			poll_fds_.push_back(pfd);
+			poll_entries_.push_back(iter->second);
+		}
+	}
+	if (poll(&poll_fds_[0], poll_fds_.size(), cms) > 0) {
+		for (size_t i = 0; i < poll_fds_.size(); i++) {
+			short revents = poll_fds_[i].revents;
+			if (revents == 0)
+				continue;
+			if (poll_entries_[i] == NULL) {
+				char buf[64];
+				while (read(wakeup_fds_[0], buf, sizeof(buf)) > 0);
+				continue;
+			}
+			Dispatch(poll_entries_[i], (revents & (POLLIN | POLLERR | POLLHUP | POLLNVAL)) != 0,
+				(revents & POLLOUT) != 0);
+		}
+	}
+	DeleteRemoved();
+	return true;
+}
+
+void RtmpSocketServer::WakeUp()
+{
+	char c = 0;
+	write(wakeup_fds_[1], &c, 1);
+}
+#else
+bool RtmpSocketServer::Wait(int cms, bool process_io)
+{
+	//* WSAPoll can't wait an event, so wait in slices and check the wakeup.
+	uint32_t end = rtc::Time() + (uint32_t)cms;
+	while (rtc::AtomicOps::CompareAndSwap(&wakeup_, 1, 0) == 0) {
+		int wait = REACTOR_POLL_MS;
+		if (cms != rtc::kForever) {
+			int left = (int)(end - rtc::Time());
+			if (left <= 0)
+				break;
+			if (left < wait)
+				wait = left;
+		}
+		poll_fds_.clear();
+		poll_entries_.clear();
+		if (process_io) {
+			EntryMap::iterator iter = entries_.begin();
+			for (; iter != entries_.end(); iter++) {
+				WSAPOLLFD pfd;
+				pfd.fd = iter->second->fd;
+				pfd.events = POLLRDNORM | (iter->second->writable ? POLLWRNORM : 0);
+				pfd.revents = 0;
+				poll_fds_.push_back(pfd);
+				poll_entries_.push_back(iter->second);
+			}
+		}
+		if (poll_fds_.empty()) {
+			::Sleep(wait);
+			continue;
+		}
+		if (WSAPoll(&poll_fds_[0], poll_fds_.size(), wait) > 0) {
+			for (size_t i = 0; i < poll_fds_.size(); i++) {
+				short revents = poll_fds_[i].revents;
+				if (revents == 0)
+					continue;
+				Dispatch(poll_entries_[i], (revents & (POLLRDNORM | POLLERR | POLLHUP | POLLNVAL)) != 0,
+					(revents & POLLWRNORM) != 0);
+			}
+			break;
+		}
+	}
+	DeleteRemoved();
+	return true;
+}
+
+void RtmpSocketServer::WakeUp()
+{
+	rtc::AtomicOps::ReleaseStore(&wakeup_, 1);
+}
+#endif
+
+//===================================================
+//* RtmpConnecting
+enum {
+	MSG_CONNECT_DONE,		// Failed at once, report it out of the Connect
+	MSG_CONNECT_TIMEOUT
+};
+
+//* The setup of a session on the reactor, resolves the host when it's not
+//* an ip, then steps srs_rtmp_connect_step by the socket events until done.
+class RtmpConnecting : public RtmpReactorHandler, public sigslot::has_slots<>
+{
+public:
+	RtmpConnecting(RtmpReactor* reactor, RtmpReactorHandler* handler, void* rtmp, bool publish)
+		: reactor_(reactor)
+		, handler_(handler)
+		, rtmp_(rtmp)
+		, publish_(publish)
+		, ret_(0)
+		, resolver_(NULL) {}
+	virtual ~RtmpConnecting(void) {
+		if (resolver_ != NULL) {
+			//* Deleted by itself when the blocking resolve returns.
+			resolver_->SignalDone.disconnect(this);
+			resolver_->Destroy(false);
+		}
+		reactor_->ss_->Remove(this);
+		reactor_->Clear(this);
+	}
+
+	RtmpReactorHandler* Handler() { return handler_; };
+
+	void Start() {
+		reactor_->PostDelayed(RTC_FROM_HERE, RTMP_CONNECT_TIMEOUT, this, MSG_CONNECT_TIMEOUT);
+		std::string host = srs_rtmp_get_host(rtmp_);
+		rtc::IPAddress ip;
+		if (rtc::IPFromString(host, &ip)) {
+			DoConnect(host);
+			return;
+		}
+		resolver_ = new rtc::AsyncResolver();
+		resolver_->SignalDone.connect(this, &RtmpConnecting::OnResolved);
+		resolver_->Start(rtc::SocketAddress(host, 0));
+	}
+
+	//* For rtc::MessageHandler
+	virtual void OnMessage(rtc::Message* msg) {
+		switch (msg->message_id) {
+		case MSG_CONNECT_DONE:
+			reactor_->ConnectDone(this, ret_);
+			break;
+		case MSG_CONNECT_TIMEOUT:
+			reactor_->ConnectDone(this, -1);
+			break;
+		}
+	}
+	//* For RtmpReactorHandler
+	virtual void OnRtmpReadable() {
+		DoStep(srs_rtmp_connect_step(rtmp_));
+	}
+	virtual void OnRtmpWritable() {
+		DoStep(srs_rtmp_connect_step(rtmp_));
+	}
+
+private:
+	void OnResolved(rtc::AsyncResolverInterface* resolver) {
+		rtc::SocketAddress addr;
+		bool resolved = resolver->GetError() == 0 && resolver->GetResolvedAddress(AF_INET, &addr);
+		resolver_->SignalDone.disconnect(this);
+		resolver_->Destroy(false);
+		resolver_ = NULL;
+		if (!resolved) {
+			reactor_->ConnectDone(this, -1);
+			return;
+		}
+		DoConnect(addr.ipaddr().ToString());
+	}
+	void DoConnect(const std::string& ip) {
+		int ret = srs_rtmp_connect_nonblock(rtmp_, ip.c_str(), publish_);
+		if (!srs_rtmp_is_would_block(ret)) {
+			//* The handler may reconnect in the callback, not in its Connect.
+			ret_ = ret;
+			reactor_->Post(RTC_FROM_HERE, this, MSG_CONNECT_DONE);
+			return;
+		}
+		reactor_->ss_->Add(this, srs_rtmp_get_fd(rtmp_));
+		reactor_->ss_->SetWritable(this, srs_rtmp_connect_want_write(rtmp_) != 0);
+	}
+	void DoStep(int ret) {
+		if (srs_rtmp_is_would_block(ret)) {
+			reactor_->ss_->SetWritable(this, srs_rtmp_connect_want_write(rtmp_) != 0);
+			return;
+		}
+		reactor_->ConnectDone(this, ret);
+	}
+
+	RtmpReactor*			reactor_;
+	RtmpReactorHandler*		handler_;
+	void*					rtmp_;
+	bool					publish_;
+	int						ret_;
+	rtc::AsyncResolver*		resolver_;
+};
+
+//===================================================
+//* RtmpReactorPool
+struct RtmpReactorPool
+{
+	RtmpReactorPool(void)
+		: num_reactors(RTMP_REACTOR_THREADS)
+		, next_reactor(0) {}
+	~RtmpReactorPool(void) {
+		for (size_t i = 0; i < reactors.size(); i++) {
+			delete reactors[i];
+		}
+	}
+	static RtmpReactorPool& Inst() {
+		static RtmpReactorPool pool;
+		return pool;
+	}
+	void Start() {
+		if (!reactors.empty())
+			return;
+		for (int i = 0; i < num_reactors; i++) {
+			RtmpReactor* reactor = new RtmpReactor();
+			reactor->SetName("RtmpReactor", reactor);
+			reactor->Start();
+			reactors.push_back(reactor);
+		}
+	}
+
+	rtc::CriticalSection		cs;
+	int							num_reactors;
+	int							next_reactor;
+	std::vector<RtmpReactor*>	reactors;
+};
+
+static void DoNothing()
+{
+}
+
+void RtmpReactor::SetThreads(int reactors)
+{
+	RtmpReactorPool& pool = RtmpReactorPool::Inst();
+	rtc::CritScope l(&pool.cs);
+	RTC_DCHECK(pool.reactors.empty());
+	pool.num_reactors = reactors > 0 ? reactors : 1;
+}
+
+RtmpReactor* RtmpReactor::Get()
+{
+	RtmpReactorPool& pool = RtmpReactorPool::Inst();
+	rtc::CritScope l(&pool.cs);
+	pool.Start();
+	RtmpReactor* reactor = pool.reactors[pool.next_reactor];
+	pool.next_reactor = (pool.next_reactor + 1) % pool.reactors.size();
+	return reactor;
+}
+
+RtmpReactor::RtmpReactor(void)
+	: rtc::Thread(std::unique_ptr<rtc::SocketServer>(new RtmpSocketServer()))
+{
+	ss_ = static_cast<RtmpSocketServer*>(socketserver());
+}
+
+RtmpReactor::~RtmpReactor(void)
+{
+	rtc::Thread::Stop();
+	while (!connectings_.empty()) {
+		CancelConnect(connectings_.begin()->first);
+	}
+}
+
+void RtmpReactor::Add(RtmpReactorHandler* handler, int fd)
+{
+	RTC_DCHECK(IsCurrent());
+	ss_->Add(handler, fd);
+}
+
+void RtmpReactor::SetWritable(RtmpReactorHandler* handler, bool enable)
+{
+	RTC_DCHECK(IsCurrent());
+	ss_->SetWritable(handler, enable);
+}
+
+void RtmpReactor::Remove(RtmpReactorHandler* handler)
+{
+	RTC_DCHECK(IsCurrent());
+	CancelConnect(handler);
+	ss_->Remove(handler);
+}
+
+void RtmpReactor::Connect(RtmpReactorHandler* handler, void* rtmp, bool publish)
+{
+	RTC_DCHECK(IsCurrent());
+	CancelConnect(handler);
+	RtmpConnecting* connecting = new RtmpConnecting(this, handler, rtmp, publish);
+	connectings_[handler] = connecting;
+	connecting->Start();
+}
+
+void RtmpReactor::Detach(RtmpReactorHandler* handler)
+{
+	RTC_DCHECK(!IsCurrent());
+	Invoke<void>(RTC_FROM_HERE, rtc::Bind(&RtmpReactor::Detach_r, this, handler));
+}
+
+void RtmpReactor::Detach(RtmpReactorHandler* handler, rtc::Thread* thread)
+{
+	RTC_DCHECK(!IsCurrent() && !thread->IsCurrent());
+	Invoke<void>(RTC_FROM_HERE, rtc::Bind(&RtmpReactor::Detach_r, this, handler));
+	//* The blocking call running on the thread posts its result to the reactor,
+	//* wait for it, then clear the reactor again.
+	thread->Clear(handler);
+	thread->Invoke<void>(RTC_FROM_HERE, rtc::Bind(&DoNothing));
+	Invoke<void>(RTC_FROM_HERE, rtc::Bind(&RtmpReactor::Detach_r, this, handler));
+}
+
+void RtmpReactor::Detach_r(RtmpReactorHandler* handler)
+{
+	CancelConnect(handler);
+	ss_->Remove(handler);
+	Clear(handler);
+}
+
+void RtmpReactor::CancelConnect(RtmpReactorHandler* handler)
+{
+	ConnectingMap::iterator iter = connectings_.find(handler);
+	if (iter == connectings_.end())
+		return;
+	RtmpConnecting* connecting = iter->second;
+	connectings_.erase(iter);
+	delete connecting;
+}
+
+void RtmpReactor::ConnectDone(RtmpConnecting* connecting, int ret)
+{
+	RtmpReactorHandler* handler = connecting->Handler();
+	connectings_.erase(handler);
+	delete connecting;
+	handler->OnRtmpConnect(ret);
+}
@@ -0,0 +1,92 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __RTMP_REACTOR_H__
+#define __RTMP_REACTOR_H__
+#include <map>
+#include "webrtc/base/messagehandler.h"
+#include "webrtc/base/thread.h"
+
+#define RTMP_REACTOR_THREADS	1		// Default event loops for all sessions
+#define RTMP_CONNECT_TIMEOUT	10000	// Max ms of the setup of a session
+
+//* One rtmp session driven by a reactor, the messages posted to it and
+//* the socket events are all called on the reactor thread.
+class RtmpReactorHandler : public rtc::MessageHandler
+{
+public:
+	RtmpReactorHandler(void){};
+	virtual ~RtmpReactorHandler(void){};
+
+	//* Also called on error or hangup, the next read gets the error.
+	virtual void OnRtmpReadable() = 0;
+	//* Only when enabled by RtmpReactor::SetWritable.
+	virtual void OnRtmpWritable() = 0;
+	//* Result of RtmpReactor::Connect, 0 when the rtmp is published or played.
+	virtual void OnRtmpConnect(int ret) {};
+};
+
+class RtmpSocketServer;
+class RtmpConnecting;
+
+//* Event loop of many rtmp sessions, instead of a blocking thread each.
+//* The sockets are waited by epoll(poll where no epoll) in the socket server
+//* of the thread, so the messages posted to the reactor wake up the same wait.
+//* The handshake, connect, play and publish are non-blocking on the reactor
+//* too, only the dns of a host name is resolved by a thread of its own.
+class RtmpReactor : public rtc::Thread
+{
+public:
+	//* Before the first session, the threads are created by the first Get.
+	static void SetThreads(int reactors);
+	//* Reactor of a new session, round robin.
+	static RtmpReactor* Get();
+
+	//* On the reactor thread, the fd is waited for reading until removed.
+	void Add(RtmpReactorHandler* handler, int fd);
+	void SetWritable(RtmpReactorHandler* handler, bool enable);
+	//* Also cancels the Connect of the handler.
+	void Remove(RtmpReactorHandler* handler);
+
+	//* On the reactor thread, the setup of the rtmp(srs_rtmp_t) to publish or
+	//* play, OnRtmpConnect is called later, failed after RTMP_CONNECT_TIMEOUT.
+	//* The rtmp is non-blocking when done, add its fd to go on.
+	void Connect(RtmpReactorHandler* handler, void* rtmp, bool publish);
+
+	//* Not on the reactor thread. When returns, the handler is removed and
+	//* none of its messages is queued or running, the caller must not post more.
+	void Detach(RtmpReactorHandler* handler);
+	//* Also waits for the messages of the handler running on the thread.
+	void Detach(RtmpReactorHandler* handler, rtc::Thread* thread);
+
+private:
+	RtmpReactor(void);
+	virtual ~RtmpReactor(void);
+	friend struct RtmpReactorPool;
+	friend class RtmpConnecting;
+
+	void Detach_r(RtmpReactorHandler* handler);
+	void CancelConnect(RtmpReactorHandler* handler);
+	void ConnectDone(RtmpConnecting* connecting, int ret);
+
+	typedef std::map<RtmpReactorHandler*, RtmpConnecting*> ConnectingMap;
+	ConnectingMap		connectings_;	// On the reactor only
+	RtmpSocketServer*	ss_;	// Owned by the thread
+};
+
+#endif	// __RTMP_REACTOR_H__
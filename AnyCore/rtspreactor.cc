@@ -0,0 +1,166 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#include "rtspreactor.h"
+#include <vector>
+#include "BasicUsageEnvironment.hh"
+#include "webrtc/base/checks.h"
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/event.h"
+#include "webrtc/base/socketserver.h"
+
+#define RTSP_SCHEDULER_GRANULARITY	10000	// us, max wait of select() for the wakeup, where no epoll
+
+//* Socket server of the reactor thread, a wait is one step of the live555 event
+//* loop, and the wakeup is a live555 event trigger.
+class RtspSocketServer : public rtc::SocketServer
+{
+public:
+	RtspSocketServer(void);
+	virtual ~RtspSocketServer(void);
+
+	UsageEnvironment& Env() { return *env_; };
+
+	//* For rtc::SocketServer
+	virtual bool Wait(int cms, bool process_io);
+	virtual void WakeUp();
+	virtual rtc::Socket* CreateSocket(int type) { RTC_NOTREACHED(); return NULL; };
+	virtual rtc::Socket* CreateSocket(int family, int type) { RTC_NOTREACHED(); return NULL; };
+	virtual rtc::AsyncSocket* CreateAsyncSocket(int type) { RTC_NOTREACHED(); return NULL; };
+	virtual rtc::AsyncSocket* CreateAsyncSocket(int family, int type) { RTC_NOTREACHED(); return NULL; };
+
+private:
+	static void OnWakeUp(void* clientData) {};
+
+	BasicTaskScheduler0*	scheduler_;
+	UsageEnvironment*		env_;
+	EventTriggerId			wakeup_trigger_;
+	rtc::Event				wakeup_;	// For the waits without io
+};
+
+RtspSocketServer::RtspSocketServer(void)
+	: scheduler_(NULL)
+	, env_(NULL)
+	, wakeup_(false, false)
+{
+#if defined(__linux__)
+	scheduler_ = EpollTaskScheduler::createNew();
+#endif
+	if (scheduler_ == NULL) {
+		scheduler_ = BasicTaskScheduler::createNew(RTSP_SCHEDULER_GRANULARITY);
+	}
+	env_ = BasicUsageEnvironment::createNew(*scheduler_);
+	wakeup_trigger_ = scheduler_->createEventTrigger(&RtspSocketServer::OnWakeUp);
+}
+
+RtspSocketServer::~RtspSocketServer(void)
+{
+	scheduler_->deleteEventTrigger(wakeup_trigger_);
+	env_->reclaim();
+	delete scheduler_;
+}
+
+bool RtspSocketServer::Wait(int cms, bool process_io)
+{
+	if (!process_io) {
+		//* Only the wakeup, for the messages sent by Invoke, no live555 handler
+		//* may run in the middle of the caller.
+		wakeup_.Wait(cms == kForever ? rtc::Event::kForever : cms);
+		return true;
+	}
+	//* SingleStep takes us, and 0 for no limit but the live555 tasks.
+	unsigned max_delay = 0;
+	if (cms != kForever) {
+		max_delay = cms > 0 ? cms * 1000 : 1;
+	}
+	scheduler_->SingleStep(max_delay);
+	return true;
+}
+
+void RtspSocketServer::WakeUp()
+{
+	wakeup_.Set();
+	//* Safe from the other threads, it breaks the wait of the step.
+	scheduler_->triggerEvent(wakeup_trigger_);
+}
+
+struct RtspReactorPool
+{
+	RtspReactorPool(void)
+		: num_reactors(RTSP_REACTOR_THREADS)
+		, next_reactor(0) {}
+	~RtspReactorPool(void) {
+		for (size_t i = 0; i < reactors.size(); i++) {
+			delete reactors[i];
+		}
+	}
+	static RtspReactorPool& Inst() {
+		static RtspReactorPool pool;
+		return pool;
+	}
+	void Start() {
+		if (!reactors.empty())
+			return;
+		for (int i = 0; i < num_reactors; i++) {
+			RtspReactor* reactor = new RtspReactor();
+			reactor->SetName("RtspReactor", reactor);
+			reactor->Start();
+			reactors.push_back(reactor);
+		}
+	}
+
+	rtc::CriticalSection		cs;
+	int							num_reactors;
+	int							next_reactor;
+	std::vector<RtspReactor*>	reactors;
+};
+
+void RtspReactor::SetThreads(int reactors)
+{
+	RtspReactorPool& pool = RtspReactorPool::Inst();
+	rtc::CritScope l(&pool.cs);
+	RTC_DCHECK(pool.reactors.empty());
+	pool.num_reactors = reactors > 0 ? reactors : 1;
+}
+
+RtspReactor* RtspReactor::Get()
+{
+	RtspReactorPool& pool = RtspReactorPool::Inst();
+	rtc::CritScope l(&pool.cs);
+	pool.Start();
+	RtspReactor* reactor = pool.reactors[pool.next_reactor];
+	pool.next_reactor = (pool.next_reactor + 1) % pool.reactors.size();
+	return reactor;
+}
+
+RtspReactor::RtspReactor(void)
+	: rtc::Thread(std::unique_ptr<rtc::SocketServer>(new RtspSocketServer()))
+{
+	ss_ = static_cast<RtspSocketServer*>(socketserver());
+}
+
+RtspReactor::~RtspReactor(void)
+{
+	rtc::Thread::Stop();
+}
+
+UsageEnvironment& RtspReactor::Env()
+{
+	RTC_DCHECK(IsCurrent());
+	return ss_->Env();
+}
@@ -0,0 +1,52 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+#ifndef __RTSP_REACTOR_H__
+#define __RTSP_REACTOR_H__
+#include "webrtc/base/thread.h"
+
+#define RTSP_REACTOR_THREADS	1		// Default event loops for all rtsp sessions
+
+class UsageEnvironment;
+class RtspSocketServer;
+
+//* Event loop of the lib_rtsp (live555) sessions. The socket server of the
+//* thread waits in the live555 TaskScheduler (epoll where it's Linux), so the
+//* rtc messages and the live555 sockets and tasks run on one thread: the
+//* sessions create and touch their live555 objects only by the messages posted
+//* or invoked to the reactor, live555 is not thread safe.
+class RtspReactor : public rtc::Thread
+{
+public:
+	//* Before the first session, the threads are created by the first Get.
+	static void SetThreads(int reactors);
+	//* Reactor of a new session, round robin.
+	static RtspReactor* Get();
+
+	//* On the reactor thread only.
+	UsageEnvironment& Env();
+
+private:
+	RtspReactor(void);
+	virtual ~RtspReactor(void);
+	friend struct RtspReactorPool;
+
+	RtspSocketServer*	ss_;	// Owned by the thread
+};
+
+#endif	// __RTSP_REACTOR_H__
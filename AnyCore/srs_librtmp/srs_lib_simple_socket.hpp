@@ -52,8 +52,16 @@ public:
 public:
     virtual srs_hijack_io_t hijack_io() = 0;
 	virtual int create_socket() = 0;
+	// use the socket accepted by user, for server side.
+	virtual int attach(int fd) = 0;
 	virtual int connect(const char* server, int port) = 0;
 	virtual int disconnect() = 0;
+	// for non-blocking io, @see srs_rtmp_set_nonblock.
+	virtual int get_fd() = 0;
+	virtual int set_nonblock() = 0;
+	virtual int flush() = 0;
+	virtual int get_send_pending() = 0;
+	virtual int check_connect() = 0;
 // ISrsBufferReader
 public:
 	virtual int read(void* buf, size_t size, ssize_t* nread) = 0;
@@ -671,6 +671,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define ERROR_SYSTEM_DIR_EXISTS             1056
 #define ERROR_SYSTEM_CREATE_DIR             1057
 #define ERROR_SYSTEM_KILL                   1058
+#define ERROR_SOCKET_WOULD_BLOCK            1059
 
 ///////////////////////////////////////////////////////
 // RTMP protocol error.
@@ -1318,6 +1319,15 @@ extern std::string srs_path_basename(std::string path);
 */
 extern bool srs_avc_startswith_annexb(SrsStream* stream, int* pnb_start_code = NULL);
 
+/**
+* find the next avc NALU start code "N[00] 00 00 01" in bytes,
+* scan 16bytes each time by SSE2 or NEON when available.
+* @param pnb_start_code output the size of start code, >=3, 0 when not found.
+*       NULL to ignore.
+* @return the offset of start code, including the N[00]; size when not found.
+*/
+extern int srs_avc_find_annexb(char* bytes, int size, int* pnb_start_code = NULL);
+
 /**
 * whether stream starts with the aac ADTS 
 * from aac-mp4a-format-ISO_IEC_14496-3+2001.pdf, page 75, 1.A.2.2 ADTS.
@@ -1769,6 +1779,9 @@ private:
         int size;
         // the reference count
         int shared_count;
+        // the free function of payload, NULL to use delete[].
+        void (*free_fn)(char* payload, void* param);
+        void* free_param;
     public:
         SrsSharedPtrPayload();
         virtual ~SrsSharedPtrPayload();
@@ -1792,6 +1805,12 @@ public:
      * @param pheader, the header to copy to the message. NULL to ignore.
      */
     virtual int create(SrsMessageHeader* pheader, char* payload, int size);
+    /**
+     * set the function to free the payload, when payload is not
+     * allocated by new[], for example, a pooled buffer of user.
+     * @remark, assert object is created.
+     */
+    virtual void set_payload_free(void (*free_fn)(char* payload, void* param), void* param);
     /**
      * get current reference count.
      * when this object created, count set to 0.
@@ -2680,7 +2699,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 //#include <srs_core.hpp>
 
-#if !defined(SRS_EXPORT_LIBRTMP)
+#if !defined(SRS_EXPORT_LIBRTMP) || 1
 
 #include <string>
 #include <map>
@@ -5479,6 +5498,11 @@ private:
     */
     AckWindowSize in_ack_size;
     /**
+    * whether the recv never waits for a part of chunk,
+    * @see set_nonblock.
+    */
+    bool nonblock;
+    /**
     * whether auto response when recv messages.
     * default to true for it's very easy to use the protocol stack.
     * @see: https://github.com/ossrs/srs/issues/217
@@ -5567,6 +5591,18 @@ public:
     */
     virtual int64_t get_recv_bytes();
     virtual int64_t get_send_bytes();
+    /**
+    * get the bytes already read from socket but not parsed to message,
+    * which maybe a part of message.
+    */
+    virtual int get_recv_buffered();
+    /**
+    * set the recv to non-blocking, for the socket in non-blocking mode,
+    * a chunk is parsed only when it's entirely in the recv buffer,
+    * so the recv_message returns ERROR_SOCKET_WOULD_BLOCK without
+    * any state changed when the socket has no more bytes.
+    */
+    virtual void set_nonblock(bool v);
 public:
     /**
     * recv a RTMP message, which is bytes oriented.
@@ -5639,7 +5675,7 @@ public:
         while (true) {
             SrsCommonMessage* msg = NULL;
             if ((ret = recv_message(&msg)) != ERROR_SUCCESS) {
-                if (ret != ERROR_SOCKET_TIMEOUT && !srs_is_client_gracefully_close(ret)) {
+                if (ret != ERROR_SOCKET_TIMEOUT && ret != ERROR_SOCKET_WOULD_BLOCK && !srs_is_client_gracefully_close(ret)) {
                     srs_error("recv message failed. ret=%d", ret);
                 }
                 return ret;
@@ -5702,6 +5738,17 @@ private:
     */
     virtual int recv_interlaced_message(SrsCommonMessage** pmsg);
     /**
+    * for non-blocking recv, read from socket until the buffer
+    * contains an entire chunk, never consume any bytes.
+    * @return ERROR_SOCKET_WOULD_BLOCK when socket has no more bytes.
+    */
+    virtual int grow_entire_chunk();
+    /**
+    * get the size of the chunk at head of buffer, by peek the
+    * headers and the cached chunk stream, 0 if header not entire.
+    */
+    virtual int peek_chunk_size();
+    /**
     * read the chunk basic header(fmt, cid) from chunk stream.
     * user can discovery a SrsChunkStream by cid.
     */
@@ -5884,12 +5931,19 @@ public:
     char* s0s1s2;
     // [1536]
     char* c2;
+    // the bytes of s0s1s2 read by read_s0s1s2_nonblock.
+    int nb_s0s1s2;
 public:
     SrsHandshakeBytes();
     virtual ~SrsHandshakeBytes();
 public:
     virtual int read_c0c1(ISrsProtocolReaderWriter* io);
     virtual int read_s0s1s2(ISrsProtocolReaderWriter* io);
+    /**
+    * read s0s1s2 from the non-blocking io, return ERROR_SOCKET_WOULD_BLOCK
+    * until all bytes read, the read bytes are kept for the next call.
+    */
+    virtual int read_s0s1s2_nonblock(ISrsProtocolReaderWriter* io);
     virtual int read_c2(ISrsProtocolReaderWriter* io);
     virtual int create_c0c1();
     virtual int create_s0s1s2(const char* c1 = NULL);
@@ -5921,11 +5975,26 @@ public:
      * if timeout, recv/send message return ERROR_SOCKET_TIMEOUT.
      */
     virtual void set_send_timeout(int64_t timeout_us);
+#ifdef SRS_PERF_MERGED_READ
+    /**
+     * @see SrsProtocol::set_merge_read and SrsProtocol::set_recv_buffer.
+     */
+    virtual void set_merge_read(bool v, IMergeReadHandler* handler);
+    virtual void set_recv_buffer(int buffer_size);
+#endif
     /**
      * get recv/send bytes.
      */
     virtual int64_t get_recv_bytes();
     virtual int64_t get_send_bytes();
+    /**
+     * @see SrsProtocol::get_recv_buffered.
+     */
+    virtual int get_recv_buffered();
+    /**
+     * @see SrsProtocol::set_nonblock.
+     */
+    virtual void set_nonblock(bool v);
     /**
      * recv a RTMP message, which is bytes oriented.
      * user can use decode_message to get the decoded RTMP packet.
@@ -5981,6 +6050,16 @@ public:
      * only use complex handshake
      */
     virtual int complex_handshake();
+    /**
+     * the simple handshake over the non-blocking io, c0c1 is written by the
+     * first call, it returns ERROR_SOCKET_WOULD_BLOCK until s0s1s2 all read,
+     * call it again when readable, c2 is written when success.
+     */
+    virtual int simple_handshake_nonblock();
+    /**
+     * send the connect app request, @see connect_app.
+     */
+    virtual int send_connect_app(std::string app, std::string tc_url, SrsRequest* req, bool debug_srs_upnode);
     /**
      * set req to use the original request of client:
      *      pageUrl and swfUrl for refer antisuck.
@@ -6012,6 +6091,10 @@ public:
      * create a stream, then play/publish data over this stream.
      */
     virtual int create_stream(int& stream_id);
+    /**
+     * send the create stream request, @see create_stream.
+     */
+    virtual int send_create_stream();
     /**
      * start play stream.
      */
@@ -6026,6 +6109,13 @@ public:
      *       connect-app => FMLE publish
      */
     virtual int fmle_publish(std::string stream, int& stream_id);
+    /**
+     * send the requests of fmle_publish in two parts, the release stream,
+     * FCPublish and create stream, then the publish with the stream id
+     * of the create stream response.
+     */
+    virtual int send_fmle_publish_start(std::string stream);
+    virtual int send_fmle_publish(std::string stream, int stream_id);
 public:
     /**
      * expect a specified message, drop others util got specified one.
@@ -6109,6 +6199,14 @@ public:
      */
     virtual int64_t get_recv_bytes();
     virtual int64_t get_send_bytes();
+    /**
+     * @see SrsProtocol::get_recv_buffered.
+     */
+    virtual int get_recv_buffered();
+    /**
+     * @see SrsProtocol::set_nonblock.
+     */
+    virtual void set_nonblock(bool v);
     /**
      * recv a RTMP message, which is bytes oriented.
      * user can use decode_message to get the decoded RTMP packet.
@@ -7823,6 +7921,10 @@ public:
     */
     virtual int handshake_with_client(SrsHandshakeBytes* hs_bytes, ISrsProtocolReaderWriter* io);
     virtual int handshake_with_server(SrsHandshakeBytes* hs_bytes, ISrsProtocolReaderWriter* io);
+    /**
+    * @see SrsRtmpClient::simple_handshake_nonblock.
+    */
+    virtual int handshake_with_server_nonblock(SrsHandshakeBytes* hs_bytes, ISrsProtocolReaderWriter* io);
 };
 
 /**
@@ -8291,6 +8393,15 @@ public:
     * @param nb_flv output the muxed flv size.
     */
     virtual int mux_avc2flv(std::string video, int8_t frame_type, int8_t avc_packet_type, u_int32_t dts, u_int32_t pts, char** flv, int* nb_flv);
+    /**
+    * mux the ibp frame to flv video packet in place, without copy,
+    * the 5bytes flv header and 4bytes NALU length are written before frame.
+    * @param frame the h.264 raw NALU, without annexb header,
+    *       there must be 9bytes writable space before frame.
+    * @param flv output the muxed flv packet, which is frame - 9.
+    * @param nb_flv output the muxed flv size.
+    */
+    virtual int mux_avc2flv_inplace(char* frame, int nb_frame, int8_t frame_type, u_int32_t dts, u_int32_t pts, char** flv, int* nb_flv);
 };
 
 /**
@@ -8344,6 +8455,15 @@ public:
     * @param nb_flv output the muxed flv size.
     */
     virtual int mux_aac2flv(char* frame, int nb_frame, SrsRawAacStreamCodec* codec, u_int32_t dts, char** flv, int* nb_flv);
+    /**
+    * mux the aac audio packet to flv audio packet in place, without copy,
+    * the 1 or 2bytes flv header is written before frame.
+    * @param frame the aac raw data, there must be 2bytes writable space before it,
+    *       for instance, the tail of the adts header.
+    * @param flv output the muxed flv packet, which points into the space before frame.
+    * @param nb_flv output the muxed flv size.
+    */
+    virtual int mux_aac2flv_inplace(char* frame, int nb_frame, SrsRawAacStreamCodec* codec, char** flv, int* nb_flv);
 };
 
 #endif
@@ -11355,8 +11475,14 @@ public:
 public:
 	virtual srs_hijack_io_t hijack_io();
 	virtual int create_socket();
+	virtual int attach(int fd);
 	virtual int connect(const char* server, int port);
 	virtual int disconnect();
+	virtual int get_fd();
+	virtual int set_nonblock();
+	virtual int flush();
+	virtual int get_send_pending();
+	virtual int check_connect();
 	// ISrsBufferReader
 public:
 	virtual int read(void* buf, size_t size, ssize_t* nread);
@@ -12395,6 +12521,80 @@ bool srs_avc_startswith_annexb(SrsStream* stream, int* pnb_start_code)
     return false;
 }
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SRS_AVC_FIND_SSE2
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define SRS_AVC_FIND_NEON
+    #include <arm_neon.h>
+#endif
+
+int srs_avc_find_annexb(char* bytes, int size, int* pnb_start_code)
+{
+    const u_int8_t* p = (const u_int8_t*)bytes;
+    int i = 0;
+    
+    // find the 00 00 01 in 16bytes block, p[i+2] is loaded at most p[i+17].
+#if defined(SRS_AVC_FIND_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    for (; i + 18 <= size; i += 16) {
+        __m128i v0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), zero);
+        __m128i v1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 1)), zero);
+        __m128i v2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i + 2)), one);
+        if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(v0, v1), v2)) != 0) {
+            break;
+        }
+    }
+#elif defined(SRS_AVC_FIND_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+    for (; i + 18 <= size; i += 16) {
+        uint8x16_t v0 = vceqq_u8(vld1q_u8(p + i), zero);
+        uint8x16_t v1 = vceqq_u8(vld1q_u8(p + i + 1), zero);
+        uint8x16_t v2 = vceqq_u8(vld1q_u8(p + i + 2), one);
+        uint64x2_t m = vreinterpretq_u64_u8(vandq_u8(vandq_u8(v0, v1), v2));
+        if ((vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1)) != 0) {
+            break;
+        }
+    }
+#endif
+    
+    // locate the 00 00 01 in the matched block, or the tail.
+    // when p[i+2] > 1, there is no start code at i, i+1 or i+2.
+    int pos = size;
+    while (i + 3 <= size) {
+        if (p[i + 2] > 1) {
+            i += 3;
+        } else if (p[i + 1] != 0) {
+            i += 2;
+        } else if (p[i] != 0 || p[i + 2] != 1) {
+            i++;
+        } else {
+            pos = i;
+            break;
+        }
+    }
+    
+    if (pos == size) {
+        if (pnb_start_code) {
+            *pnb_start_code = 0;
+        }
+        return size;
+    }
+    
+    // the N[00] before 00 00 01 is part of the start code.
+    int start = pos;
+    while (start > 0 && p[start - 1] == 0x00) {
+        start--;
+    }
+    if (pnb_start_code) {
+        *pnb_start_code = pos - start + 3;
+    }
+    
+    return start;
+}
+
 bool srs_aac_startswith_adts(SrsStream* stream)
 {
     char* bytes = stream->data() + stream->pos();
@@ -13062,6 +13262,8 @@ SrsSharedPtrMessage::SrsSharedPtrPayload::SrsSharedPtrPayload()
     payload = NULL;
     size = 0;
     shared_count = 0;
+    free_fn = NULL;
+    free_param = NULL;
 }
 
 SrsSharedPtrMessage::SrsSharedPtrPayload::~SrsSharedPtrPayload()
@@ -13069,6 +13271,11 @@ SrsSharedPtrMessage::SrsSharedPtrPayload::~SrsSharedPtrPayload()
 #ifdef SRS_AUTO_MEM_WATCH
     srs_memory_unwatch(payload);
 #endif
+    if (free_fn) {
+        free_fn(payload, free_param);
+        payload = NULL;
+        return;
+    }
     srs_freepa(payload);
 }
 
@@ -13137,6 +13344,14 @@ int SrsSharedPtrMessage::create(SrsMessageHeader* pheader, char* payload, int si
     return ret;
 }
 
+void SrsSharedPtrMessage::set_payload_free(void (*free_fn)(char* payload, void* param), void* param)
+{
+    srs_assert(ptr);
+    
+    ptr->free_fn = free_fn;
+    ptr->free_param = param;
+}
+
 int SrsSharedPtrMessage::count()
 {
     srs_assert(ptr);
@@ -15006,14 +15221,8 @@ int SrsAvcAacCodec::avc_demux_annexb_format(SrsStream* stream, SrsCodecSample* s
         // the NALU start bytes.
         char* p = stream->data() + stream->pos();
         
-        // get the last matched NALU
-        while (!stream->empty()) {
-            if (srs_avc_startswith_annexb(stream, NULL)) {
-                break;
-            }
-            
-            stream->skip(1);
-        }
+        // get the last matched NALU, until the next start code.
+        stream->skip(srs_avc_find_annexb(p, stream->size() - stream->pos()));
         
         char* pp = stream->data() + stream->pos();
         
@@ -15772,7 +15981,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 //#include <srs_kernel_ts.hpp>
 
-#if !defined(SRS_EXPORT_LIBRTMP)
+#if !defined(SRS_EXPORT_LIBRTMP) || 1
 
 // for srs-librtmp, @see https://github.com/ossrs/srs/issues/213
 #ifndef _WIN32
@@ -21265,6 +21474,7 @@ SrsProtocol::SrsProtocol(ISrsProtocolReaderWriter* io)
     
     warned_c0c3_cache_dry = false;
     auto_response_when_recv = true;
+    nonblock = false;
     
     cs_cache = NULL;
     if (SRS_PERF_CHUNK_STREAM_CACHE > 0) {
@@ -21384,6 +21594,16 @@ int64_t SrsProtocol::get_recv_bytes()
     return skt->get_recv_bytes();
 }
 
+int SrsProtocol::get_recv_buffered()
+{
+    return in_buffer->size();
+}
+
+void SrsProtocol::set_nonblock(bool v)
+{
+    nonblock = v;
+}
+
 int64_t SrsProtocol::get_send_bytes()
 {
     return skt->get_send_bytes();
@@ -21398,6 +21618,12 @@ int SrsProtocol::recv_message(SrsCommonMessage** pmsg)
     while (true) {
         SrsCommonMessage* msg = NULL;
         
+        // for non-blocking, parse only the entire chunk, for
+        // the parse of chunk cannot resume from a part of it.
+        if (nonblock && (ret = grow_entire_chunk()) != ERROR_SUCCESS) {
+            return ret;
+        }
+        
         if ((ret = recv_interlaced_message(&msg)) != ERROR_SUCCESS) {
             if (ret != ERROR_SOCKET_TIMEOUT && !srs_is_client_gracefully_close(ret)) {
                 srs_error("recv interlaced message failed. ret=%d", ret);
@@ -22035,6 +22261,93 @@ int SrsProtocol::recv_interlaced_message(SrsCommonMessage** pmsg)
     return ret;
 }
 
+int SrsProtocol::grow_entire_chunk()
+{
+    int ret = ERROR_SUCCESS;
+    
+    while (true) {
+        int size = peek_chunk_size();
+        if (size > 0 && in_buffer->size() >= size) {
+            return ret;
+        }
+        
+        // read at least 1byte, never consume, the bytes are parsed when entire.
+        if ((ret = in_buffer->grow(skt, in_buffer->size() + 1)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    
+    return ret;
+}
+
+int SrsProtocol::peek_chunk_size()
+{
+    int nb_bytes = in_buffer->size();
+    u_int8_t* p = (u_int8_t*)in_buffer->bytes();
+    
+    // basic header, @see read_basic_header
+    if (nb_bytes < 1) {
+        return 0;
+    }
+    char fmt = (p[0] >> 6) & 0x03;
+    int cid = p[0] & 0x3f;
+    int bh_size = 1;
+    if (cid == 0) {
+        bh_size = 2;
+        if (nb_bytes < bh_size) {
+            return 0;
+        }
+        cid = 64 + p[1];
+    } else if (cid == 1) {
+        bh_size = 3;
+        if (nb_bytes < bh_size) {
+            return 0;
+        }
+        cid = 64 + p[1] + p[2] * 256;
+    }
+    
+    // message header, @see read_message_header
+    static const int mh_sizes[] = {11, 7, 3, 0};
+    int mh_size = mh_sizes[(int)fmt];
+    if (nb_bytes < bh_size + mh_size) {
+        return 0;
+    }
+    u_int8_t* mh = p + bh_size;
+    
+    // the fresh chunk stream is not created until parsed,
+    // for it the fmt must be 0 or the parse fails anyway.
+    SrsChunkStream* chunk = NULL;
+    if (cid < SRS_PERF_CHUNK_STREAM_CACHE) {
+        chunk = cs_cache[cid];
+    } else if (chunk_streams.find(cid) != chunk_streams.end()) {
+        chunk = chunk_streams[cid];
+    }
+    
+    bool extended_timestamp = chunk && chunk->extended_timestamp;
+    if (fmt <= RTMP_FMT_TYPE2) {
+        int32_t timestamp_delta = (mh[0] << 16) | (mh[1] << 8) | mh[2];
+        extended_timestamp = (timestamp_delta >= RTMP_EXTENDED_TIMESTAMP);
+    }
+    
+    int32_t payload_length = chunk? chunk->header.payload_length : 0;
+    if (fmt <= RTMP_FMT_TYPE1) {
+        payload_length = (mh[3] << 16) | (mh[4] << 8) | mh[5];
+    }
+    
+    // always wait for the 4bytes extended-timestamp, although some
+    // continued chunk of ffmpeg/librtmp donot send it, for it's only the
+    // delay of 4bytes of the next chunk.
+    int size = bh_size + mh_size + (extended_timestamp? 4 : 0);
+    
+    // chunk payload, @see read_message_payload
+    int received = (chunk && chunk->msg)? chunk->msg->size : 0;
+    if (payload_length > received) {
+        size += srs_min(payload_length - received, in_chunk_size);
+    }
+    
+    return size;
+}
+
 /**
 * 6.1.1. Chunk Basic Header
 * The Chunk Basic Header encodes the chunk stream ID and the chunk
@@ -22804,6 +23117,7 @@ bool srs_client_type_is_publish(SrsRtmpConnType type)
 SrsHandshakeBytes::SrsHandshakeBytes()
 {
     c0c1 = s0s1s2 = c2 = NULL;
+    nb_s0s1s2 = 0;
 }
 
 SrsHandshakeBytes::~SrsHandshakeBytes()
@@ -22853,6 +23167,31 @@ int SrsHandshakeBytes::read_s0s1s2(ISrsProtocolReaderWriter* io)
     return ret;
 }
 
+int SrsHandshakeBytes::read_s0s1s2_nonblock(ISrsProtocolReaderWriter* io)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if (!s0s1s2) {
+        s0s1s2 = new char[3073];
+        nb_s0s1s2 = 0;
+    }
+    
+    // never read more than s0s1s2, the server sends nothing else before c2.
+    while (nb_s0s1s2 < 3073) {
+        ssize_t nsize = 0;
+        if ((ret = io->read(s0s1s2 + nb_s0s1s2, 3073 - nb_s0s1s2, &nsize)) != ERROR_SUCCESS) {
+            if (ret != ERROR_SOCKET_WOULD_BLOCK) {
+                srs_warn("read s0s1s2 failed. ret=%d", ret);
+            }
+            return ret;
+        }
+        nb_s0s1s2 += (int)nsize;
+    }
+    srs_verbose("read s0s1s2 success.");
+    
+    return ret;
+}
+
 int SrsHandshakeBytes::read_c2(ISrsProtocolReaderWriter* io)
 {
     int ret = ERROR_SUCCESS;
@@ -22976,11 +23315,33 @@ void SrsRtmpClient::set_send_timeout(int64_t timeout_us)
     protocol->set_send_timeout(timeout_us);
 }
 
+#ifdef SRS_PERF_MERGED_READ
+void SrsRtmpClient::set_merge_read(bool v, IMergeReadHandler* handler)
+{
+    protocol->set_merge_read(v, handler);
+}
+
+void SrsRtmpClient::set_recv_buffer(int buffer_size)
+{
+    protocol->set_recv_buffer(buffer_size);
+}
+#endif
+
 int64_t SrsRtmpClient::get_recv_bytes()
 {
     return protocol->get_recv_bytes();
 }
 
+int SrsRtmpClient::get_recv_buffered()
+{
+    return protocol->get_recv_buffered();
+}
+
+void SrsRtmpClient::set_nonblock(bool v)
+{
+    protocol->set_nonblock(v);
+}
+
 int64_t SrsRtmpClient::get_send_bytes()
 {
     return protocol->get_send_bytes();
@@ -23073,6 +23434,22 @@ int SrsRtmpClient::complex_handshake()
     return ret;
 }
 
+int SrsRtmpClient::simple_handshake_nonblock()
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(hs_bytes);
+    
+    SrsSimpleHandshake simple_hs;
+    if ((ret = simple_hs.handshake_with_server_nonblock(hs_bytes, io)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    srs_freep(hs_bytes);
+    
+    return ret;
+}
+
 int SrsRtmpClient::connect_app(string app, string tc_url, SrsRequest* req, bool debug_srs_upnode)
 {
     std::string srs_server_ip;
@@ -23096,6 +23473,58 @@ int SrsRtmpClient::connect_app2(
 ){
     int ret = ERROR_SUCCESS;
     
+    if ((ret = send_connect_app(app, tc_url, req, debug_srs_upnode)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    // expect connect _result
+    SrsCommonMessage* msg = NULL;
+    SrsConnectAppResPacket* pkt = NULL;
+    if ((ret = expect_message<SrsConnectAppResPacket>(&msg, &pkt)) != ERROR_SUCCESS) {
+        srs_error("expect connect app response message failed. ret=%d", ret);
+        return ret;
+    }
+    SrsAutoFree(SrsCommonMessage, msg);
+    SrsAutoFree(SrsConnectAppResPacket, pkt);
+    
+    // server info
+    SrsAmf0Any* data = pkt->info->get_property("data");
+    if (data && data->is_ecma_array()) {
+        SrsAmf0EcmaArray* arr = data->to_ecma_array();
+        
+        SrsAmf0Any* prop = NULL;
+        if ((prop = arr->ensure_property_string("srs_primary")) != NULL) {
+            srs_primary = prop->to_str();
+        }
+        if ((prop = arr->ensure_property_string("srs_authors")) != NULL) {
+            srs_authors = prop->to_str();
+        }
+        if ((prop = arr->ensure_property_string("srs_version")) != NULL) {
+            srs_version = prop->to_str();
+        }
+        if ((prop = arr->ensure_property_string("srs_server_ip")) != NULL) {
+            srs_server_ip = prop->to_str();
+        }
+        if ((prop = arr->ensure_property_string("srs_server")) != NULL) {
+            srs_server = prop->to_str();
+        }
+        if ((prop = arr->ensure_property_number("srs_id")) != NULL) {
+            srs_id = (int)prop->to_number();
+        }
+        if ((prop = arr->ensure_property_number("srs_pid")) != NULL) {
+            srs_pid = (int)prop->to_number();
+        }
+    }
+    srs_trace("connected, version=%s, ip=%s, pid=%d, id=%d, dsu=%d",
+              srs_version.c_str(), srs_server_ip.c_str(), srs_pid, srs_id, debug_srs_upnode);
+    
+    return ret;
+}
+
+int SrsRtmpClient::send_connect_app(string app, string tc_url, SrsRequest* req, bool debug_srs_upnode)
+{
+    int ret = ERROR_SUCCESS;
+    
     // Connect(vhost, app)
     if (true) {
         SrsConnectAppPacket* pkt = new SrsConnectAppPacket();
@@ -23145,47 +23574,6 @@ int SrsRtmpClient::connect_app2(
         }
     }
     
-    // expect connect _result
-    SrsCommonMessage* msg = NULL;
-    SrsConnectAppResPacket* pkt = NULL;
-    if ((ret = expect_message<SrsConnectAppResPacket>(&msg, &pkt)) != ERROR_SUCCESS) {
-        srs_error("expect connect app response message failed. ret=%d", ret);
-        return ret;
-    }
-    SrsAutoFree(SrsCommonMessage, msg);
-    SrsAutoFree(SrsConnectAppResPacket, pkt);
-    
-    // server info
-    SrsAmf0Any* data = pkt->info->get_property("data");
-    if (data && data->is_ecma_array()) {
-        SrsAmf0EcmaArray* arr = data->to_ecma_array();
-        
-        SrsAmf0Any* prop = NULL;
-        if ((prop = arr->ensure_property_string("srs_primary")) != NULL) {
-            srs_primary = prop->to_str();
-        }
-        if ((prop = arr->ensure_property_string("srs_authors")) != NULL) {
-            srs_authors = prop->to_str();
-        }
-        if ((prop = arr->ensure_property_string("srs_version")) != NULL) {
-            srs_version = prop->to_str();
-        }
-        if ((prop = arr->ensure_property_string("srs_server_ip")) != NULL) {
-            srs_server_ip = prop->to_str();
-        }
-        if ((prop = arr->ensure_property_string("srs_server")) != NULL) {
-            srs_server = prop->to_str();
-        }
-        if ((prop = arr->ensure_property_number("srs_id")) != NULL) {
-            srs_id = (int)prop->to_number();
-        }
-        if ((prop = arr->ensure_property_number("srs_pid")) != NULL) {
-            srs_pid = (int)prop->to_number();
-        }
-    }
-    srs_trace("connected, version=%s, ip=%s, pid=%d, id=%d, dsu=%d",
-              srs_version.c_str(), srs_server_ip.c_str(), srs_pid, srs_id, debug_srs_upnode);
-    
     return ret;
 }
 
@@ -23193,12 +23581,8 @@ int SrsRtmpClient::create_stream(int& stream_id)
 {
     int ret = ERROR_SUCCESS;
     
-    // CreateStream
-    if (true) {
-        SrsCreateStreamPacket* pkt = new SrsCreateStreamPacket();
-        if ((ret = protocol->send_and_free_packet(pkt, 0)) != ERROR_SUCCESS) {
-            return ret;
-        }
+    if ((ret = send_create_stream()) != ERROR_SUCCESS) {
+        return ret;
     }
     
     // CreateStream _result.
@@ -23219,6 +23603,21 @@ int SrsRtmpClient::create_stream(int& stream_id)
     return ret;
 }
 
+int SrsRtmpClient::send_create_stream()
+{
+    int ret = ERROR_SUCCESS;
+    
+    // CreateStream
+    if (true) {
+        SrsCreateStreamPacket* pkt = new SrsCreateStreamPacket();
+        if ((ret = protocol->send_and_free_packet(pkt, 0)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    
+    return ret;
+}
+
 int SrsRtmpClient::play(string stream, int stream_id)
 {
     int ret = ERROR_SUCCESS;
@@ -23304,6 +23703,32 @@ int SrsRtmpClient::fmle_publish(string stream, int& stream_id)
     
     int ret = ERROR_SUCCESS;
     
+    if ((ret = send_fmle_publish_start(stream)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    // expect result of CreateStream
+    if (true) {
+        SrsCommonMessage* msg = NULL;
+        SrsCreateStreamResPacket* pkt = NULL;
+        if ((ret = expect_message<SrsCreateStreamResPacket>(&msg, &pkt)) != ERROR_SUCCESS) {
+            srs_error("expect create stream response message failed. ret=%d", ret);
+            return ret;
+        }
+        SrsAutoFree(SrsCommonMessage, msg);
+        SrsAutoFree(SrsCreateStreamResPacket, pkt);
+        srs_info("get create stream response message");
+
+        stream_id = (int)pkt->stream_id;
+    }
+    
+    return send_fmle_publish(stream, stream_id);
+}
+
+int SrsRtmpClient::send_fmle_publish_start(string stream)
+{
+    int ret = ERROR_SUCCESS;
+    
     // SrsFMLEStartPacket
     if (true) {
         SrsFMLEStartPacket* pkt = SrsFMLEStartPacket::create_release_stream(stream);
@@ -23335,20 +23760,12 @@ int SrsRtmpClient::fmle_publish(string stream, int& stream_id)
         }
     }
     
-    // expect result of CreateStream
-    if (true) {
-        SrsCommonMessage* msg = NULL;
-        SrsCreateStreamResPacket* pkt = NULL;
-        if ((ret = expect_message<SrsCreateStreamResPacket>(&msg, &pkt)) != ERROR_SUCCESS) {
-            srs_error("expect create stream response message failed. ret=%d", ret);
-            return ret;
-        }
-        SrsAutoFree(SrsCommonMessage, msg);
-        SrsAutoFree(SrsCreateStreamResPacket, pkt);
-        srs_info("get create stream response message");
+    return ret;
+}
 
-        stream_id = (int)pkt->stream_id;
-    }
+int SrsRtmpClient::send_fmle_publish(string stream, int stream_id)
+{
+    int ret = ERROR_SUCCESS;
     
     // publish(stream)
     if (true) {
@@ -23424,6 +23841,16 @@ int64_t SrsRtmpServer::get_send_bytes()
     return protocol->get_send_bytes();
 }
 
+int SrsRtmpServer::get_recv_buffered()
+{
+    return protocol->get_recv_buffered();
+}
+
+void SrsRtmpServer::set_nonblock(bool v)
+{
+    protocol->set_nonblock(v);
+}
+
 int SrsRtmpServer::recv_message(SrsCommonMessage** pmsg)
 {
     return protocol->recv_message(pmsg);
@@ -27484,6 +27911,55 @@ int SrsSimpleHandshake::handshake_with_server(SrsHandshakeBytes* hs_bytes, ISrsP
     return ret;
 }
 
+int SrsSimpleHandshake::handshake_with_server_nonblock(SrsHandshakeBytes* hs_bytes, ISrsProtocolReaderWriter* io)
+{
+    int ret = ERROR_SUCCESS;
+    
+    ssize_t nsize;
+    
+    // the first call, the non-blocking io queues the bytes it cannot send.
+    if (!hs_bytes->c0c1) {
+        if ((ret = hs_bytes->create_c0c1()) != ERROR_SUCCESS) {
+            return ret;
+        }
+        
+        if ((ret = io->write(hs_bytes->c0c1, 1537, &nsize)) != ERROR_SUCCESS) {
+            srs_warn("write c0c1 failed. ret=%d", ret);
+            return ret;
+        }
+        srs_verbose("write c0c1 success.");
+    }
+    
+    if ((ret = hs_bytes->read_s0s1s2_nonblock(io)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    // plain text required.
+    if (hs_bytes->s0s1s2[0] != 0x03) {
+        ret = ERROR_RTMP_HANDSHAKE;
+        srs_warn("handshake failed, plain text required. ret=%d", ret);
+        return ret;
+    }
+    
+    if ((ret = hs_bytes->create_c2()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    // for simple handshake, copy s1 to c2.
+    // @see https://github.com/ossrs/srs/issues/418
+    memcpy(hs_bytes->c2, hs_bytes->s0s1s2 + 1, 1536);
+    
+    if ((ret = io->write(hs_bytes->c2, 1536, &nsize)) != ERROR_SUCCESS) {
+        srs_warn("simple handshake write c2 failed. ret=%d", ret);
+        return ret;
+    }
+    srs_verbose("simple handshake write c2 success.");
+    
+    srs_trace("simple handshake success.");
+    
+    return ret;
+}
+
 SrsComplexHandshake::SrsComplexHandshake()
 {
 }
@@ -28343,12 +28819,7 @@ int SrsRawH264Stream::annexb_demux(SrsStream* stream, char** pframe, int* pnb_fr
         
         // find the last frame prefixed by annexb format.
         stream->skip(pnb_start_code);
-        while (!stream->empty()) {
-            if (srs_avc_startswith_annexb(stream, NULL)) {
-                break;
-            }
-            stream->skip(1);
-        }
+        stream->skip(srs_avc_find_annexb(stream->data() + stream->pos(), stream->size() - stream->pos()));
         
         // demux the frame.
         *pnb_frame = stream->pos() - start;
@@ -28586,6 +29057,39 @@ int SrsRawH264Stream::mux_avc2flv(string video, int8_t frame_type, int8_t avc_pa
     return ret;
 }
 
+int SrsRawH264Stream::mux_avc2flv_inplace(char* frame, int nb_frame, int8_t frame_type, u_int32_t dts, u_int32_t pts, char** flv, int* nb_flv)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // 5bytes flv video header, 4bytes NALUnitLength,
+    // @see mux_avc2flv and mux_ipb_frame.
+    char* data = frame - 9;
+    char* p = data;
+    
+    *p++ = (frame_type << 4) | SrsCodecVideoAVC;
+    *p++ = SrsCodecVideoAVCTypeNALU;
+    
+    // cts = pts - dts.
+    u_int32_t cts = pts - dts;
+    char* pp = (char*)&cts;
+    *p++ = pp[2];
+    *p++ = pp[1];
+    *p++ = pp[0];
+    
+    // NALUnitLength, in big-endian.
+    u_int32_t NAL_unit_length = nb_frame;
+    pp = (char*)&NAL_unit_length;
+    *p++ = pp[3];
+    *p++ = pp[2];
+    *p++ = pp[1];
+    *p++ = pp[0];
+
+    *flv = data;
+    *nb_flv = nb_frame + 9;
+
+    return ret;
+}
+
 SrsRawAacStream::SrsRawAacStream()
 {
 }
@@ -28841,6 +29345,36 @@ int SrsRawAacStream::mux_aac2flv(char* frame, int nb_frame, SrsRawAacStreamCodec
     return ret;
 }
 
+int SrsRawAacStream::mux_aac2flv_inplace(char* frame, int nb_frame, SrsRawAacStreamCodec* codec, char** flv, int* nb_flv)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // 1bytes header, and 1bytes AACPacketType for aac.
+    // @see mux_aac2flv.
+    int nb_header = 1;
+    if (codec->sound_format == SrsCodecAudioAAC) {
+        nb_header += 1;
+    }
+    char* data = frame - nb_header;
+    char* p = data;
+    
+    u_int8_t audio_header = codec->sound_type & 0x01;
+    audio_header |= (codec->sound_size << 1) & 0x02;
+    audio_header |= (codec->sound_rate << 2) & 0x0c;
+    audio_header |= (codec->sound_format << 4) & 0xf0;
+    
+    *p++ = audio_header;
+    
+    if (codec->sound_format == SrsCodecAudioAAC) {
+        *p++ = codec->aac_packet_type;
+    }
+
+    *flv = data;
+    *nb_flv = nb_frame + nb_header;
+
+    return ret;
+}
+
 // following is generated by src/protocol/srs_rtsp_stack.cpp
 /*
 The MIT License (MIT)
@@ -32030,6 +32564,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <string>
 #include <sstream>
+#include <deque>
+#include <algorithm>
 using namespace std;
 
 //#include <srs_kernel_error.hpp>
@@ -32057,6 +32593,21 @@ ISrsThreadContext* _srs_context = new ISrsThreadContext();
 /**
 * export runtime context.
 */
+struct HlsContext;
+extern "C" int srs_hls_write_msg(HlsContext* hls, SrsSharedPtrMessage* msg);
+/**
+* the steps of the non-blocking connect, each waits for the response.
+*/
+enum SrsConnectState
+{
+    SrsConnectNone,
+    SrsConnectTcp,
+    SrsConnectHandshake,
+    SrsConnectApp,
+    SrsConnectStream,
+    SrsConnectDone,
+};
+
 struct Context
 {
     std::string url;
@@ -32109,6 +32660,23 @@ struct Context
     int64_t stimeout;
     int64_t rtimeout;
     
+    // whether in batch write, @see srs_rtmp_batch_begin.
+    bool batching;
+    // the messages to write when batch flush,
+    // merged to one writev by the protocol.
+    std::vector<SrsSharedPtrMessage*> batch_msgs;
+    
+    // the recv buffer size of merged read, 0 to disable,
+    // @see srs_rtmp_set_merged_read.
+    int mr_buffer_size;
+    
+    // the hls to write the packets to, not owned, @see srs_rtmp_set_hls.
+    HlsContext* hls;
+    
+    // the step of the non-blocking connect, @see srs_rtmp_connect_step.
+    SrsConnectState connect_state;
+    bool connect_publish;
+    
     Context() {
         rtmp = NULL;
         skt = NULL;
@@ -32118,6 +32686,11 @@ struct Context
         h264_sps_changed = false;
         h264_pps_changed = false;
         rtimeout = stimeout = -1;
+        batching = false;
+        mr_buffer_size = 0;
+        hls = NULL;
+        connect_state = SrsConnectNone;
+        connect_publish = false;
     }
     virtual ~Context() {
         srs_freep(req);
@@ -32130,6 +32703,13 @@ struct Context
             srs_freep(msg);
         }
         msgs.clear();
+        
+        std::vector<SrsSharedPtrMessage*>::iterator bit;
+        for (bit = batch_msgs.begin(); bit != batch_msgs.end(); ++bit) {
+            SrsSharedPtrMessage* msg = *bit;
+            srs_freep(msg);
+        }
+        batch_msgs.clear();
     }
 };
 
@@ -32587,6 +33167,223 @@ srs_rtmp_t srs_rtmp_create2(const char* url)
     return context;
 }
    
+/**
+* apply the merged read to the rtmp client, which is created when handshake.
+*/
+void srs_rtmp_apply_merged_read(Context* context)
+{
+#ifdef SRS_PERF_MERGED_READ
+    if (!context->rtmp || context->mr_buffer_size <= 0) {
+        return;
+    }
+    
+    // no handler, for the client never sleep to merge more data.
+    context->rtmp->set_merge_read(true, NULL);
+    context->rtmp->set_recv_buffer(context->mr_buffer_size);
+#endif
+}
+
+int srs_rtmp_set_merged_read(srs_rtmp_t rtmp, int buffer_size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    context->mr_buffer_size = buffer_size;
+    srs_rtmp_apply_merged_read(context);
+    
+    return ret;
+}
+
+srs_bool srs_rtmp_has_buffered(srs_rtmp_t rtmp)
+{
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    if (!context->msgs.empty()) {
+        return true;
+    }
+    
+    return context->rtmp && context->rtmp->get_recv_buffered() > 0;
+}
+
+int srs_rtmp_set_nonblock(srs_rtmp_t rtmp)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    // the client is created when handshake.
+    if (!context->rtmp) {
+        return ERROR_SYSTEM_IO_INVALID;
+    }
+    
+    if ((ret = context->skt->set_nonblock()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    context->rtmp->set_nonblock(true);
+    
+    return ret;
+}
+
+int srs_rtmp_get_fd(srs_rtmp_t rtmp)
+{
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    return context->skt->get_fd();
+}
+
+int srs_rtmp_flush(srs_rtmp_t rtmp)
+{
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    return context->skt->flush();
+}
+
+int srs_rtmp_get_send_pending(srs_rtmp_t rtmp)
+{
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    return context->skt->get_send_pending();
+}
+
+srs_bool srs_rtmp_is_would_block(int error_code)
+{
+    return error_code == ERROR_SOCKET_WOULD_BLOCK;
+}
+
+const char* srs_rtmp_get_host(srs_rtmp_t rtmp)
+{
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    srs_librtmp_context_parse_uri(context);
+    
+    return context->host.c_str();
+}
+
+int srs_rtmp_connect_nonblock(srs_rtmp_t rtmp, const char* ip, srs_bool publish)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    srs_assert(context->skt != NULL);
+    
+    // the client is created before connect, to switch both to non-blocking.
+    srs_freep(context->rtmp);
+    context->rtmp = new SrsRtmpClient(context->skt);
+    srs_rtmp_apply_merged_read(context);
+    if ((ret = srs_rtmp_set_nonblock(rtmp)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    context->ip = ip;
+    context->connect_publish = publish;
+    context->connect_state = SrsConnectTcp;
+    
+    if ((ret = srs_librtmp_context_connect(context)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    // connected at once, for example, to the loopback.
+    return srs_rtmp_connect_step(rtmp);
+}
+
+int srs_rtmp_connect_step(srs_rtmp_t rtmp)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    if (context->connect_state == SrsConnectTcp) {
+        if ((ret = context->skt->check_connect()) != ERROR_SUCCESS) {
+            return ret;
+        }
+        context->connect_state = SrsConnectHandshake;
+    }
+    
+    // the bytes the socket cannot take go first, in order.
+    if ((ret = context->skt->flush()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    if (context->connect_state == SrsConnectHandshake) {
+        if ((ret = context->rtmp->simple_handshake_nonblock()) != ERROR_SUCCESS) {
+            return ret;
+        }
+        
+        string tcUrl = srs_generate_tc_url(
+            context->ip, context->vhost, context->app, context->port,
+            context->param
+        );
+        if ((ret = context->rtmp->send_connect_app(context->app, tcUrl, context->req, true)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        context->connect_state = SrsConnectApp;
+    }
+    
+    // the non-blocking protocol parses the entire chunks only, the expect
+    // returns would block without any state changed, to go on next time.
+    if (context->connect_state == SrsConnectApp) {
+        SrsCommonMessage* msg = NULL;
+        SrsConnectAppResPacket* pkt = NULL;
+        if ((ret = context->rtmp->expect_message<SrsConnectAppResPacket>(&msg, &pkt)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        srs_freep(msg);
+        srs_freep(pkt);
+        
+        if (context->connect_publish) {
+            ret = context->rtmp->send_fmle_publish_start(context->stream);
+        } else {
+            ret = context->rtmp->send_create_stream();
+        }
+        if (ret != ERROR_SUCCESS) {
+            return ret;
+        }
+        context->connect_state = SrsConnectStream;
+    }
+    
+    if (context->connect_state == SrsConnectStream) {
+        SrsCommonMessage* msg = NULL;
+        SrsCreateStreamResPacket* pkt = NULL;
+        if ((ret = context->rtmp->expect_message<SrsCreateStreamResPacket>(&msg, &pkt)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        context->stream_id = (int)pkt->stream_id;
+        srs_freep(msg);
+        srs_freep(pkt);
+        
+        if (context->connect_publish) {
+            ret = context->rtmp->send_fmle_publish(context->stream, context->stream_id);
+        } else {
+            ret = context->rtmp->play(context->stream, context->stream_id);
+        }
+        if (ret != ERROR_SUCCESS) {
+            return ret;
+        }
+        context->connect_state = SrsConnectDone;
+    }
+    
+    return ret;
+}
+
+srs_bool srs_rtmp_connect_want_write(srs_rtmp_t rtmp)
+{
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    return context->connect_state == SrsConnectTcp || context->skt->get_send_pending() > 0;
+}
+
 int srs_rtmp_set_timeout(srs_rtmp_t rtmp, int recv_timeout_ms, int send_timeout_ms)
 {
     int ret = ERROR_SUCCESS;
@@ -32707,6 +33504,7 @@ int srs_rtmp_do_complex_handshake(srs_rtmp_t rtmp)
     // simple handshake
     srs_freep(context->rtmp);
     context->rtmp = new SrsRtmpClient(context->skt);
+    srs_rtmp_apply_merged_read(context);
     
     if ((ret = context->rtmp->complex_handshake()) != ERROR_SUCCESS) {
         return ret;
@@ -32754,6 +33552,7 @@ int srs_rtmp_do_simple_handshake(srs_rtmp_t rtmp)
     // simple handshake
     srs_freep(context->rtmp);
     context->rtmp = new SrsRtmpClient(context->skt);
+    srs_rtmp_apply_merged_read(context);
     
     if ((ret = context->rtmp->simple_handshake()) != ERROR_SUCCESS) {
         return ret;
@@ -33089,6 +33888,49 @@ int srs_rtmp_read_packet(srs_rtmp_t rtmp, char* type, u_int32_t* timestamp, char
     return ret;
 }
 
+/**
+* send out the msg, or cache it when in batch mode.
+* @remark the msg is always freed, even if error.
+*/
+int srs_rtmp_send_msg(Context* context, SrsSharedPtrMessage* msg)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(msg);
+    
+    // write to hls as well, @see srs_rtmp_set_hls.
+    if (context->hls) {
+        ret = srs_hls_write_msg(context->hls, msg);
+    }
+    
+    // never connected, the packets only go to hls.
+    if (!context->rtmp) {
+        srs_freep(msg);
+        return ret;
+    }
+    
+    // the rtmp never fails for hls.
+    ret = ERROR_SUCCESS;
+    
+    // cache the msg when batch write, sendout when flush.
+    if (context->batching) {
+        context->batch_msgs.push_back(msg);
+        
+        // flush when cache is full, for the iovs is limited.
+        if ((int)context->batch_msgs.size() >= SRS_PERF_MW_MSGS) {
+            return srs_rtmp_batch_flush(context);
+        }
+        return ret;
+    }
+
+    // send out encoded msg.
+    if ((ret = context->rtmp->send_and_free_message(msg, context->stream_id)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    return ret;
+}
+
 int srs_rtmp_write_packet(srs_rtmp_t rtmp, char type, u_int32_t timestamp, char* data, int size)
 {
     int ret = ERROR_SUCCESS;
@@ -33102,13 +33944,106 @@ int srs_rtmp_write_packet(srs_rtmp_t rtmp, char type, u_int32_t timestamp, char*
         return ret;
     }
 
-    srs_assert(msg);
+    return srs_rtmp_send_msg(context, msg);
+}
 
-    // send out encoded msg.
-    if ((ret = context->rtmp->send_and_free_message(msg, context->stream_id)) != ERROR_SUCCESS) {
+int srs_rtmp_write_packet_nocopy(srs_rtmp_t rtmp, 
+    char type, u_int32_t timestamp, char* data, int size, srs_free_t free_fn, void* param
+) {
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    srs_assert(free_fn != NULL);
+    Context* context = (Context*)rtmp;
+    
+    SrsSharedPtrMessage* msg = NULL;
+
+    // only when failed, we must free the data.
+    if ((ret = srs_do_rtmp_create_msg(type, timestamp, data, size, context->stream_id, &msg)) != ERROR_SUCCESS) {
+        free_fn(data, param);
+        return ret;
+    }
+    
+    // the payload is freed by user when msg is sent out.
+    msg->set_payload_free(free_fn, param);
+
+    return srs_rtmp_send_msg(context, msg);
+}
+
+int srs_rtmp_write_packets(srs_rtmp_t rtmp, 
+    char* types, u_int32_t* timestamps, char** datas, int* sizes, int nb_packets
+) {
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    // when already in batch, the user will flush it.
+    bool batching = context->batching;
+    if (!batching && (ret = srs_rtmp_batch_begin(rtmp)) != ERROR_SUCCESS) {
         return ret;
     }
     
+    for (int i = 0; i < nb_packets; i++) {
+        if ((ret = srs_rtmp_write_packet(rtmp, types[i], timestamps[i], datas[i], sizes[i])) != ERROR_SUCCESS) {
+            // user should never free the data, even if error.
+            for (int j = i + 1; j < nb_packets; j++) {
+                srs_freepa(datas[j]);
+            }
+            break;
+        }
+    }
+    
+    if (!batching) {
+        int r0 = srs_rtmp_batch_end(rtmp);
+        if (ret == ERROR_SUCCESS) {
+            ret = r0;
+        }
+    }
+    
+    return ret;
+}
+
+int srs_rtmp_batch_begin(srs_rtmp_t rtmp)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    context->batching = true;
+    
+    return ret;
+}
+
+int srs_rtmp_batch_flush(srs_rtmp_t rtmp)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    if (context->batch_msgs.empty()) {
+        return ret;
+    }
+    
+    // the msgs are always freed by protocol, even if error.
+    SrsSharedPtrMessage** msgs = &context->batch_msgs[0];
+    int nb_msgs = (int)context->batch_msgs.size();
+    ret = context->rtmp->send_and_free_messages(msgs, nb_msgs, context->stream_id);
+    context->batch_msgs.clear();
+    
+    return ret;
+}
+
+int srs_rtmp_batch_end(srs_rtmp_t rtmp)
+{
+    int ret = srs_rtmp_batch_flush(rtmp);
+    
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    context->batching = false;
+    
     return ret;
 }
 
@@ -33141,6 +34076,640 @@ srs_bool srs_rtmp_is_onMetaData(char type, char* data, int size)
     return false;
 }
 
+/**
+* the server side context, serve one client.
+*/
+struct SourceConsumer;
+void srs_rtmp_source_remove_consumer(SourceConsumer* consumer);
+struct ServerContext
+{
+    SimpleSocketStream* skt;
+    SrsRtmpServer* rtmp;
+    SrsRequest* req;
+    int stream_id;
+    // the source played, @see srs_rtmp_source_add_player.
+    SourceConsumer* consumer;
+    
+    ServerContext() {
+        skt = NULL;
+        rtmp = NULL;
+        req = NULL;
+        stream_id = SRS_DEFAULT_SID;
+        consumer = NULL;
+    }
+    virtual ~ServerContext() {
+        srs_freep(rtmp);
+        srs_freep(req);
+        srs_freep(skt);
+    }
+};
+
+srs_rtmp_server_t srs_rtmp_server_create(int fd)
+{
+    ServerContext* context = new ServerContext();
+    
+    context->skt = new SimpleSocketStreamImpl();
+    if (context->skt->attach(fd) != ERROR_SUCCESS) {
+        srs_freep(context);
+        return NULL;
+    }
+    
+    context->rtmp = new SrsRtmpServer(context->skt);
+    context->req = new SrsRequest();
+    
+    return context;
+}
+
+void srs_rtmp_server_destroy(srs_rtmp_server_t server)
+{
+    if (!server) {
+        return;
+    }
+    
+    ServerContext* context = (ServerContext*)server;
+    
+    if (context->consumer) {
+        srs_rtmp_source_remove_consumer(context->consumer);
+    }
+    
+    srs_freep(context);
+}
+
+int srs_rtmp_server_set_timeout(srs_rtmp_server_t server, int recv_timeout_ms, int send_timeout_ms)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if (!server) {
+        return ret;
+    }
+    
+    ServerContext* context = (ServerContext*)server;
+    
+    context->rtmp->set_recv_timeout(recv_timeout_ms * 1000LL);
+    context->rtmp->set_send_timeout(send_timeout_ms * 1000LL);
+    
+    return ret;
+}
+
+int srs_rtmp_server_accept(srs_rtmp_server_t server, srs_bool* publish)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    SrsRtmpServer* rtmp = context->rtmp;
+    SrsRequest* req = context->req;
+    
+    if ((ret = rtmp->handshake()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = rtmp->connect_app(req)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    // the same to the connect response of srs.
+    if ((ret = rtmp->set_window_ack_size((int)(2.5 * 1000 * 1000))) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = rtmp->set_peer_bandwidth((int)(2.5 * 1000 * 1000), 2)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = rtmp->response_connect_app(req, NULL)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = rtmp->on_bw_done()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    SrsRtmpConnType type;
+    if ((ret = rtmp->identify_client(context->stream_id, type, req->stream, req->duration)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    req->strip();
+    
+    // large chunk to send less chunk headers.
+    if ((ret = rtmp->set_chunk_size(SRS_CONSTS_RTMP_SRS_CHUNK_SIZE)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    switch (type) {
+        case SrsRtmpConnPlay:
+            ret = rtmp->start_play(context->stream_id);
+            break;
+        case SrsRtmpConnFMLEPublish:
+            ret = rtmp->start_fmle_publish(context->stream_id);
+            break;
+        case SrsRtmpConnFlashPublish:
+            ret = rtmp->start_flash_publish(context->stream_id);
+            break;
+        default:
+            ret = ERROR_SYSTEM_CLIENT_INVALID;
+            break;
+    }
+    if (ret != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    *publish = srs_client_type_is_publish(type);
+    
+    return ret;
+}
+
+const char* srs_rtmp_server_get_app(srs_rtmp_server_t server)
+{
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    return context->req->app.c_str();
+}
+
+const char* srs_rtmp_server_get_stream(srs_rtmp_server_t server)
+{
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    return context->req->stream.c_str();
+}
+
+int srs_rtmp_server_read_packet(srs_rtmp_server_t server, 
+    char* type, u_int32_t* timestamp, char** data, int* size
+) {
+    *type = 0;
+    *timestamp = 0;
+    *data = NULL;
+    *size = 0;
+    
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    SrsCommonMessage* msg = NULL;
+    while (!msg) {
+        if ((ret = context->rtmp->recv_message(&msg)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    SrsAutoFree(SrsCommonMessage, msg);
+    
+    if (msg->header.is_audio()) {
+        *type = SRS_RTMP_TYPE_AUDIO;
+    } else if (msg->header.is_video()) {
+        *type = SRS_RTMP_TYPE_VIDEO;
+    } else if (msg->header.is_amf0_data() || msg->header.is_amf3_data()) {
+        *type = SRS_RTMP_TYPE_SCRIPT;
+    } else {
+        *type = msg->header.message_type;
+    }
+    *timestamp = (u_int32_t)msg->header.timestamp;
+    *data = (char*)msg->payload;
+    *size = (int)msg->size;
+    // detach bytes from packet.
+    msg->payload = NULL;
+    
+    return ret;
+}
+
+int srs_rtmp_server_write_packet(srs_rtmp_server_t server, 
+    char type, u_int32_t timestamp, char* data, int size
+) {
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    SrsSharedPtrMessage* msg = NULL;
+    if ((ret = srs_rtmp_create_msg(type, timestamp, data, size, context->stream_id, &msg)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    return context->rtmp->send_and_free_message(msg, context->stream_id);
+}
+
+int srs_rtmp_server_set_nonblock(srs_rtmp_server_t server)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    if ((ret = context->skt->set_nonblock()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    context->rtmp->set_nonblock(true);
+    
+    return ret;
+}
+
+int srs_rtmp_server_get_fd(srs_rtmp_server_t server)
+{
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    return context->skt->get_fd();
+}
+
+int srs_rtmp_server_flush(srs_rtmp_server_t server)
+{
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    return context->skt->flush();
+}
+
+int srs_rtmp_server_get_send_pending(srs_rtmp_server_t server)
+{
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    return context->skt->get_send_pending();
+}
+
+srs_bool srs_rtmp_server_has_buffered(srs_rtmp_server_t server)
+{
+    srs_assert(server != NULL);
+    ServerContext* context = (ServerContext*)server;
+    
+    return context->rtmp->get_recv_buffered() > 0;
+}
+
+/**
+* the live source, the gop cache and the players.
+*/
+struct SourceContext;
+struct SourceConsumer
+{
+    SourceContext* source;
+    ServerContext* server;
+    // the copies of shared messages to send.
+    std::deque<SrsSharedPtrMessage*> queue;
+    // after the queue is shrinked, drop the av until the keyframe.
+    bool wait_keyframe;
+    // the messages dropped since last send.
+    int nb_dropped;
+    // the timestamp of the queued av, the sequence headers excluded,
+    // for they are stale.
+    int64_t av_start_time;
+    int64_t av_end_time;
+    
+    SourceConsumer() {
+        source = NULL;
+        server = NULL;
+        wait_keyframe = false;
+        nb_dropped = 0;
+        av_start_time = av_end_time = -1;
+    }
+    virtual ~SourceConsumer() {
+        clear();
+    }
+    
+    void clear() {
+        std::deque<SrsSharedPtrMessage*>::iterator it;
+        for (it = queue.begin(); it != queue.end(); ++it) {
+            SrsSharedPtrMessage* msg = *it;
+            srs_freep(msg);
+        }
+        queue.clear();
+        av_start_time = av_end_time = -1;
+    }
+    
+    int64_t duration() {
+        if (av_start_time < 0) {
+            return 0;
+        }
+        return av_end_time - av_start_time;
+    }
+};
+
+// the audio packets after the last video, to guess the pure audio stream.
+#define SRS_SOURCE_PURE_AUDIO_GUESS_COUNT 115
+
+struct SourceContext
+{
+    bool gop_cache;
+    int64_t queue_ms;
+    SrsSharedPtrMessage* metadata;
+    SrsSharedPtrMessage* video_sh;
+    SrsSharedPtrMessage* audio_sh;
+    // the gop from the last keyframe, or the audio of pure audio stream.
+    std::vector<SrsSharedPtrMessage*> gop;
+    int audio_after_last_video;
+    bool cached_video;
+    std::vector<SourceConsumer*> consumers;
+    
+    SourceContext() {
+        gop_cache = SRS_PERF_GOP_CACHE;
+        queue_ms = SRS_PERF_PLAY_QUEUE * 1000;
+        metadata = video_sh = audio_sh = NULL;
+        audio_after_last_video = 0;
+        cached_video = false;
+    }
+    virtual ~SourceContext() {
+        for (int i = 0; i < (int)consumers.size(); i++) {
+            SourceConsumer* consumer = consumers[i];
+            consumer->server->consumer = NULL;
+            srs_freep(consumer);
+        }
+        consumers.clear();
+        clear_gop();
+        srs_freep(metadata);
+        srs_freep(video_sh);
+        srs_freep(audio_sh);
+    }
+    
+    void clear_gop() {
+        for (int i = 0; i < (int)gop.size(); i++) {
+            SrsSharedPtrMessage* msg = gop[i];
+            srs_freep(msg);
+        }
+        gop.clear();
+        cached_video = false;
+        audio_after_last_video = 0;
+    }
+    
+    // @see SrsGopCache::cache of srs.
+    void cache(SrsSharedPtrMessage* msg) {
+        if (!gop_cache) {
+            return;
+        }
+        
+        if (msg->is_video()) {
+            // a gop starts at the keyframe.
+            if (SrsFlvCodec::video_is_keyframe(msg->payload, msg->size)) {
+                clear_gop();
+            } else if (!cached_video) {
+                return;
+            }
+            cached_video = true;
+            audio_after_last_video = 0;
+        }
+        
+        // the audio of a video stream is cached after the keyframe,
+        // the pure audio stream is cached in the count of guess.
+        if (msg->is_audio()) {
+            if (cached_video) {
+                audio_after_last_video++;
+            } else if ((int)gop.size() >= SRS_SOURCE_PURE_AUDIO_GUESS_COUNT) {
+                clear_gop();
+            }
+        }
+        if (cached_video && audio_after_last_video > SRS_SOURCE_PURE_AUDIO_GUESS_COUNT) {
+            clear_gop();
+            return;
+        }
+        
+        // the large gop is not cached, for the player drops it anyway.
+        if (!gop.empty() && msg->timestamp - gop[0]->timestamp > queue_ms) {
+            clear_gop();
+            return;
+        }
+        
+        gop.push_back(msg->copy());
+    }
+    
+    // queue the copy of msg to consumer, shrink the queue when full.
+    void enqueue(SourceConsumer* consumer, SrsSharedPtrMessage* msg) {
+        bool sh = msg == metadata || msg == video_sh || msg == audio_sh;
+        
+        if (!sh && consumer->wait_keyframe) {
+            if (!msg->is_video() || !SrsFlvCodec::video_is_keyframe(msg->payload, msg->size)) {
+                consumer->nb_dropped++;
+                return;
+            }
+            consumer->wait_keyframe = false;
+        }
+        
+        consumer->queue.push_back(msg->copy());
+        if (!sh && msg->is_av()) {
+            if (consumer->av_start_time < 0) {
+                consumer->av_start_time = msg->timestamp;
+            }
+            consumer->av_end_time = msg->timestamp;
+        }
+        
+        // @see SrsMessageQueue::shrink of srs, keep the sequence headers only.
+        if (consumer->duration() > queue_ms) {
+            consumer->nb_dropped += (int)consumer->queue.size();
+            consumer->clear();
+            if (metadata) {
+                consumer->queue.push_back(metadata->copy());
+            }
+            if (video_sh) {
+                consumer->queue.push_back(video_sh->copy());
+            }
+            if (audio_sh) {
+                consumer->queue.push_back(audio_sh->copy());
+            }
+            consumer->nb_dropped -= (int)consumer->queue.size();
+            consumer->wait_keyframe = true;
+        }
+    }
+};
+
+srs_rtmp_source_t srs_rtmp_source_create(srs_bool gop_cache, int queue_ms)
+{
+    SourceContext* context = new SourceContext();
+    
+    context->gop_cache = gop_cache;
+    if (queue_ms > 0) {
+        context->queue_ms = queue_ms;
+    }
+    
+    return context;
+}
+
+void srs_rtmp_source_destroy(srs_rtmp_source_t source)
+{
+    if (!source) {
+        return;
+    }
+    
+    SourceContext* context = (SourceContext*)source;
+    
+    srs_freep(context);
+}
+
+int srs_rtmp_source_on_packet(srs_rtmp_source_t source, 
+    char type, u_int32_t timestamp, char* data, int size
+) {
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(source != NULL);
+    SourceContext* context = (SourceContext*)source;
+    
+    if (type != SRS_RTMP_TYPE_AUDIO && type != SRS_RTMP_TYPE_VIDEO && type != SRS_RTMP_TYPE_SCRIPT) {
+        srs_freepa(data);
+        return ret;
+    }
+    
+    // the @setDataFrame of publisher is sent as onMetaData to players.
+    if (type == SRS_RTMP_TYPE_SCRIPT) {
+        if (!srs_rtmp_is_onMetaData(type, data, size)) {
+            srs_freepa(data);
+            return ret;
+        }
+        
+        SrsStream stream;
+        std::string name;
+        if (stream.initialize(data, size) == ERROR_SUCCESS 
+            && srs_amf0_read_string(&stream, name) == ERROR_SUCCESS
+            && name == SRS_CONSTS_RTMP_SET_DATAFRAME
+        ) {
+            int left = size - stream.pos();
+            char* metadata = new char[left];
+            memcpy(metadata, data + stream.pos(), left);
+            srs_freepa(data);
+            data = metadata;
+            size = left;
+        }
+    }
+    
+    SrsSharedPtrMessage* msg = NULL;
+    if ((ret = srs_rtmp_create_msg(type, timestamp, data, size, SRS_DEFAULT_SID, &msg)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    SrsAutoFree(SrsSharedPtrMessage, msg);
+    
+    // the sequence headers and metadata are cached for new players,
+    // and are kept when the queue of player is shrinked.
+    SrsSharedPtrMessage** cached = NULL;
+    if (type == SRS_RTMP_TYPE_SCRIPT) {
+        cached = &context->metadata;
+    } else if (msg->is_video() && SrsFlvCodec::video_is_sequence_header(msg->payload, msg->size)) {
+        cached = &context->video_sh;
+    } else if (msg->is_audio() && SrsFlvCodec::audio_is_sequence_header(msg->payload, msg->size)) {
+        cached = &context->audio_sh;
+    }
+    if (cached) {
+        srs_freep(*cached);
+        *cached = msg->copy();
+    } else {
+        context->cache(msg);
+    }
+    
+    SrsSharedPtrMessage* shared = cached? *cached : msg;
+    for (int i = 0; i < (int)context->consumers.size(); i++) {
+        context->enqueue(context->consumers[i], shared);
+    }
+    
+    return ret;
+}
+
+int srs_rtmp_source_add_player(srs_rtmp_source_t source, srs_rtmp_server_t server)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(source != NULL && server != NULL);
+    SourceContext* context = (SourceContext*)source;
+    ServerContext* player = (ServerContext*)server;
+    
+    if (player->consumer) {
+        return ERROR_SYSTEM_CLIENT_INVALID;
+    }
+    
+    SourceConsumer* consumer = new SourceConsumer();
+    consumer->source = context;
+    consumer->server = player;
+    player->consumer = consumer;
+    context->consumers.push_back(consumer);
+    
+    // @see SrsSource::create_consumer of srs.
+    if (context->metadata) {
+        context->enqueue(consumer, context->metadata);
+    }
+    if (context->video_sh) {
+        context->enqueue(consumer, context->video_sh);
+    }
+    if (context->audio_sh) {
+        context->enqueue(consumer, context->audio_sh);
+    }
+    for (int i = 0; i < (int)context->gop.size(); i++) {
+        context->enqueue(consumer, context->gop[i]);
+    }
+    
+    return ret;
+}
+
+void srs_rtmp_source_remove_consumer(SourceConsumer* consumer)
+{
+    SourceContext* context = consumer->source;
+    
+    std::vector<SourceConsumer*>::iterator it;
+    it = std::find(context->consumers.begin(), context->consumers.end(), consumer);
+    if (it != context->consumers.end()) {
+        context->consumers.erase(it);
+    }
+    
+    consumer->server->consumer = NULL;
+    srs_freep(consumer);
+}
+
+void srs_rtmp_source_remove_player(srs_rtmp_source_t source, srs_rtmp_server_t server)
+{
+    srs_assert(source != NULL && server != NULL);
+    ServerContext* player = (ServerContext*)server;
+    
+    if (player->consumer && player->consumer->source == (SourceContext*)source) {
+        srs_rtmp_source_remove_consumer(player->consumer);
+    }
+}
+
+int srs_rtmp_source_get_players(srs_rtmp_source_t source)
+{
+    srs_assert(source != NULL);
+    SourceContext* context = (SourceContext*)source;
+    
+    return (int)context->consumers.size();
+}
+
+int srs_rtmp_source_send(srs_rtmp_source_t source, srs_rtmp_server_t server, int* nb_dropped)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(source != NULL && server != NULL);
+    ServerContext* player = (ServerContext*)server;
+    SourceConsumer* consumer = player->consumer;
+    
+    if (!consumer || consumer->source != (SourceContext*)source) {
+        return ERROR_SYSTEM_CLIENT_INVALID;
+    }
+    
+    if (nb_dropped) {
+        *nb_dropped = consumer->nb_dropped;
+    }
+    consumer->nb_dropped = 0;
+    
+    // the protocol frees the msgs, even if error.
+    SrsSharedPtrMessage* msgs[SRS_PERF_MW_MSGS];
+    while (!consumer->queue.empty() && player->skt->get_send_pending() == 0) {
+        int nb_msgs = 0;
+        while (nb_msgs < SRS_PERF_MW_MSGS && !consumer->queue.empty()) {
+            msgs[nb_msgs++] = consumer->queue.front();
+            consumer->queue.pop_front();
+        }
+        if ((ret = player->rtmp->send_and_free_messages(msgs, nb_msgs, player->stream_id)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    
+    // the queue starts at the first left.
+    if (consumer->queue.empty()) {
+        consumer->av_start_time = consumer->av_end_time = -1;
+    } else {
+        consumer->av_start_time = consumer->queue.front()->timestamp;
+    }
+    
+    return ret;
+}
+
+srs_bool srs_rtmp_source_has_queued(srs_rtmp_source_t source, srs_rtmp_server_t server)
+{
+    srs_assert(source != NULL && server != NULL);
+    ServerContext* player = (ServerContext*)server;
+    
+    return player->consumer && !player->consumer->queue.empty();
+}
+
 /**
 * directly write a audio frame.
 */
@@ -33158,6 +34727,29 @@ int srs_write_audio_raw_frame(Context* context,
     return srs_rtmp_write_packet(context, SRS_RTMP_TYPE_AUDIO, timestamp, data, size);
 }
 
+/**
+* write aac sequence header if not sent.
+*/
+int srs_write_aac_sequence_header(Context* context, 
+    SrsRawAacStreamCodec* codec, u_int32_t timestamp
+) {
+    int ret = ERROR_SUCCESS;
+    
+    if (!context->aac_specific_config.empty()) {
+        return ret;
+    }
+    
+    std::string sh;
+    if ((ret = context->aac_raw.mux_sequence_header(codec, sh)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    context->aac_specific_config = sh;
+
+    codec->aac_packet_type = 0;
+
+    return srs_write_audio_raw_frame(context, (char*)sh.data(), (int)sh.length(), codec, timestamp);
+}
+
 /**
 * write aac frame in adts.
 */
@@ -33167,18 +34759,8 @@ int srs_write_aac_adts_frame(Context* context,
     int ret = ERROR_SUCCESS;
     
     // send out aac sequence header if not sent.
-    if (context->aac_specific_config.empty()) {
-        std::string sh;
-        if ((ret = context->aac_raw.mux_sequence_header(codec, sh)) != ERROR_SUCCESS) {
-            return ret;
-        }
-        context->aac_specific_config = sh;
-
-        codec->aac_packet_type = 0;
-
-        if ((ret = srs_write_audio_raw_frame(context, (char*)sh.data(), (int)sh.length(), codec, timestamp)) != ERROR_SUCCESS) {
-            return ret;
-        }
+    if ((ret = srs_write_aac_sequence_header(context, codec, timestamp)) != ERROR_SUCCESS) {
+        return ret;
     }
     
     codec->aac_packet_type = 1;
@@ -33260,6 +34842,62 @@ int srs_audio_write_raw_frame(srs_rtmp_t rtmp,
     return ret;
 }
 
+int srs_audio_write_raw_frame_nocopy(srs_rtmp_t rtmp, 
+    char sound_format, char sound_rate, char sound_size, char sound_type,
+    char* frame, int frame_size, u_int32_t timestamp, srs_free_t free_fn, void* param
+) {
+    int ret = ERROR_SUCCESS;
+    
+    Context* context = (Context*)rtmp;
+    srs_assert(context);
+    srs_assert(free_fn != NULL);
+    
+    // only one adts frame can be muxed in place, over the tail of adts header,
+    // others use the copy path.
+    if (sound_format != SrsCodecAudioAAC
+        || srs_aac_adts_frame_size(frame, frame_size) != frame_size
+    ) {
+        ret = srs_audio_write_raw_frame(rtmp, sound_format, sound_rate, sound_size, sound_type, 
+            frame, frame_size, timestamp);
+        free_fn(frame, param);
+        return ret;
+    }
+    
+    char* raw = NULL;
+    int raw_size = 0;
+    SrsRawAacStreamCodec codec;
+    SrsStream* stream = &context->aac_raw_stream;
+    if ((ret = stream->initialize(frame, frame_size)) != ERROR_SUCCESS
+        || (ret = context->aac_raw.adts_demux(stream, &raw, &raw_size, codec)) != ERROR_SUCCESS
+    ) {
+        free_fn(frame, param);
+        return ret;
+    }
+    
+    // override by user specified.
+    codec.sound_format = sound_format;
+    codec.sound_rate = sound_rate;
+    codec.sound_size = sound_size;
+    codec.sound_type = sound_type;
+    
+    // send out aac sequence header if not sent.
+    if ((ret = srs_write_aac_sequence_header(context, &codec, timestamp)) != ERROR_SUCCESS) {
+        free_fn(frame, param);
+        return ret;
+    }
+    
+    codec.aac_packet_type = 1;
+    
+    char* flv = NULL;
+    int nb_flv = 0;
+    if ((ret = context->aac_raw.mux_aac2flv_inplace(raw, raw_size, &codec, &flv, &nb_flv)) != ERROR_SUCCESS) {
+        free_fn(frame, param);
+        return ret;
+    }
+    
+    return srs_rtmp_write_packet_nocopy(rtmp, SRS_RTMP_TYPE_AUDIO, timestamp, flv, nb_flv, free_fn, param);
+}
+
 /**
 * whether aac raw data is in adts format,
 * which bytes sequence matches '1111 1111 1111'B, that is 0xFFF.
@@ -33505,6 +35143,60 @@ int srs_h264_write_raw_frames(srs_rtmp_t rtmp,
     return error_code_return;
 }
 
+int srs_h264_write_raw_frame_nocopy(srs_rtmp_t rtmp, 
+    char* frame, int frame_size, u_int32_t dts, u_int32_t pts, srs_free_t free_fn, void* param
+) {
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    srs_assert(free_fn != NULL);
+    Context* context = (Context*)rtmp;
+    
+    // empty frame.
+    if (frame_size <= 0) {
+        free_fn(frame, param);
+        return ret;
+    }
+    
+    // sps/pps are cached by context, others are ignored, use the copy path.
+    SrsAvcNaluType nut = (SrsAvcNaluType)(frame[0] & 0x1f);
+    if (nut != SrsAvcNaluTypeIDR && nut != SrsAvcNaluTypeNonIDR) {
+        ret = srs_write_h264_raw_frame(context, frame, frame_size, dts, pts);
+        free_fn(frame, param);
+        return ret;
+    }
+    
+    // send pps+sps before ipb frames when sps/pps changed.
+    if ((ret = srs_write_h264_sps_pps(context, dts, pts)) != ERROR_SUCCESS) {
+        free_fn(frame, param);
+        return ret;
+    }
+    
+    // when sps or pps not sent, ignore the packet.
+    // @see https://github.com/ossrs/srs/issues/203
+    if (!context->h264_sps_pps_sent) {
+        free_fn(frame, param);
+        return ERROR_H264_DROP_BEFORE_SPS_PPS;
+    }
+    
+    // for IDR frame, the frame is keyframe.
+    SrsCodecVideoAVCFrame frame_type = SrsCodecVideoAVCFrameInterFrame;
+    if (nut == SrsAvcNaluTypeIDR) {
+        frame_type = SrsCodecVideoAVCFrameKeyFrame;
+    }
+    
+    char* flv = NULL;
+    int nb_flv = 0;
+    if ((ret = context->avc_raw.mux_avc2flv_inplace(frame, frame_size, frame_type, dts, pts, &flv, &nb_flv)) != ERROR_SUCCESS) {
+        free_fn(frame, param);
+        return ret;
+    }
+    
+    // the timestamp in rtmp message header is dts.
+    u_int32_t timestamp = dts;
+    return srs_rtmp_write_packet_nocopy(rtmp, SRS_RTMP_TYPE_VIDEO, timestamp, flv, nb_flv, free_fn, param);
+}
+
 srs_bool srs_h264_is_dvbsp_error(int error_code)
 {
     return error_code == ERROR_H264_DROP_BEFORE_SPS_PPS;
@@ -33530,6 +35222,34 @@ srs_bool srs_h264_startswith_annexb(char* h264_raw_data, int h264_raw_size, int*
     return srs_avc_startswith_annexb(&stream, pnb_start_code);
 }
 
+int srs_h264_scan_nalus(char* h264_raw_data, int h264_raw_size, int* nalus, int* nb_nalus, int max_nalus)
+{
+    int count = 0;
+    
+    int nb_start_code = 0;
+    int pos = srs_avc_find_annexb(h264_raw_data, h264_raw_size, &nb_start_code);
+    
+    while (pos < h264_raw_size && count < max_nalus) {
+        int start = pos + nb_start_code;
+        
+        // the last one contains all left data.
+        if (count == max_nalus - 1) {
+            pos = h264_raw_size;
+        } else {
+            pos = start + srs_avc_find_annexb(h264_raw_data + start, h264_raw_size - start, &nb_start_code);
+        }
+        
+        // ignore the empty NALU.
+        if (pos > start) {
+            nalus[count] = start;
+            nb_nalus[count] = pos - start;
+            count++;
+        }
+    }
+    
+    return count;
+}
+
 struct FlvContext
 {
     SrsFileReader reader;
@@ -33713,6 +35433,566 @@ srs_bool srs_flv_is_keyframe(char* data, int32_t size)
     return SrsFlvCodec::video_is_keyframe(data, (int)size);
 }
 
+/**
+* the default min duration of hls segment in ms, @see srs_hls_open.
+*/
+#define SRS_HLS_FRAGMENT_MS 10000
+/**
+* the buffer of the ts segment writer, the multiple of both the ts packet
+* and the 4KB page, so each write to file is whole packets and pages.
+*/
+#define SRS_HLS_WRITE_BUFFER (188 * 1024)
+/**
+* reap the segment at any frame when it's longer than the fragment of this
+* ratio, for the pure audio or the video stalled, @see hls_aof_ratio of srs.
+*/
+#define SRS_HLS_AOF_RATIO 2
+/**
+* the segments kept on disk after removed from the playlist,
+* for the players which got the playlist before.
+*/
+#define SRS_HLS_DELETE_DELAY 1
+
+/**
+* the buffered writer of ts segment, the ts muxer writes 188B each time.
+*/
+class SrsHlsFileWriter : public SrsFileWriter
+{
+private:
+    char* buf;
+    int nb_buf;
+public:
+    SrsHlsFileWriter() {
+        buf = new char[SRS_HLS_WRITE_BUFFER];
+        nb_buf = 0;
+    }
+    virtual ~SrsHlsFileWriter() {
+        close();
+        srs_freepa(buf);
+    }
+public:
+    virtual int open(std::string p) {
+        nb_buf = 0;
+        return SrsFileWriter::open(p);
+    }
+    virtual void close() {
+        flush();
+        SrsFileWriter::close();
+    }
+    virtual int64_t tellg() {
+        return SrsFileWriter::tellg() + nb_buf;
+    }
+    virtual int write(void* data, size_t count, ssize_t* pnwrite) {
+        int ret = ERROR_SUCCESS;
+        
+        char* p = (char*)data;
+        int left = (int)count;
+        while (left > 0) {
+            int nb_copy = srs_min(left, SRS_HLS_WRITE_BUFFER - nb_buf);
+            memcpy(buf + nb_buf, p, nb_copy);
+            nb_buf += nb_copy;
+            p += nb_copy;
+            left -= nb_copy;
+            
+            if (nb_buf == SRS_HLS_WRITE_BUFFER && (ret = flush()) != ERROR_SUCCESS) {
+                return ret;
+            }
+        }
+        
+        if (pnwrite != NULL) {
+            *pnwrite = (ssize_t)count;
+        }
+        
+        return ret;
+    }
+    /**
+    * write the buffered bytes to file.
+    */
+    virtual int flush() {
+        int ret = ERROR_SUCCESS;
+        
+        if (nb_buf <= 0 || !is_open()) {
+            nb_buf = 0;
+            return ret;
+        }
+        
+        ssize_t nwrite = 0;
+        if ((ret = SrsFileWriter::write(buf, nb_buf, &nwrite)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        // short write of file, generally the disk is full.
+        if (nwrite != nb_buf) {
+            ret = ERROR_SYSTEM_FILE_WRITE;
+            srs_error("hls write %d bytes, only %d written. ret=%d", nb_buf, (int)nwrite, ret);
+            return ret;
+        }
+        nb_buf = 0;
+        
+        return ret;
+    }
+};
+
+/**
+* a completed segment of hls.
+*/
+struct HlsSegment
+{
+    int sequence_no;
+    // the duration in ms.
+    int64_t duration;
+    // the uri in playlist, the file name in the dir of playlist.
+    std::string uri;
+};
+
+struct HlsContext
+{
+    // the path of playlist, the segments are dir/name-sequence_no.ts
+    std::string m3u8;
+    std::string dir;
+    std::string name;
+    int fragment_ms;
+    int window;
+    
+    SrsAvcAacCodec codec;
+    SrsCodecSample sample;
+    // the video frame is cached until all its slices got.
+    SrsTsCache cache;
+    SrsTsContext context;
+    SrsHlsFileWriter writer;
+    // the muxer of current segment, the segment is open when writer is open.
+    SrsTSMuxer* muxer;
+    
+    // the segments on disk, the last window ones are in playlist.
+    std::deque<HlsSegment> segments;
+    int sequence_no;
+    // the dts of current segment, in 90khz.
+    int64_t segment_start;
+    int64_t segment_end;
+    // whether got the video, the segments start at keyframe.
+    bool has_video;
+    // the timestamp of the first packet, the dts is rebased to it.
+    bool got_base;
+    u_int32_t base;
+    
+    HlsContext() {
+        fragment_ms = SRS_HLS_FRAGMENT_MS;
+        window = 0;
+        muxer = NULL;
+        sequence_no = 0;
+        segment_start = segment_end = 0;
+        has_video = false;
+        got_base = false;
+        base = 0;
+    }
+    virtual ~HlsContext() {
+        srs_freep(muxer);
+    }
+};
+
+int srs_hls_rename(const std::string& from, const std::string& to)
+{
+    int ret = ERROR_SUCCESS;
+    
+#ifdef _WIN32
+    // rename never replace the file on windows.
+    ::remove(to.c_str());
+#endif
+    
+    if (::rename(from.c_str(), to.c_str()) < 0) {
+        ret = ERROR_SYSTEM_FILE_RENAME;
+        srs_error("hls rename %s to %s failed. ret=%d", from.c_str(), to.c_str(), ret);
+        return ret;
+    }
+    
+    return ret;
+}
+
+/**
+* write the playlist to a temp file, then rename to it.
+* @param ended whether the stream is ended, no more segments.
+*/
+int srs_hls_write_m3u8(HlsContext* hls, bool ended)
+{
+    int ret = ERROR_SUCCESS;
+    
+    int nb_segments = (int)hls->segments.size();
+    int first = 0;
+    if (hls->window > 0 && nb_segments > hls->window) {
+        first = nb_segments - hls->window;
+    }
+    
+    int64_t target = 0;
+    for (int i = first; i < nb_segments; i++) {
+        target = srs_max(target, hls->segments[i].duration);
+    }
+    
+    std::stringstream ss;
+    ss << "#EXTM3U" << SRS_CONSTS_LF
+        << "#EXT-X-VERSION:3" << SRS_CONSTS_LF
+        << "#EXT-X-MEDIA-SEQUENCE:" << (first < nb_segments? hls->segments[first].sequence_no : hls->sequence_no) << SRS_CONSTS_LF
+        << "#EXT-X-TARGETDURATION:" << (target + 999) / 1000 << SRS_CONSTS_LF;
+    // all segments are kept, the players can seek in it.
+    if (hls->window <= 0) {
+        ss << "#EXT-X-PLAYLIST-TYPE:EVENT" << SRS_CONSTS_LF;
+    }
+    
+    for (int i = first; i < nb_segments; i++) {
+        HlsSegment* segment = &hls->segments[i];
+        char extinf[64];
+        snprintf(extinf, sizeof(extinf), "#EXTINF:%.3f,", segment->duration / 1000.0);
+        ss << extinf << SRS_CONSTS_LF << segment->uri << SRS_CONSTS_LF;
+    }
+    
+    if (ended) {
+        ss << "#EXT-X-ENDLIST" << SRS_CONSTS_LF;
+    }
+    
+    std::string tmp = hls->m3u8 + ".tmp";
+    std::string m3u8 = ss.str();
+    
+    SrsFileWriter writer;
+    if ((ret = writer.open(tmp)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = writer.write((void*)m3u8.data(), m3u8.length(), NULL)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    writer.close();
+    
+    return srs_hls_rename(tmp, hls->m3u8);
+}
+
+/**
+* write the cached video frame to segment.
+*/
+int srs_hls_flush_video(HlsContext* hls)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if (!hls->cache.video) {
+        return ret;
+    }
+    
+    ret = hls->muxer->write_video(hls->cache.video);
+    srs_freep(hls->cache.video);
+    
+    return ret;
+}
+
+/**
+* open a segment to name-sequence_no.ts.tmp, start at dts.
+*/
+int srs_hls_open_segment(HlsContext* hls, int64_t dts)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // the pure audio segment has no video pid, @see SrsTsContext::encode.
+    SrsCodecVideo vcodec = hls->has_video? SrsCodecVideoAVC : SrsCodecVideoDisabled;
+    srs_freep(hls->muxer);
+    hls->muxer = new SrsTSMuxer(&hls->writer, &hls->context, SrsCodecAudioAAC, vcodec);
+    
+    std::stringstream ss;
+    ss << hls->dir << hls->name << "-" << hls->sequence_no << ".ts.tmp";
+    if ((ret = hls->muxer->open(ss.str())) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    hls->segment_start = hls->segment_end = dts;
+    
+    return ret;
+}
+
+/**
+* complete the current segment at dts, rename it to name-sequence_no.ts,
+* and delete the segments out of window.
+*/
+int srs_hls_close_segment(HlsContext* hls, int64_t dts)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // the last frame of segment.
+    if ((ret = srs_hls_flush_video(hls)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    if ((ret = hls->writer.flush()) != ERROR_SUCCESS) {
+        return ret;
+    }
+    hls->muxer->close();
+    
+    std::stringstream ss;
+    ss << hls->name << "-" << hls->sequence_no << ".ts";
+    
+    HlsSegment segment;
+    segment.sequence_no = hls->sequence_no++;
+    segment.duration = (dts - hls->segment_start) / 90;
+    segment.uri = ss.str();
+    
+    std::string path = hls->dir + segment.uri;
+    if ((ret = srs_hls_rename(path + ".tmp", path)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    hls->segments.push_back(segment);
+    
+    while (hls->window > 0 && (int)hls->segments.size() > hls->window + SRS_HLS_DELETE_DELAY) {
+        std::string expired = hls->dir + hls->segments.front().uri;
+        ::remove(expired.c_str());
+        hls->segments.pop_front();
+    }
+    
+    return ret;
+}
+
+/**
+* complete the current segment and start a new one at dts.
+*/
+int srs_hls_reap_segment(HlsContext* hls, int64_t dts)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if ((ret = srs_hls_close_segment(hls, dts)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    if ((ret = srs_hls_write_m3u8(hls, false)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    return srs_hls_open_segment(hls, dts);
+}
+
+int srs_hls_on_audio(HlsContext* hls, int64_t dts, char* data, int size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    SrsCodecSample* sample = &hls->sample;
+    sample->clear();
+    if ((ret = hls->codec.audio_aac_demux(data, size, sample)) != ERROR_SUCCESS) {
+        if (ret != ERROR_HLS_TRY_MP3) {
+            return ret;
+        }
+        if ((ret = hls->codec.audio_mp3_demux(data, size, sample)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    SrsCodecAudio acodec = (SrsCodecAudio)hls->codec.audio_codec_id;
+    
+    // ts support audio codec: aac/mp3
+    if (acodec != SrsCodecAudioAAC && acodec != SrsCodecAudioMP3) {
+        return ret;
+    }
+    
+    // for aac: ignore sequence header
+    if (acodec == SrsCodecAudioAAC && sample->aac_packet_type == SrsCodecAudioTypeSequenceHeader) {
+        return ret;
+    }
+    
+    if ((ret = srs_hls_flush_video(hls)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    if (hls->writer.is_open()) {
+        // the pure audio is reaped at any frame, so is the video stalled too long.
+        int64_t duration = dts - hls->segment_start;
+        int64_t fragment = (int64_t)hls->fragment_ms * 90;
+        if ((!hls->has_video && duration >= fragment) || duration >= fragment * SRS_HLS_AOF_RATIO) {
+            if ((ret = srs_hls_reap_segment(hls, dts)) != ERROR_SUCCESS) {
+                return ret;
+            }
+        }
+    } else if (!hls->has_video) {
+        if ((ret = srs_hls_open_segment(hls, dts)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    } else {
+        // the first segment starts at the keyframe.
+        return ret;
+    }
+    hls->segment_end = dts;
+    
+    if ((ret = hls->muxer->update_acodec(acodec)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    if ((ret = hls->cache.cache_audio(&hls->codec, dts, sample)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    ret = hls->muxer->write_audio(hls->cache.audio);
+    srs_freep(hls->cache.audio);
+    
+    return ret;
+}
+
+int srs_hls_on_video(HlsContext* hls, int64_t dts, char* data, int size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    SrsCodecSample* sample = &hls->sample;
+    sample->clear();
+    if ((ret = hls->codec.video_avc_demux(data, size, sample)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    // ignore info frame,
+    // @see https://github.com/ossrs/srs/issues/288#issuecomment-69863909
+    if (sample->frame_type == SrsCodecVideoAVCFrameVideoInfoFrame) {
+        return ret;
+    }
+    
+    if (hls->codec.video_codec_id != SrsCodecVideoAVC) {
+        return ret;
+    }
+    hls->has_video = true;
+    
+    // ignore sequence header, the sps/pps are written before each IDR.
+    bool keyframe = sample->frame_type == SrsCodecVideoAVCFrameKeyFrame;
+    if (keyframe && sample->avc_packet_type == SrsCodecVideoAVCTypeSequenceHeader) {
+        return ret;
+    }
+    
+    // the slices of a frame come in the packets of the same dts,
+    // for example, by srs_h264_write_raw_frames, mux them to one pes,
+    // for a aud is inserted before each pes.
+    SrsTsMessage* video = hls->cache.video;
+    if (video && video->dts == dts) {
+        static u_int8_t cont_nalu_header[] = { 0x00, 0x00, 0x01 };
+        for (int i = 0; i < sample->nb_sample_units; i++) {
+            SrsCodecSampleUnit* sample_unit = &sample->sample_units[i];
+            SrsAvcNaluType nal_unit_type = (SrsAvcNaluType)(sample_unit->bytes[0] & 0x1f);
+            if (nal_unit_type == SrsAvcNaluTypeSPS || nal_unit_type == SrsAvcNaluTypePPS
+                || nal_unit_type == SrsAvcNaluTypeAccessUnitDelimiter
+            ) {
+                continue;
+            }
+            video->payload->append((const char*)cont_nalu_header, 3);
+            video->payload->append(sample_unit->bytes, sample_unit->size);
+        }
+        return ret;
+    }
+    
+    if ((ret = srs_hls_flush_video(hls)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    if (hls->writer.is_open()) {
+        // the segment opened before video got, starts the video at keyframe.
+        bool no_video = hls->muxer->video_codec() != SrsCodecVideoAVC;
+        if (no_video && !keyframe) {
+            return ret;
+        }
+        if (keyframe && (no_video || dts - hls->segment_start >= (int64_t)hls->fragment_ms * 90)) {
+            if ((ret = srs_hls_reap_segment(hls, dts)) != ERROR_SUCCESS) {
+                return ret;
+            }
+        }
+    } else {
+        // the first segment starts at the keyframe.
+        if (!keyframe) {
+            return ret;
+        }
+        if ((ret = srs_hls_open_segment(hls, dts)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    hls->segment_end = dts;
+    
+    return hls->cache.cache_video(&hls->codec, dts, sample);
+}
+
+srs_hls_t srs_hls_open(const char* m3u8, int fragment_ms, int window)
+{
+    HlsContext* hls = new HlsContext();
+    hls->m3u8 = m3u8;
+    hls->fragment_ms = fragment_ms > 0? fragment_ms : SRS_HLS_FRAGMENT_MS;
+    hls->window = srs_max(window, 0);
+    
+    // the segments are in the dir of playlist, named by it.
+    std::string name = hls->m3u8;
+    size_t pos = name.find_last_of("/\\");
+    if (pos != std::string::npos) {
+        hls->dir = name.substr(0, pos + 1);
+        name = name.substr(pos + 1);
+    }
+    if ((pos = name.rfind(".m3u8")) != std::string::npos && pos + 5 == name.length()) {
+        name = name.substr(0, pos);
+    }
+    if (name.empty()) {
+        srs_freep(hls);
+        return NULL;
+    }
+    hls->name = name;
+    
+    return hls;
+}
+
+void srs_hls_close(srs_hls_t hls)
+{
+    HlsContext* context = (HlsContext*)hls;
+    if (!context) {
+        return;
+    }
+    
+    // the players stop at the end of the last segment.
+    if (context->writer.is_open()
+        && srs_hls_close_segment(context, context->segment_end) == ERROR_SUCCESS
+    ) {
+        srs_hls_write_m3u8(context, true);
+    }
+    
+    srs_freep(context);
+}
+
+int srs_hls_write_packet(srs_hls_t hls, char type, u_int32_t timestamp, char* data, int size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(hls != NULL);
+    HlsContext* context = (HlsContext*)hls;
+    
+    if (type != SRS_RTMP_TYPE_AUDIO && type != SRS_RTMP_TYPE_VIDEO) {
+        return ret;
+    }
+    
+    if (!context->got_base) {
+        context->got_base = true;
+        context->base = timestamp;
+    }
+    // the packets before the first one, for example, the audio of the
+    // same time merged after video, start at 0 as well.
+    int32_t diff = (int32_t)(timestamp - context->base);
+    int64_t dts = (int64_t)srs_max(diff, 0) * 90;
+    
+    if (type == SRS_RTMP_TYPE_AUDIO) {
+        return srs_hls_on_audio(context, dts, data, size);
+    }
+    return srs_hls_on_video(context, dts, data, size);
+}
+
+int srs_hls_write_msg(HlsContext* hls, SrsSharedPtrMessage* msg)
+{
+    char type = SRS_RTMP_TYPE_SCRIPT;
+    if (msg->is_audio()) {
+        type = SRS_RTMP_TYPE_AUDIO;
+    } else if (msg->is_video()) {
+        type = SRS_RTMP_TYPE_VIDEO;
+    }
+    
+    return srs_hls_write_packet(hls, type, (u_int32_t)msg->timestamp, msg->payload, msg->size);
+}
+
+int srs_rtmp_set_hls(srs_rtmp_t rtmp, srs_hls_t hls)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(rtmp != NULL);
+    Context* context = (Context*)rtmp;
+    
+    context->hls = (HlsContext*)hls;
+    
+    return ret;
+}
+
 srs_amf0_t srs_amf0_parse(char* data, int size, int* nparsed)
 {
     int ret = ERROR_SUCCESS;
@@ -34581,7 +36861,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 // for srs-librtmp, @see https://github.com/ossrs/srs/issues/213
 #ifndef _WIN32
     #define SOCKET_ETIME EWOULDBLOCK
+    #define SOCKET_EAGAIN EAGAIN
     #define SOCKET_ECONNRESET ECONNRESET
+    #define SOCKET_EINPROGRESS EINPROGRESS
 
     #define SOCKET_ERRNO() errno
     #define SOCKET_RESET(fd) fd = -1; (void)0
@@ -34592,11 +36874,14 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
         } \
         (void)0
     #define SOCKET_VALID(x) (x > 0)
+    #define SOCKET_BUFF(x) (x)
     #define SOCKET_SETUP() (void)0
     #define SOCKET_CLEANUP() (void)0
 #else
     #define SOCKET_ETIME WSAETIMEDOUT
+    #define SOCKET_EAGAIN WSAEWOULDBLOCK
     #define SOCKET_ECONNRESET WSAECONNRESET
+    #define SOCKET_EINPROGRESS WSAEWOULDBLOCK
     #define SOCKET_ERRNO() WSAGetLastError()
     #define SOCKET_RESET(x) x=INVALID_SOCKET
     #define SOCKET_CLOSE(x) if(x!=INVALID_SOCKET){::closesocket(x);x=INVALID_SOCKET;}
@@ -34611,12 +36896,15 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
     #include <unistd.h>
     #include <sys/socket.h>
     #include <netinet/in.h>
+    #include <netinet/tcp.h>
     #include <arpa/inet.h>
     #include <sys/uio.h>
+    #include <fcntl.h>
 #endif
 
 #include <sys/types.h>
 #include <errno.h>
+#include <string>
 
 //#include <srs_kernel_utility.hpp>
 
@@ -34633,10 +36921,17 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
         int64_t send_timeout;
         int64_t recv_bytes;
         int64_t send_bytes;
+        // whether in non-blocking mode, @see srs_hijack_io_set_nonblock.
+        bool nonblock;
+        // the bytes the non-blocking writev left, to send from send_pos.
+        std::string send_buf;
+        size_t send_pos;
         
         SrsBlockSyncSocket() {
             send_timeout = recv_timeout = ST_UTIME_NO_TIMEOUT;
             recv_bytes = send_bytes = 0;
+            nonblock = false;
+            send_pos = 0;
             
             SOCKET_RESET(fd);
             SOCKET_SETUP();
@@ -34665,6 +36960,11 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
         if (!SOCKET_VALID(skt->fd)) {
             return ERROR_SOCKET_CREATE;
         }
+#ifdef SRS_PERF_TCP_NODELAY
+        // the handshake and small messages must not wait for the delayed ack.
+        int nodelay = 1;
+        setsockopt(skt->fd, IPPROTO_TCP, TCP_NODELAY, SOCKET_BUFF(&nodelay), sizeof(nodelay));
+#endif
 #if defined(WEBRTC_IOS)
         /// skt->fd ò `SIGPIPE` źŵ socket 
         int value = 1;
@@ -34672,6 +36972,17 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #endif    
         return ERROR_SUCCESS;
     }
+    int srs_hijack_io_attach(srs_hijack_io_t ctx, int fd)
+    {
+        SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
+        
+        skt->fd = (SOCKET)fd;
+        if (!SOCKET_VALID(skt->fd)) {
+            return ERROR_SOCKET_CREATE;
+        }
+        
+        return ERROR_SUCCESS;
+    }
     int srs_hijack_io_connect(srs_hijack_io_t ctx, const char* server_ip, int port)
     {
         SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
@@ -34682,6 +36993,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
         addr.sin_addr.s_addr = inet_addr(server_ip);
         
         if(::connect(skt->fd, (const struct sockaddr*)&addr, sizeof(sockaddr_in)) < 0){
+            // wait for the socket writable, @see srs_hijack_io_check_connect.
+            if (skt->nonblock && SOCKET_ERRNO() == SOCKET_EINPROGRESS) {
+                return ERROR_SOCKET_WOULD_BLOCK;
+            }
             return ERROR_SOCKET_CONNECT;
         }
         
@@ -34693,6 +37008,75 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 		SOCKET_CLOSE(skt->fd);
 		return ERROR_SUCCESS;
 	}
+    int srs_hijack_io_get_fd(srs_hijack_io_t ctx)
+    {
+        SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
+        return (int)skt->fd;
+    }
+    int srs_hijack_io_set_nonblock(srs_hijack_io_t ctx)
+    {
+        SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
+        
+#ifndef _WIN32
+        int flags = fcntl(skt->fd, F_GETFL, 0);
+        if (flags == -1 || fcntl(skt->fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+            return ERROR_SYSTEM_IO_INVALID;
+        }
+#else
+        u_long v = 1;
+        if (ioctlsocket(skt->fd, FIONBIO, &v) != 0) {
+            return ERROR_SYSTEM_IO_INVALID;
+        }
+#endif
+        skt->nonblock = true;
+        
+        return ERROR_SUCCESS;
+    }
+    int srs_hijack_io_flush(srs_hijack_io_t ctx)
+    {
+        SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
+        
+        while (skt->send_pos < skt->send_buf.size()) {
+            ssize_t nb_write = ::send(skt->fd, skt->send_buf.data() + skt->send_pos, 
+                skt->send_buf.size() - skt->send_pos, 0);
+            if (nb_write < 0) {
+                if (SOCKET_ERRNO() != SOCKET_EAGAIN) {
+                    return ERROR_SOCKET_WRITE;
+                }
+                // drop the sent bytes when they are the most part of buffer.
+                if (skt->send_pos > skt->send_buf.size() / 2) {
+                    skt->send_buf.erase(0, skt->send_pos);
+                    skt->send_pos = 0;
+                }
+                return ERROR_SUCCESS;
+            }
+            skt->send_pos += nb_write;
+            skt->send_bytes += nb_write;
+        }
+        
+        // all sent, reuse the buffer.
+        skt->send_buf.clear();
+        skt->send_pos = 0;
+        
+        return ERROR_SUCCESS;
+    }
+    int srs_hijack_io_get_send_pending(srs_hijack_io_t ctx)
+    {
+        SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
+        return (int)(skt->send_buf.size() - skt->send_pos);
+    }
+    int srs_hijack_io_check_connect(srs_hijack_io_t ctx)
+    {
+        SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
+        
+        int error = 0;
+        socklen_t len = sizeof(error);
+        if (getsockopt(skt->fd, SOL_SOCKET, SO_ERROR, SOCKET_BUFF(&error), &len) < 0 || error != 0) {
+            return ERROR_SOCKET_CONNECT;
+        }
+        
+        return ERROR_SUCCESS;
+    }
     int srs_hijack_io_read(srs_hijack_io_t ctx, void* buf, size_t size, ssize_t* nread)
     {
         SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
@@ -34708,6 +37092,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
         // On success a non-negative integer indicating the number of bytes actually read is returned 
         // (a value of 0 means the network connection is closed or end of file is reached).
         if (nb_read <= 0) {
+            if (nb_read < 0 && skt->nonblock && SOCKET_ERRNO() == SOCKET_EAGAIN) {
+                return ERROR_SOCKET_WOULD_BLOCK;
+            }
+            
             if (nb_read < 0 && SOCKET_ERRNO() == SOCKET_ETIME) {
                 return ERROR_SOCKET_TIMEOUT;
             }
@@ -34792,12 +37180,55 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
         SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
         return skt->send_bytes;
     }
+    int srs_hijack_io_nonblock_writev(SrsBlockSyncSocket* skt, const iovec *iov, int iov_size, ssize_t* nwrite)
+    {
+        int ret = ERROR_SUCCESS;
+        
+        // keep the order, all bytes are queued when some left.
+        if ((ret = srs_hijack_io_flush(skt)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        
+        ssize_t nb_write = 0;
+        if (skt->send_pos == skt->send_buf.size()) {
+            if ((nb_write = ::writev(skt->fd, iov, iov_size)) < 0) {
+                if (SOCKET_ERRNO() != SOCKET_EAGAIN) {
+                    return ERROR_SOCKET_WRITE;
+                }
+                nb_write = 0;
+            }
+            skt->send_bytes += nb_write;
+        }
+        
+        // queue the left bytes, all bytes are taken for the protocol.
+        ssize_t size = 0;
+        for (int i = 0; i < iov_size; i++) {
+            size_t len = iov[i].iov_len;
+            size += len;
+            if (nb_write >= (ssize_t)len) {
+                nb_write -= len;
+                continue;
+            }
+            skt->send_buf.append((char*)iov[i].iov_base + nb_write, len - nb_write);
+            nb_write = 0;
+        }
+        
+        if (nwrite) {
+            *nwrite = size;
+        }
+        
+        return ret;
+    }
     int srs_hijack_io_writev(srs_hijack_io_t ctx, const iovec *iov, int iov_size, ssize_t* nwrite)
     {
         SrsBlockSyncSocket* skt = (SrsBlockSyncSocket*)ctx;
         
         int ret = ERROR_SUCCESS;
         
+        if (skt->nonblock) {
+            return srs_hijack_io_nonblock_writev(skt, iov, iov_size, nwrite);
+        }
+        
         ssize_t nb_write = ::writev(skt->fd, iov, iov_size);
         
         if (nwrite) {
@@ -34858,6 +37289,11 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
         
         int ret = ERROR_SUCCESS;
         
+        if (skt->nonblock) {
+            iovec iov = { buf, size };
+            return srs_hijack_io_nonblock_writev(skt, &iov, 1, nwrite);
+        }
+        
         ssize_t nb_write = ::send(skt->fd, (char*)buf, size, 0);
         
         if (nwrite) {
@@ -34903,6 +37339,12 @@ int SimpleSocketStreamImpl::create_socket()
     return srs_hijack_io_create_socket(io);
 }
 
+int SimpleSocketStreamImpl::attach(int fd)
+{
+    srs_assert(io);
+    return srs_hijack_io_attach(io, fd);
+}
+
 int SimpleSocketStreamImpl::connect(const char* server_ip, int port)
 {
     srs_assert(io);
@@ -34915,6 +37357,36 @@ int SimpleSocketStreamImpl::disconnect()
 	return srs_hijack_io_disconnect(io);
 }
 
+int SimpleSocketStreamImpl::get_fd()
+{
+    srs_assert(io);
+    return srs_hijack_io_get_fd(io);
+}
+
+int SimpleSocketStreamImpl::set_nonblock()
+{
+    srs_assert(io);
+    return srs_hijack_io_set_nonblock(io);
+}
+
+int SimpleSocketStreamImpl::flush()
+{
+    srs_assert(io);
+    return srs_hijack_io_flush(io);
+}
+
+int SimpleSocketStreamImpl::get_send_pending()
+{
+    srs_assert(io);
+    return srs_hijack_io_get_send_pending(io);
+}
+
+int SimpleSocketStreamImpl::check_connect()
+{
+    srs_assert(io);
+    return srs_hijack_io_check_connect(io);
+}
+
 // ISrsBufferReader
 int SimpleSocketStreamImpl::read(void* buf, size_t size, ssize_t* nread)
 {
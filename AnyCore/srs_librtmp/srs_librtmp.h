@@ -272,15 +272,253 @@ extern int srs_rtmp_bandwidth_check(srs_rtmp_t rtmp,
 extern int srs_rtmp_read_packet(srs_rtmp_t rtmp, 
     char* type, u_int32_t* timestamp, char** data, int* size
 );
+/**
+* whether srs_rtmp_read_packet can get a packet without recv from socket,
+* that is, the cached messages of aggregate, or bytes in the recv buffer.
+* @remark when the buffered bytes are a part of message, the read still
+*       waits for the left bytes, which are generally already on the way.
+*/
+extern srs_bool srs_rtmp_has_buffered(srs_rtmp_t rtmp);
+/**
+* enable the merged read for client, @see SRS_PERF_MERGED_READ,
+* the recv buffer is enlarged to read all bytes of socket by one syscall.
+* @param buffer_size the size of recv buffer in bytes, max to 256KB.
+* @remark never sleep to merge more data like the server, for the latency of player.
+* @remark can be set before handshake, it's applied when the client created.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_set_merged_read(srs_rtmp_t rtmp, int buffer_size);
+/**
+* switch the rtmp to non-blocking io, for a reactor(epoll for instance)
+* to drive many connections on one thread, call it after play or publish.
+* when switched:
+*   srs_rtmp_read_packet never blocks, it returns the error checked by
+*       srs_rtmp_is_would_block when no entire packet in the socket.
+*   the writes never block, the bytes the socket cannot take are queued,
+*       user should call srs_rtmp_flush when the socket is writable.
+* @remark the handshake, connect, play and publish are blocking,
+*       @see srs_rtmp_connect_nonblock for the non-blocking ones.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_set_nonblock(srs_rtmp_t rtmp);
+/**
+* get the socket fd, to wait for the io events.
+*/
+extern int srs_rtmp_get_fd(srs_rtmp_t rtmp);
+/**
+* send the bytes queued by the non-blocking writes, until all sent or would block.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_flush(srs_rtmp_t rtmp);
+/**
+* get the bytes queued by the non-blocking writes, 0 when all sent.
+*/
+extern int srs_rtmp_get_send_pending(srs_rtmp_t rtmp);
+/**
+* whether the error code is would block of the non-blocking io.
+*/
+extern srs_bool srs_rtmp_is_would_block(int error_code);
+/**
+* the non-blocking connect, for a reactor to connect many clients on one
+* thread, instead of srs_rtmp_handshake, srs_rtmp_connect_app, then
+* srs_rtmp_publish_stream or srs_rtmp_play_stream:
+*   1. srs_rtmp_get_host parses the url and gets the host, resolve it where
+*       a blocking call is allowed, or use it when it's an ip already.
+*   2. srs_rtmp_connect_nonblock switches the rtmp to non-blocking, the same
+*       to srs_rtmp_set_nonblock, and starts to connect to the ip.
+*   3. srs_rtmp_connect_step when the fd is readable, or writable when
+*       srs_rtmp_connect_want_write, until it returns other than the error
+*       checked by srs_rtmp_is_would_block.
+* the steps do the simple handshake, connect app, then publish or play,
+* the timeout is not checked, user should give up when it takes too long.
+*
+* @return 0, success; would block when to wait; otherswise, failed.
+*/
+extern const char* srs_rtmp_get_host(srs_rtmp_t rtmp);
+extern int srs_rtmp_connect_nonblock(srs_rtmp_t rtmp, const char* ip, srs_bool publish);
+extern int srs_rtmp_connect_step(srs_rtmp_t rtmp);
+extern srs_bool srs_rtmp_connect_want_write(srs_rtmp_t rtmp);
 extern int srs_rtmp_write_packet(srs_rtmp_t rtmp, 
     char type, u_int32_t timestamp, char* data, int size
 );
+/**
+* the function to free the data of nocopy write,
+* @param data the packet data passed to write, maybe moved before the frame.
+* @param param the param passed to write.
+*/
+typedef void (*srs_free_t)(char* data, void* param);
+/**
+* the headroom before the h.264 frame for srs_h264_write_raw_frame_nocopy,
+* where the flv video header and NALU length are written in place.
+*/
+#define SRS_H264_NOCOPY_HEADROOM 9
+/**
+* write a audio/video/script-data packet to rtmp stream, without copy,
+* the data is sent out directly, and freed by free_fn when sent out.
+* @param free_fn the function to free the data, never NULL.
+* @param param the param passed to free_fn.
+*
+* @remark: free_fn is always called once, even if error.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_write_packet_nocopy(srs_rtmp_t rtmp, 
+    char type, u_int32_t timestamp, char* data, int size, srs_free_t free_fn, void* param
+);
+/**
+* write a batch of audio/video/script-data packets to rtmp stream,
+* all packets are merged and sent by one writev.
+* @param types, timestamps, datas, sizes, the arrays of packets,
+*       each element is same to the param of srs_rtmp_write_packet.
+* @param nb_packets, the number of packets in arrays.
+*
+* @remark: user should never free the datas, even if error.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_write_packets(srs_rtmp_t rtmp, 
+    char* types, u_int32_t* timestamps, char** datas, int* sizes, int nb_packets
+);
+/**
+* start to batch write packets, all packets written after this,
+* by srs_rtmp_write_packet, srs_h264_write_raw_frames or srs_audio_write_raw_frame,
+* are cached and sent in one writev when flush.
+* @remark, the cache is auto flushed when exceed SRS_PERF_MW_MSGS messages.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_batch_begin(srs_rtmp_t rtmp);
+/**
+* send out all cached packets in one writev, keep in batch mode.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_batch_flush(srs_rtmp_t rtmp);
+/**
+* flush the cached packets and quit the batch mode.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_batch_end(srs_rtmp_t rtmp);
 
 /**
 * whether type is script data and the data is onMetaData.
 */
 extern srs_bool srs_rtmp_is_onMetaData(char type, char* data, int size);
 
+/*************************************************************
+**************************************************************
+* RTMP server side, serve one client on a socket accepted by user,
+* for the embedded relay and the loopback tests, not a full featured server.
+**************************************************************
+*************************************************************/
+typedef void* srs_rtmp_server_t;
+/**
+* create the server side rtmp stack on a accepted socket.
+* @param fd the accepted socket, closed when destroy.
+* @remark default timeout to 30s if not set by srs_rtmp_server_set_timeout.
+*
+* @return a rtmp handler, or NULL if error occured.
+*/
+extern srs_rtmp_server_t srs_rtmp_server_create(int fd);
+extern void srs_rtmp_server_destroy(srs_rtmp_server_t server);
+extern int srs_rtmp_server_set_timeout(srs_rtmp_server_t server, int recv_timeout_ms, int send_timeout_ms);
+/**
+* handshake, response the connect app, identify the client,
+* then start the play or publish it requested.
+* @param publish output, whether the client publishes, otherwise plays.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_server_accept(srs_rtmp_server_t server, srs_bool* publish);
+/**
+* get the app and stream the client requested, valid after accepted.
+*/
+extern const char* srs_rtmp_server_get_app(srs_rtmp_server_t server);
+extern const char* srs_rtmp_server_get_stream(srs_rtmp_server_t server);
+/**
+* read a packet from the client, the same to srs_rtmp_read_packet,
+* but the aggregate message is returned as is.
+*/
+extern int srs_rtmp_server_read_packet(srs_rtmp_server_t server, 
+    char* type, u_int32_t* timestamp, char** data, int* size
+);
+/**
+* write a packet to the client, the same to srs_rtmp_write_packet.
+* @remark: user should never free the data, even if error.
+*/
+extern int srs_rtmp_server_write_packet(srs_rtmp_server_t server, 
+    char type, u_int32_t timestamp, char* data, int size
+);
+/**
+* the non-blocking mode of server, the same to srs_rtmp_set_nonblock,
+* srs_rtmp_get_fd, srs_rtmp_flush, srs_rtmp_get_send_pending and srs_rtmp_has_buffered.
+* @remark set it after accepted, for the accept is blocking.
+*/
+extern int srs_rtmp_server_set_nonblock(srs_rtmp_server_t server);
+extern int srs_rtmp_server_get_fd(srs_rtmp_server_t server);
+extern int srs_rtmp_server_flush(srs_rtmp_server_t server);
+extern int srs_rtmp_server_get_send_pending(srs_rtmp_server_t server);
+extern srs_bool srs_rtmp_server_has_buffered(srs_rtmp_server_t server);
+
+/*************************************************************
+**************************************************************
+* RTMP live source, fan out the packets of one publisher to many
+* played servers, each player queues the copies of the shared message,
+* that is, a reference to the same payload, no copy for each player.
+* @remark the source and its players are not thread safe, use them in
+*       the same thread, for example, the event loop of the players.
+**************************************************************
+*************************************************************/
+typedef void* srs_rtmp_source_t;
+/**
+* create the live source.
+* @param gop_cache whether cache the last gop, the new players start
+*       at the keyframe at once, @see SRS_PERF_GOP_CACHE.
+* @param queue_ms the max duration of the queue of each player, the
+*       slow player drops the queue and waits for the next keyframe,
+*       0 to SRS_PERF_PLAY_QUEUE.
+*/
+extern srs_rtmp_source_t srs_rtmp_source_create(srs_bool gop_cache, int queue_ms);
+/**
+* destroy the source, the players are removed but not destroyed.
+*/
+extern void srs_rtmp_source_destroy(srs_rtmp_source_t source);
+/**
+* dispatch a packet of the publisher to the queues of all players,
+* the sequence headers, metadata and gop are cached for the new players.
+* @param type, the same to srs_rtmp_write_packet, others are ignored.
+* @remark: user should never free the data, even if error.
+*/
+extern int srs_rtmp_source_on_packet(srs_rtmp_source_t source, 
+    char type, u_int32_t timestamp, char* data, int size
+);
+/**
+* add a played server to the source, the metadata, sequence headers and
+* gop cache are queued to it at once.
+* @remark a server plays one source, it's removed when destroyed.
+*/
+extern int srs_rtmp_source_add_player(srs_rtmp_source_t source, srs_rtmp_server_t server);
+extern void srs_rtmp_source_remove_player(srs_rtmp_source_t source, srs_rtmp_server_t server);
+extern int srs_rtmp_source_get_players(srs_rtmp_source_t source);
+/**
+* send the queued messages of the player, in one writev for each
+* SRS_PERF_MW_MSGS messages.
+* @remark for non-blocking server, stops when some bytes left in socket,
+*       call it again when srs_rtmp_server_flush sent all of them.
+* @param nb_dropped output, the messages dropped for the queue is full, NULL to ignore.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_source_send(srs_rtmp_source_t source, srs_rtmp_server_t server, int* nb_dropped);
+/**
+* whether the player has messages to send.
+*/
+extern srs_bool srs_rtmp_source_has_queued(srs_rtmp_source_t source, srs_rtmp_server_t server);
+
 /*************************************************************
 **************************************************************
 * audio raw codec
@@ -341,6 +579,21 @@ extern int srs_audio_write_raw_frame(srs_rtmp_t rtmp,
     char sound_format, char sound_rate, char sound_size, char sound_type,
     char* frame, int frame_size, u_int32_t timestamp
 );
+/**
+* write audio raw frame over RTMP without copy, same to srs_audio_write_raw_frame,
+* the flv audio header is written over the tail of the adts header.
+* @param free_fn the function to free the frame, never NULL.
+* @param param the param passed to free_fn.
+*
+* @remark only one aac frame in adts is sent without copy, others use the copy path.
+* @remark free_fn is always called once, even if error.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_audio_write_raw_frame_nocopy(srs_rtmp_t rtmp, 
+    char sound_format, char sound_rate, char sound_size, char sound_type,
+    char* frame, int frame_size, u_int32_t timestamp, srs_free_t free_fn, void* param
+);
 
 /**
 * whether aac raw data is in adts format,
@@ -428,6 +681,22 @@ extern int srs_h264_write_raw_frames(srs_rtmp_t rtmp,
     char* frames, int frames_size, u_int32_t dts, u_int32_t pts
 );
 /**
+* write one h.264 raw frame over RTMP without copy.
+* @param frame the h.264 NALU, without the annexb header,
+*       there must be SRS_H264_NOCOPY_HEADROOM writable bytes before frame,
+*       where the flv video header and NALU length are written.
+* @param free_fn the function to free the frame, never NULL.
+* @param param the param passed to free_fn.
+*
+* @remark the sps/pps and other NALUs use the copy path.
+* @remark free_fn is always called once, even if error.
+*
+* @return 0, success; otherswise, failed, same to srs_h264_write_raw_frames.
+*/
+extern int srs_h264_write_raw_frame_nocopy(srs_rtmp_t rtmp, 
+    char* frame, int frame_size, u_int32_t dts, u_int32_t pts, srs_free_t free_fn, void* param
+);
+/**
 * whether error_code is dvbsp(drop video before sps/pps/sequence-header) error.
 *
 * @see https://github.com/ossrs/srs/issues/203
@@ -469,6 +738,23 @@ extern srs_bool srs_h264_startswith_annexb(
     char* h264_raw_data, int h264_raw_size, 
     int* pnb_start_code
 );
+/**
+* scan all NALUs in h264 raw data in one pass,
+* each NALU is prefixed by annexb header N[00] 00 00 01, where N>=0.
+* @param h264_raw_data the input h264 raw data, one or more NALUs.
+* @param h264_raw_size the size of h264 raw data.
+* @param nalus output the offset of each NALU in data, after the start code.
+* @param nb_nalus output the size of each NALU, without the start code.
+* @param max_nalus the capacity of nalus and nb_nalus.
+*
+* @remark when more than max_nalus, the last one contains all left data.
+* @remark the scan is vectorized by SSE2 or NEON when available.
+*
+* @return the number of NALUs, 0 when no annexb header found.
+*/
+extern int srs_h264_scan_nalus(char* h264_raw_data, int h264_raw_size, 
+    int* nalus, int* nb_nalus, int max_nalus
+);
 
 /*************************************************************
 **************************************************************
@@ -569,6 +855,59 @@ extern srs_bool srs_flv_is_sequence_header(char* data, int32_t size);
 */
 extern srs_bool srs_flv_is_keyframe(char* data, int32_t size);
 
+/*************************************************************
+**************************************************************
+* hls muxer, write the rolling mpegts segments and the m3u8 playlist,
+* by the ts stack of srs, @see SrsTSMuxer.
+* the segments are reaped at the keyframes, and written to the name.ts.tmp,
+* then renamed to name.ts when completed, the m3u8 is rewritten by rename
+* as well, so the playlist only lists the completed segments, even if crash.
+**************************************************************
+*************************************************************/
+typedef void* srs_hls_t;
+/**
+* open the hls muxer.
+* @param m3u8 the path of playlist, for example, /data/hls/livestream.m3u8,
+*       the segments are /data/hls/livestream-0.ts, livestream-1.ts, ...
+* @param fragment_ms the min duration of segment, it's reaped at the next keyframe,
+*       0 to SRS_HLS_FRAGMENT_MS.
+* @param window the max segments in playlist, the older ones are deleted,
+*       0 to keep all segments, for instance, to record the stream.
+*
+* @return a hls handler, or NULL if error occured.
+*/
+extern srs_hls_t srs_hls_open(const char* m3u8, int fragment_ms, int window);
+/**
+* close the hls muxer, reap the last segment and end the playlist.
+* @remark the segments and playlist are kept on disk.
+*/
+extern void srs_hls_close(srs_hls_t hls);
+/**
+* write the flv tag to hls, the h.264 video and aac/mp3 audio,
+* others are ignored.
+* @param timestamp the dts in ms, rebased to the first packet.
+* @remark, the data is never freed, the same to srs_flv_write_tag.
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_hls_write_packet(srs_hls_t hls, 
+    char type, u_int32_t timestamp, char* data, int size
+);
+/**
+* write the packets of rtmp to hls as well, including the packets muxed by
+* srs_h264_write_raw_frames and srs_audio_write_raw_frame.
+* @param hls the hls muxer, NULL to stop, user must close it after stopped.
+* @remark the rtmp never fails for hls, for the rtmp never connected, the
+*       packets only go to hls and the errors of hls are returned, so to mux
+*       the raw frames to hls without server, for example:
+*           srs_rtmp_t rtmp = srs_rtmp_create("");
+*           srs_rtmp_set_hls(rtmp, hls);
+*           srs_h264_write_raw_frames(rtmp, frames, size, dts, pts);
+*
+* @return 0, success; otherswise, failed.
+*/
+extern int srs_rtmp_set_hls(srs_rtmp_t rtmp, srs_hls_t hls);
+
 /*************************************************************
 **************************************************************
 * amf0 codec
@@ -989,9 +1328,15 @@ typedef void* srs_hijack_io_t;
     */
     extern int srs_hijack_io_create_socket(srs_hijack_io_t ctx);
     /**
-    * connect socket at server_ip:port.
+    * use the socket accepted by user instead of create, for server side.
     * @return 0, success; otherswise, failed.
     */
+    extern int srs_hijack_io_attach(srs_hijack_io_t ctx, int fd);
+    /**
+    * connect socket at server_ip:port.
+    * @return 0, success; ERROR_SOCKET_WOULD_BLOCK when the non-blocking
+    *       connect is in progress; otherswise, failed.
+    */
     extern int srs_hijack_io_connect(srs_hijack_io_t ctx, const char* server_ip, int port);
     /**
     * read from socket.
@@ -1048,6 +1393,30 @@ typedef void* srs_hijack_io_t;
     * @return 0, success; otherswise, failed.
     */
     extern int srs_hijack_io_write(srs_hijack_io_t ctx, void* buf, size_t size, ssize_t* nwrite);
+    /**
+    * get the socket fd to wait for io events.
+    */
+    extern int srs_hijack_io_get_fd(srs_hijack_io_t ctx);
+    /**
+    * set the socket to non-blocking, the read returns ERROR_SOCKET_WOULD_BLOCK
+    * when no bytes, the writev never blocks and queues the left bytes.
+    * @return 0, success; otherswise, failed.
+    */
+    extern int srs_hijack_io_set_nonblock(srs_hijack_io_t ctx);
+    /**
+    * send the bytes queued by the non-blocking writev.
+    * @return 0, success or would block; otherswise, failed.
+    */
+    extern int srs_hijack_io_flush(srs_hijack_io_t ctx);
+    /**
+    * get the bytes queued by the non-blocking writev.
+    */
+    extern int srs_hijack_io_get_send_pending(srs_hijack_io_t ctx);
+    /**
+    * get the result of the non-blocking connect, when the socket is writable.
+    * @return 0, connected; otherswise, failed.
+    */
+    extern int srs_hijack_io_check_connect(srs_hijack_io_t ctx);
 #endif
 
 /*************************************************************
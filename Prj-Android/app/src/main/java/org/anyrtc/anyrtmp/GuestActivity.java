@@ -99,7 +99,7 @@ public class GuestActivity extends Activity implements RTMPGuestHelper {
     }
 
     @Override
-    public void OnRtmplayerStatus(final int cacheTime, final int curBitrate) {
+    public void OnRtmplayerStatus(final int cacheTime, final int curBitrate, final int targetDelay, final int minDelay) {
         runOnUiThread(new Runnable() {
             @Override
             public void run() {
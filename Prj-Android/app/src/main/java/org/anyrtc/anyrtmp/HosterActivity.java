@@ -116,7 +116,7 @@ public class HosterActivity extends Activity implements RTMPHosterHelper {
     }
 
     @Override
-    public void OnRtmpStreamStatus(final int delayMs, final int netBand) {
+    public void OnRtmpStreamStatus(final int delayMs, final int netBand, final int dropFrames, final int dropBytes) {
         runOnUiThread(new Runnable() {
             @Override
             public void run() {
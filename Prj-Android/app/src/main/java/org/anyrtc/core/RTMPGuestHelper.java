@@ -24,7 +24,7 @@ package org.anyrtc.core;
 public interface RTMPGuestHelper {
     //* For RTMPCGuesterEvent
     public void OnRtmplayerOK();
-    public void OnRtmplayerStatus(int cacheTime, int curBitrate);
+    public void OnRtmplayerStatus(int cacheTime, int curBitrate, int targetDelay, int minDelay);
     public void OnRtmplayerCache(int time);
     public void OnRtmplayerClosed(int errcode);
 }
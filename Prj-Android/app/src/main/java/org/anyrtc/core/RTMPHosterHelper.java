@@ -25,7 +25,7 @@ public interface RTMPHosterHelper {
     //* RTMP Callback
     public void OnRtmpStreamOK();
     public void OnRtmpStreamReconnecting(int times);
-    public void OnRtmpStreamStatus(int delayMs, int netBand);
+    public void OnRtmpStreamStatus(int delayMs, int netBand, int dropFrames, int dropBytes);
     public void OnRtmpStreamFailed(int code);
     public void OnRtmpStreamClosed();
 }
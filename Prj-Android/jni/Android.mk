@@ -53,6 +53,7 @@ LOCAL_C_INCLUDES += $(NDK_STL_INC) \
 LOCAL_CFLAGS := -std=gnu++11 -DWEBRTC_POSIX -DWEBRTC_ANDROID -D__STDC_CONSTANT_MACROS 
  
 LOCAL_STATIC_LIBRARIES := anycore
+LOCAL_STATIC_LIBRARIES += rtsp
 LOCAL_STATIC_LIBRARIES += webrtc
 LOCAL_STATIC_LIBRARIES += yuv_static
 LOCAL_SHARED_LIBRARIES := openh264-p 
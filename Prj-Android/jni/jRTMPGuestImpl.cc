@@ -69,15 +69,15 @@ void JRTMPGuestImpl::OnRtmplayerOK()
 		jni->CallVoidMethod(m_jJavaObj, j_callJavaMId);
 	}
 }
-void JRTMPGuestImpl::OnRtmplayerStatus(int cacheTime, int curBitrate) 
+void JRTMPGuestImpl::OnRtmplayerStatus(int cacheTime, int curBitrate, int targetDelay, int minDelay) 
 {
 	webrtc::AttachThreadScoped ats(webrtc_jni::GetJVM());
 	JNIEnv* jni = ats.env();
 	{
 		// Get *** callback interface method id
-		jmethodID j_callJavaMId = webrtc_jni::GetMethodID(jni, m_jClass, "OnRtmplayerStatus", "(II)V");
+		jmethodID j_callJavaMId = webrtc_jni::GetMethodID(jni, m_jClass, "OnRtmplayerStatus", "(IIII)V");
 		// Callback with params
-		jni->CallVoidMethod(m_jJavaObj, j_callJavaMId, cacheTime, curBitrate);
+		jni->CallVoidMethod(m_jJavaObj, j_callJavaMId, cacheTime, curBitrate, targetDelay, minDelay);
 	}
 }
 void JRTMPGuestImpl::OnRtmplayerCache(int time) 
@@ -80,15 +80,15 @@ void JRTMPHosterImpl::OnRtmpStreamReconnecting(int times)
 		jni->CallVoidMethod(m_jJavaObj, j_callJavaMId, times);
 	}
 }
-void JRTMPHosterImpl::OnRtmpStreamStatus(int delayMs, int netBand)
+void JRTMPHosterImpl::OnRtmpStreamStatus(int delayMs, int netBand, int dropFrames, int dropBytes)
 {
 	webrtc::AttachThreadScoped ats(webrtc_jni::GetJVM());
 	JNIEnv* jni = ats.env();
 	{
 		// Get *** callback interface method id
-		jmethodID j_callJavaMId = webrtc_jni::GetMethodID(jni, m_jClass, "OnRtmpStreamStatus", "(II)V");
+		jmethodID j_callJavaMId = webrtc_jni::GetMethodID(jni, m_jClass, "OnRtmpStreamStatus", "(IIII)V");
 		// Callback with params
-		jni->CallVoidMethod(m_jJavaObj, j_callJavaMId, delayMs, netBand);
+		jni->CallVoidMethod(m_jJavaObj, j_callJavaMId, delayMs, netBand, dropFrames, dropBytes);
 	}
 }
 void JRTMPHosterImpl::OnRtmpStreamFailed(int code)
@@ -34,7 +34,7 @@ public:
 	//* For RTMPHosterEvent
 	virtual void OnRtmpStreamOK();
 	virtual void OnRtmpStreamReconnecting(int times);
-	virtual void OnRtmpStreamStatus(int delayMs, int netBand);
+	virtual void OnRtmpStreamStatus(int delayMs, int netBand, int dropFrames, int dropBytes);
 	virtual void OnRtmpStreamFailed(int code);
 	virtual void OnRtmpStreamClosed();
 
@@ -0,0 +1,171 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+//* aactest, checks the pcm buffering of the pluginaac encoder.
+//* The same pcm is encoded by whole frames, then by odd-sized chunks through
+//* aac_encoder_encode_frame and aac_encoder_encode_frames, no sample may be
+//* lost, so the frames and the bytes must be the same.
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "pluginaac.h"
+
+#define TEST_SAMPLE_RATE	44100
+#define TEST_CHANNELS		2
+#define TEST_FRAMES			200		// Frames of pcm to encode
+#define TEST_MAX_FRAMES		8		// Frame table of one aac_encoder_encode_frames
+#define TEST_MAX_DELAY		3		// Frames of the faac encoder delay
+
+//* Byte sizes of the chunks, all shorter than a frame, most are odd.
+static const unsigned int kChunks[] = { 1, 7, 333, 1001, 2047, 4095, 2, 3999, 513 };
+
+struct EncodeResult
+{
+	int frames;
+	std::vector<unsigned char> adts;
+};
+
+static void MakePcm(std::vector<short>& pcm, int samples)
+{
+	//* Two tones and a slow sweep, so each frame encodes to a different size.
+	pcm.resize(samples * TEST_CHANNELS);
+	for (int i = 0; i < samples; i++) {
+		double t = (double)i / TEST_SAMPLE_RATE;
+		pcm[i * TEST_CHANNELS] = (short)(8000 * sin(2 * M_PI * 440 * t) + 3000 * sin(2 * M_PI * (200 + 50 * t) * t * 10));
+		pcm[i * TEST_CHANNELS + 1] = (short)(6000 * sin(2 * M_PI * 1000 * t));
+	}
+}
+
+//* Whole frames, or the sizes of kChunks in turn when chunked.
+static bool EncodeByFrame(const std::vector<short>& pcm, unsigned int frameBytes, bool chunked, EncodeResult& result)
+{
+	aac_enc_t enc = aac_encoder_open(TEST_CHANNELS, TEST_SAMPLE_RATE, 16, false);
+	if (enc == NULL)
+		return false;
+	unsigned int maxFrameBytes = 0;
+	aac_encoder_get_info(enc, NULL, &maxFrameBytes);
+	std::vector<unsigned char> out(maxFrameBytes);
+
+	unsigned char* data = (unsigned char*)&pcm[0];
+	unsigned int size = pcm.size() * sizeof(short);
+	unsigned int pos = 0;
+	int next = 0;
+	result.frames = 0;
+	result.adts.clear();
+	while (pos < size) {
+		unsigned int len = chunked ? kChunks[next++ % (sizeof(kChunks) / sizeof(kChunks[0]))] : frameBytes;
+		if (len > size - pos)
+			len = size - pos;
+		unsigned int outlen = 0;
+		int ret = aac_encoder_encode_frame(enc, data + pos, len, &out[0], &outlen);
+		if (ret < 0) {
+			aac_encoder_close(enc);
+			return false;
+		}
+		if (ret > 0) {
+			result.frames++;
+			result.adts.insert(result.adts.end(), out.begin(), out.begin() + outlen);
+		}
+		pos += len;
+	}
+	aac_encoder_close(enc);
+	return true;
+}
+
+static bool EncodeByBatch(const std::vector<short>& pcm, EncodeResult& result)
+{
+	aac_enc_t enc = aac_encoder_open(TEST_CHANNELS, TEST_SAMPLE_RATE, 16, false);
+	if (enc == NULL)
+		return false;
+	unsigned int maxFrameBytes = 0;
+	aac_encoder_get_info(enc, NULL, &maxFrameBytes);
+	std::vector<unsigned char> out(maxFrameBytes * TEST_MAX_FRAMES);
+	aac_enc_frame_t frames[TEST_MAX_FRAMES];
+
+	const unsigned char* data = (const unsigned char*)&pcm[0];
+	unsigned int size = pcm.size() * sizeof(short);
+	unsigned int pos = 0;
+	int next = 0;
+	result.frames = 0;
+	result.adts.clear();
+	while (pos < size) {
+		unsigned int len = kChunks[next++ % (sizeof(kChunks) / sizeof(kChunks[0]))];
+		if (len > size - pos)
+			len = size - pos;
+		//* A chunk may take more than one call when the frame table is full.
+		unsigned int used = 0;
+		while (used < len) {
+			unsigned int inused = 0;
+			int ret = aac_encoder_encode_frames(enc, data + pos + used, len - used, &inused,
+				&out[0], out.size(), frames, TEST_MAX_FRAMES);
+			if (ret < 0) {
+				aac_encoder_close(enc);
+				return false;
+			}
+			for (int i = 0; i < ret; i++) {
+				result.adts.insert(result.adts.end(), out.begin() + frames[i].offset,
+					out.begin() + frames[i].offset + frames[i].size);
+			}
+			result.frames += ret;
+			used += inused;
+		}
+		pos += len;
+	}
+	aac_encoder_close(enc);
+	return true;
+}
+
+static bool Check(const char* name, const EncodeResult& result, const EncodeResult& expected, unsigned int frameSamples)
+{
+	bool ok = result.frames == expected.frames && result.adts == expected.adts;
+	printf("%-24s %4d frames %7d samples %7d bytes  %s\n", name, result.frames, result.frames * frameSamples,
+		(int)result.adts.size(), ok ? "ok" : "FAILED");
+	return ok;
+}
+
+int main(int argc, char* argv[])
+{
+	aac_enc_t enc = aac_encoder_open(TEST_CHANNELS, TEST_SAMPLE_RATE, 16, false);
+	if (enc == NULL) {
+		fprintf(stderr, "open aac encoder failed\n");
+		return 2;
+	}
+	unsigned int frameSamples = 0;
+	aac_encoder_get_info(enc, &frameSamples, NULL);
+	aac_encoder_close(enc);
+	unsigned int frameBytes = frameSamples * TEST_CHANNELS * sizeof(short);
+
+	std::vector<short> pcm;
+	MakePcm(pcm, TEST_FRAMES * frameSamples);
+
+	EncodeResult expected, byChunk, byBatch;
+	if (!EncodeByFrame(pcm, frameBytes, false, expected) || !EncodeByFrame(pcm, frameBytes, true, byChunk)
+		|| !EncodeByBatch(pcm, byBatch)) {
+		fprintf(stderr, "encode failed\n");
+		return 2;
+	}
+	//* The first frames are taken by the encoder delay, the rest of the input is all out.
+	int delay = TEST_FRAMES - expected.frames;
+	printf("aactest: %d frames of %u samples in, encoder delay %d frames\n", TEST_FRAMES, frameSamples, delay);
+	bool ok = delay >= 0 && delay <= TEST_MAX_DELAY;
+	ok = Check("whole frames", expected, expected, frameSamples) && ok;
+	ok = Check("encode_frame by chunks", byChunk, expected, frameSamples) && ok;
+	ok = Check("encode_frames by chunks", byBatch, expected, frameSamples) && ok;
+	return ok ? 0 : 1;
+}
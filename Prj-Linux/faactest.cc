@@ -0,0 +1,203 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+//* faactest, checks the SIMD code of faac against its scalar code.
+//* A fixed pcm is encoded by each SIMD level the cpu has and by the scalar code.
+//* VecMul, VecMulRev, VecScale and the FFT keep the scalar operation order,
+//* only VecEnergy sums in lanes, which may move a block switch decision by
+//* rounding. So the ADTS of a level is either the same bytes as the scalar
+//* ADTS, or it is decoded by faad2 and the pcm must be within TEST_MIN_SNR_DB
+//* of the pcm decoded from the scalar ADTS.
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <faac.h>
+#include "pluginaac.h"
+#include "third_party/faad2-2.7/include/neaacdec.h"
+
+#define TEST_FRAMES			300		// Frames of pcm to encode
+#define TEST_MAX_FRAMES		8		// Frame table of one aac_encoder_encode_frames
+#define TEST_MIN_SNR_DB		60.0	// Decoded pcm of a level against the scalar one, when the bytes differ
+
+struct TestVector
+{
+	const char*		name;
+	unsigned int	sample_rate;
+	unsigned char	channels;
+};
+
+static const TestVector kVectors[] = {
+	{ "stereo44", 44100, 2 },
+	{ "mono16", 16000, 1 },
+};
+
+static const struct {
+	int			level;
+	const char*	name;
+} kLevels[] = {
+	{ FAAC_SIMD_SSE2, "sse2" },
+	{ FAAC_SIMD_AVX2, "avx2" },
+	{ FAAC_SIMD_NEON, "neon" },
+};
+
+static void MakePcm(std::vector<short>& pcm, const TestVector& v, int samples)
+{
+	//* Tones, a sweep, noise and a few clicks for the short blocks.
+	unsigned int seed = 1;
+	pcm.resize(samples * v.channels);
+	for (int i = 0; i < samples; i++) {
+		double t = (double)i / v.sample_rate;
+		for (int c = 0; c < v.channels; c++) {
+			seed = seed * 1103515245 + 12345;
+			double noise = (double)((seed >> 16) & 0x7fff) / 0x7fff - 0.5;
+			double click = (i % (v.sample_rate / 3)) < 64 ? 12000 * noise : 0;
+			pcm[i * v.channels + c] = (short)(6000 * sin(2 * M_PI * (440 + 110 * c) * t)
+				+ 3000 * sin(2 * M_PI * (100 + 2000 * t) * t) + 1500 * noise + click);
+		}
+	}
+}
+
+static bool Encode(const TestVector& v, const std::vector<short>& pcm, std::vector<unsigned char>& adts,
+	std::vector<unsigned int>& sizes)
+{
+	aac_enc_t enc = aac_encoder_open(v.channels, v.sample_rate, 16, false);
+	if (enc == NULL)
+		return false;
+	unsigned int maxFrameBytes = 0;
+	aac_encoder_get_info(enc, NULL, &maxFrameBytes);
+	std::vector<unsigned char> out(maxFrameBytes * TEST_MAX_FRAMES);
+	aac_enc_frame_t table[TEST_MAX_FRAMES];
+
+	const unsigned char* data = (const unsigned char*)&pcm[0];
+	unsigned int size = pcm.size() * sizeof(short);
+	unsigned int pos = 0;
+	adts.clear();
+	sizes.clear();
+	while (pos < size) {
+		unsigned int used = 0;
+		int ret = aac_encoder_encode_frames(enc, data + pos, size - pos, &used,
+			&out[0], out.size(), table, TEST_MAX_FRAMES);
+		if (ret < 0) {
+			aac_encoder_close(enc);
+			return false;
+		}
+		for (int i = 0; i < ret; i++) {
+			adts.insert(adts.end(), out.begin() + table[i].offset, out.begin() + table[i].offset + table[i].size);
+			sizes.push_back(table[i].size);
+		}
+		pos += used;
+	}
+	aac_encoder_close(enc);
+	return !sizes.empty();
+}
+
+static bool Decode(std::vector<unsigned char>& adts, const std::vector<unsigned int>& sizes, std::vector<short>& pcm)
+{
+	NeAACDecHandle dec = NeAACDecOpen();
+	unsigned long samplerate = 0;
+	unsigned char channels = 0;
+	if (dec == NULL)
+		return false;
+	if (NeAACDecInit(dec, &adts[0], adts.size(), &samplerate, &channels) < 0) {
+		NeAACDecClose(dec);
+		return false;
+	}
+	pcm.clear();
+	unsigned char* data = &adts[0];
+	for (size_t i = 0; i < sizes.size(); i++) {
+		NeAACDecFrameInfo info;
+		short* out = (short*)NeAACDecDecode(dec, &info, data, sizes[i]);
+		if (info.error > 0) {
+			NeAACDecClose(dec);
+			return false;
+		}
+		if (out != NULL)
+			pcm.insert(pcm.end(), out, out + info.samples);
+		data += sizes[i];
+	}
+	NeAACDecClose(dec);
+	return !pcm.empty();
+}
+
+//* Signal to difference ratio of b against a, INFINITY when the same.
+static double Snr(const std::vector<short>& a, const std::vector<short>& b)
+{
+	double signal = 0, diff = 0;
+	size_t n = a.size() < b.size() ? a.size() : b.size();
+	for (size_t i = 0; i < n; i++) {
+		double d = (double)a[i] - b[i];
+		signal += (double)a[i] * a[i];
+		diff += d * d;
+	}
+	if (a.size() != b.size())
+		return -INFINITY;
+	return diff > 0 ? 10 * log10(signal / diff) : INFINITY;
+}
+
+int main(int argc, char* argv[])
+{
+	bool ok = true;
+	int levels = 0;
+	printf("faactest: %d frames of each vector, the bytes of each level or its decoded pcm within %.0f dB of the scalar code\n",
+		TEST_FRAMES, TEST_MIN_SNR_DB);
+	for (size_t v = 0; v < sizeof(kVectors) / sizeof(kVectors[0]); v++) {
+		const TestVector& vec = kVectors[v];
+		std::vector<short> pcm;
+		MakePcm(pcm, vec, TEST_FRAMES * 1024);
+
+		std::vector<unsigned char> scalar_adts;
+		std::vector<unsigned int> scalar_sizes;
+		std::vector<short> scalar_pcm;
+		faacEncSetSIMD(FAAC_SIMD_NONE);
+		if (!Encode(vec, pcm, scalar_adts, scalar_sizes) || !Decode(scalar_adts, scalar_sizes, scalar_pcm)) {
+			fprintf(stderr, "%s: scalar encode or decode failed\n", vec.name);
+			faacEncSetSIMD(FAAC_SIMD_AUTO);
+			return 2;
+		}
+		printf("%-8s scalar %4d frames %7d bytes\n", vec.name, (int)scalar_sizes.size(), (int)scalar_adts.size());
+
+		for (size_t l = 0; l < sizeof(kLevels) / sizeof(kLevels[0]); l++) {
+			if (faacEncSetSIMD(kLevels[l].level) != kLevels[l].level)
+				continue;
+			levels++;
+			std::vector<unsigned char> adts;
+			std::vector<unsigned int> sizes;
+			std::vector<short> out;
+			if (!Encode(vec, pcm, adts, sizes)) {
+				printf("%-8s %-6s encode FAILED\n", vec.name, kLevels[l].name);
+				ok = false;
+				continue;
+			}
+			if (adts == scalar_adts) {
+				printf("%-8s %-6s %4d frames %7d bytes  same bytes  ok\n", vec.name, kLevels[l].name,
+					(int)sizes.size(), (int)adts.size());
+				continue;
+			}
+			double snr = Decode(adts, sizes, out) ? Snr(scalar_pcm, out) : -INFINITY;
+			bool pass = snr >= TEST_MIN_SNR_DB;
+			printf("%-8s %-6s %4d frames %7d bytes  pcm %.1f dB  %s\n", vec.name, kLevels[l].name,
+				(int)sizes.size(), (int)adts.size(), snr, pass ? "ok" : "FAILED");
+			ok = ok && pass;
+		}
+	}
+	faacEncSetSIMD(FAAC_SIMD_AUTO);
+	if (levels == 0)
+		printf("no SIMD level on this cpu or build, only the scalar code ran\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+//* faadbench, decode speed of faad2 by the scalar and the SIMD code.
+//* The ADTS corpus is encoded once at start from a fixed pcm by the pluginaac
+//* encoder, so it is the same on each run without shipping a binary:
+//*   lc48,  48 kHz stereo AAC-LC.
+//*   sbr22, 22.05 kHz stereo, decoded with implicit SBR to 44.1 kHz, for the
+//*          QMF and DCT-IV of the SBR tool.
+//* Each implementation decodes the whole corpus, the frames/s are printed and
+//* the pcm of the SIMD code must be the same as the scalar one, it keeps the
+//* scalar operation order. The exit code is not 0 on a decode error or a mismatch.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "pluginaac.h"
+#include "third_party/faad2-2.7/include/neaacdec.h"
+
+#define BENCH_FRAMES		500			// Frames of each corpus
+#define BENCH_RUNS			3
+#define BENCH_MAX_FRAMES	8			// Frame table of one aac_encoder_encode_frames
+
+struct Corpus
+{
+	const char*		name;
+	unsigned int	sample_rate;
+	unsigned char	channels;
+	std::vector<unsigned char>	adts;
+	std::vector<unsigned int>	sizes;	// Bytes of each frame
+};
+
+static long long NowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void MakePcm(std::vector<short>& pcm, unsigned int sample_rate, unsigned char channels, int samples)
+{
+	//* Tones, a sweep and a little noise, so all the bands are coded.
+	unsigned int seed = 1;
+	pcm.resize(samples * channels);
+	for (int i = 0; i < samples; i++) {
+		double t = (double)i / sample_rate;
+		for (int c = 0; c < channels; c++) {
+			seed = seed * 1103515245 + 12345;
+			double noise = (double)((seed >> 16) & 0x7fff) / 0x7fff - 0.5;
+			pcm[i * channels + c] = (short)(6000 * sin(2 * M_PI * (440 + 110 * c) * t)
+				+ 3000 * sin(2 * M_PI * (100 + 2000 * t) * t) + 1500 * noise);
+		}
+	}
+}
+
+static bool Encode(Corpus& corpus, int frames)
+{
+	aac_enc_t enc = aac_encoder_open(corpus.channels, corpus.sample_rate, 16, false);
+	if (enc == NULL)
+		return false;
+	unsigned int frameSamples = 0, maxFrameBytes = 0;
+	aac_encoder_get_info(enc, &frameSamples, &maxFrameBytes);
+	std::vector<short> pcm;
+	MakePcm(pcm, corpus.sample_rate, corpus.channels, frames * frameSamples);
+	std::vector<unsigned char> out(maxFrameBytes * BENCH_MAX_FRAMES);
+	aac_enc_frame_t table[BENCH_MAX_FRAMES];
+
+	const unsigned char* data = (const unsigned char*)&pcm[0];
+	unsigned int size = pcm.size() * sizeof(short);
+	unsigned int pos = 0;
+	while (pos < size) {
+		unsigned int used = 0;
+		int ret = aac_encoder_encode_frames(enc, data + pos, size - pos, &used,
+			&out[0], out.size(), table, BENCH_MAX_FRAMES);
+		if (ret < 0) {
+			aac_encoder_close(enc);
+			return false;
+		}
+		for (int i = 0; i < ret; i++) {
+			corpus.adts.insert(corpus.adts.end(), out.begin() + table[i].offset,
+				out.begin() + table[i].offset + table[i].size);
+			corpus.sizes.push_back(table[i].size);
+		}
+		pos += used;
+	}
+	aac_encoder_close(enc);
+	return !corpus.sizes.empty();
+}
+
+//* Decodes the corpus once, pcm gets the output when not NULL.
+static bool Decode(Corpus& corpus, std::vector<short>* pcm, unsigned long* out_rate)
+{
+	NeAACDecHandle dec = NeAACDecOpen();
+	unsigned long samplerate = 0;
+	unsigned char channels = 0;
+	if (dec == NULL)
+		return false;
+	if (NeAACDecInit(dec, &corpus.adts[0], corpus.adts.size(), &samplerate, &channels) < 0) {
+		NeAACDecClose(dec);
+		return false;
+	}
+	if (pcm != NULL)
+		pcm->clear();
+	unsigned char* data = &corpus.adts[0];
+	for (size_t i = 0; i < corpus.sizes.size(); i++) {
+		NeAACDecFrameInfo info;
+		short* out = (short*)NeAACDecDecode(dec, &info, data, corpus.sizes[i]);
+		if (info.error > 0) {
+			fprintf(stderr, "%s frame %d: %s\n", corpus.name, (int)i, NeAACDecGetErrorMessage(info.error));
+			NeAACDecClose(dec);
+			return false;
+		}
+		if (pcm != NULL && out != NULL)
+			pcm->insert(pcm->end(), out, out + info.samples);
+		if (out_rate != NULL && info.samplerate > 0)
+			*out_rate = info.samplerate;
+		data += corpus.sizes[i];
+	}
+	NeAACDecClose(dec);
+	return true;
+}
+
+//* Frames per second of the best of runs.
+static double Bench(Corpus& corpus, int runs, bool* ok)
+{
+	double best = 0;
+	for (int i = 0; i < runs; i++) {
+		long long start = NowNs();
+		if (!Decode(corpus, NULL, NULL)) {
+			*ok = false;
+			return 0;
+		}
+		long long ns = NowNs() - start;
+		double fps = ns > 0 ? corpus.sizes.size() * 1e9 / ns : 0;
+		if (fps > best)
+			best = fps;
+	}
+	return best;
+}
+
+static void Usage(const char* name)
+{
+	printf("Usage: %s [options]\n"
+		"  -n <n>     frames of each corpus, default %d\n"
+		"  -r <n>     runs of each implementation, the best is printed, default %d\n",
+		name, BENCH_FRAMES, BENCH_RUNS);
+}
+
+int main(int argc, char* argv[])
+{
+	int frames = BENCH_FRAMES;
+	int runs = BENCH_RUNS;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:r:h")) != -1) {
+		switch (opt) {
+		case 'n': frames = atoi(optarg); break;
+		case 'r': runs = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+	if (frames <= 0 || runs <= 0) {
+		Usage(argv[0]);
+		return 2;
+	}
+
+	Corpus corpora[2];
+	corpora[0].name = "lc48";
+	corpora[0].sample_rate = 48000;
+	corpora[0].channels = 2;
+	corpora[1].name = "sbr22";
+	corpora[1].sample_rate = 22050;
+	corpora[1].channels = 2;
+
+	bool simd = NeAACDecSetSIMD(1) != 0;
+	printf("faadbench: %d frames of each corpus, best of %d runs, simd %s\n",
+		frames, runs, simd ? "on this cpu" : "not built or not on this cpu");
+	bool ok = true;
+	for (size_t i = 0; i < sizeof(corpora) / sizeof(corpora[0]); i++) {
+		Corpus& corpus = corpora[i];
+		if (!Encode(corpus, frames)) {
+			fprintf(stderr, "encode %s failed\n", corpus.name);
+			return 2;
+		}
+		std::vector<short> scalar_pcm, simd_pcm;
+		unsigned long out_rate = 0;
+		NeAACDecSetSIMD(0);
+		bool decoded = Decode(corpus, &scalar_pcm, &out_rate) && !scalar_pcm.empty();
+		double scalar_fps = Bench(corpus, runs, &decoded);
+		double simd_fps = 0;
+		bool same = true;
+		if (simd) {
+			NeAACDecSetSIMD(1);
+			decoded = Decode(corpus, &simd_pcm, NULL) && decoded;
+			simd_fps = Bench(corpus, runs, &decoded);
+			same = simd_pcm == scalar_pcm;
+		}
+		printf("%-6s %5u Hz -> %5lu Hz %4d frames %7d bytes | scalar %8.0f frames/s",
+			corpus.name, corpus.sample_rate, out_rate, (int)corpus.sizes.size(), (int)corpus.adts.size(), scalar_fps);
+		if (simd) {
+			printf(" | simd %8.0f frames/s %+6.1f%% | pcm %s", simd_fps,
+				scalar_fps > 0 ? (simd_fps / scalar_fps - 1) * 100 : 0, same ? "same" : "DIFFERS");
+		}
+		printf("%s\n", decoded ? "" : " | DECODE FAILED");
+		ok = ok && decoded && same;
+	}
+	NeAACDecSetSIMD(1);
+	return ok ? 0 : 1;
+}
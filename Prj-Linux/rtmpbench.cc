@@ -0,0 +1,1077 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+//* rtmpbench, headless load test of AnyRtmpPush and AnyRtmpPull.
+//* An in-process loopback rtmp server relays N publishers to M players each,
+//* no network or device needed, the exit code is not 0 when any session failed.
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "anyrtmprelay.h"
+#include "anyrtmpull.h"
+#include "anyrtmpush.h"
+#include "rtmpreactor.h"
+#include "srs_librtmp.h"
+#include "webrtc/base/bind.h"
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/thread.h"
+#include "webrtc/base/timeutils.h"
+
+#define BENCH_APP			"live"
+#define BENCH_STREAM		"bench"
+#define BENCH_FEED_MS		2			// Interval of the feeder to push the frames due
+#define BENCH_MAX_LATENCY	10000		// Max ms of the latency histogram, the larger ones go to the last bucket
+#define BENCH_WIDTH			640
+#define BENCH_HEIGHT		480
+#define BENCH_IDR_SCALE		4			// Size of IDR to the P frames
+#define AUDIO_SAMPLE_RATE	44100
+#define AUDIO_FRAME_SAMPLES	1024
+#define SERVER_TIMEOUT		30000		// Recv and send timeout of the loopback server, ms
+#define SERVER_POLL_MS		100			// Max wait of accept, to check the quit
+
+//* Message, byte counters and the latency histogram in 1ms buckets.
+class BenchStat
+{
+public:
+	BenchStat(void) : buckets_(BENCH_MAX_LATENCY + 1, 0), msgs_(0), bytes_(0) {};
+
+	void Add(int bytes, int64_t latency) {
+		rtc::CritScope l(&cs_);
+		if (latency < 0)
+			latency = 0;
+		if (latency > BENCH_MAX_LATENCY)
+			latency = BENCH_MAX_LATENCY;
+		buckets_[latency]++;
+		msgs_++;
+		bytes_ += bytes;
+	}
+	//* Add to dst, then reset if take.
+	void MergeTo(BenchStat* dst, bool take) {
+		rtc::CritScope l(&cs_);
+		for (size_t i = 0; i < buckets_.size(); i++) {
+			dst->buckets_[i] += buckets_[i];
+			if (take)
+				buckets_[i] = 0;
+		}
+		dst->msgs_ += msgs_;
+		dst->bytes_ += bytes_;
+		if (take) {
+			msgs_ = 0;
+			bytes_ = 0;
+		}
+	}
+	//* Not locked, for the stats merged only.
+	int64_t Msgs() const { return msgs_; };
+	int64_t Bytes() const { return bytes_; };
+	int Percentile(double p) const {
+		int64_t target = (int64_t)(msgs_ * p);
+		int64_t count = 0;
+		for (size_t i = 0; i < buckets_.size(); i++) {
+			count += buckets_[i];
+			if (count > target)
+				return (int)i;
+		}
+		return 0;
+	}
+	int Max() const {
+		for (size_t i = buckets_.size(); i > 0; i--) {
+			if (buckets_[i - 1] > 0)
+				return (int)(i - 1);
+		}
+		return 0;
+	}
+
+private:
+	rtc::CriticalSection	cs_;
+	std::vector<int64_t>	buckets_;
+	int64_t					msgs_;
+	int64_t					bytes_;
+};
+
+//===================================================
+//* BenchSource, one loop of AnnexB and ADTS frames, pushed again and again.
+struct BenchFrame
+{
+	bool		video;
+	uint32_t	ts;
+	std::string	data;
+};
+
+static bool FrameBefore(const BenchFrame& a, const BenchFrame& b)
+{
+	return a.ts < b.ts;
+}
+
+//* RBSP bits for the synthetic SPS and PPS.
+class BitWriter
+{
+public:
+	BitWriter(void) : cur_(0), nbits_(0) {};
+
+	void Bit(int b) {
+		cur_ = (cur_ << 1) | (b & 1);
+		if (++nbits_ == 8) {
+			buf_.push_back((char)cur_);
+			cur_ = 0;
+			nbits_ = 0;
+		}
+	}
+	void Bits(uint32_t v, int n) {
+		for (int i = n - 1; i >= 0; i--)
+			Bit(v >> i);
+	}
+	void Ue(uint32_t v) {
+		v++;
+		int len = 0;
+		for (uint32_t t = v; t > 1; t >>= 1)
+			len++;
+		Bits(0, len);
+		Bits(v, len + 1);
+	}
+	void Se(int v) {
+		Ue(v <= 0 ? -2 * v : 2 * v - 1);
+	}
+	//* The trailing bits, then the emulation prevention.
+	std::string Nalu(uint8_t header) {
+		Bit(1);
+		while (nbits_ != 0)
+			Bit(0);
+		std::string nalu(1, (char)header);
+		int zeros = 0;
+		for (size_t i = 0; i < buf_.size(); i++) {
+			uint8_t c = buf_[i];
+			if (zeros == 2 && c <= 3) {
+				nalu.push_back(3);
+				zeros = 0;
+			}
+			nalu.push_back((char)c);
+			zeros = (c == 0) ? zeros + 1 : 0;
+		}
+		return nalu;
+	}
+
+private:
+	std::string	buf_;
+	uint32_t	cur_;
+	int			nbits_;
+};
+
+static const char kStartCode[] = { 0, 0, 0, 1 };
+
+static std::string AnnexB(const std::string& nalu)
+{
+	return std::string(kStartCode, 4) + nalu;
+}
+
+static std::string Adts(int profile, int sr_index, int channels, const char* raw, int size)
+{
+	int len = size + 7;
+	char header[7];
+	header[0] = (char)0xff;
+	header[1] = (char)0xf1;
+	header[2] = (char)(((profile - 1) << 6) | (sr_index << 2) | ((channels >> 2) & 0x01));
+	header[3] = (char)(((channels & 0x03) << 6) | ((len >> 11) & 0x03));
+	header[4] = (char)((len >> 3) & 0xff);
+	header[5] = (char)(((len & 0x07) << 5) | 0x1f);
+	header[6] = (char)0xfc;
+	return std::string(header, 7) + std::string(raw, size);
+}
+
+class BenchSource
+{
+public:
+	BenchSource(void) : duration_(0) {};
+
+	//* Baseline 640x480, one GOP of video and the audio in the same time.
+	bool LoadSynthetic(int fps, int gop, int video_kbps, int audio_kbps) {
+		BitWriter sps;
+		sps.Bits(66, 8);		// profile_idc, baseline
+		sps.Bits(0xc0, 8);		// constraint_set0/1
+		sps.Bits(30, 8);		// level_idc
+		sps.Ue(0);				// seq_parameter_set_id
+		sps.Ue(0);				// log2_max_frame_num_minus4
+		sps.Ue(2);				// pic_order_cnt_type
+		sps.Ue(1);				// max_num_ref_frames
+		sps.Bit(0);				// gaps_in_frame_num_value_allowed_flag
+		sps.Ue(BENCH_WIDTH / 16 - 1);
+		sps.Ue(BENCH_HEIGHT / 16 - 1);
+		sps.Bit(1);				// frame_mbs_only_flag
+		sps.Bit(1);				// direct_8x8_inference_flag
+		sps.Bit(0);				// frame_cropping_flag
+		sps.Bit(0);				// vui_parameters_present_flag
+		BitWriter pps;
+		pps.Ue(0);				// pic_parameter_set_id
+		pps.Ue(0);				// seq_parameter_set_id
+		pps.Bit(0);				// entropy_coding_mode_flag
+		pps.Bit(0);				// bottom_field_pic_order_in_frame_present_flag
+		pps.Ue(0);				// num_slice_groups_minus1
+		pps.Ue(0);				// num_ref_idx_l0_default_active_minus1
+		pps.Ue(0);				// num_ref_idx_l1_default_active_minus1
+		pps.Bit(0);				// weighted_pred_flag
+		pps.Bits(0, 2);			// weighted_bipred_idc
+		pps.Se(0);				// pic_init_qp_minus26
+		pps.Se(0);				// pic_init_qs_minus26
+		pps.Se(0);				// chroma_qp_index_offset
+		pps.Bit(1);				// deblocking_filter_control_present_flag
+		pps.Bit(0);				// constrained_intra_pred_flag
+		pps.Bit(0);				// redundant_pic_cnt_present_flag
+		std::string sps_pps = AnnexB(sps.Nalu(0x67)) + AnnexB(pps.Nalu(0x68));
+
+		//* The slices are never decoded, fill them without start code emulation.
+		int p_size = video_kbps * 1000 / 8 / fps;
+		if (p_size < 16)
+			p_size = 16;
+		std::string idr = AnnexB(std::string(1, (char)0x65) + std::string(p_size * BENCH_IDR_SCALE, (char)0xaa));
+		std::string p = AnnexB(std::string(1, (char)0x41) + std::string(p_size, (char)0xaa));
+
+		frames_.clear();
+		duration_ = (uint32_t)(gop * 1000 / fps);
+		for (int i = 0; i < gop; i++) {
+			BenchFrame frame;
+			frame.video = true;
+			frame.ts = (uint32_t)(i * 1000 / fps);
+			frame.data = (i == 0) ? sps_pps + idr : p;
+			frames_.push_back(frame);
+		}
+		int a_size = audio_kbps * 1000 / 8 * AUDIO_FRAME_SAMPLES / AUDIO_SAMPLE_RATE;
+		std::string raw(a_size > 0 ? a_size : 1, (char)0x55);
+		for (int i = 0;; i++) {
+			uint32_t ts = (uint32_t)((int64_t)i * AUDIO_FRAME_SAMPLES * 1000 / AUDIO_SAMPLE_RATE);
+			if (ts >= duration_)
+				break;
+			BenchFrame frame;
+			frame.video = false;
+			frame.ts = ts;
+			frame.data = Adts(2, 4, 2, raw.data(), raw.size());	// AAC LC, 44100, stereo
+			frames_.push_back(frame);
+		}
+		std::stable_sort(frames_.begin(), frames_.end(), FrameBefore);
+		return true;
+	}
+
+	//* H.264 and AAC of the flv, from the first keyframe.
+	bool LoadFlv(const char* file) {
+		srs_flv_t flv = srs_flv_open_read(file);
+		if (flv == NULL)
+			return false;
+		char header[9];
+		if (srs_flv_read_header(flv, header) != 0) {
+			srs_flv_close(flv);
+			return false;
+		}
+
+		std::string sps_pps;
+		int nalu_len_size = 4;
+		int aac_profile = 2, aac_sr_index = 4, aac_channels = 2;
+		bool got_keyframe = false;
+		uint32_t first_ts = 0;
+		frames_.clear();
+		for (;;) {
+			char type;
+			int32_t size;
+			u_int32_t time;
+			if (srs_flv_read_tag_header(flv, &type, &size, &time) != 0)
+				break;
+			std::vector<char> data(size > 0 ? size : 1);
+			if (srs_flv_read_tag_data(flv, &data[0], size) != 0)
+				break;
+			const uint8_t* p = (const uint8_t*)&data[0];
+
+			if (type == SRS_RTMP_TYPE_VIDEO && size > 5 && (p[0] & 0x0f) == 7) {
+				if (p[1] == 0) {
+					//* AVCDecoderConfigurationRecord
+					if (size < 11)
+						continue;
+					nalu_len_size = (p[9] & 0x03) + 1;
+					sps_pps.clear();
+					int pos = 10;
+					for (int set = 0; set < 2 && pos < size; set++) {
+						int count = set == 0 ? (p[pos++] & 0x1f) : p[pos++];
+						for (int i = 0; i < count && pos + 2 <= size; i++) {
+							int len = (p[pos] << 8) | p[pos + 1];
+							pos += 2;
+							if (pos + len > size)
+								break;
+							sps_pps += AnnexB(std::string((const char*)p + pos, len));
+							pos += len;
+						}
+					}
+					continue;
+				}
+				bool keyframe = (p[0] >> 4) == 1;
+				if (!got_keyframe && !(keyframe && !sps_pps.empty()))
+					continue;
+				if (!got_keyframe) {
+					got_keyframe = true;
+					first_ts = time;
+				}
+				BenchFrame frame;
+				frame.video = true;
+				frame.ts = time - first_ts;
+				if (keyframe)
+					frame.data = sps_pps;
+				for (int pos = 5; pos + nalu_len_size <= size;) {
+					int len = 0;
+					for (int i = 0; i < nalu_len_size; i++)
+						len = (len << 8) | p[pos + i];
+					pos += nalu_len_size;
+					if (len <= 0 || pos + len > size)
+						break;
+					frame.data += AnnexB(std::string((const char*)p + pos, len));
+					pos += len;
+				}
+				frames_.push_back(frame);
+			}
+			else if (type == SRS_RTMP_TYPE_AUDIO && size > 2 && (p[0] >> 4) == 10) {
+				if (p[1] == 0) {
+					//* AudioSpecificConfig
+					if (size >= 4) {
+						aac_profile = p[2] >> 3;
+						aac_sr_index = ((p[2] & 0x07) << 1) | (p[3] >> 7);
+						aac_channels = (p[3] >> 3) & 0x0f;
+					}
+					continue;
+				}
+				if (!got_keyframe)
+					continue;
+				BenchFrame frame;
+				frame.video = false;
+				frame.ts = time - first_ts;
+				frame.data = Adts(aac_profile, aac_sr_index, aac_channels, (const char*)p + 2, size - 2);
+				frames_.push_back(frame);
+			}
+		}
+		srs_flv_close(flv);
+		if (frames_.empty())
+			return false;
+		std::stable_sort(frames_.begin(), frames_.end(), FrameBefore);
+		//* One frame interval between the loops.
+		duration_ = frames_.back().ts + 40;
+		return true;
+	}
+
+	const std::vector<BenchFrame>& Frames() const { return frames_; };
+	uint32_t Duration() const { return duration_; };
+
+private:
+	std::vector<BenchFrame>	frames_;
+	uint32_t				duration_;
+};
+
+//===================================================
+//* BenchPublisher
+class BenchPublisher : public AnyRtmpushCallback
+{
+public:
+	BenchPublisher(const std::string& url, const BenchSource& source)
+		: source_(source)
+		, push_(NULL)
+		, connected_(false)
+		, ever_connected_(false)
+		, failed_(false)
+		, base_ms_(0)
+		, next_(0)
+		, loop_ts_(0)
+		, reconnects_(0)
+		, delay_max_(0)
+		, drop_frames_(0)
+		, drop_bytes_(0) {
+		push_ = new AnyRtmpPush(*this, url);
+	};
+	virtual ~BenchPublisher(void) {
+		delete push_;
+	};
+
+	//* On the feeder thread, push the frames due since connected.
+	void Feed(int64_t now) {
+		rtc::CritScope l(&cs_);
+		if (!connected_)
+			return;
+		const std::vector<BenchFrame>& frames = source_.Frames();
+		for (;;) {
+			const BenchFrame& frame = frames[next_];
+			uint32_t ts = loop_ts_ + frame.ts;
+			if ((int64_t)ts > now - base_ms_)
+				break;
+			uint8_t* data = (uint8_t*)frame.data.data();
+			if (frame.video)
+				push_->SetH264Data(data, frame.data.size(), ts, ts);
+			else
+				push_->SetAacData(data, frame.data.size(), ts);
+			stat_.Add(frame.data.size(), now - base_ms_ - ts);
+			if (++next_ == frames.size()) {
+				next_ = 0;
+				loop_ts_ += source_.Duration();
+			}
+		}
+	}
+
+	//* Wall clock of the timestamp 0.
+	int64_t BaseMs() {
+		rtc::CritScope l(&cs_);
+		return base_ms_;
+	}
+	bool Connected() { rtc::CritScope l(&cs_); return connected_; };
+	bool Failed() { rtc::CritScope l(&cs_); return failed_ || !ever_connected_; };
+	BenchStat& Stat() { return stat_; };
+	//* Max ms queued, and the drops since last call.
+	void TakeQueue(int* delay_max, int* drop_frames, int* drop_bytes, int* reconnects) {
+		rtc::CritScope l(&cs_);
+		*delay_max = std::max(*delay_max, delay_max_);
+		*drop_frames += drop_frames_;
+		*drop_bytes += drop_bytes_;
+		*reconnects += reconnects_;
+		delay_max_ = drop_frames_ = drop_bytes_ = reconnects_ = 0;
+	}
+
+	//* For AnyRtmpushCallback
+	virtual void OnRtmpConnected() {
+		rtc::CritScope l(&cs_);
+		connected_ = true;
+		ever_connected_ = true;
+		base_ms_ = rtc::TimeMillis();
+		next_ = 0;
+		loop_ts_ = 0;
+	}
+	virtual void OnRtmpReconnecting(int times) {
+		rtc::CritScope l(&cs_);
+		connected_ = false;
+		reconnects_++;
+	}
+	virtual void OnRtmpDisconnect() {
+		rtc::CritScope l(&cs_);
+		connected_ = false;
+		failed_ = true;
+	}
+	virtual void OnRtmpStatusEvent(int delayMs, int netBand, int dropFrames, int dropBytes) {
+		rtc::CritScope l(&cs_);
+		delay_max_ = std::max(delay_max_, delayMs);
+		drop_frames_ += dropFrames;
+		drop_bytes_ += dropBytes;
+	}
+
+private:
+	const BenchSource&	source_;
+	AnyRtmpPush*		push_;
+	BenchStat			stat_;
+	rtc::CriticalSection	cs_;
+	bool				connected_;
+	bool				ever_connected_;
+	bool				failed_;
+	int64_t				base_ms_;
+	size_t				next_;
+	uint32_t			loop_ts_;
+	int					reconnects_;
+	int					delay_max_;
+	int					drop_frames_;
+	int					drop_bytes_;
+};
+
+//===================================================
+//* BenchPlayer
+class BenchPlayer : public AnyRtmpPullCallback
+{
+public:
+	BenchPlayer(const std::string& url, BenchPublisher& publisher)
+		: publisher_(publisher)
+		, pull_(NULL)
+		, connected_(false)
+		, failed_(false) {
+		pull_ = new AnyRtmpPull(*this, url);
+	};
+	virtual ~BenchPlayer(void) {
+		delete pull_;
+	};
+
+	bool Connected() const { return connected_; };
+	bool Failed() const { return failed_ || !connected_; };
+	BenchStat& Stat() { return stat_; };
+
+	//* For AnyRtmpPullCallback, on the reactor thread.
+	virtual void OnRtmpullConnected() { connected_ = true; };
+	virtual void OnRtmpullFailed() { failed_ = true; };
+	virtual void OnRtmpullDisconnect() { failed_ = true; };
+	virtual void OnRtmpullH264Data(DemuxFrame* frame, uint32_t ts) {
+		stat_.Add(frame->Size(), rtc::TimeMillis() - publisher_.BaseMs() - ts);
+		delete frame;
+	}
+	virtual void OnRtmpullAACData(const DemuxFrame& frame, uint32_t ts) {
+		stat_.Add(frame.Size(), rtc::TimeMillis() - publisher_.BaseMs() - ts);
+	}
+
+private:
+	BenchPublisher&		publisher_;
+	AnyRtmpPull*		pull_;
+	BenchStat			stat_;
+	volatile bool		connected_;
+	volatile bool		failed_;
+};
+
+//===================================================
+//* BenchFeeder, push the due frames of all publishers.
+class BenchFeeder : public rtc::Thread
+{
+public:
+	BenchFeeder(std::vector<BenchPublisher*>& publishers)
+		: publishers_(publishers), running_(false) {};
+	virtual ~BenchFeeder(void) { Close(); };
+
+	void Open() {
+		running_ = true;
+		rtc::Thread::Start();
+	}
+	void Close() {
+		running_ = false;
+		rtc::Thread::Stop();
+	}
+
+	//* For Thread
+	virtual void Run() {
+		while (running_) {
+			int64_t now = rtc::TimeMillis();
+			for (size_t i = 0; i < publishers_.size(); i++)
+				publishers_[i]->Feed(now);
+			rtc::Thread::SleepMs(BENCH_FEED_MS);
+		}
+	}
+
+private:
+	std::vector<BenchPublisher*>&	publishers_;
+	volatile bool					running_;
+};
+
+//===================================================
+//* Loopback server, the publisher is read on its own thread, and written
+//* to the players of the stream on the same thread, the players have no thread.
+class LoopbackServerCallback
+{
+public:
+	LoopbackServerCallback(void) {};
+	virtual ~LoopbackServerCallback(void) {};
+
+	//* Wall clock of the timestamp 0 of the stream.
+	virtual int64_t StreamBaseMs(const std::string& stream) = 0;
+};
+
+struct LoopbackStream
+{
+	rtc::CriticalSection	cs;
+	std::string				name;
+	std::string				metadata;	// Sent to the new players first
+	std::string				video_sh;
+	std::string				audio_sh;
+	std::vector<srs_rtmp_server_t>	players;
+};
+
+class LoopbackServer;
+
+class LoopbackPublisher : public rtc::Thread
+{
+public:
+	LoopbackPublisher(LoopbackServer& server, LoopbackStream* stream, srs_rtmp_server_t rtmp)
+		: server_(server), stream_(stream), rtmp_(rtmp), running_(true) {
+		rtc::Thread::Start();
+	};
+	virtual ~LoopbackPublisher(void) {
+		running_ = false;
+		rtc::Thread::Stop();
+		srs_rtmp_server_destroy(rtmp_);
+	};
+
+	//* For Thread
+	virtual void Run();
+
+private:
+	LoopbackServer&		server_;
+	LoopbackStream*		stream_;
+	srs_rtmp_server_t	rtmp_;
+	volatile bool		running_;
+};
+
+class LoopbackServer : public rtc::Thread
+{
+public:
+	LoopbackServer(LoopbackServerCallback& callback)
+		: callback_(callback), fd_(-1), port_(0), running_(false), players_(0) {};
+	virtual ~LoopbackServer(void) { Close(); };
+
+	//* Listen on a random port of 127.0.0.1.
+	bool Open() {
+		fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+		if (fd_ < 0)
+			return false;
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		addr.sin_port = 0;
+		socklen_t len = sizeof(addr);
+		if (::bind(fd_, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd_, 1024) < 0
+			|| ::getsockname(fd_, (sockaddr*)&addr, &len) < 0) {
+			return false;
+		}
+		port_ = ntohs(addr.sin_port);
+		running_ = true;
+		rtc::Thread::Start();
+		return true;
+	}
+	//* After all the clients closed, or the publishers wait for the timeout.
+	void Close() {
+		running_ = false;
+		rtc::Thread::Stop();
+		for (size_t i = 0; i < publishers_.size(); i++)
+			delete publishers_[i];
+		publishers_.clear();
+		std::map<std::string, LoopbackStream*>::iterator iter = streams_.begin();
+		for (; iter != streams_.end(); iter++) {
+			LoopbackStream* stream = iter->second;
+			for (size_t i = 0; i < stream->players.size(); i++)
+				srs_rtmp_server_destroy(stream->players[i]);
+			delete stream;
+		}
+		streams_.clear();
+		if (fd_ >= 0) {
+			::close(fd_);
+			fd_ = -1;
+		}
+	}
+
+	int Port() const { return port_; };
+	BenchStat& Stat() { return stat_; };
+	int Players() {
+		rtc::CritScope l(&cs_);
+		return players_;
+	}
+
+	//* On the publisher thread, the data is freed.
+	void Deliver(LoopbackStream* stream, char type, u_int32_t ts, char* data, int size) {
+		stat_.Add(size, rtc::TimeMillis() - callback_.StreamBaseMs(stream->name) - ts);
+
+		rtc::CritScope l(&stream->cs);
+		//* Cache the sequence headers and metadata for the players come later.
+		if (type == SRS_RTMP_TYPE_VIDEO && srs_flv_is_sequence_header(data, size))
+			stream->video_sh.assign(data, size);
+		else if (type == SRS_RTMP_TYPE_AUDIO && srs_utils_flv_audio_sound_format(data, size) == 10
+			&& srs_utils_flv_audio_aac_packet_type(data, size) == 0)
+			stream->audio_sh.assign(data, size);
+		else if (srs_rtmp_is_onMetaData(type, data, size))
+			stream->metadata.assign(data, size);
+
+		std::vector<srs_rtmp_server_t>::iterator iter = stream->players.begin();
+		while (iter != stream->players.end()) {
+			if (WriteCopy(*iter, type, ts, data, size) != 0) {
+				srs_rtmp_server_destroy(*iter);
+				iter = stream->players.erase(iter);
+				rtc::CritScope l(&cs_);
+				players_--;
+			}
+			else {
+				iter++;
+			}
+		}
+		free(data);
+	}
+
+	//* For Thread
+	virtual void Run() {
+		while (running_) {
+			pollfd pfd = { fd_, POLLIN, 0 };
+			if (poll(&pfd, 1, SERVER_POLL_MS) <= 0)
+				continue;
+			int fd = ::accept(fd_, NULL, NULL);
+			if (fd < 0)
+				continue;
+			OnAccept(fd);
+		}
+	}
+
+private:
+	static int WriteCopy(srs_rtmp_server_t rtmp, char type, u_int32_t ts, const char* data, int size) {
+		char* copy = (char*)malloc(size);
+		memcpy(copy, data, size);
+		return srs_rtmp_server_write_packet(rtmp, type, ts, copy, size);
+	}
+
+	LoopbackStream* GetStream(const std::string& name) {
+		rtc::CritScope l(&cs_);
+		LoopbackStream*& stream = streams_[name];
+		if (stream == NULL) {
+			stream = new LoopbackStream();
+			stream->name = name;
+		}
+		return stream;
+	}
+
+	//* The clients connect without blocking their reactors, it's ok to serve them one by one.
+	void OnAccept(int fd) {
+		//* The handshake and the small messages wait for the delayed ack otherwise.
+		int nodelay = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+		srs_rtmp_server_t rtmp = srs_rtmp_server_create(fd);
+		if (rtmp == NULL) {
+			::close(fd);
+			return;
+		}
+		srs_rtmp_server_set_timeout(rtmp, SERVER_TIMEOUT, SERVER_TIMEOUT);
+		srs_bool publish = false;
+		if (srs_rtmp_server_accept(rtmp, &publish) != 0) {
+			srs_rtmp_server_destroy(rtmp);
+			return;
+		}
+		LoopbackStream* stream = GetStream(srs_rtmp_server_get_stream(rtmp));
+		if (publish) {
+			publishers_.push_back(new LoopbackPublisher(*this, stream, rtmp));
+			return;
+		}
+
+		rtc::CritScope l(&stream->cs);
+		if ((!stream->metadata.empty() && WriteCopy(rtmp, SRS_RTMP_TYPE_SCRIPT, 0, stream->metadata.data(), stream->metadata.size()) != 0)
+			|| (!stream->video_sh.empty() && WriteCopy(rtmp, SRS_RTMP_TYPE_VIDEO, 0, stream->video_sh.data(), stream->video_sh.size()) != 0)
+			|| (!stream->audio_sh.empty() && WriteCopy(rtmp, SRS_RTMP_TYPE_AUDIO, 0, stream->audio_sh.data(), stream->audio_sh.size()) != 0)) {
+			srs_rtmp_server_destroy(rtmp);
+			return;
+		}
+		stream->players.push_back(rtmp);
+		rtc::CritScope ls(&cs_);
+		players_++;
+	}
+
+	LoopbackServerCallback&		callback_;
+	int							fd_;
+	int							port_;
+	volatile bool				running_;
+	BenchStat					stat_;
+	rtc::CriticalSection		cs_;
+	int							players_;
+	std::map<std::string, LoopbackStream*>	streams_;
+	std::vector<LoopbackPublisher*>		publishers_;	// On the accept thread only
+};
+
+void LoopbackPublisher::Run()
+{
+	while (running_) {
+		char type;
+		u_int32_t timestamp;
+		char* data;
+		int size;
+		if (srs_rtmp_server_read_packet(rtmp_, &type, &timestamp, &data, &size) != 0)
+			break;
+		if (type == SRS_RTMP_TYPE_AUDIO || type == SRS_RTMP_TYPE_VIDEO || type == SRS_RTMP_TYPE_SCRIPT)
+			server_.Deliver(stream_, type, timestamp, data, size);
+		else
+			free(data);
+	}
+}
+
+//===================================================
+//* Bench
+struct BenchOptions
+{
+	int publishers;
+	int players;		// Per publisher
+	int duration;		// Seconds
+	int interval;		// Seconds between the reports
+	int reactors;
+	int fps;
+	int gop;
+	int video_kbps;
+	int audio_kbps;
+	bool relay;			// Players play an AnyRtmpRelay of each stream
+	const char* flv;
+};
+
+static int64_t ThreadCpuUs()
+{
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t ProcessCpuUs()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000
+		+ usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+class Bench : public LoopbackServerCallback
+{
+public:
+	Bench(const BenchOptions& options)
+		: options_(options)
+		, server_(*this)
+		, delay_max_(0)
+		, drop_frames_(0)
+		, drop_bytes_(0)
+		, reconnects_(0) {};
+	virtual ~Bench(void) {};
+
+	int Run() {
+		if (options_.flv ? !source_.LoadFlv(options_.flv)
+			: !source_.LoadSynthetic(options_.fps, options_.gop, options_.video_kbps, options_.audio_kbps)) {
+			fprintf(stderr, "load source failed\n");
+			return 2;
+		}
+		if (!server_.Open()) {
+			fprintf(stderr, "open loopback server failed\n");
+			return 2;
+		}
+		RtmpReactor::SetThreads(options_.reactors);
+
+		char url[256];
+		char play_url[256];
+		for (int i = 0; i < options_.publishers; i++) {
+			snprintf(url, sizeof(url), "rtmp://127.0.0.1:%d/%s/%s%d", server_.Port(), BENCH_APP, BENCH_STREAM, i);
+			publishers_.push_back(new BenchPublisher(url, source_));
+			strcpy(play_url, url);
+			if (options_.relay) {
+				//* The relay pulls the stream once, and serves all its players.
+				AnyRtmpRelay* relay = new AnyRtmpRelay();
+				if (!relay->Open(0, true)) {
+					fprintf(stderr, "open relay failed\n");
+					delete relay;
+					return 2;
+				}
+				relay->Pull(url);
+				relays_.push_back(relay);
+				snprintf(play_url, sizeof(play_url), "rtmp://127.0.0.1:%d/%s/%s%d", relay->Port(), BENCH_APP, BENCH_STREAM, i);
+			}
+			for (int j = 0; j < options_.players; j++) {
+				players_.push_back(new BenchPlayer(play_url, *publishers_.back()));
+			}
+		}
+		BenchFeeder feeder(publishers_);
+		feeder.Open();
+
+		printf("rtmpbench: %d publishers, %d players%s, %s, %d reactors, %ds\n",
+			options_.publishers, (int)players_.size(), options_.relay ? " by relay" : "",
+			options_.flv ? options_.flv : "synthetic",
+			options_.reactors, options_.duration);
+		int64_t start = rtc::TimeMillis();
+		int64_t start_cpu = ProcessCpuUs();
+		int64_t start_reactor_cpu = ReactorCpuUs();
+		int64_t last = start;
+		int64_t last_cpu = start_cpu;
+		int64_t remain;
+		while ((remain = start + options_.duration * 1000 - rtc::TimeMillis()) > 0) {
+			rtc::Thread::SleepMs((int)std::min<int64_t>(remain, options_.interval * 1000));
+			int64_t now = rtc::TimeMillis();
+			int64_t cpu = ProcessCpuUs();
+			Report(now - start, now - last, cpu - last_cpu);
+			last = now;
+			last_cpu = cpu;
+		}
+		int64_t elapsed = rtc::TimeMillis() - start;
+		int64_t cpu = ProcessCpuUs() - start_cpu;
+		int64_t reactor_cpu = ReactorCpuUs() - start_reactor_cpu;
+
+		feeder.Close();
+		int failed = Summary(elapsed, cpu, reactor_cpu);
+		for (size_t i = 0; i < players_.size(); i++)
+			delete players_[i];
+		for (size_t i = 0; i < relays_.size(); i++)
+			delete relays_[i];
+		for (size_t i = 0; i < publishers_.size(); i++)
+			delete publishers_[i];
+		server_.Close();
+		return failed > 0 ? 1 : 0;
+	}
+
+	//* For LoopbackServerCallback
+	virtual int64_t StreamBaseMs(const std::string& stream) {
+		int index = atoi(stream.c_str() + strlen(BENCH_STREAM));
+		if (index < 0 || index >= (int)publishers_.size())
+			return 0;
+		return publishers_[index]->BaseMs();
+	}
+
+private:
+	//* The reactors are got round robin, so each of them once.
+	int64_t ReactorCpuUs() {
+		int64_t cpu = 0;
+		for (int i = 0; i < options_.reactors; i++) {
+			cpu += RtmpReactor::Get()->Invoke<int64_t>(RTC_FROM_HERE, rtc::Bind(&ThreadCpuUs));
+		}
+		return cpu;
+	}
+
+	void Collect(BenchStat* pushed, BenchStat* ingress, BenchStat* egress, bool take) {
+		for (size_t i = 0; i < publishers_.size(); i++)
+			publishers_[i]->Stat().MergeTo(pushed, take);
+		server_.Stat().MergeTo(ingress, take);
+		for (size_t i = 0; i < players_.size(); i++)
+			players_[i]->Stat().MergeTo(egress, take);
+	}
+
+	void Report(int64_t at, int64_t elapsed, int64_t cpu) {
+		BenchStat pushed, ingress, egress;
+		Collect(&pushed, &ingress, &egress, true);
+		pushed.MergeTo(&pushed_, false);
+		ingress.MergeTo(&ingress_, false);
+		egress.MergeTo(&egress_, false);
+
+		int pub_connected = 0, ply_connected = 0;
+		for (size_t i = 0; i < publishers_.size(); i++)
+			pub_connected += publishers_[i]->Connected() ? 1 : 0;
+		for (size_t i = 0; i < players_.size(); i++)
+			ply_connected += players_[i]->Connected() ? 1 : 0;
+		int delay_max = 0, drop_frames = 0, drop_bytes = 0, reconnects = 0;
+		for (size_t i = 0; i < publishers_.size(); i++)
+			publishers_[i]->TakeQueue(&delay_max, &drop_frames, &drop_bytes, &reconnects);
+		drop_frames_ += drop_frames;
+		drop_bytes_ += drop_bytes;
+		reconnects_ += reconnects;
+		delay_max_ = std::max(delay_max_, delay_max);
+
+		double secs = elapsed / 1000.0;
+		printf("[%4ds] pub %d/%d ply %d/%d | in %6.0f msg/s %7.2f Mbps p50 %3d p99 %4d ms"
+			" | out %7.0f msg/s %7.2f Mbps p50 %3d p99 %4d ms | queue %4d ms drop %d | cpu %5.1f%%\n",
+			(int)(at / 1000), pub_connected, (int)publishers_.size(), ply_connected, (int)players_.size(),
+			ingress.Msgs() / secs, ingress.Bytes() * 8 / secs / 1000000, ingress.Percentile(0.5), ingress.Percentile(0.99),
+			egress.Msgs() / secs, egress.Bytes() * 8 / secs / 1000000, egress.Percentile(0.5), egress.Percentile(0.99),
+			delay_max, drop_frames, cpu / 10.0 / elapsed);
+		fflush(stdout);
+	}
+
+	int Summary(int64_t elapsed, int64_t cpu, int64_t reactor_cpu) {
+		BenchStat pushed, ingress, egress;
+		Collect(&pushed, &ingress, &egress, true);
+		pushed.MergeTo(&pushed_, false);
+		ingress.MergeTo(&ingress_, false);
+		egress.MergeTo(&egress_, false);
+
+		int failed = 0;
+		for (size_t i = 0; i < publishers_.size(); i++)
+			failed += publishers_[i]->Failed() ? 1 : 0;
+		for (size_t i = 0; i < players_.size(); i++)
+			failed += players_[i]->Failed() ? 1 : 0;
+		int sessions = (int)(publishers_.size() + players_.size());
+		double secs = elapsed / 1000.0;
+
+		printf("\nsummary in %.1fs, %d sessions, %d failed, %d reconnects\n", secs, sessions, failed, reconnects_);
+		PrintStat("pushed", pushed_, secs);
+		PrintStat("ingress", ingress_, secs);
+		PrintStat("egress", egress_, secs);
+		printf("  %-8s max %d ms, dropped %d frames %d bytes\n", "queue", delay_max_, drop_frames_, drop_bytes_);
+		printf("  %-8s process %.1f%%, %.3f%% per session; reactors %.1f%%, %.3f%% per session\n", "cpu",
+			cpu / 10.0 / elapsed, sessions ? cpu / 10.0 / elapsed / sessions : 0,
+			reactor_cpu / 10.0 / elapsed, sessions ? reactor_cpu / 10.0 / elapsed / sessions : 0);
+		if (egress_.Msgs() == 0 && !players_.empty())
+			failed++;
+		return failed;
+	}
+
+	static void PrintStat(const char* name, const BenchStat& stat, double secs) {
+		printf("  %-8s %lld msgs, %.0f msg/s, %.2f Mbps, latency p50 %d p90 %d p99 %d max %d ms\n",
+			name, (long long)stat.Msgs(), stat.Msgs() / secs, stat.Bytes() * 8 / secs / 1000000,
+			stat.Percentile(0.5), stat.Percentile(0.9), stat.Percentile(0.99), stat.Max());
+	}
+
+	BenchOptions					options_;
+	BenchSource						source_;
+	LoopbackServer					server_;
+	std::vector<BenchPublisher*>	publishers_;
+	std::vector<BenchPlayer*>		players_;
+	std::vector<AnyRtmpRelay*>		relays_;
+	BenchStat						pushed_;	// Totals
+	BenchStat						ingress_;
+	BenchStat						egress_;
+	int								delay_max_;
+	int								drop_frames_;
+	int								drop_bytes_;
+	int								reconnects_;
+};
+
+static void Usage(const char* name)
+{
+	printf("Usage: %s [options]\n"
+		"  -p <n>     publishers, default 4\n"
+		"  -c <n>     players of each publisher, default 4\n"
+		"  -d <sec>   duration, default 10\n"
+		"  -i <sec>   report interval, default 1\n"
+		"  -r <n>     reactor threads, default %d\n"
+		"  -f <fps>   synthetic video fps, default 25\n"
+		"  -g <n>     synthetic gop in frames, default 50\n"
+		"  -v <kbps>  synthetic video bitrate, default 800\n"
+		"  -a <kbps>  synthetic audio bitrate, default 64\n"
+		"  -F <file>  push the H.264/AAC of the flv instead, looped\n"
+		"  -R         serve the players of each stream by an AnyRtmpRelay\n"
+		"The latency is from the capture time of the frame, pushed is the feeder lateness,\n"
+		"ingress is at the loopback server, egress is at the players.\n",
+		name, RTMP_REACTOR_THREADS);
+}
+
+int main(int argc, char* argv[])
+{
+	BenchOptions options;
+	options.publishers = 4;
+	options.players = 4;
+	options.duration = 10;
+	options.interval = 1;
+	options.reactors = RTMP_REACTOR_THREADS;
+	options.fps = 25;
+	options.gop = 50;
+	options.video_kbps = 800;
+	options.audio_kbps = 64;
+	options.relay = false;
+	options.flv = NULL;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "p:c:d:i:r:f:g:v:a:F:Rh")) != -1) {
+		switch (opt) {
+		case 'p': options.publishers = atoi(optarg); break;
+		case 'c': options.players = atoi(optarg); break;
+		case 'd': options.duration = atoi(optarg); break;
+		case 'i': options.interval = atoi(optarg); break;
+		case 'r': options.reactors = atoi(optarg); break;
+		case 'f': options.fps = atoi(optarg); break;
+		case 'g': options.gop = atoi(optarg); break;
+		case 'v': options.video_kbps = atoi(optarg); break;
+		case 'a': options.audio_kbps = atoi(optarg); break;
+		case 'F': options.flv = optarg; break;
+		case 'R': options.relay = true; break;
+		default:
+			Usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+	if (options.publishers <= 0 || options.players < 0 || options.duration <= 0 || options.interval <= 0
+		|| options.fps <= 0 || options.gop <= 0 || options.reactors <= 0) {
+		Usage(argv[0]);
+		return 2;
+	}
+
+	//* The peer may close first.
+	signal(SIGPIPE, SIG_IGN);
+	Bench bench(options);
+	return bench.Run();
+}
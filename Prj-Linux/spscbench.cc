@@ -0,0 +1,235 @@
+/*
+*  Copyright (c) 2016 The AnyRTC project authors. All Rights Reserved.
+*
+*  Please visit https://www.anyrtc.io for detail.
+*
+* The GNU General Public License is a free, copyleft license for
+* software and other kinds of works.
+*
+* The licenses for most software and other practical works are designed
+* to take away your freedom to share and change the works.  By contrast,
+* the GNU General Public License is intended to guarantee your freedom to
+* share and change all versions of a program--to make sure it remains free
+* software for all its users.  We, the Free Software Foundation, use the
+* GNU General Public License for most of our software; it applies also to
+* any other work released this way by its authors.  You can apply it to
+* your programs, too.
+* See the GNU LICENSE file for more info.
+*/
+//* spscbench, microbenchmark of the hand-off between two threads by
+//* rtc::SpscQueue against the std::list and rtc::CriticalSection it replaced
+//* in AnyRtmpPush, PlyBuffer and PlyDecoder.
+//* Each run has a producer thread and a consumer thread polling the queue:
+//*   burst, the producer pushes as fast as it can, the throughput.
+//*   paced, one item every BENCH_PACE_NS, the latency from push to pop.
+//* The exit code is not 0 when an item is lost or out of order.
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <algorithm>
+#include <list>
+#include <vector>
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/platform_thread.h"
+#include "webrtc/base/spsc_queue.h"
+#include "webrtc/base/timeutils.h"
+
+#define BENCH_ITEMS			2000000		// Items of a burst run
+#define BENCH_PACED_ITEMS	200000		// Items of a paced run
+#define BENCH_PACE_NS		2000		// Interval of the paced pushes
+#define BENCH_CAPACITY		1024		// Both queues are bounded by it
+#define BENCH_RUNS			3
+#define BENCH_SPINS			256			// Polls before yielding, the threads may share one cpu
+
+struct BenchItem
+{
+	int			seq;
+	int64_t		pushed_ns;
+};
+
+static void Backoff(int& spins)
+{
+	if (++spins >= BENCH_SPINS) {
+		spins = 0;
+		sched_yield();
+	}
+}
+
+//* The locked list, bounded like the ring for a fair burst.
+class ListQueue
+{
+public:
+	explicit ListQueue(size_t capacity) : capacity_(capacity) {}
+
+	bool Push(BenchItem** item) {
+		rtc::CritScope l(&cs_);
+		if (list_.size() >= capacity_)
+			return false;
+		list_.push_back(*item);
+		return true;
+	}
+	bool Pop(BenchItem** item) {
+		rtc::CritScope l(&cs_);
+		if (list_.empty())
+			return false;
+		*item = list_.front();
+		list_.pop_front();
+		return true;
+	}
+
+private:
+	size_t					capacity_;
+	rtc::CriticalSection	cs_;
+	std::list<BenchItem*>	list_;
+};
+
+struct RunResult
+{
+	double	mops;			// Million items per second
+	int64_t	p50_ns;
+	int64_t	p99_ns;
+	int64_t	max_ns;
+	bool	ok;
+};
+
+template <class Queue>
+class BenchRun
+{
+public:
+	BenchRun(int items, bool paced)
+		: queue_(BENCH_CAPACITY)
+		, items_(items)
+		, paced_(paced)
+		, ok_(false)
+		, pool_(items)
+		, start_ns_(0)
+		, end_ns_(0) {
+		latency_.reserve(paced ? items : 0);
+	}
+
+	RunResult Run() {
+		rtc::PlatformThread consumer(&BenchRun::Consume, this, "SpscConsumer");
+		rtc::PlatformThread producer(&BenchRun::Produce, this, "SpscProducer");
+		consumer.Start();
+		producer.Start();
+		producer.Stop();
+		consumer.Stop();
+
+		RunResult result;
+		result.ok = ok_;
+		result.mops = end_ns_ > start_ns_ ? items_ * 1000.0 / (end_ns_ - start_ns_) : 0;
+		result.p50_ns = result.p99_ns = result.max_ns = 0;
+		if (!latency_.empty()) {
+			std::sort(latency_.begin(), latency_.end());
+			result.p50_ns = latency_[latency_.size() / 2];
+			result.p99_ns = latency_[latency_.size() * 99 / 100];
+			result.max_ns = latency_.back();
+		}
+		return result;
+	}
+
+private:
+	//* For rtc::PlatformThread, each runs once.
+	static bool Produce(void* obj) {
+		BenchRun* run = (BenchRun*)obj;
+		run->start_ns_ = rtc::TimeNanos();
+		int64_t next_ns = run->start_ns_;
+		int spins = 0;
+		for (int i = 0; i < run->items_; i++) {
+			BenchItem* item = &run->pool_[i];
+			item->seq = i;
+			if (run->paced_) {
+				next_ns += BENCH_PACE_NS;
+				while (rtc::TimeNanos() < next_ns)
+					Backoff(spins);
+				item->pushed_ns = rtc::TimeNanos();
+			}
+			while (!run->queue_.Push(&item))
+				Backoff(spins);
+		}
+		return false;
+	}
+	static bool Consume(void* obj) {
+		BenchRun* run = (BenchRun*)obj;
+		run->ok_ = true;
+		int spins = 0;
+		for (int i = 0; i < run->items_; i++) {
+			BenchItem* item = NULL;
+			while (!run->queue_.Pop(&item))
+				Backoff(spins);
+			if (run->paced_) {
+				run->latency_.push_back(rtc::TimeNanos() - item->pushed_ns);
+			}
+			if (item->seq != i) {
+				run->ok_ = false;
+			}
+		}
+		run->end_ns_ = rtc::TimeNanos();
+		return false;
+	}
+
+	Queue						queue_;
+	int							items_;
+	bool						paced_;
+	bool						ok_;
+	std::vector<BenchItem>		pool_;
+	std::vector<int64_t>		latency_;
+	int64_t						start_ns_;
+	int64_t						end_ns_;
+};
+
+template <class Queue>
+static bool Bench(const char* name, int runs, int items, int paced_items)
+{
+	bool ok = true;
+	for (int i = 0; i < runs; i++) {
+		RunResult burst = BenchRun<Queue>(items, false).Run();
+		RunResult paced = BenchRun<Queue>(paced_items, true).Run();
+		printf("%-14s run %d | burst %7.2f Mitems/s | paced latency p50 %6lld p99 %6lld max %8lld ns%s\n",
+			name, i + 1, burst.mops, (long long)paced.p50_ns, (long long)paced.p99_ns, (long long)paced.max_ns,
+			burst.ok && paced.ok ? "" : " | LOST OR REORDERED");
+		ok = ok && burst.ok && paced.ok;
+	}
+	return ok;
+}
+
+static void Usage(const char* name)
+{
+	printf("Usage: %s [options]\n"
+		"  -n <n>     items of a burst run, default %d\n"
+		"  -m <n>     items of a paced run, one each %d ns, default %d\n"
+		"  -r <n>     runs, default %d\n"
+		"Both queues are bounded to %d items, the producer polls when full, the consumer when empty,\n"
+		"each yields the cpu after %d polls.\n",
+		name, BENCH_ITEMS, BENCH_PACE_NS, BENCH_PACED_ITEMS, BENCH_RUNS, BENCH_CAPACITY, BENCH_SPINS);
+}
+
+int main(int argc, char* argv[])
+{
+	int items = BENCH_ITEMS;
+	int paced_items = BENCH_PACED_ITEMS;
+	int runs = BENCH_RUNS;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "n:m:r:h")) != -1) {
+		switch (opt) {
+		case 'n': items = atoi(optarg); break;
+		case 'm': paced_items = atoi(optarg); break;
+		case 'r': runs = atoi(optarg); break;
+		default:
+			Usage(argv[0]);
+			return opt == 'h' ? 0 : 2;
+		}
+	}
+	if (items <= 0 || paced_items <= 0 || runs <= 0) {
+		Usage(argv[0]);
+		return 2;
+	}
+
+	printf("spscbench: %d burst items, %d paced items, capacity %d, %ld cpus\n",
+		items, paced_items, BENCH_CAPACITY, sysconf(_SC_NPROCESSORS_ONLN));
+	bool ok = Bench<rtc::SpscQueue<BenchItem*> >("SpscQueue", runs, items, paced_items);
+	ok = Bench<ListQueue>("list+lock", runs, items, paced_items) && ok;
+	return ok ? 0 : 1;
+}
@@ -38,7 +38,7 @@ public:
 public:
 	//* For RTMPCGuesterEvent
 	virtual void OnRtmplayerOK() {};
-	virtual void OnRtmplayerStatus(int cacheTime, int curBitrate) {};
+	virtual void OnRtmplayerStatus(int cacheTime, int curBitrate, int targetDelay, int minDelay) {};
 	virtual void OnRtmplayerCache(int time) {};
 	virtual void OnRtmplayerClosed(int errcode) {};
 
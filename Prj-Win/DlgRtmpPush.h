@@ -39,7 +39,7 @@ protected:
 	//* For RTMPHosterEvent
 	virtual void OnRtmpStreamOK() {};
 	virtual void OnRtmpStreamReconnecting(int times) {};
-	virtual void OnRtmpStreamStatus(int delayMs, int netBand) {};
+	virtual void OnRtmpStreamStatus(int delayMs, int netBand, int dropFrames, int dropBytes) {};
 	virtual void OnRtmpStreamFailed(int code) {};
 	virtual void OnRtmpStreamClosed() {};
 
@@ -79,7 +79,7 @@
     self.stateRTMPLabel.text = [NSString stringWithFormat:@"第%d次重连中...",times];
 }
 
-- (void)OnRtmpStreamStatus:(int) delayMs withNetBand:(int) netBand {
+- (void)OnRtmpStreamStatus:(int) delayMs withNetBand:(int) netBand withDropFrames:(int) dropFrames withDropBytes:(int) dropBytes {
     NSLog(@"OnRtmpStreamStatus:%d withNetBand:%d",delayMs,netBand);
     self.stateRTMPLabel.text = [NSString stringWithFormat:@"RTMP延迟:%d 网络:%d",delayMs,netBand];
 }
@@ -52,7 +52,7 @@
     NSLog(@"OnRtmpStreamOK");
     self.stateRTMPLabel.text = @"连接RTMP服务成功";
 }
-- (void)OnRtmplayerStatus:(int) cacheTime withBitrate:(int) curBitrate {
+- (void)OnRtmplayerStatus:(int) cacheTime withBitrate:(int) curBitrate withTargetDelay:(int) targetDelay withMinDelay:(int) minDelay {
     NSLog(@"OnRtmplayerStatus:%d withBitrate:%d",cacheTime,curBitrate);
     self.stateRTMPLabel.text = [NSString stringWithFormat:@"RTMP缓存区:%d 码率:%d",cacheTime,curBitrate];
 }
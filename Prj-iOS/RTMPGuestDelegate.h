@@ -32,8 +32,10 @@
  *
  *  @param cacheTime delay time (ms)
  *  @param curBitrate Bit rate
+ *  @param targetDelay delay the jitter buffer aims at (ms)
+ *  @param minDelay minimum delay in the last second (ms)
  */
-- (void)OnRtmplayerStatus:(int) cacheTime withBitrate:(int) curBitrate;
+- (void)OnRtmplayerStatus:(int) cacheTime withBitrate:(int) curBitrate withTargetDelay:(int) targetDelay withMinDelay:(int) minDelay;
 /**
  *  cache time
  *
@@ -47,11 +47,11 @@ public:
             [rtmp_delegate_ OnRtmplayerOK];
         });
     };
-    virtual void OnRtmplayerStatus(int cacheTime, int curBitrate){
+    virtual void OnRtmplayerStatus(int cacheTime, int curBitrate, int targetDelay, int minDelay){
         if(!ui_avalible_)
             return;
         dispatch_async(dispatch_get_main_queue(), ^{
-            [rtmp_delegate_ OnRtmplayerStatus:cacheTime withBitrate:curBitrate];
+            [rtmp_delegate_ OnRtmplayerStatus:cacheTime withBitrate:curBitrate withTargetDelay:targetDelay withMinDelay:minDelay];
         });
     };
     virtual void OnRtmplayerCache(int time){
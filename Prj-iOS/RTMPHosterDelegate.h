@@ -39,8 +39,10 @@
  *
  *  @param delayMs delay time (ms)
  *  @param netBand network bandwidth
+ *  @param dropFrames frames dropped from the send queue since the last status
+ *  @param dropBytes bytes dropped from the send queue since the last status
  */
-- (void)OnRtmpStreamStatus:(int) delayMs withNetBand:(int) netBand;
+- (void)OnRtmpStreamStatus:(int) delayMs withNetBand:(int) netBand withDropFrames:(int) dropFrames withDropBytes:(int) dropBytes;
 /**
  *  RTMP service connection is failure callback
  *
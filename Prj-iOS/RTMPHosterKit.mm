@@ -58,11 +58,11 @@ public:
             [rtmp_delegate_ OnRtmpStreamReconnecting:times];
         });
     };
-    virtual void OnRtmpStreamStatus(int delayMs, int netBand){
+    virtual void OnRtmpStreamStatus(int delayMs, int netBand, int dropFrames, int dropBytes){
         if(!ui_avalible_)
             return;
         dispatch_async(dispatch_get_main_queue(), ^{
-            [rtmp_delegate_ OnRtmpStreamStatus:delayMs withNetBand:netBand];
+            [rtmp_delegate_ OnRtmpStreamStatus:delayMs withNetBand:netBand withDropFrames:dropFrames withDropBytes:dropBytes];
         });
     };
     virtual void OnRtmpStreamFailed(int code){
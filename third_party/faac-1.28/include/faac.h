@@ -89,6 +89,16 @@ int FAACAPI faacEncEncode(faacEncHandle hEncoder, int32_t * inputBuffer, unsigne
 int FAACAPI faacEncClose(faacEncHandle hEncoder);
 
 
+/*
+	Selects the SIMD code of all encoders, one of FAAC_SIMD_*. A level the
+	cpu or the build has not is ignored, FAAC_SIMD_AUTO is the best the cpu
+	has, which is also the default.
+
+	Returns the level in use.
+*/
+int FAACAPI faacEncSetSIMD(int level);
+
+
 
 #pragma pack(pop)
 
@@ -45,6 +45,13 @@
 #define SHORTCTL_NOSHORT   1
 #define SHORTCTL_NOLONG    2
 
+/* SIMD code of the encoder, for faacEncSetSIMD */
+#define FAAC_SIMD_AUTO    -1
+#define FAAC_SIMD_NONE     0
+#define FAAC_SIMD_SSE2     1
+#define FAAC_SIMD_AVX2     2
+#define FAAC_SIMD_NEON     3
+
 #pragma pack(push, 1)
 typedef struct faacEncConfiguration
 {
@@ -24,6 +24,7 @@
 #include <stdio.h>
 
 #include "fft.h"
+#include "frame.h" /* FAAC_SIMD_* */
 #include "util.h"
 
 #define MAXLOGM 9
@@ -551,6 +552,146 @@ static void reorder( FFT_Tables *fft_tables, double *x, int logm)
 	}
 }
 
+#if defined(FAAC_X86)
+/* Two butterflies at a time of a pass with step >= 2, same operations as the scalar loop */
+static FAAC_TARGET_SSE2 void fft_pass_sse2(double *xr, double *xi, const fftfloat *refac,
+		const fftfloat *imfac, int size, int step, int estep)
+{
+	int shift, pos, exp, x1, x2;
+
+	for (pos = 0; pos < size; pos += (2 * step))
+	{
+		x1 = pos;
+		x2 = pos + step;
+		exp = 0;
+		for (shift = 0; shift < step; shift += 2)
+		{
+			__m128d re = _mm_set_pd(refac[exp + estep], refac[exp]);
+			__m128d im = _mm_set_pd(imfac[exp + estep], imfac[exp]);
+			__m128d ar = _mm_loadu_pd(xr + x2);
+			__m128d ai = _mm_loadu_pd(xi + x2);
+			__m128d br = _mm_loadu_pd(xr + x1);
+			__m128d bi = _mm_loadu_pd(xi + x1);
+			__m128d v2r = _mm_sub_pd(_mm_mul_pd(ar, re), _mm_mul_pd(ai, im));
+			__m128d v2i = _mm_add_pd(_mm_mul_pd(ar, im), _mm_mul_pd(ai, re));
+
+			_mm_storeu_pd(xr + x2, _mm_sub_pd(br, v2r));
+			_mm_storeu_pd(xr + x1, _mm_add_pd(br, v2r));
+			_mm_storeu_pd(xi + x2, _mm_sub_pd(bi, v2i));
+			_mm_storeu_pd(xi + x1, _mm_add_pd(bi, v2i));
+			exp += 2 * estep;
+			x1 += 2;
+			x2 += 2;
+		}
+	}
+}
+
+/* Four butterflies at a time of a pass with step >= 4 */
+static FAAC_TARGET_AVX2 void fft_pass_avx2(double *xr, double *xi, const fftfloat *refac,
+		const fftfloat *imfac, int size, int step, int estep)
+{
+	int shift, pos, exp, x1, x2;
+
+	for (pos = 0; pos < size; pos += (2 * step))
+	{
+		x1 = pos;
+		x2 = pos + step;
+		exp = 0;
+		for (shift = 0; shift < step; shift += 4)
+		{
+			__m256d re = _mm256_set_pd(refac[exp + 3 * estep], refac[exp + 2 * estep], refac[exp + estep], refac[exp]);
+			__m256d im = _mm256_set_pd(imfac[exp + 3 * estep], imfac[exp + 2 * estep], imfac[exp + estep], imfac[exp]);
+			__m256d ar = _mm256_loadu_pd(xr + x2);
+			__m256d ai = _mm256_loadu_pd(xi + x2);
+			__m256d br = _mm256_loadu_pd(xr + x1);
+			__m256d bi = _mm256_loadu_pd(xi + x1);
+			__m256d v2r = _mm256_sub_pd(_mm256_mul_pd(ar, re), _mm256_mul_pd(ai, im));
+			__m256d v2i = _mm256_add_pd(_mm256_mul_pd(ar, im), _mm256_mul_pd(ai, re));
+
+			_mm256_storeu_pd(xr + x2, _mm256_sub_pd(br, v2r));
+			_mm256_storeu_pd(xr + x1, _mm256_add_pd(br, v2r));
+			_mm256_storeu_pd(xi + x2, _mm256_sub_pd(bi, v2i));
+			_mm256_storeu_pd(xi + x1, _mm256_add_pd(bi, v2i));
+			exp += 4 * estep;
+			x1 += 4;
+			x2 += 4;
+		}
+	}
+}
+#endif
+
+#if defined(FAAC_NEON)
+/* Two butterflies at a time of a pass with step >= 2, same operations as the scalar loop */
+static void fft_pass_neon(double *xr, double *xi, const fftfloat *refac,
+		const fftfloat *imfac, int size, int step, int estep)
+{
+	int shift, pos, exp, x1, x2;
+
+	for (pos = 0; pos < size; pos += (2 * step))
+	{
+		x1 = pos;
+		x2 = pos + step;
+		exp = 0;
+		for (shift = 0; shift < step; shift += 2)
+		{
+			float64x2_t re = vcombine_f64(vdup_n_f64(refac[exp]), vdup_n_f64(refac[exp + estep]));
+			float64x2_t im = vcombine_f64(vdup_n_f64(imfac[exp]), vdup_n_f64(imfac[exp + estep]));
+			float64x2_t ar = vld1q_f64(xr + x2);
+			float64x2_t ai = vld1q_f64(xi + x2);
+			float64x2_t br = vld1q_f64(xr + x1);
+			float64x2_t bi = vld1q_f64(xi + x1);
+			float64x2_t v2r = vsubq_f64(vmulq_f64(ar, re), vmulq_f64(ai, im));
+			float64x2_t v2i = vaddq_f64(vmulq_f64(ar, im), vmulq_f64(ai, re));
+
+			vst1q_f64(xr + x2, vsubq_f64(br, v2r));
+			vst1q_f64(xr + x1, vaddq_f64(br, v2r));
+			vst1q_f64(xi + x2, vsubq_f64(bi, v2i));
+			vst1q_f64(xi + x1, vaddq_f64(bi, v2i));
+			exp += 2 * estep;
+			x1 += 2;
+			x2 += 2;
+		}
+	}
+}
+#endif
+
+#if defined(FAAC_X86) || defined(FAAC_NEON)
+/* One pass by the SIMD level in use, returns 0 when the scalar loop has to do it */
+static int fft_pass_simd(double *xr, double *xi, const fftfloat *refac,
+		const fftfloat *imfac, int size, int step, int estep)
+{
+	switch (SimdLevel())
+	{
+#if defined(FAAC_X86)
+	case FAAC_SIMD_AVX2:
+		if (step >= 4)
+		{
+			fft_pass_avx2(xr, xi, refac, imfac, size, step, estep);
+			return 1;
+		}
+		/* fall through - AVX2 has SSE2 */
+	case FAAC_SIMD_SSE2:
+		if (step >= 2)
+		{
+			fft_pass_sse2(xr, xi, refac, imfac, size, step, estep);
+			return 1;
+		}
+		break;
+#endif
+#if defined(FAAC_NEON)
+	case FAAC_SIMD_NEON:
+		if (step >= 2)
+		{
+			fft_pass_neon(xr, xi, refac, imfac, size, step, estep);
+			return 1;
+		}
+		break;
+#endif
+	}
+	return 0;
+}
+#endif
+
 static void fft_proc(
 		double *xr, 
 		double *xi,
@@ -567,6 +708,10 @@ static void fft_proc(
 		int x1;
 		int x2 = 0;
 		estep >>= 1;
+#if defined(FAAC_X86) || defined(FAAC_NEON)
+		if (fft_pass_simd(xr, xi, refac, imfac, size, step, estep))
+			continue;
+#endif
 		for (pos = 0; pos < size; pos += (2 * step))
 		{
 			x1 = x2;
@@ -658,22 +803,16 @@ void rfft( FFT_Tables *fft_tables, double *x, int logm)
 
 void ffti( FFT_Tables *fft_tables, double *xr, double *xi, int logm)
 {
-	int i, size;
+	int size;
 	double fac;
-	double *xrp, *xip;
 
 	fft( fft_tables, xi, xr, logm);
 
 	size = 1 << logm;
 	fac = 1.0 / size;
-	xrp = xr;
-	xip = xi;
 
-	for (i = 0; i < size; i++)
-	{
-		*xrp++ *= fac;
-		*xip++ *= fac;
-	}
+	VecScale(xr, fac, size);
+	VecScale(xi, fac, size);
 }
 
 #endif /* defined DRM && !defined DRM_1024 */
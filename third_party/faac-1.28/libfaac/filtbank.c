@@ -99,7 +99,7 @@ void FilterBank(faacEncHandle hEncoder,
 {
     double *p_o_buf, *first_window, *second_window;
     double *transf_buf;
-    int k, i;
+    int k;
     int block_type = coderInfo->block_type;
 
     transf_buf = (double*)AllocMemory(2*BLOCK_LEN_LONG*sizeof(double));
@@ -157,40 +157,32 @@ void FilterBank(faacEncHandle hEncoder,
     /* Separate action for each Block Type */
     switch (block_type) {
     case ONLY_LONG_WINDOW :
-        for ( i = 0 ; i < BLOCK_LEN_LONG ; i++){
-            p_out_mdct[i] = p_o_buf[i] * first_window[i];
-            p_out_mdct[i+BLOCK_LEN_LONG] = p_o_buf[i+BLOCK_LEN_LONG] * second_window[BLOCK_LEN_LONG-i-1];
-        }
+        VecMul(p_out_mdct, p_o_buf, first_window, BLOCK_LEN_LONG);
+        VecMulRev(p_out_mdct+BLOCK_LEN_LONG, p_o_buf+BLOCK_LEN_LONG, second_window, BLOCK_LEN_LONG);
         MDCT( &hEncoder->fft_tables, p_out_mdct, 2*BLOCK_LEN_LONG );
         break;
 
     case LONG_SHORT_WINDOW :
-        for ( i = 0 ; i < BLOCK_LEN_LONG ; i++)
-            p_out_mdct[i] = p_o_buf[i] * first_window[i];
+        VecMul(p_out_mdct, p_o_buf, first_window, BLOCK_LEN_LONG);
         memcpy(p_out_mdct+BLOCK_LEN_LONG,p_o_buf+BLOCK_LEN_LONG,NFLAT_LS*sizeof(double));
-        for ( i = 0 ; i < BLOCK_LEN_SHORT ; i++)
-            p_out_mdct[i+BLOCK_LEN_LONG+NFLAT_LS] = p_o_buf[i+BLOCK_LEN_LONG+NFLAT_LS] * second_window[BLOCK_LEN_SHORT-i-1];
+        VecMulRev(p_out_mdct+BLOCK_LEN_LONG+NFLAT_LS, p_o_buf+BLOCK_LEN_LONG+NFLAT_LS, second_window, BLOCK_LEN_SHORT);
         SetMemory(p_out_mdct+BLOCK_LEN_LONG+NFLAT_LS+BLOCK_LEN_SHORT,0,NFLAT_LS*sizeof(double));
         MDCT( &hEncoder->fft_tables, p_out_mdct, 2*BLOCK_LEN_LONG );
         break;
 
     case SHORT_LONG_WINDOW :
         SetMemory(p_out_mdct,0,NFLAT_LS*sizeof(double));
-        for ( i = 0 ; i < BLOCK_LEN_SHORT ; i++)
-            p_out_mdct[i+NFLAT_LS] = p_o_buf[i+NFLAT_LS] * first_window[i];
+        VecMul(p_out_mdct+NFLAT_LS, p_o_buf+NFLAT_LS, first_window, BLOCK_LEN_SHORT);
         memcpy(p_out_mdct+NFLAT_LS+BLOCK_LEN_SHORT,p_o_buf+NFLAT_LS+BLOCK_LEN_SHORT,NFLAT_LS*sizeof(double));
-        for ( i = 0 ; i < BLOCK_LEN_LONG ; i++)
-            p_out_mdct[i+BLOCK_LEN_LONG] = p_o_buf[i+BLOCK_LEN_LONG] * second_window[BLOCK_LEN_LONG-i-1];
+        VecMulRev(p_out_mdct+BLOCK_LEN_LONG, p_o_buf+BLOCK_LEN_LONG, second_window, BLOCK_LEN_LONG);
         MDCT( &hEncoder->fft_tables, p_out_mdct, 2*BLOCK_LEN_LONG );
         break;
 
     case ONLY_SHORT_WINDOW :
         p_o_buf += NFLAT_LS;
         for ( k=0; k < MAX_SHORT_WINDOWS; k++ ) {
-            for ( i = 0 ; i < BLOCK_LEN_SHORT ; i++ ){
-                p_out_mdct[i] = p_o_buf[i] * first_window[i];
-                p_out_mdct[i+BLOCK_LEN_SHORT] = p_o_buf[i+BLOCK_LEN_SHORT] * second_window[BLOCK_LEN_SHORT-i-1];
-            }
+            VecMul(p_out_mdct, p_o_buf, first_window, BLOCK_LEN_SHORT);
+            VecMulRev(p_out_mdct+BLOCK_LEN_SHORT, p_o_buf+BLOCK_LEN_SHORT, second_window, BLOCK_LEN_SHORT);
             MDCT( &hEncoder->fft_tables, p_out_mdct, 2*BLOCK_LEN_SHORT );
             p_out_mdct += BLOCK_LEN_SHORT;
             p_o_buf += BLOCK_LEN_SHORT;
@@ -420,15 +412,12 @@ static void CalculateKBDWindow(double* win, double alpha, int length)
 
 static void MDCT( FFT_Tables *fft_tables, double *data, int N )
 {
-    double *xi, *xr;
+    double xi[BLOCK_LEN_LONG >> 1], xr[BLOCK_LEN_LONG >> 1]; /* N is at most 2*BLOCK_LEN_LONG */
     double tempr, tempi, c, s, cold, cfreq, sfreq; /* temps for pre and post twiddle */
     double freq = TWOPI / N;
     double cosfreq8, sinfreq8;
     int i, n;
 
-    xi = (double*)AllocMemory((N >> 2)*sizeof(double));
-    xr = (double*)AllocMemory((N >> 2)*sizeof(double));
-
     /* prepare for recurrence relation in pre-twiddle */
     cfreq = cos (freq);
     sfreq = sin (freq);
@@ -492,22 +481,16 @@ static void MDCT( FFT_Tables *fft_tables, double *data, int N )
         c = c * cfreq - s * sfreq;
         s = s * cfreq + cold * sfreq;
     }
-
-    if (xr) FreeMemory(xr);
-    if (xi) FreeMemory(xi);
 }
 
 static void IMDCT( FFT_Tables *fft_tables, double *data, int N)
 {
-    double *xi, *xr;
+    double xi[BLOCK_LEN_LONG >> 1], xr[BLOCK_LEN_LONG >> 1]; /* N is at most 2*BLOCK_LEN_LONG */
     double tempr, tempi, c, s, cold, cfreq, sfreq; /* temps for pre and post twiddle */
     double freq = 2.0 * M_PI / N;
     double fac, cosfreq8, sinfreq8;
     int i;
 
-    xi = (double*)AllocMemory((N >> 2)*sizeof(double));
-    xr = (double*)AllocMemory((N >> 2)*sizeof(double));
-
     /* Choosing to allocate 2/N factor to Inverse Xform! */
     fac = 2. / N; /* remaining 2/N from 4/N IFFT factor */
 
@@ -572,7 +555,4 @@ static void IMDCT( FFT_Tables *fft_tables, double *data, int N)
         c = c * cfreq - s * sfreq;
         s = s * cfreq + cold * sfreq;
     }
-
-    if (xr) FreeMemory(xr);
-    if (xi) FreeMemory(xi);
 }
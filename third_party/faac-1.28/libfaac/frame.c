@@ -87,6 +87,12 @@ int FAACAPI faacEncGetVersion( char **faac_id_string,
 }
 
 
+int FAACAPI faacEncSetSIMD(int level)
+{
+    return SetSimdLevel(level);
+}
+
+
 int FAACAPI faacEncGetDecoderSpecificInfo(faacEncHandle hEncoder,unsigned char** ppBuffer,unsigned long* pSizeOfDecoderSpecificInfo)
 {
     BitStream* pBitStream = NULL;
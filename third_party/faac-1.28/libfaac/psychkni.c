@@ -47,19 +47,11 @@ psydata_t;
 
 static void Hann(GlobalPsyInfo * gpsyInfo, double *inSamples, int size)
 {
-  int i;
-
   /* Applying Hann window */
   if (size == BLOCK_LEN_LONG * 2)
-  {
-    for (i = 0; i < size; i++)
-      inSamples[i] *= gpsyInfo->hannWindow[i];
-  }
+    VecMul(inSamples, inSamples, gpsyInfo->hannWindow, size);
   else
-  {
-    for (i = 0; i < size; i++)
-      inSamples[i] *= gpsyInfo->hannWindowS[i];
-  }
+    VecMul(inSamples, inSamples, gpsyInfo->hannWindowS, size);
 }
 
 static void PsyCheckShort(PsyInfo * psyInfo)
@@ -368,9 +360,6 @@ static void PsyBufferUpdate( FFT_Tables *fft_tables, GlobalPsyInfo * gpsyInfo, P
 
     for (sfb = 0; sfb < num_cb_short; sfb++)
     {
-      double e;
-      int l;
-
       first = last;
       last = first + cb_width_short[sfb];
 
@@ -381,16 +370,8 @@ static void PsyBufferUpdate( FFT_Tables *fft_tables, GlobalPsyInfo * gpsyInfo, P
       if (first >= psydata->bandS) // band out of range
 	break;
 
-      e = 0.0;
-      for (l = first; l < last; l++)
-      {
-	double a = transBuffS[l];
-	double b = transBuffS[l + psyInfo->sizeS];
-
-	e += a * a + b * b;
-      }
-
-      psydata->fftEnrgNext2S[win][sfb] = e;
+      psydata->fftEnrgNext2S[win][sfb] =
+	VecEnergy(transBuffS + first, transBuffS + psyInfo->sizeS + first, last - first);
     }
     psydata->lastband = sfb;
     for (; sfb < num_cb_short; sfb++)
@@ -21,6 +21,7 @@
 
 #include <math.h>
 
+#include "frame.h" /* FAAC_SIMD_* */
 #include "util.h"
 #include "coder.h"  // FRAME_LEN
 
@@ -93,3 +94,282 @@ unsigned int MaxBitresSize(unsigned long bitRate, unsigned long sampleRate)
 {
     return 6144 - (unsigned int)((double)bitRate/(double)sampleRate*(double)FRAME_LEN);
 }
+
+/* -1 until the cpu is checked */
+static int simd_level = -1;
+
+static int CpuSimdLevel(void)
+{
+#if defined(FAAC_X86) && defined(__GNUC__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return FAAC_SIMD_AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return FAAC_SIMD_SSE2;
+    return FAAC_SIMD_NONE;
+#elif defined(FAAC_X86) && defined(_MSC_VER)
+    int regs[4];
+
+    __cpuid(regs, 0);
+    if (regs[0] >= 7)
+    {
+        /* AVX2, and the OS saves the ymm registers (OSXSAVE, XCR0 bits 1 and 2) */
+        int osxsave;
+
+        __cpuid(regs, 1);
+        osxsave = (regs[2] & (1 << 27)) != 0;
+        __cpuidex(regs, 7, 0);
+        if (osxsave && (regs[1] & (1 << 5)) && (_xgetbv(0) & 6) == 6)
+            return FAAC_SIMD_AVX2;
+    }
+    __cpuid(regs, 1);
+    return (regs[3] & (1 << 26)) ? FAAC_SIMD_SSE2 : FAAC_SIMD_NONE;
+#elif defined(FAAC_NEON)
+    /* NEON is part of aarch64 */
+    return FAAC_SIMD_NEON;
+#else
+    return FAAC_SIMD_NONE;
+#endif
+}
+
+int SimdLevel(void)
+{
+    if (simd_level < 0)
+        simd_level = CpuSimdLevel();
+    return simd_level;
+}
+
+int SetSimdLevel(int level)
+{
+    int best = CpuSimdLevel();
+
+    if (level == FAAC_SIMD_AUTO)
+        simd_level = best;
+    else if (level == FAAC_SIMD_NONE || level == best || (level == FAAC_SIMD_SSE2 && best == FAAC_SIMD_AVX2))
+        simd_level = level;
+    return SimdLevel();
+}
+
+#ifdef FAAC_X86
+static FAAC_TARGET_SSE2 int VecMulSSE2(double *out, const double *a, const double *b, int n)
+{
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    return i;
+}
+
+static FAAC_TARGET_AVX2 int VecMulAVX2(double *out, const double *a, const double *b, int n)
+{
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    return i;
+}
+
+static FAAC_TARGET_SSE2 int VecMulRevSSE2(double *out, const double *a, const double *b, int n)
+{
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+    {
+        __m128d r = _mm_loadu_pd(b + n - i - 2);
+        r = _mm_shuffle_pd(r, r, 1);
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), r));
+    }
+    return i;
+}
+
+static FAAC_TARGET_AVX2 int VecMulRevAVX2(double *out, const double *a, const double *b, int n)
+{
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m256d r = _mm256_permute4x64_pd(_mm256_loadu_pd(b + n - i - 4), _MM_SHUFFLE(0, 1, 2, 3));
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), r));
+    }
+    return i;
+}
+
+static FAAC_TARGET_SSE2 int VecScaleSSE2(double *x, double fac, int n)
+{
+    __m128d f = _mm_set1_pd(fac);
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+        _mm_storeu_pd(x + i, _mm_mul_pd(_mm_loadu_pd(x + i), f));
+    return i;
+}
+
+static FAAC_TARGET_AVX2 int VecScaleAVX2(double *x, double fac, int n)
+{
+    __m256d f = _mm256_set1_pd(fac);
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(x + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), f));
+    return i;
+}
+
+static FAAC_TARGET_SSE2 int VecEnergySSE2(const double *re, const double *im, int n, double *e)
+{
+    __m128d acc = _mm_setzero_pd();
+    double lanes[2];
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+    {
+        __m128d a = _mm_loadu_pd(re + i);
+        __m128d b = _mm_loadu_pd(im + i);
+        acc = _mm_add_pd(acc, _mm_add_pd(_mm_mul_pd(a, a), _mm_mul_pd(b, b)));
+    }
+    _mm_storeu_pd(lanes, acc);
+    *e = lanes[0] + lanes[1];
+    return i;
+}
+
+static FAAC_TARGET_AVX2 int VecEnergyAVX2(const double *re, const double *im, int n, double *e)
+{
+    __m256d acc = _mm256_setzero_pd();
+    double lanes[4];
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+    {
+        __m256d a = _mm256_loadu_pd(re + i);
+        __m256d b = _mm256_loadu_pd(im + i);
+        acc = _mm256_add_pd(acc, _mm256_add_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b)));
+    }
+    _mm256_storeu_pd(lanes, acc);
+    *e = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    return i;
+}
+#endif
+
+#ifdef FAAC_NEON
+static int VecMulNEON(double *out, const double *a, const double *b, int n)
+{
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+        vst1q_f64(out + i, vmulq_f64(vld1q_f64(a + i), vld1q_f64(b + i)));
+    return i;
+}
+
+static int VecMulRevNEON(double *out, const double *a, const double *b, int n)
+{
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+    {
+        float64x2_t r = vld1q_f64(b + n - i - 2);
+        r = vextq_f64(r, r, 1);
+        vst1q_f64(out + i, vmulq_f64(vld1q_f64(a + i), r));
+    }
+    return i;
+}
+
+static int VecScaleNEON(double *x, double fac, int n)
+{
+    float64x2_t f = vdupq_n_f64(fac);
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+        vst1q_f64(x + i, vmulq_f64(vld1q_f64(x + i), f));
+    return i;
+}
+
+static int VecEnergyNEON(const double *re, const double *im, int n, double *e)
+{
+    float64x2_t acc = vdupq_n_f64(0.0);
+    int i;
+
+    for (i = 0; i + 2 <= n; i += 2)
+    {
+        float64x2_t a = vld1q_f64(re + i);
+        float64x2_t b = vld1q_f64(im + i);
+        acc = vaddq_f64(acc, vaddq_f64(vmulq_f64(a, a), vmulq_f64(b, b)));
+    }
+    *e = vgetq_lane_f64(acc, 0) + vgetq_lane_f64(acc, 1);
+    return i;
+}
+#endif
+
+/* Each SIMD function does the leading multiple of its width and returns where
+   the scalar loop goes on */
+void VecMul(double *out, const double *a, const double *b, int n)
+{
+    int i = 0;
+
+    switch (SimdLevel())
+    {
+#ifdef FAAC_X86
+    case FAAC_SIMD_AVX2: i = VecMulAVX2(out, a, b, n); break;
+    case FAAC_SIMD_SSE2: i = VecMulSSE2(out, a, b, n); break;
+#endif
+#ifdef FAAC_NEON
+    case FAAC_SIMD_NEON: i = VecMulNEON(out, a, b, n); break;
+#endif
+    }
+    for (; i < n; i++)
+        out[i] = a[i] * b[i];
+}
+
+void VecMulRev(double *out, const double *a, const double *b, int n)
+{
+    int i = 0;
+
+    switch (SimdLevel())
+    {
+#ifdef FAAC_X86
+    case FAAC_SIMD_AVX2: i = VecMulRevAVX2(out, a, b, n); break;
+    case FAAC_SIMD_SSE2: i = VecMulRevSSE2(out, a, b, n); break;
+#endif
+#ifdef FAAC_NEON
+    case FAAC_SIMD_NEON: i = VecMulRevNEON(out, a, b, n); break;
+#endif
+    }
+    for (; i < n; i++)
+        out[i] = a[i] * b[n - 1 - i];
+}
+
+void VecScale(double *x, double fac, int n)
+{
+    int i = 0;
+
+    switch (SimdLevel())
+    {
+#ifdef FAAC_X86
+    case FAAC_SIMD_AVX2: i = VecScaleAVX2(x, fac, n); break;
+    case FAAC_SIMD_SSE2: i = VecScaleSSE2(x, fac, n); break;
+#endif
+#ifdef FAAC_NEON
+    case FAAC_SIMD_NEON: i = VecScaleNEON(x, fac, n); break;
+#endif
+    }
+    for (; i < n; i++)
+        x[i] *= fac;
+}
+
+double VecEnergy(const double *re, const double *im, int n)
+{
+    double e = 0.0;
+    int i = 0;
+
+    switch (SimdLevel())
+    {
+#ifdef FAAC_X86
+    case FAAC_SIMD_AVX2: i = VecEnergyAVX2(re, im, n, &e); break;
+    case FAAC_SIMD_SSE2: i = VecEnergySSE2(re, im, n, &e); break;
+#endif
+#ifdef FAAC_NEON
+    case FAAC_SIMD_NEON: i = VecEnergyNEON(re, im, n, &e); break;
+#endif
+    }
+    for (; i < n; i++)
+        e += re[i] * re[i] + im[i] * im[i];
+    return e;
+}
@@ -22,6 +22,26 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+/* SIMD on doubles: SSE2 and AVX2 on x86, NEON on aarch64. Each is built
+   beside the scalar code and picked at run time by SimdLevel(), see
+   faacEncSetSIMD(). Define FAAC_NO_SIMD to build the scalar code only. */
+#if !defined(FAAC_NO_SIMD)
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define FAAC_X86
+#include <immintrin.h>
+#if defined(__GNUC__)
+#define FAAC_TARGET_SSE2 __attribute__((target("sse2")))
+#define FAAC_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define FAAC_TARGET_SSE2
+#define FAAC_TARGET_AVX2
+#endif
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#define FAAC_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif /* __cplusplus */
@@ -52,6 +72,17 @@ unsigned int MinBitrate();
 unsigned int MaxBitresSize(unsigned long bitRate, unsigned long sampleRate);
 unsigned int BitAllocation(double pe, int short_block);
 
+/* The FAAC_SIMD_* level in use, the best the cpu has until faacEncSetSIMD() */
+int SimdLevel(void);
+int SetSimdLevel(int level);
+
+/* Vector helpers. VecMul, VecMulRev and VecScale give the same results as
+   the plain loops, VecEnergy sums in lanes, which only moves the rounding. */
+void VecMul(double *out, const double *a, const double *b, int n);        /* out[i] = a[i] * b[i] */
+void VecMulRev(double *out, const double *a, const double *b, int n);     /* out[i] = a[i] * b[n-1-i] */
+void VecScale(double *x, double fac, int n);                              /* x[i] *= fac */
+double VecEnergy(const double *re, const double *im, int n);              /* sum of re[i]^2 + im[i]^2 */
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -202,6 +202,11 @@ char* NEAACDECAPI NeAACDecGetErrorMessage(unsigned char errcode);
 
 unsigned long NEAACDECAPI NeAACDecGetCapabilities(void);
 
+/* Selects the SIMD code (enable != 0) or the scalar code for all decoders,
+   the SIMD code is the default when the cpu has it.
+   Returns 1 if the SIMD code is selected. */
+unsigned char NEAACDECAPI NeAACDecSetSIMD(unsigned char enable);
+
 NeAACDecHandle NEAACDECAPI NeAACDecOpen(void);
 
 NeAACDecConfigurationPtr NEAACDECAPI NeAACDecGetCurrentConfiguration(NeAACDecHandle hDecoder);
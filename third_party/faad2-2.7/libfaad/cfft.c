@@ -65,6 +65,62 @@ INLINE void cfftf1(uint16_t n, complex_t *c, complex_t *ch,
 static void cffti1(uint16_t n, complex_t *wa, uint16_t *ifac);
 
 
+#ifdef FAAD_SIMD
+/* Two butterflies of passf2pos (isign +1) or passf2neg (isign -1) */
+static INLINE SIMD_TARGET void passf2_simd(const complex_t *cc, complex_t *ch, const uint16_t ido,
+                               const uint16_t l1ido, const complex_t *wa, const int8_t isign)
+{
+    real4_t a0 = LD4((const real_t*)cc);
+    real4_t a1 = LD4((const real_t*)(cc + ido));
+    real4_t t2 = SUB4(a0, a1);
+
+    ST4((real_t*)ch, ADD4(a0, a1));
+    if (isign > 0)
+        ST4((real_t*)(ch + l1ido), ComplexMult2(t2, LD4((const real_t*)wa)));
+    else
+        ST4((real_t*)(ch + l1ido), ComplexMultConj2(t2, LD4((const real_t*)wa)));
+}
+
+/* Two butterflies of passf4pos (isign +1) or passf4neg (isign -1) */
+static INLINE SIMD_TARGET void passf4_simd(const complex_t *cc, complex_t *ch, const uint16_t ido,
+                               const uint16_t l1ido, const complex_t *wa1, const complex_t *wa2,
+                               const complex_t *wa3, const int8_t isign)
+{
+    real4_t a0 = LD4((const real_t*)cc);
+    real4_t a1 = LD4((const real_t*)(cc + ido));
+    real4_t a2 = LD4((const real_t*)(cc + 2*ido));
+    real4_t a3 = LD4((const real_t*)(cc + 3*ido));
+    real4_t t1 = SUB4(a0, a2);
+    real4_t t2 = ADD4(a0, a2);
+    real4_t t3 = ADD4(a1, a3);
+    real4_t t4 = ImRe2(SUB4(a3, a1), SUB4(a1, a3));
+    real4_t c2, c3, c4;
+
+    if (isign > 0)
+    {
+        c2 = ADD4(t1, t4);
+        c4 = SUB4(t1, t4);
+    } else {
+        c2 = SUB4(t1, t4);
+        c4 = ADD4(t1, t4);
+    }
+    c3 = SUB4(t2, t3);
+    ST4((real_t*)ch, ADD4(t2, t3));
+
+    if (isign > 0)
+    {
+        ST4((real_t*)(ch + l1ido), ComplexMult2(c2, LD4((const real_t*)wa1)));
+        ST4((real_t*)(ch + 2*l1ido), ComplexMult2(c3, LD4((const real_t*)wa2)));
+        ST4((real_t*)(ch + 3*l1ido), ComplexMult2(c4, LD4((const real_t*)wa3)));
+    } else {
+        ST4((real_t*)(ch + l1ido), ComplexMultConj2(c2, LD4((const real_t*)wa1)));
+        ST4((real_t*)(ch + 2*l1ido), ComplexMultConj2(c3, LD4((const real_t*)wa2)));
+        ST4((real_t*)(ch + 3*l1ido), ComplexMultConj2(c4, LD4((const real_t*)wa3)));
+    }
+}
+#endif
+
+
 /*----------------------------------------------------------------------
    passf2, passf3, passf4, passf5. Complex FFT passes fwd and bwd.
   ----------------------------------------------------------------------*/
@@ -92,7 +148,13 @@ static void passf2pos(const uint16_t ido, const uint16_t l1, const complex_t *cc
             ah = k*ido;
             ac = 2*k*ido;
 
-            for (i = 0; i < ido; i++)
+            i = 0;
+#ifdef FAAD_SIMD
+            if (SIMD_ENABLED())
+                for (; i + 2 <= ido; i += 2)
+                    passf2_simd(cc + ac + i, ch + ah + i, ido, l1*ido, wa + i, +1);
+#endif
+            for (; i < ido; i++)
             {
                 complex_t t2;
 
@@ -137,7 +199,13 @@ static void passf2neg(const uint16_t ido, const uint16_t l1, const complex_t *cc
             ah = k*ido;
             ac = 2*k*ido;
 
-            for (i = 0; i < ido; i++)
+            i = 0;
+#ifdef FAAD_SIMD
+            if (SIMD_ENABLED())
+                for (; i + 2 <= ido; i += 2)
+                    passf2_simd(cc + ac + i, ch + ah + i, ido, l1*ido, wa + i, -1);
+#endif
+            for (; i < ido; i++)
             {
                 complex_t t2;
 
@@ -340,7 +408,13 @@ static void passf4pos(const uint16_t ido, const uint16_t l1, const complex_t *cc
             ac = 4*k*ido;
             ah = k*ido;
 
-            for (i = 0; i < ido; i++)
+            i = 0;
+#ifdef FAAD_SIMD
+            if (SIMD_ENABLED())
+                for (; i + 2 <= ido; i += 2)
+                    passf4_simd(cc + ac + i, ch + ah + i, ido, l1*ido, wa1 + i, wa2 + i, wa3 + i, +1);
+#endif
+            for (; i < ido; i++)
             {
                 complex_t c2, c3, c4, t1, t2, t3, t4;
 
@@ -427,7 +501,13 @@ static void passf4neg(const uint16_t ido, const uint16_t l1, const complex_t *cc
             ac = 4*k*ido;
             ah = k*ido;
 
-            for (i = 0; i < ido; i++)
+            i = 0;
+#ifdef FAAD_SIMD
+            if (SIMD_ENABLED())
+                for (; i + 2 <= ido; i += 2)
+                    passf4_simd(cc + ac + i, ch + ah + i, ido, l1*ido, wa1 + i, wa2 + i, wa3 + i, -1);
+#endif
+            for (; i < ido; i++)
             {
                 complex_t c2, c3, c4, t1, t2, t3, t4;
 
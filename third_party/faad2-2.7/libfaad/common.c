@@ -36,6 +36,48 @@
 #include <stdlib.h>
 #include "syntax.h"
 
+#if defined(FAAD_SIMD) && (defined(__i386__) || defined(_M_IX86))
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+/* Returns 1 if the cpu runs the SIMD code of this build */
+uint8_t cpu_has_simd(void)
+{
+#if !defined(FAAD_SIMD)
+    return 0;
+#elif defined(__i386__) || defined(_M_IX86)
+    /* CPUID.1:EDX bit 26, SSE2 */
+#ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[3] & (1 << 26)) ? 1 : 0;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    return (edx & bit_SSE2) ? 1 : 0;
+#endif
+#else
+    /* SSE2 is part of x86-64, NEON is only built with -mfpu=neon or on arm64 */
+    return 1;
+#endif
+}
+
+#ifdef FAAD_SIMD
+int8_t faad_simd = -1;
+
+uint8_t simd_check(void)
+{
+    if (faad_simd < 0)
+        faad_simd = cpu_has_simd();
+    return faad_simd;
+}
+#endif
 
 /* Returns the sample rate index based on the samplerate */
 uint8_t get_sr_index(const uint32_t samplerate)
@@ -406,8 +406,123 @@ typedef real_t complex_t[2];
 #define IM(A) A[1]
 
 
+/* SIMD for the float build, SSE2 or NEON. The SIMD code is built on every
+   x86 and NEON target and selected at run time by SIMD_ENABLED(), the scalar
+   code is the fallback. Define FAAD_NO_SIMD to build the scalar code only.
+   The helpers do the same operations as the scalar code, in the same order. */
+#if !defined(FIXED_POINT) && !defined(USE_DOUBLE_PRECISION) && !defined(FAAD_NO_SIMD)
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define FAAD_SIMD
+#include <emmintrin.h>
+
+/* The functions using SSE2, when the build does not assume it */
+#if defined(__GNUC__) && !defined(__SSE2__)
+#define SIMD_TARGET __attribute__((target("sse2")))
+#else
+#define SIMD_TARGET
+#endif
+
+typedef __m128 real4_t;
+
+#define LD4(p)          _mm_loadu_ps(p)
+#define ST4(p, v)       _mm_storeu_ps(p, v)
+#define ADD4(a, b)      _mm_add_ps(a, b)
+#define SUB4(a, b)      _mm_sub_ps(a, b)
+#define MUL4(a, b)      _mm_mul_ps(a, b)
+#define SET4(a, b, c, d) _mm_setr_ps(a, b, c, d)
+
+/* p[0], p[2], p[4], p[6] */
+static INLINE SIMD_TARGET real4_t LdEven4(const real_t *p)
+{
+    return _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+/* Two complex numbers per vector: {IM(a), RE(b)} of each */
+static INLINE SIMD_TARGET real4_t ImRe2(real4_t a, real4_t b)
+{
+    real4_t t = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 3, 1));
+    return _mm_shuffle_ps(t, t, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+/* {x1*c1 - x2*c2, x2*c1 + x1*c2} of each complex x and c */
+static INLINE SIMD_TARGET real4_t ComplexMult2(real4_t x, real4_t c)
+{
+    const real4_t sign = _mm_castsi128_ps(_mm_setr_epi32(0x80000000, 0, 0x80000000, 0));
+    real4_t a = _mm_mul_ps(x, _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 0, 0)));
+    real4_t b = _mm_mul_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 1, 1)));
+    return _mm_add_ps(a, _mm_xor_ps(b, sign));
+}
+
+/* {x1*c1 + x2*c2, x2*c1 - x1*c2} of each complex x and c */
+static INLINE SIMD_TARGET real4_t ComplexMultConj2(real4_t x, real4_t c)
+{
+    const real4_t sign = _mm_castsi128_ps(_mm_setr_epi32(0, 0x80000000, 0, 0x80000000));
+    real4_t a = _mm_mul_ps(x, _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 0, 0)));
+    real4_t b = _mm_mul_ps(_mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 1, 1)));
+    return _mm_add_ps(a, _mm_xor_ps(b, sign));
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FAAD_SIMD
+#include <arm_neon.h>
+
+#define SIMD_TARGET
+
+typedef float32x4_t real4_t;
+
+#define LD4(p)          vld1q_f32(p)
+#define ST4(p, v)       vst1q_f32(p, v)
+#define ADD4(a, b)      vaddq_f32(a, b)
+#define SUB4(a, b)      vsubq_f32(a, b)
+#define MUL4(a, b)      vmulq_f32(a, b)
+
+static INLINE real4_t SET4(real_t a, real_t b, real_t c, real_t d)
+{
+    ALIGN real_t v[4];
+    v[0] = a; v[1] = b; v[2] = c; v[3] = d;
+    return vld1q_f32(v);
+}
+
+static INLINE real4_t LdEven4(const real_t *p)
+{
+    return vld2q_f32(p).val[0];
+}
+
+static INLINE real4_t ImRe2(real4_t a, real4_t b)
+{
+    return vtrnq_f32(vrev64q_f32(a), b).val[0];
+}
+
+static INLINE real4_t ComplexMult2(real4_t x, real4_t c)
+{
+    static const uint32_t sign[4] = { 0x80000000, 0, 0x80000000, 0 };
+    float32x4x2_t cc = vtrnq_f32(c, c);
+    real4_t a = vmulq_f32(x, cc.val[0]);
+    real4_t b = vmulq_f32(vrev64q_f32(x), cc.val[1]);
+    return vaddq_f32(a, vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(b), vld1q_u32(sign))));
+}
+
+static INLINE real4_t ComplexMultConj2(real4_t x, real4_t c)
+{
+    static const uint32_t sign[4] = { 0, 0x80000000, 0, 0x80000000 };
+    float32x4x2_t cc = vtrnq_f32(c, c);
+    real4_t a = vmulq_f32(x, cc.val[0]);
+    real4_t b = vmulq_f32(vrev64q_f32(x), cc.val[1]);
+    return vaddq_f32(a, vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(b), vld1q_u32(sign))));
+}
+#endif
+#endif
+
+#ifdef FAAD_SIMD
+/* -1 until the cpu is checked, then 1 for the SIMD code, 0 for the scalar code */
+extern int8_t faad_simd;
+uint8_t simd_check(void);
+#define SIMD_ENABLED() (faad_simd > 0 || (faad_simd < 0 && simd_check()))
+#endif
+
+
 /* common functions */
-uint8_t cpu_has_sse(void);
+uint8_t cpu_has_simd(void);
 uint32_t ne_rng(uint32_t *__r1, uint32_t *__r2);
 uint32_t wl_min_lzc(uint32_t x);
 #ifdef FIXED_POINT
@@ -97,6 +97,16 @@ unsigned long NEAACDECAPI NeAACDecGetCapabilities(void)
     return cap;
 }
 
+unsigned char NEAACDECAPI NeAACDecSetSIMD(unsigned char enable)
+{
+#ifdef FAAD_SIMD
+    faad_simd = (enable && cpu_has_simd()) ? 1 : 0;
+    return faad_simd;
+#else
+    return 0;
+#endif
+}
+
 const unsigned char mes[] = { 0x67,0x20,0x61,0x20,0x20,0x20,0x6f,0x20,0x72,0x20,0x65,0x20,0x6e,0x20,0x20,0x20,0x74,0x20,0x68,0x20,0x67,0x20,0x69,0x20,0x72,0x20,0x79,0x20,0x70,0x20,0x6f,0x20,0x63 };
 NeAACDecHandle NEAACDECAPI NeAACDecOpen(void)
 {
@@ -119,6 +119,33 @@ void faad_mdct_end(mdct_info *mdct)
     }
 }
 
+#ifdef FAAD_SIMD
+/* Z1[k] = {x2, x1} * sincos[k] of the pre-IFFT twiddle, two at a time,
+   returns the k the scalar code goes on from */
+static SIMD_TARGET uint16_t imdct_pre_twiddle_simd(complex_t *Z1, const real_t *X_in,
+                                                   const complex_t *sincos, uint16_t N2, uint16_t N4)
+{
+    uint16_t k;
+
+    for (k = 0; k + 2 <= N4; k += 2)
+    {
+        real4_t x = SET4(X_in[N2 - 1 - 2*k], X_in[2*k], X_in[N2 - 3 - 2*k], X_in[2*k + 2]);
+        ST4((real_t*)(Z1 + k), ComplexMult2(x, LD4((const real_t*)(sincos + k))));
+    }
+    return k;
+}
+
+/* Z1[k] = Z1[k] * sincos[k] of the post-IFFT twiddle, two at a time */
+static SIMD_TARGET uint16_t imdct_post_twiddle_simd(complex_t *Z1, const complex_t *sincos, uint16_t N4)
+{
+    uint16_t k;
+
+    for (k = 0; k + 2 <= N4; k += 2)
+        ST4((real_t*)(Z1 + k), ComplexMult2(LD4((const real_t*)(Z1 + k)), LD4((const real_t*)(sincos + k))));
+    return k;
+}
+#endif
+
 void faad_imdct(mdct_info *mdct, real_t *X_in, real_t *X_out)
 {
     uint16_t k;
@@ -155,7 +182,12 @@ void faad_imdct(mdct_info *mdct, real_t *X_in, real_t *X_out)
 #endif
 
     /* pre-IFFT complex multiplication */
-    for (k = 0; k < N4; k++)
+    k = 0;
+#ifdef FAAD_SIMD
+    if (SIMD_ENABLED())
+        k = imdct_pre_twiddle_simd(Z1, X_in, sincos, N2, N4);
+#endif
+    for (; k < N4; k++)
     {
         ComplexMult(&IM(Z1[k]), &RE(Z1[k]),
             X_in[2*k], X_in[N2 - 1 - 2*k], RE(sincos[k]), IM(sincos[k]));
@@ -173,7 +205,12 @@ void faad_imdct(mdct_info *mdct, real_t *X_in, real_t *X_out)
 #endif
 
     /* post-IFFT complex multiplication */
-    for (k = 0; k < N4; k++)
+    k = 0;
+#ifdef FAAD_SIMD
+    if (SIMD_ENABLED())
+        k = imdct_post_twiddle_simd(Z1, sincos, N4);
+#endif
+    for (; k < N4; k++)
     {
         RE(x) = RE(Z1[k]);
         IM(x) = IM(Z1[k]);
@@ -1892,6 +1892,52 @@ static const real_t w_array_imag[] = {
     FRAC_CONST(-0.382683361692986), FRAC_CONST(-0.195090241632088)
 };
 
+#ifdef FAAD_SIMD
+/* Stage 1 of fft_dif, four butterflies at a time */
+static SIMD_TARGET void fft_dif_stage1_simd(real_t * Real, real_t * Imag)
+{
+    uint32_t i;
+
+    for (i = 0; i < 16; i += 4)
+    {
+        real4_t p1r = LD4(Real + i), p1i = LD4(Imag + i);
+        real4_t p2r = LD4(Real + i + 16), p2i = LD4(Imag + i + 16);
+        real4_t wr = LD4(w_array_real + i), wi = LD4(w_array_imag + i);
+
+        ST4(Real + i, ADD4(p1r, p2r));
+        ST4(Imag + i, ADD4(p1i, p2i));
+        p1r = SUB4(p1r, p2r);
+        p1i = SUB4(p1i, p2i);
+        ST4(Real + i + 16, SUB4(MUL4(p1r, wr), MUL4(p1i, wi)));
+        ST4(Imag + i + 16, ADD4(MUL4(p1r, wi), MUL4(p1i, wr)));
+    }
+}
+
+/* Stage 2 of fft_dif, four butterflies at a time */
+static SIMD_TARGET void fft_dif_stage2_simd(real_t * Real, real_t * Imag)
+{
+    uint32_t i, j;
+
+    for (j = 0; j < 8; j += 4)
+    {
+        real4_t wr = LdEven4(w_array_real + 2*j), wi = LdEven4(w_array_imag + 2*j);
+
+        for (i = j; i < n; i += 16)
+        {
+            real4_t p1r = LD4(Real + i), p1i = LD4(Imag + i);
+            real4_t p2r = LD4(Real + i + 8), p2i = LD4(Imag + i + 8);
+
+            ST4(Real + i, ADD4(p1r, p2r));
+            ST4(Imag + i, ADD4(p1i, p2i));
+            p1r = SUB4(p1r, p2r);
+            p1i = SUB4(p1i, p2i);
+            ST4(Real + i + 8, SUB4(MUL4(p1r, wr), MUL4(p1i, wi)));
+            ST4(Imag + i + 8, ADD4(MUL4(p1r, wi), MUL4(p1i, wr)));
+        }
+    }
+}
+#endif
+
 // FFT decimation in frequency
 // 4*16*2+16=128+16=144 multiplications
 // 6*16*2+10*8+4*16*2=192+80+128=400 additions
@@ -1905,6 +1951,11 @@ static void fft_dif(real_t * Real, real_t * Imag)
     // 4*16*2=64*2=128 multiplications
     // 6*16*2=96*2=192 additions
 	// Stage 1 of 32 point FFT decimation in frequency
+#ifdef FAAD_SIMD
+    if (SIMD_ENABLED())
+        fft_dif_stage1_simd(Real, Imag);
+    else
+#endif
     for (i = 0; i < 16; i++)
     {
         point1_real = Real[i];
@@ -1929,6 +1980,11 @@ static void fft_dif(real_t * Real, real_t * Imag)
         Imag[i2] = (MUL_F(point1_real,w_imag) + MUL_F(point1_imag,w_real));
      }
     // Stage 2 of 32 point FFT decimation in frequency
+#ifdef FAAD_SIMD
+    if (SIMD_ENABLED())
+        fft_dif_stage2_simd(Real, Imag);
+    else
+#endif
     for (j = 0, w_index = 0; j < 8; j++, w_index += 2)
     {
         w_real = w_array_real[w_index];
@@ -2221,6 +2277,46 @@ static const real_t dct4_64_tab[] = {
     COEF_CONST(0.897167563438416), COEF_CONST(0.949727773666382)
 };
 
+#ifdef FAAD_SIMD
+/* Step 2 of dct4_kernel, four at a time */
+static SIMD_TARGET void dct4_modulate_simd(real_t * in_real, real_t * in_imag)
+{
+    uint32_t i;
+
+    for (i = 0; i < 32; i += 4)
+    {
+        real4_t x_re = LD4(in_real + i);
+        real4_t x_im = LD4(in_imag + i);
+        real4_t tmp = MUL4(ADD4(x_re, x_im), LD4(dct4_64_tab + i));
+
+        ST4(in_real + i, ADD4(MUL4(x_im, LD4(dct4_64_tab + i + 64)), tmp));
+        ST4(in_imag + i, ADD4(MUL4(x_re, LD4(dct4_64_tab + i + 32)), tmp));
+    }
+}
+
+/* Step 4 of dct4_kernel, four at a time */
+static SIMD_TARGET void dct4_reorder_simd(const real_t * in_real, const real_t * in_imag,
+                                          real_t * out_real, real_t * out_imag, const uint8_t * bit_rev_tab)
+{
+    uint32_t i;
+
+    for (i = 0; i < 32; i += 4)
+    {
+        real4_t x_re = SET4(in_real[bit_rev_tab[i]], in_real[bit_rev_tab[i + 1]],
+            in_real[bit_rev_tab[i + 2]], in_real[bit_rev_tab[i + 3]]);
+        real4_t x_im = SET4(in_imag[bit_rev_tab[i]], in_imag[bit_rev_tab[i + 1]],
+            in_imag[bit_rev_tab[i + 2]], in_imag[bit_rev_tab[i + 3]]);
+        real4_t tmp = MUL4(ADD4(x_re, x_im), LD4(dct4_64_tab + i + 3*32));
+
+        ST4(out_real + i, ADD4(MUL4(x_im, LD4(dct4_64_tab + i + 5*32)), tmp));
+        ST4(out_imag + i, ADD4(MUL4(x_re, LD4(dct4_64_tab + i + 4*32)), tmp));
+    }
+    // i = 16, i_rev = 1 = rev(16);
+    out_imag[16] = MUL_C(in_imag[1] - in_real[1], dct4_64_tab[16 + 3*32]);
+    out_real[16] = MUL_C(in_real[1] + in_imag[1], dct4_64_tab[16 + 3*32]);
+}
+#endif
+
 /* size 64 only! */
 void dct4_kernel(real_t * in_real, real_t * in_imag, real_t * out_real, real_t * out_imag)
 {
@@ -2231,6 +2327,11 @@ void dct4_kernel(real_t * in_real, real_t * in_imag, real_t * out_real, real_t *
     /* Step 2: modulate */
     // 3*32=96 multiplications
     // 3*32=96 additions
+#ifdef FAAD_SIMD
+    if (SIMD_ENABLED())
+        dct4_modulate_simd(in_real, in_imag);
+    else
+#endif
     for (i = 0; i < 32; i++)
     {
     	real_t x_re, x_im, tmp;
@@ -2247,6 +2348,13 @@ void dct4_kernel(real_t * in_real, real_t * in_imag, real_t * out_real, real_t *
     /* Step 4: modulate + bitreverse reordering */
     // 3*31+2=95 multiplications
     // 3*31+2=95 additions
+#ifdef FAAD_SIMD
+    if (SIMD_ENABLED())
+    {
+        dct4_reorder_simd(in_real, in_imag, out_real, out_imag, bit_rev_tab);
+        return;
+    }
+#endif
     for (i = 0; i < 16; i++)
     {
     	real_t x_re, x_im, tmp;
@@ -2271,7 +2379,6 @@ void dct4_kernel(real_t * in_real, real_t * in_imag, real_t * out_real, real_t *
         out_real[i] = MUL_C(x_im, dct4_64_tab[i + 5*32]) + tmp;
         out_imag[i] = MUL_C(x_re, dct4_64_tab[i + 4*32]) + tmp;
     }
-
 }
 
 #endif
@@ -66,6 +66,26 @@ void qmfa_end(qmfa_info *qmfa)
     }
 }
 
+#ifdef FAAD_SIMD
+/* u[n] of the analysis window, four at a time */
+static SIMD_TARGET void qmfa_window_simd(real_t *u, const real_t *x)
+{
+    int16_t n;
+
+    for (n = 0; n < 64; n += 4)
+    {
+        const real_t *px = x + n;
+
+        ST4(u + n, ADD4(ADD4(ADD4(ADD4(
+            MUL4(LD4(px), LdEven4(qmf_c + 2*n)),
+            MUL4(LD4(px + 64), LdEven4(qmf_c + 2*(n + 64)))),
+            MUL4(LD4(px + 128), LdEven4(qmf_c + 2*(n + 128)))),
+            MUL4(LD4(px + 192), LdEven4(qmf_c + 2*(n + 192)))),
+            MUL4(LD4(px + 256), LdEven4(qmf_c + 2*(n + 256)))));
+    }
+}
+#endif
+
 void sbr_qmf_analysis_32(sbr_info *sbr, qmfa_info *qmfa, const real_t *input,
                          qmf_t X[MAX_NTSRHFG][64], uint8_t offset, uint8_t kx)
 {
@@ -98,7 +118,15 @@ void sbr_qmf_analysis_32(sbr_info *sbr, qmfa_info *qmfa, const real_t *input,
         }
 
         /* window and summation to create array u */
-        for (n = 0; n < 64; n++)
+        n = 0;
+#ifdef FAAD_SIMD
+        if (SIMD_ENABLED())
+        {
+            qmfa_window_simd(u, qmfa->x + qmfa->x_index);
+            n = 64;
+        }
+#endif
+        for (; n < 64; n++)
         {
             u[n] = MUL_F(qmfa->x[qmfa->x_index + n], qmf_c[2*n]) +
                 MUL_F(qmfa->x[qmfa->x_index + n + 64], qmf_c[2*(n + 64)]) +
@@ -388,6 +416,31 @@ void sbr_qmf_synthesis_64(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][6
     }
 }
 #else
+#ifdef FAAD_SIMD
+/* 32 output samples of the synthesis window, four at a time */
+static SIMD_TARGET void qmfs_window32_simd(real_t *output, const real_t *v)
+{
+    uint16_t k;
+
+    for (k = 0; k < 32; k += 4)
+    {
+        const real_t *pv = v + k;
+
+        ST4(output + k, ADD4(ADD4(ADD4(ADD4(ADD4(ADD4(ADD4(ADD4(ADD4(
+            MUL4(LD4(pv), LdEven4(qmf_c + 2*k)),
+            MUL4(LD4(pv + 96), LdEven4(qmf_c + 64 + 2*k))),
+            MUL4(LD4(pv + 128), LdEven4(qmf_c + 128 + 2*k))),
+            MUL4(LD4(pv + 224), LdEven4(qmf_c + 192 + 2*k))),
+            MUL4(LD4(pv + 256), LdEven4(qmf_c + 256 + 2*k))),
+            MUL4(LD4(pv + 352), LdEven4(qmf_c + 320 + 2*k))),
+            MUL4(LD4(pv + 384), LdEven4(qmf_c + 384 + 2*k))),
+            MUL4(LD4(pv + 480), LdEven4(qmf_c + 448 + 2*k))),
+            MUL4(LD4(pv + 512), LdEven4(qmf_c + 512 + 2*k))),
+            MUL4(LD4(pv + 608), LdEven4(qmf_c + 576 + 2*k))));
+    }
+}
+#endif
+
 void sbr_qmf_synthesis_32(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][64],
                           real_t *output)
 {
@@ -433,7 +486,16 @@ void sbr_qmf_synthesis_32(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][6
         }
 
         /* calculate 32 output samples and window */
-        for (k = 0; k < 32; k++)
+        k = 0;
+#ifdef FAAD_SIMD
+        if (SIMD_ENABLED())
+        {
+            qmfs_window32_simd(output + out, qmfs->v + qmfs->v_index);
+            out += 32;
+            k = 32;
+        }
+#endif
+        for (; k < 32; k++)
         {
             output[out++] = MUL_F(qmfs->v[qmfs->v_index + k], qmf_c[2*k]) +
                 MUL_F(qmfs->v[qmfs->v_index + 96 + k], qmf_c[64 + 2*k]) +
@@ -454,6 +516,31 @@ void sbr_qmf_synthesis_32(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][6
     }
 }
 
+#if defined(FAAD_SIMD) && !defined(PREFER_POINTERS)
+/* 64 output samples of the synthesis window, four at a time */
+static SIMD_TARGET void qmfs_window64_simd(real_t *output, const real_t *v)
+{
+    uint16_t k;
+
+    for (k = 0; k < 64; k += 4)
+    {
+        const real_t *pv = v + k;
+
+        ST4(output + k, ADD4(ADD4(ADD4(ADD4(ADD4(ADD4(ADD4(ADD4(ADD4(
+            MUL4(LD4(pv),              LD4(qmf_c + k)),
+            MUL4(LD4(pv + 192),        LD4(qmf_c + k + 64))),
+            MUL4(LD4(pv + 256),        LD4(qmf_c + k + 128))),
+            MUL4(LD4(pv + (256+192)),  LD4(qmf_c + k + 192))),
+            MUL4(LD4(pv + 512),        LD4(qmf_c + k + 256))),
+            MUL4(LD4(pv + (512+192)),  LD4(qmf_c + k + 320))),
+            MUL4(LD4(pv + 768),        LD4(qmf_c + k + 384))),
+            MUL4(LD4(pv + (768+192)),  LD4(qmf_c + k + 448))),
+            MUL4(LD4(pv + 1024),       LD4(qmf_c + k + 512))),
+            MUL4(LD4(pv + (1024+192)), LD4(qmf_c + k + 576))));
+    }
+}
+#endif
+
 void sbr_qmf_synthesis_64(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][64],
                           real_t *output)
 {
@@ -596,7 +683,16 @@ void sbr_qmf_synthesis_64(sbr_info *sbr, qmfs_info *qmfs, qmf_t X[MAX_NTSRHFG][6
 #endif // #ifdef PREFER_POINTERS
 
         /* calculate 64 output samples and window */
-        for (k = 0; k < 64; k++)
+        k = 0;
+#if defined(FAAD_SIMD) && !defined(PREFER_POINTERS)
+        if (SIMD_ENABLED())
+        {
+            qmfs_window64_simd(output + out, pring_buffer_1);
+            out += 64;
+            k = 64;
+        }
+#endif
+        for (; k < 64; k++)
         {
 #ifdef PREFER_POINTERS
             output[out++] =
@@ -78,6 +78,7 @@
         'safe_conversions.h',
         'safe_conversions_impl.h',
         'scoped_ref_ptr.h',
+        'spsc_queue.h',
         'stringencode.cc',
         'stringencode.h',
         'stringutils.cc',
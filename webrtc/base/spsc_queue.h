@@ -0,0 +1,142 @@
+/*
+ *  Copyright (c) 2016 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef WEBRTC_BASE_SPSC_QUEUE_H_
+#define WEBRTC_BASE_SPSC_QUEUE_H_
+
+#include <stddef.h>
+
+#include <utility>
+#include <vector>
+
+#include "webrtc/base/atomicops.h"
+#include "webrtc/base/checks.h"
+#include "webrtc/base/constructormagic.h"
+
+namespace rtc {
+
+// Bounded, lock-free queue for handing items from exactly one producer
+// thread to exactly one consumer thread.
+//
+// Push() may only be called on the producer thread. Pop(), Front() and
+// Back() may only be called on the consumer thread. Size() and Empty() are
+// safe on any thread but only return a snapshot.
+//
+// All storage is allocated up front: the capacity is rounded up to a power
+// of two and Push() fails instead of growing when the queue is full. Head
+// and tail live on separate cache lines, and each side caches the other
+// side's index so that the shared index is only reloaded when the cached
+// value says the queue is full (producer) or empty (consumer).
+template <typename T>
+class SpscQueue {
+ public:
+  explicit SpscQueue(size_t capacity)
+      : mask_(RoundUpToPowerOfTwo(capacity) - 1),
+        items_(mask_ + 1),
+        head_(0),
+        cached_tail_(0),
+        tail_(0),
+        cached_head_(0) {
+    RTC_DCHECK_GT(capacity, 0u);
+  }
+
+  // Producer side. Returns false, leaving |item| untouched, if the queue is
+  // full.
+  bool Push(T* item) {
+    const unsigned int tail = static_cast<unsigned int>(tail_);
+    if (tail - cached_head_ > mask_) {
+      cached_head_ = static_cast<unsigned int>(AtomicOps::AcquireLoad(&head_));
+      if (tail - cached_head_ > mask_)
+        return false;
+    }
+    using std::swap;
+    swap(items_[tail & mask_], *item);
+    AtomicOps::ReleaseStore(&tail_, static_cast<int>(tail + 1));
+    return true;
+  }
+
+  // Consumer side. Returns false if the queue is empty.
+  bool Pop(T* item) {
+    const unsigned int head = static_cast<unsigned int>(head_);
+    if (!HasItem(head))
+      return false;
+    using std::swap;
+    swap(items_[head & mask_], *item);
+    AtomicOps::ReleaseStore(&head_, static_cast<int>(head + 1));
+    return true;
+  }
+
+  // Consumer side. Oldest item, or NULL if the queue is empty.
+  T* Front() {
+    const unsigned int head = static_cast<unsigned int>(head_);
+    if (!HasItem(head))
+      return NULL;
+    return &items_[head & mask_];
+  }
+
+  // Consumer side. Newest item published so far, or NULL if the queue is
+  // empty.
+  T* Back() {
+    const unsigned int head = static_cast<unsigned int>(head_);
+    cached_tail_ = static_cast<unsigned int>(AtomicOps::AcquireLoad(&tail_));
+    if (head == cached_tail_)
+      return NULL;
+    return &items_[(cached_tail_ - 1) & mask_];
+  }
+
+  size_t Size() const {
+    const unsigned int head =
+        static_cast<unsigned int>(AtomicOps::AcquireLoad(&head_));
+    const unsigned int tail =
+        static_cast<unsigned int>(AtomicOps::AcquireLoad(&tail_));
+    return tail - head;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  size_t Capacity() const { return mask_ + 1; }
+
+ private:
+  static unsigned int RoundUpToPowerOfTwo(size_t n) {
+    unsigned int v = 1;
+    while (v < n)
+      v <<= 1;
+    return v;
+  }
+
+  bool HasItem(unsigned int head) {
+    if (head != cached_tail_)
+      return true;
+    cached_tail_ = static_cast<unsigned int>(AtomicOps::AcquireLoad(&tail_));
+    return head != cached_tail_;
+  }
+
+  enum { kCacheLineSize = 64 };
+
+  const unsigned int mask_;
+  std::vector<T> items_;
+
+  // Owned by the consumer.
+  char pad0_[kCacheLineSize];
+  volatile int head_;
+  unsigned int cached_tail_;
+
+  // Owned by the producer.
+  char pad1_[kCacheLineSize];
+  volatile int tail_;
+  unsigned int cached_head_;
+  char pad2_[kCacheLineSize];
+
+  RTC_DISALLOW_COPY_AND_ASSIGN(SpscQueue);
+};
+
+}  // namespace rtc
+
+#endif  // WEBRTC_BASE_SPSC_QUEUE_H_
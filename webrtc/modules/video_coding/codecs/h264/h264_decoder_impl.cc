@@ -35,6 +35,9 @@ const size_t kYPlaneIndex = 0;
 const size_t kUPlaneIndex = 1;
 const size_t kVPlaneIndex = 2;
 
+// More threads don't pay off for a single stream and only add frame delay.
+const int kMaxDecoderThreads = 8;
+
 // Used by histograms. Values of entries should not be changed.
 enum H264DecoderImplEvent {
   kH264DecoderEventInit = 0,
@@ -181,6 +184,7 @@ void H264DecoderImpl::AVFreeBuffer2(void* opaque, uint8_t* data) {
 
 H264DecoderImpl::H264DecoderImpl() : pool_(true),
                                      decoded_image_callback_(nullptr),
+                                     thread_type_(kThreadSlice),
                                      has_reported_init_(false),
                                      has_reported_error_(false) {
 }
@@ -231,10 +235,22 @@ int32_t H264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
   av_context_->extradata = nullptr;
   av_context_->extradata_size = 0;
 
-  // If this is ever increased, look at |av_context_->thread_safe_callbacks| and
-  // make it possible to disable the thread checker in the frame buffer pool.
-  av_context_->thread_count = 1;
-  av_context_->thread_type = FF_THREAD_SLICE;
+  // |av_context_->thread_safe_callbacks| is left unset: with frame threads
+  // FFmpeg then calls |AVGetBuffer2| on the thread calling |Decode|, which
+  // keeps the thread checker of the frame buffer pool happy.
+  av_context_->thread_count =
+      std::max(1, std::min<int>(number_of_cores, kMaxDecoderThreads));
+  switch (thread_type_) {
+    case kThreadSlice:
+      av_context_->thread_type = FF_THREAD_SLICE;
+      break;
+    case kThreadFrame:
+      av_context_->thread_type = FF_THREAD_FRAME;
+      break;
+    case kThreadAuto:
+      av_context_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+      break;
+  }
 
   // Function used by FFmpeg to get buffers to store decoded frames in.
   av_context_->get_buffer2 = AVGetBuffer2;
@@ -262,6 +278,8 @@ int32_t H264DecoderImpl::InitDecode(const VideoCodec* codec_settings,
   }
 
   av_frame_.reset(av_frame_alloc());
+  LOG(LS_INFO) << "H264DecoderImpl decodes on " << av_context_->thread_count
+               << " threads, thread type: " << av_context_->active_thread_type;
   return WEBRTC_VIDEO_CODEC_OK;
 }
 
@@ -277,6 +295,10 @@ int32_t H264DecoderImpl::RegisterDecodeCompleteCallback(
   return WEBRTC_VIDEO_CODEC_OK;
 }
 
+void H264DecoderImpl::SetThreadType(ThreadType thread_type) {
+  thread_type_ = thread_type;
+}
+
 int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
                                 bool /*missing_frames*/,
                                 const RTPFragmentationHeader* /*fragmentation*/,
@@ -322,7 +344,9 @@ int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
     return WEBRTC_VIDEO_CODEC_ERROR;
   }
   packet.size = static_cast<int>(input_image._length);
-  av_context_->reordered_opaque = input_image.ntp_time_ms_ * 1000;  // ms -> μs
+  // With frame threads the decoded frame is not the one of |input_image|, its
+  // timestamp is carried through FFmpeg instead.
+  av_context_->reordered_opaque = input_image._timeStamp;
 
   int frame_decoded = 0;
   int result = avcodec_decode_video2(av_context_.get(),
@@ -343,8 +367,11 @@ int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
   }
 
   if (!frame_decoded) {
-    LOG(LS_WARNING) << "avcodec_decode_video2 successful but no frame was "
-        "decoded.";
+    // Expected while the frame threads fill up.
+    if (!(av_context_->active_thread_type & FF_THREAD_FRAME)) {
+      LOG(LS_WARNING) << "avcodec_decode_video2 successful but no frame was "
+          "decoded.";
+    }
     return WEBRTC_VIDEO_CODEC_OK;
   }
 
@@ -358,7 +385,8 @@ int32_t H264DecoderImpl::Decode(const EncodedImage& input_image,
                video_frame->video_frame_buffer()->DataU());
   RTC_CHECK_EQ(av_frame_->data[kVPlane],
                video_frame->video_frame_buffer()->DataV());
-  video_frame->set_timestamp(input_image._timeStamp);
+  video_frame->set_timestamp(
+      static_cast<uint32_t>(av_frame_->reordered_opaque));
 
   int32_t ret;
 
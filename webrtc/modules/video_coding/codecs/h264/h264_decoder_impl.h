@@ -45,6 +45,8 @@ class H264DecoderImpl : public H264Decoder {
   int32_t RegisterDecodeCompleteCallback(
       DecodedImageCallback* callback) override;
 
+  void SetThreadType(ThreadType thread_type) override;
+
   // |missing_frames|, |fragmentation| and |render_time_ms| are ignored.
   int32_t Decode(const EncodedImage& input_image,
                  bool /*missing_frames*/,
@@ -72,6 +74,7 @@ class H264DecoderImpl : public H264Decoder {
   std::unique_ptr<AVFrame, AVFrameDeleter> av_frame_;
 
   DecodedImageCallback* decoded_image_callback_;
+  ThreadType thread_type_;
 
   bool has_reported_init_;
   bool has_reported_error_;
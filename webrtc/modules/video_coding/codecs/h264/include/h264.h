@@ -44,9 +44,25 @@ class H264Encoder : public VideoEncoder {
 
 class H264Decoder : public VideoDecoder {
  public:
+  // How a software decoder spreads the work over |number_of_cores| threads.
+  enum ThreadType {
+    // Threads decode slices of the same frame. No added delay, but it only
+    // helps streams encoded with several slices per frame.
+    kThreadSlice,
+    // Threads decode consecutive frames. Output is delayed by one frame per
+    // extra thread.
+    kThreadFrame,
+    // Frame threads where possible, slice threads otherwise.
+    kThreadAuto,
+  };
+
   static H264Decoder* Create();
   static bool IsSupported();
 
+  // Takes effect on the next |InitDecode|. Decoders that don't decode on
+  // threads of their own ignore it.
+  virtual void SetThreadType(ThreadType thread_type) {}
+
   ~H264Decoder() override {}
 };
 